@@ -56,6 +56,16 @@ enum C2AmlParamIndexKind : C2Param::type_index_t {
 
     /*these are Video Encoder config parameters.*/
     kParamIndexVendorVencCanvasMode = C2Param:: TYPE_INDEX_VENDOR_START + 0x400,
+    kParamIndexVendorVencRoiRegions,
+    kParamIndexVendorVencQpOffsetMap,
+    kParamIndexVendorVencMaxLayer,
+    kParamIndexVendorVencLtrInterval,
+    kParamIndexVendorVencLtrRecovery,
+    kParamIndexVendorVencFrameRefInfo,
+    kParamIndexVendorVencIntraRefreshInfo,
+    kParamIndexVendorVencStats,
+    kParamIndexVendorVencMaxBitrate,
+    kParamIndexVendorVencBackPressure,
 };
 
 struct C2StreamPtsUnstableStruct {
@@ -337,6 +347,121 @@ typedef C2PortParam<C2Setting, C2Int32Value, kParamIndexVendorVencCanvasMode> C2
 constexpr char C2_PARAMKEY_VENDOR_VENC_CANVAS_MODE[] = "venc.canvasmode";
 constexpr char KEY_VENDOR_CANVAS_MODE[] = "vendor.venc.canvasmode.value";
 
+/* region of interest, a rectangle in pixels of the coded picture and the qp delta applied to it. */
+struct C2VencRoiRegionStruct {
+    inline C2VencRoiRegionStruct() = default;
+    inline C2VencRoiRegionStruct(int32_t left_, int32_t top_, int32_t width_, int32_t height_, int32_t qpDelta_)
+        : left(left_), top(top_), width(width_), height(height_), qpDelta(qpDelta_) {}
+    int32_t left;
+    int32_t top;
+    int32_t width;
+    int32_t height;
+    int32_t qpDelta;
+    DEFINE_AND_DESCRIBE_C2STRUCT(VencRoiRegion)
+    C2FIELD(left, "left")
+    C2FIELD(top, "top")
+    C2FIELD(width, "width")
+    C2FIELD(height, "height")
+    C2FIELD(qpDelta, "qp-delta")
+};
+typedef C2StreamParam<C2Tuning, C2SimpleArrayStruct<C2VencRoiRegionStruct>, kParamIndexVendorVencRoiRegions> C2StreamVencRoiRegions;
+constexpr char C2_PARAMKEY_VENDOR_VENC_ROI_REGIONS[] = "venc.roi-regions";
+
+/* qp delta (int8) of each 16x16 block in raster order, an empty blob disables it. */
+typedef C2StreamParam<C2Tuning, C2BlobValue, kParamIndexVendorVencQpOffsetMap> C2StreamVencQpOffsetMap;
+constexpr char C2_PARAMKEY_VENDOR_VENC_QP_OFFSET_MAP[] = "venc.qp-offset-map";
+constexpr char KEY_VENDOR_QP_OFFSET_MAP[] = "vendor.venc.qp-offset-map.value";
+
+/* highest temporal layer to encode, the frames of the layers above are dropped. -1 keeps all the layers. */
+typedef C2StreamParam<C2Tuning, C2Int32Value, kParamIndexVendorVencMaxLayer> C2StreamVencMaxLayer;
+constexpr char C2_PARAMKEY_VENDOR_VENC_MAX_LAYER[] = "venc.max-layer";
+constexpr char KEY_VENDOR_MAX_LAYER[] = "vendor.venc.max-layer.value";
+
+/* base layer frames between two long term reference marks, 0 only marks the IDR frames. */
+typedef C2StreamParam<C2Tuning, C2Uint32Value, kParamIndexVendorVencLtrInterval> C2StreamVencLtrInterval;
+constexpr char C2_PARAMKEY_VENDOR_VENC_LTR_INTERVAL[] = "venc.ltr-interval";
+constexpr char KEY_VENDOR_LTR_INTERVAL[] = "vendor.venc.ltr-interval.value";
+
+/* set to 1 on a loss, the next frame references the last long term reference instead of being an IDR. */
+typedef C2StreamParam<C2Tuning, C2Int32Value, kParamIndexVendorVencLtrRecovery> C2StreamVencLtrRecovery;
+constexpr char C2_PARAMKEY_VENDOR_VENC_LTR_RECOVERY[] = "venc.ltr-recovery";
+constexpr char KEY_VENDOR_LTR_RECOVERY[] = "vendor.venc.ltr-recovery.value";
+
+/* reference decision of an output frame. */
+struct C2VencFrameRefInfoStruct {
+    inline C2VencFrameRefInfoStruct() = default;
+    inline C2VencFrameRefInfoStruct(int32_t layerId_, int32_t ltrMark_, int32_t ltrUse_, int32_t dropped_)
+        : layerId(layerId_), ltrMark(ltrMark_), ltrUse(ltrUse_), dropped(dropped_) {}
+    int32_t layerId;
+    int32_t ltrMark;
+    int32_t ltrUse;
+    int32_t dropped;
+    DEFINE_AND_DESCRIBE_C2STRUCT(VencFrameRefInfo)
+    C2FIELD(layerId, "layer-id")
+    C2FIELD(ltrMark, "ltr-mark")
+    C2FIELD(ltrUse, "ltr-use")
+    C2FIELD(dropped, "dropped")
+};
+typedef C2StreamParam<C2Info, C2VencFrameRefInfoStruct, kParamIndexVendorVencFrameRefInfo> C2StreamVencFrameRefInfo;
+constexpr char C2_PARAMKEY_VENDOR_VENC_FRAME_REF_INFO[] = "venc.frame-ref-info";
+
+/* intra refresh cycle of an output frame, the frame with cycle-end set completes the refresh. */
+struct C2VencIntraRefreshInfoStruct {
+    inline C2VencIntraRefreshInfoStruct() = default;
+    inline C2VencIntraRefreshInfoStruct(int32_t position_, int32_t length_, int32_t cycleStart_, int32_t cycleEnd_)
+        : position(position_), length(length_), cycleStart(cycleStart_), cycleEnd(cycleEnd_) {}
+    int32_t position;
+    int32_t length;
+    int32_t cycleStart;
+    int32_t cycleEnd;
+    DEFINE_AND_DESCRIBE_C2STRUCT(VencIntraRefreshInfo)
+    C2FIELD(position, "position")
+    C2FIELD(length, "length")
+    C2FIELD(cycleStart, "cycle-start")
+    C2FIELD(cycleEnd, "cycle-end")
+};
+typedef C2StreamParam<C2Info, C2VencIntraRefreshInfoStruct, kParamIndexVendorVencIntraRefreshInfo> C2StreamVencIntraRefreshInfo;
+constexpr char C2_PARAMKEY_VENDOR_VENC_INTRA_REFRESH_INFO[] = "venc.intra-refresh-info";
+
+//the statistics of the last encoded frames,filled when queried.
+struct C2VencStatsStruct {
+    inline C2VencStatsStruct() = default;
+    uint32_t frames;
+    uint32_t idrFrames;
+    uint32_t pFrames;
+    uint32_t droppedFrames;
+    uint32_t maxFrameBytes;
+    uint32_t avgEncodeTimeUs;
+    uint32_t maxEncodeTimeUs;
+    int32_t avgQp;
+    uint32_t bitrate;
+    uint32_t targetBitrate;
+    int32_t rcErrorPercent;
+    DEFINE_AND_DESCRIBE_C2STRUCT(VencStats)
+    C2FIELD(frames, "frames")
+    C2FIELD(idrFrames, "idr-frames")
+    C2FIELD(pFrames, "p-frames")
+    C2FIELD(droppedFrames, "dropped-frames")
+    C2FIELD(maxFrameBytes, "max-frame-bytes")
+    C2FIELD(avgEncodeTimeUs, "avg-encode-time-us")
+    C2FIELD(maxEncodeTimeUs, "max-encode-time-us")
+    C2FIELD(avgQp, "avg-qp")
+    C2FIELD(bitrate, "bitrate")
+    C2FIELD(targetBitrate, "target-bitrate")
+    C2FIELD(rcErrorPercent, "rc-error-percent")
+};
+typedef C2StreamParam<C2Info, C2VencStatsStruct, kParamIndexVendorVencStats> C2StreamVencStats;
+constexpr char C2_PARAMKEY_VENDOR_VENC_STATS[] = "venc.stats";
+
+/* peak bitrate of the variable bitrate mode, cap of the quality mode, 0 leaves it to the encoder. */
+typedef C2StreamParam<C2Tuning, C2Uint32Value, kParamIndexVendorVencMaxBitrate> C2StreamVencMaxBitrate;
+constexpr char C2_PARAMKEY_VENDOR_VENC_MAX_BITRATE[] = "venc.max-bitrate";
+constexpr char KEY_VENDOR_MAX_BITRATE[] = "vendor.venc.max-bitrate.value";
+
+/* 1 while the session is paced below its frame rate to fit the hardware budget, reported in the output configUpdate when it changes. */
+typedef C2StreamParam<C2Info, C2Int32Value, kParamIndexVendorVencBackPressure> C2StreamVencBackPressureInfo;
+constexpr char C2_PARAMKEY_VENDOR_VENC_BACK_PRESSURE[] = "venc.back-pressure";
+
 
 
 #endif//C2_VENDOR_CONFIG_H_
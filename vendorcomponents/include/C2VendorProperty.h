@@ -43,6 +43,8 @@
 #define C2_PROPERTY_VDEC_INST_MAX_NUM               "vendor.media.c2.vdec.inst.max_num"
 #define C2_PROPERTY_VDEC_INST_MAX_NUM_SECURE        "vendor.media.c2.vdec.inst.max_num_secure"
 #define C2_PROPERTY_VDEC_INST_MAX_HIGH_RES_NUM      "vendor.media.c2.vdec.inst.max_high_res"
+#define C2_PROPERTY_VDEC_MBPS_BUDGET                "vendor.media.c2.vdec.inst.mbps_budget"
+#define C2_PROPERTY_VDEC_MEMORY_BUDGET_MB           "vendor.media.c2.vdec.inst.memory_budget_mb"
 
 
 #define C2_PROPERTY_VDEC_OUT_DELAY                  "vendor.media.c2.vdec.out.delay"
@@ -61,6 +63,7 @@
 #define C2_PROPERTY_VDEC_HDR_LITTLE_ENDIAN_ENABLE   "vendor.media.c2.vdec.hdr.little_endian_enable"
 #define C2_PROPERTY_VDEC_ERRPOLICY_DISABLE          "vendor.media.c2.vdec.errpolicy_disable"
 #define C2_PROPERTY_VDEC_REALLOC_TUNNEL_RESCHANGE   "vendor.media.c2.vdec.realloc_for_tunnel_reschange"
+#define C2_PROPERTY_VDEC_REUSE_TUNNEL_RESCHANGE     "vendor.media.c2.vdec.reuse_for_tunnel_reschange"
 #define C2_PROPERTY_VDEC_RETRYBLOCK_TIMEOUT         "vendor.media.c2.vdec.retryblock_timeout"
 #define C2_PROPERTY_VDEC_FORCE_DI_PERMISSION        "vendor.media.c2.vdec.force_di_permission"
 #define C2_PROPERTY_VDEC_GAME_LOW_LATENCY           "vendor.media.c2.vdec.game_low_latency"
@@ -82,12 +85,19 @@
 #define C2_PROPERTY_VDEC_DIABLE_BYPASS_VPP          "debug.vendor.media.c2.vdec.default.bypass_vpp"
 #define C2_PROPERTY_VDEC_LLV_FIRST_ALLOC_NUM        "debug.vendor.media.c2.vdec.llv_first_alloc_num"
 #define C2_PROPERTY_VDEC_SUPPORT_GRALLOC_V2         "debug.vendor.media.c2.vdec.support.gralloc_v2"
+#define C2_PROPERTY_VDEC_DUMP_INPUT                 "debug.vendor.media.c2.vdec.dump_input"
 
 /* soft vdec */
 #define C2_PROPERTY_SOFTVDEC_INST_MAX_NUM           "vendor.media.c2.softvdec.inst.max_num"
 #define C2_PROPERTY_SOFTVDEC_DUMP_YUV               "debug.vendor.media.c2.softvdec.dump_yuv"
+#define C2_PROPERTY_SOFTVDEC_INPUT_QUEUE_SIZE       "vendor.media.c2.softvdec.input.queue_size"
 
 /* venc */
+#define C2_PROPERTY_VENC_INTRA_REFRESH_MODE         "vendor.media.c2.venc.intra_refresh_mode"
+#define C2_PROPERTY_VENC_QP_SAMPLE_INTERVAL         "vendor.media.c2.venc.qp_sample_interval"
+#define C2_PROPERTY_VENC_WARM_CONTEXTS              "vendor.media.c2.venc.warm_contexts"
+#define C2_PROPERTY_VENC_ARBITER_SLOTS              "vendor.media.c2.venc.arbiter_slots"
+#define C2_PROPERTY_VENC_ARBITER_MBPS               "vendor.media.c2.venc.arbiter_mbps"
 
 /* audio decoder */
 #define C2_PROPERTY_AUDIO_DECODER_DEBUG             "vendor.media.c2.audio.decoder.debug"
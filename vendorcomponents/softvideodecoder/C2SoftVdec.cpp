@@ -18,7 +18,9 @@
 #define LOG_TAG "C2SoftVdec"
 
 #include <dlfcn.h>
+#include <sys/prctl.h>
 #include <cutils/properties.h>
+#include <utils/AndroidThreads.h>
 #include <media/stagefright/foundation/MediaDefs.h>
 #include <C2Config.h>
 #include <C2PlatformSupport.h>
@@ -32,6 +34,7 @@
 #include <C2SoftVdecInterfaceImpl.h>
 
 #define MAX_WORK_PENDING_COUNT (7)
+#define MAX_DECODE_QUEUE_SIZE (4)
 
 #define UNUSED(expr)  \
     do {              \
@@ -69,6 +72,9 @@ C2SoftVdec::C2SoftVdec(C2String name, c2_node_id_t id,
                                const std::shared_ptr<IntfImpl> &intfImpl)
         : C2SoftVdecComponent(std::make_shared<SimpleInterface<IntfImpl>>(name.c_str(), id, intfImpl)),
         mIntfImpl(intfImpl),
+        mDecodeThreadExit(false),
+        mDecodeFlushing(false),
+        mMaxDecodeRequests(MAX_DECODE_QUEUE_SIZE),
         mDecoderName(name),
         mWidth(320),
         mHeight(240),
@@ -78,8 +84,9 @@ C2SoftVdec::C2SoftVdec(C2String name, c2_node_id_t id,
         mSignalledOutputEos(false),
         mSignalledError(false),
         mFirstPictureReviced(false),
+        mSizeChanged(false),
+        mOutPts(0),
         mDecInit(false),
-        mPic(NULL),
         mCodec(NULL),
         mExtraData(NULL),
         mDumpYuvFp(NULL) {
@@ -89,6 +96,8 @@ C2SoftVdec::C2SoftVdec(C2String name, c2_node_id_t id,
         CODEC2_LOG(CODEC2_LOG_INFO, "Create %s(%s)", __func__, name.c_str());
 
         propGetInt(CODEC2_VDEC_LOGDEBUG_PROPERTY, &gloglevel);
+        int32_t queueSize = property_get_int32(C2_PROPERTY_SOFTVDEC_INPUT_QUEUE_SIZE, MAX_DECODE_QUEUE_SIZE);
+        mMaxDecodeRequests = (queueSize > 0) ? queueSize : 1;
         mDumpYuvEnable = property_get_bool(C2_PROPERTY_SOFTVDEC_DUMP_YUV, false);
         if (mDumpYuvEnable) {
             char pathFile[1024] = { '\0'  };
@@ -104,7 +113,6 @@ C2SoftVdec::C2SoftVdec(C2String name, c2_node_id_t id,
 
 C2SoftVdec::~C2SoftVdec() {
     CODEC2_LOG(CODEC2_LOG_INFO, "%s", __func__);
-    mPendingWorkFrameIndexes.clear();
     onRelease();
     if (mExtraData) {
         free(mExtraData);
@@ -139,6 +147,12 @@ c2_status_t C2SoftVdec::onInit() {
 
 c2_status_t C2SoftVdec::onStop() {
     CODEC2_LOG(CODEC2_LOG_INFO, "%s", __func__);
+    stopDecodeThread();
+    {
+        std::lock_guard<std::mutex> lock(mDecodeLock);
+        mDecodeFlushing = false;
+    }
+    mStagedRequest.reset();
     if (OK != resetDecoder()) {
         return C2_CORRUPTED;
     }
@@ -153,19 +167,36 @@ void C2SoftVdec::onReset() {
 
 void C2SoftVdec::onRelease() {
    CODEC2_LOG(CODEC2_LOG_INFO, "%s", __func__);
+   stopDecodeThread();
+   mStagedRequest.reset();
    deleteDecoder();
     if (mOutBlock) {
         mOutBlock.reset();
     }
 }
 
+void C2SoftVdec::onFlushStart() {
+    // The flushed works go back to the client once flush_sm returns, the decode
+    // thread must not finish any of them after that.
+    {
+        std::lock_guard<std::mutex> lock(mDecodeLock);
+        mDecodeFlushing = true;
+    }
+    stopDecodeThread();
+}
+
 c2_status_t C2SoftVdec::onFlush_sm() {
     CODEC2_LOG(CODEC2_LOG_INFO, "%s", __func__);
+    stopDecodeThread();
+    {
+        std::lock_guard<std::mutex> lock(mDecodeLock);
+        mDecodeFlushing = false;
+    }
+    mStagedRequest.reset();
     resetDecoder();
     resetPlugin();
     mSignalledOutputEos = false;
     mFirstPictureReviced = false;
-    mPendingWorkFrameIndexes.clear();
     return C2_OK;
 }
 
@@ -211,8 +242,8 @@ Error:
 }
 
 bool C2SoftVdec::unload_ffmpeg_decoder_lib(){
-    if (mFFmpegVideoDecoderCloseFunc != NULL)
-        mFFmpegVideoDecoderCloseFunc(mCodec);
+    if (mFFmpegVideoDecoderCloseFunc != NULL)
+        mFFmpegVideoDecoderCloseFunc(mCodec);
 
     mCodec = NULL;
     return true;
@@ -247,19 +278,20 @@ status_t C2SoftVdec::deleteDecoder() {
     return OK;
 }
 
-static void fillEmptyWork(const std::unique_ptr<C2Work> &work) {
-    uint32_t flags = 0;
-    if (work->input.flags & C2FrameData::FLAG_END_OF_STREAM) {
-        flags |= C2FrameData::FLAG_END_OF_STREAM;
+void C2SoftVdec::finishEmptyWork(const PendingFrame &frame, uint32_t flags, c2_status_t result) {
+    if (flags & C2FrameData::FLAG_END_OF_STREAM) {
         CODEC2_LOG(CODEC2_LOG_INFO, "Signalling EOS");
     }
-    work->worklets.front()->output.flags = (C2FrameData::flags_t)flags;
-    work->worklets.front()->output.buffers.clear();
-    work->worklets.front()->output.ordinal = work->input.ordinal;
-    work->workletsProcessed = 1u;
+    finish(frame.frameIndex, frame.customOrdinal, [flags, result](const std::unique_ptr<C2Work> &work) {
+        work->worklets.front()->output.flags = (C2FrameData::flags_t)flags;
+        work->worklets.front()->output.buffers.clear();
+        work->worklets.front()->output.ordinal = work->input.ordinal;
+        work->workletsProcessed = 1u;
+        work->result = result;
+    });
 }
 
-void C2SoftVdec::finishWork(uint64_t index, const std::unique_ptr<C2Work> &work) {
+void C2SoftVdec::finishWork(uint64_t index, uint32_t flags) {
     std::shared_ptr<C2Buffer> buffer = createGraphicBuffer(std::move(mOutBlock),
                                                            C2Rect(mWidth, mHeight));
     mOutBlock = nullptr;
@@ -268,58 +300,27 @@ void C2SoftVdec::finishWork(uint64_t index, const std::unique_ptr<C2Work> &work)
         buffer->setInfo(mIntfImpl->getColorAspects_l());
     }
 
-    class FillWork {
-       public:
-        FillWork(uint32_t flags, C2WorkOrdinalStruct ordinal,
-                 const std::shared_ptr<C2Buffer>& buffer)
-            : mFlags(flags), mOrdinal(ordinal), mBuffer(buffer) {}
-        ~FillWork() = default;
-
-        void operator()(const std::unique_ptr<C2Work>& work) {
-            work->worklets.front()->output.flags = (C2FrameData::flags_t)mFlags;
-            work->worklets.front()->output.buffers.clear();
-            work->worklets.front()->output.ordinal = mOrdinal;
-            work->workletsProcessed = 1u;
-            work->result = C2_OK;
-            if (mBuffer) {
-                work->worklets.front()->output.buffers.push_back(mBuffer);
-            }
-            CODEC2_LOG(CODEC2_LOG_INFO, "Timestamp = %lld, index = %lld, w/%s buffer",
-                  mOrdinal.timestamp.peekll(), mOrdinal.frameIndex.peekll(),
-                  mBuffer ? "" : "o");
-        }
-
-       private:
-        const uint32_t mFlags;
-        const C2WorkOrdinalStruct mOrdinal;
-        const std::shared_ptr<C2Buffer> mBuffer;
-    };
+    std::shared_ptr<C2StreamPictureSizeInfo::output> size;
+    if (mSizeChanged) {
+        size = std::make_shared<C2StreamPictureSizeInfo::output>(0u, mWidth, mHeight);
+        mSizeChanged = false;
+    }
 
-    auto fillWork = [buffer](const std::unique_ptr<C2Work> &work) {
-        work->worklets.front()->output.flags = (C2FrameData::flags_t)0;
+    auto fillWork = [buffer, flags, size](const std::unique_ptr<C2Work> &work) {
+        work->worklets.front()->output.flags = (C2FrameData::flags_t)flags;
         work->worklets.front()->output.buffers.clear();
         work->worklets.front()->output.buffers.push_back(buffer);
+        if (size) {
+            work->worklets.front()->output.configUpdate.push_back(C2Param::Copy(*size));
+        }
         work->worklets.front()->output.ordinal = work->input.ordinal;
         work->workletsProcessed = 1u;
+        work->result = C2_OK;
+        CODEC2_LOG(CODEC2_LOG_INFO, "Timestamp = %lld, index = %lld, out pts = %lld",
+              work->input.ordinal.timestamp.peekll(), work->input.ordinal.frameIndex.peekll(),
+              work->input.ordinal.customOrdinal.peekll());
     };
-    if (work && c2_cntr64_t(index) == work->input.ordinal.frameIndex) {
-        bool eos = ((work->input.flags & C2FrameData::FLAG_END_OF_STREAM) != 0);
-        // TODO: Check if cloneAndSend can be avoided by tracking number of frames remaining
-        if (eos) {
-            mOutIndex = index;
-            C2WorkOrdinalStruct outOrdinal = work->input.ordinal;
-            cloneAndSend(
-                mOutIndex, work,
-                FillWork(C2FrameData::FLAG_INCOMPLETE, outOrdinal, buffer));
-            buffer.reset();
-        } else {
-            fillWork(work);
-        }
-    } else {
-        if (work) {
-            finish(index, work->input.ordinal.customOrdinal.peeku(), fillWork);
-        }
-    }
+    finish(index, mOutPts, fillWork);
 }
 
 c2_status_t C2SoftVdec::ensureDecoderState(const std::shared_ptr<C2BlockPool> &pool) {
@@ -361,31 +362,138 @@ void C2SoftVdec::process(
     work->workletsProcessed = 0u;
     work->worklets.front()->output.configUpdate.clear();
     work->worklets.front()->output.flags = work->input.flags;
+    mStagedRequest.reset();
 
     if (mSignalledError || mSignalledOutputEos) {
         work->result = C2_BAD_VALUE;
+        work->workletsProcessed = 1u;
         return;
     }
 
+    // The work is left pending here, decoding and finishing it happen on the
+    // decode thread once the component queued it (see onWorkPending).
+    mStagedRequest.reset(new DecodeRequest {
+            work->input.ordinal.frameIndex.peeku(),
+            work->input.ordinal.timestamp.peeku(),
+            work->input.ordinal.customOrdinal.peeku(),
+            work->input.flags,
+            work->input.buffers.empty() ? nullptr : work->input.buffers[0],
+            pool });
+}
+
+void C2SoftVdec::onWorkPending(uint64_t frameIndex) {
+    if (!mStagedRequest || mStagedRequest->frameIndex != frameIndex) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mDecodeLock);
+    if (!mDecodeFlushing && !mDecodeThread.joinable()) {
+        startDecodeThread_l();
+    }
+    // Hold the component thread until the decoder catches up, so that the
+    // framework stops queueing more input than we can decode.
+    mDecodeCond.wait(lock, [this] {
+        return mDecodeRequests.size() < mMaxDecodeRequests || mDecodeThreadExit;
+    });
+    if (mDecodeThreadExit) {
+        // Stopped by a flush, which hands the work back to the client.
+        mStagedRequest.reset();
+        return;
+    }
+    mDecodeRequests.push_back(std::move(*mStagedRequest));
+    mStagedRequest.reset();
+    lock.unlock();
+    mDecodeCond.notify_all();
+}
+
+void C2SoftVdec::startDecodeThread_l() {
+    mDecodeThreadExit = false;
+    mDecodeThread = std::thread(&C2SoftVdec::decodeThreadLoop, this);
+}
+
+void C2SoftVdec::stopDecodeThread() {
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(mDecodeLock);
+        mDecodeThreadExit = true;
+        // Works of the dropped requests are returned by flush_sm or cleared by stop.
+        mDecodeRequests.clear();
+        // Called from the client thread by a flush too, take the thread over
+        // so that the component thread never sees it half joined.
+        thread = std::move(mDecodeThread);
+    }
+    mDecodeCond.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    mPendingWorkFrameIndexes.clear();
+}
+
+bool C2SoftVdec::isFetchInterrupted() {
+    std::lock_guard<std::mutex> lock(mDecodeLock);
+    return mDecodeThreadExit;
+}
+
+void C2SoftVdec::decodeThreadLoop() {
+    prctl(PR_SET_NAME, (unsigned long)"C2SoftVdecDecode");
+    androidSetThreadPriority(0, ANDROID_PRIORITY_VIDEO);
+    CODEC2_LOG(CODEC2_LOG_INFO, "Decode thread start, max queued input %zu", mMaxDecodeRequests);
+
+    while (true) {
+        DecodeRequest request;
+        {
+            std::unique_lock<std::mutex> lock(mDecodeLock);
+            mDecodeCond.wait(lock, [this] {
+                return !mDecodeRequests.empty() || mDecodeThreadExit;
+            });
+            if (mDecodeThreadExit) {
+                break;
+            }
+            request = std::move(mDecodeRequests.front());
+            mDecodeRequests.pop_front();
+        }
+        mDecodeCond.notify_all();
+
+        if (mSignalledError) {
+            finishEmptyWork({request.frameIndex, request.customOrdinal}, 0, C2_BAD_VALUE);
+            continue;
+        }
+        c2_status_t err = decodeRequest(request);
+        if (err == C2_BLOCKING) {
+            break;
+        }
+        if (err != C2_OK) {
+            failPendingWorks(err);
+        }
+    }
+    CODEC2_LOG(CODEC2_LOG_INFO, "Decode thread exit");
+}
+
+void C2SoftVdec::failPendingWorks(c2_status_t err) {
+    CODEC2_LOG(CODEC2_LOG_ERR, "Decode error %d, return %zu pending works", err, mPendingWorkFrameIndexes.size());
+    mSignalledError = true;
+    while (!mPendingWorkFrameIndexes.empty()) {
+        finishEmptyWork(mPendingWorkFrameIndexes.front(), 0, err);
+        mPendingWorkFrameIndexes.pop_front();
+    }
+}
+
+c2_status_t C2SoftVdec::decodeRequest(const DecodeRequest &request) {
     size_t inSize = 0u;
-    uint32_t workIndex = work->input.ordinal.frameIndex.peeku() & 0xFFFFFFFF;
     C2ReadView rView = mDummyReadView;
-    if (!work->input.buffers.empty()) {
-        rView = work->input.buffers[0]->data().linearBlocks().front().map().get();
+    if (request.buffer) {
+        rView = request.buffer->data().linearBlocks().front().map().get();
         inSize = rView.capacity();
         if (inSize && rView.error()) {
             CODEC2_LOG(CODEC2_LOG_ERR, "Read view map failed %d", rView.error());
-            work->result = rView.error();
-            return;
+            finishEmptyWork({request.frameIndex, request.customOrdinal}, 0, rView.error());
+            return C2_OK;
         }
     }
 
     uint8_t *inBuffer = const_cast<uint8_t *>(rView.data());
-    bool codecConfig = ((work->input.flags & C2FrameData::FLAG_CODEC_CONFIG) !=0);
-    bool eos = ((work->input.flags & C2FrameData::FLAG_END_OF_STREAM) != 0);
+    bool codecConfig = ((request.flags & C2FrameData::FLAG_CODEC_CONFIG) != 0);
+    bool eos = ((request.flags & C2FrameData::FLAG_END_OF_STREAM) != 0);
     bool frameHasData = (inSize > 0);
-    bool flushPendingWork = (eos && !mPendingWorkFrameIndexes.empty());
-    bool hasPicture = false;
 
     // Config csd data
     if (codecConfig) {
@@ -396,200 +504,190 @@ void C2SoftVdec::process(
             }
             mExtraData = (uint8_t *)malloc(inSize);
             if (mExtraData == NULL) {
-                work->result = C2_NO_MEMORY;
-                return;
+                finishEmptyWork({request.frameIndex, request.customOrdinal}, 0, C2_NO_MEMORY);
+                return C2_OK;
             }
             memcpy(mExtraData, inBuffer, inSize);
             mVideoInfo.extra_data = mExtraData;
             mVideoInfo.extra_data_size = inSize;
         }
         CODEC2_LOG(CODEC2_LOG_INFO, "For %s don't input config pkt to ffmpeg", mDecoderName.c_str());
-        fillEmptyWork(work);
-        return;
+        finishEmptyWork({request.frameIndex, request.customOrdinal},
+                request.flags & C2FrameData::FLAG_END_OF_STREAM, C2_OK);
+        return C2_OK;
     }
 
-    // Loop for resolution changed case.
-    while (frameHasData || flushPendingWork) {
-        if (C2_OK != ensureDecoderState(pool)) {
-            mSignalledError = true;
-            work->workletsProcessed = 1u;
-            work->result = C2_CORRUPTED;
-            return;
-        }
+    if (!frameHasData && !eos) {
+        finishEmptyWork({request.frameIndex, request.customOrdinal}, 0, C2_OK);
+        return C2_OK;
+    }
+    mPendingWorkFrameIndexes.push_back({request.frameIndex, request.customOrdinal});
 
-        C2GraphicView wView = mOutBlock->map().get();
-        if (wView.error()) {
-            CODEC2_LOG(CODEC2_LOG_ERR, "Graphic view map failed %d", wView.error());
-            work->result = wView.error();
-            return;
+    // On EOS keep draining the decoder with empty packets until every pending work got its picture.
+    while (frameHasData || (eos && !mPendingWorkFrameIndexes.empty())) {
+        bool hasPicture = false;
+        c2_status_t err = decodeOnePicture(inBuffer, inSize, request, &hasPicture);
+        if (err != C2_OK) {
+            return err;
         }
-
-        // Decode new picture.
-        if (mPic == NULL) {
-            // Init FFmpeg decoder.
-            if (mDecInit == false)
-            {
-                if (mVideoInfo.width == 0 && mVideoInfo.height == 0 &&
-                    mWidth && mHeight) {
-                    CODEC2_LOG(CODEC2_LOG_INFO, "Set resolution to mVideoInfo [%d:%d]", mWidth, mHeight);
-                    mVideoInfo.width = mWidth;
-                    mVideoInfo.height = mHeight;
-                }
-                if (mFFmpegVideoDecoderInitFunc(mIntfImpl->ConvertComponentNameToMimeType(mDecoderName.c_str()), &mVideoInfo, &mCodec)) {
-                    CODEC2_LOG(CODEC2_LOG_ERR, "FFmpeg decoder init failed for %s", mDecoderName.c_str());
-                    mSignalledError = true;
-                    work->workletsProcessed = 1u;
-                    work->result = C2_CORRUPTED;
-                    return;
-                }
-                mDecInit = true;
+        if (!hasPicture) {
+            // Pending or drop frame when decode failed.
+            // For VP8 first 3(ffmpeg_decode_thread_num - 1) frames decode failed case.
+            if (!eos && (mFirstPictureReviced || mPendingWorkFrameIndexes.size() > MAX_WORK_PENDING_COUNT)) {
+                mTotalDropedOutputFrameNum++;
+                CODEC2_LOG(CODEC2_LOG_ERR, "Drop frame Index %" PRId64", In_Pts %" PRId64", total droped %" PRId64"",
+                    request.frameIndex, request.timestamp, mTotalDropedOutputFrameNum);
+                mPendingWorkFrameIndexes.pop_back();
+                finishEmptyWork({request.frameIndex, request.customOrdinal}, 0, C2_OK);
             }
-
-            mPic = (VIDEO_FRAME_WRAPPER_T *)malloc(sizeof(VIDEO_FRAME_WRAPPER_T));
-            if (mPic == NULL) {
-                mSignalledError = true;
-                work->workletsProcessed = 1u;
-                work->result = C2_NO_MEMORY;
-                return;
-            }
-            memset(mPic, 0, sizeof(VIDEO_FRAME_WRAPPER_T));
-            mPic->pts = work->input.ordinal.timestamp.peeku();
-
-            mTimeStart = systemTime();
-            nsecs_t delay = mTimeStart - mTimeEnd;
-            int size = mFFmpegVideoDecoderProcessFunc(inBuffer, inSize, mPic, mCodec);
-            mTimeEnd = systemTime();
-            nsecs_t decodeTime = mTimeEnd - mTimeStart;
-            mTimeTotal += decodeTime;
-            mTotalProcessedFrameNum++;
-            CODEC2_LOG(CODEC2_LOG_DEBUG_LEVEL1,
-                "Average DecodeTime=%" PRId64 "us, DecodeTime=%" PRId64 "us, Delay=%" PRId64 "us, FrameIndex=%" PRId64", In_Size=%zu, Out_Size=%d, In_Pts=%" PRId64", Out_Pts=%" PRId64", Flags=%x",
-                (int64_t)(mTimeTotal / mTotalProcessedFrameNum / 1000), (decodeTime / 1000), (delay / 1000), work->input.ordinal.frameIndex.peeku(), inSize, size,
-                work->input.ordinal.timestamp.peeku(), mPic->pts, work->input.flags);
-            if (size >= 0) {
-                if (mPic->width != 0 && mPic->height != 0
-                    && (mPic->width != mWidth ||  mPic->height != mHeight)) {
-                    CODEC2_LOG(CODEC2_LOG_INFO, "Resolution changed from %d x %d to %d x %d", mWidth, mHeight, mPic->width, mPic->height);
-                    mWidth = mPic->width;
-                    mHeight = mPic->height;
-                    work->workletsProcessed = 0u;
-
-                    C2StreamPictureSizeInfo::output size(0u, mWidth, mHeight);
-                    std::vector<std::unique_ptr<C2SettingResult>> failures;
-                    c2_status_t err =
-                        mIntfImpl->config({&size}, C2_MAY_BLOCK, &failures);
-                    if (err == OK) {
-                        work->worklets.front()->output.configUpdate.push_back(
-                            C2Param::Copy(size));
-                    } else {
-                        CODEC2_LOG(CODEC2_LOG_ERR, "Cannot set width and height");
-                        mSignalledError = true;
-                        work->workletsProcessed = 1u;
-                        work->result = C2_CORRUPTED;
-                        free(mPic);
-                        mPic = NULL;
-                        return;
-                    }
-                    continue;
-                }
-                hasPicture = true;
-                mFirstPictureReviced = true;
-            } else {
-                // Decode frame failed.
-                CODEC2_LOG(CODEC2_LOG_ERR, "Decode failed, frame Index %" PRId64", In_Pts %" PRId64"",
-                    work->input.ordinal.frameIndex.peeku(), work->input.ordinal.timestamp.peeku());
-                free(mPic);
-                mPic = NULL;
-                if (flushPendingWork) {
-                    break;
-                }
-            }
-        } else {
-            hasPicture = true;
-            mFirstPictureReviced = true;
+            break;
         }
 
-        if (hasPicture) {
-            uint8_t *dstY = const_cast<uint8_t *>(wView.data()[C2PlanarLayout::PLANE_Y]);
-            uint8_t *dstU = const_cast<uint8_t *>(wView.data()[C2PlanarLayout::PLANE_U]);
-            uint8_t *dstV = const_cast<uint8_t *>(wView.data()[C2PlanarLayout::PLANE_V]);
-
-            size_t srcYStride = mPic->linesize[0];
-            size_t srcUStride = mPic->linesize[1];
-            size_t srcVStride = mPic->linesize[2];
-            C2PlanarLayout layout = wView.layout();
-            size_t dstYStride = layout.planes[C2PlanarLayout::PLANE_Y].rowInc;
-            size_t dstUVStride = layout.planes[C2PlanarLayout::PLANE_U].rowInc;
-
-            const uint8_t *srcY = (const uint8_t *)mPic->data[0];
-            const uint8_t *srcU = (const uint8_t *)mPic->data[1];
-            const uint8_t *srcV = (const uint8_t *)mPic->data[2];
-
-            // Convert and fill yuv data.
-            convertYUV420Planar8ToYV12(dstY, dstU, dstV, srcY, srcU, srcV, srcYStride, srcUStride,
-                                       srcVStride, dstYStride, dstUVStride, mWidth, mHeight);
-            // Set out pts
-            work->input.ordinal.customOrdinal = mPic->pts;
-            uint8_t *data = NULL;
-
-            // For yuv dump
-            if (mDumpYuvFp) {
-             /* const uint8_t* const* data = wView.data();
-                int size = mOutBlock->width() * mOutBlock->height() * 3 / 2;
-                fwrite(data[0], size, 1, mDumpYuvFp); */
-                int shift;
-                for (int i = 0; i < 3; i++) {
-                     shift = i>0 ? 1 : 0;
-                     data = (uint8_t *)mPic->data[i];
-                     for (int j = 0; j < mOutBlock->height()>>shift; j++) {
-                          fwrite(data, sizeof(char), mOutBlock->width()>>shift, mDumpYuvFp);
-                           data += mPic->linesize[i];
-                     }
-                }
-            }
-
-            // Free pic after yuv data filled.
-            mFFmpegVideoDecoderFreeFrameFunc(mCodec);
-            free(mPic);
-            mPic = NULL;
-
-            if (!mPendingWorkFrameIndexes.empty()) {
-                if (!flushPendingWork) {
-                    mPendingWorkFrameIndexes.push_back(work->input.ordinal.frameIndex.peeku());
-                }
-                finishWork(mPendingWorkFrameIndexes.front(), work);
-                mPendingWorkFrameIndexes.pop_front();
-            } else {
-                finishWork(workIndex, work);
-            }
-        }
-        // Exit directly if no need flushPendingWork or flush done.
-        if (!flushPendingWork || mPendingWorkFrameIndexes.empty()) {
+        // Pictures come out in decode order, hand them to the oldest pending work.
+        PendingFrame frame = mPendingWorkFrameIndexes.front();
+        mPendingWorkFrameIndexes.pop_front();
+        bool last = eos && mPendingWorkFrameIndexes.empty();
+        finishWork(frame.frameIndex, last ? C2FrameData::FLAG_END_OF_STREAM : 0);
+        if (!eos) {
             break;
         }
+        inBuffer = NULL;
+        inSize = 0u;
+        frameHasData = false;
     }
 
     if (eos) {
-        drainInternal(DRAIN_COMPONENT_WITH_EOS, pool, work);
+        while (!mPendingWorkFrameIndexes.empty()) {
+            PendingFrame frame = mPendingWorkFrameIndexes.front();
+            mPendingWorkFrameIndexes.pop_front();
+            finishEmptyWork(frame,
+                    mPendingWorkFrameIndexes.empty() ? C2FrameData::FLAG_END_OF_STREAM : 0, C2_OK);
+        }
         mSignalledOutputEos = true;
-    } else if (!hasPicture) {
-        // Pending or drop frame when decode failed.
-        // For VP8 first 3(ffmpeg_decode_thread_num - 1) frames decode failed case.
-        if (!mFirstPictureReviced && mPendingWorkFrameIndexes.size() < MAX_WORK_PENDING_COUNT) {
-            mPendingWorkFrameIndexes.push_back(work->input.ordinal.frameIndex.peeku());
-        } else {
-            mTotalDropedOutputFrameNum++;
-            CODEC2_LOG(CODEC2_LOG_ERR, "Drop frame Index %" PRId64", In_Pts %" PRId64", total droped %" PRId64"",
-                work->input.ordinal.frameIndex.peeku(), work->input.ordinal.timestamp.peeku(), mTotalDropedOutputFrameNum);
-            fillEmptyWork(work);
+    }
+    return C2_OK;
+}
+
+c2_status_t C2SoftVdec::decodeOnePicture(
+        uint8_t *inBuffer, size_t inSize, const DecodeRequest &request, bool *hasPicture) {
+    *hasPicture = false;
+
+    // Init FFmpeg decoder.
+    if (mDecInit == false) {
+        if (mVideoInfo.width == 0 && mVideoInfo.height == 0 &&
+            mWidth && mHeight) {
+            CODEC2_LOG(CODEC2_LOG_INFO, "Set resolution to mVideoInfo [%d:%d]", mWidth, mHeight);
+            mVideoInfo.width = mWidth;
+            mVideoInfo.height = mHeight;
         }
+        if (mFFmpegVideoDecoderInitFunc(mIntfImpl->ConvertComponentNameToMimeType(mDecoderName.c_str()), &mVideoInfo, &mCodec)) {
+            CODEC2_LOG(CODEC2_LOG_ERR, "FFmpeg decoder init failed for %s", mDecoderName.c_str());
+            return C2_CORRUPTED;
+        }
+        mDecInit = true;
+    }
+
+    VIDEO_FRAME_WRAPPER_T pic;
+    memset(&pic, 0, sizeof(VIDEO_FRAME_WRAPPER_T));
+    pic.pts = request.timestamp;
+
+    mTimeStart = systemTime();
+    nsecs_t delay = mTimeStart - mTimeEnd;
+    int size = mFFmpegVideoDecoderProcessFunc(inBuffer, inSize, &pic, mCodec);
+    mTimeEnd = systemTime();
+    nsecs_t decodeTime = mTimeEnd - mTimeStart;
+    mTimeTotal += decodeTime;
+    mTotalProcessedFrameNum++;
+    CODEC2_LOG(CODEC2_LOG_DEBUG_LEVEL1,
+        "Average DecodeTime=%" PRId64 "us, DecodeTime=%" PRId64 "us, Delay=%" PRId64 "us, FrameIndex=%" PRId64", In_Size=%zu, Out_Size=%d, In_Pts=%" PRId64", Out_Pts=%" PRId64", Flags=%x",
+        (int64_t)(mTimeTotal / mTotalProcessedFrameNum / 1000), (decodeTime / 1000), (delay / 1000), request.frameIndex, inSize, size,
+        request.timestamp, pic.pts, request.flags);
+    if (size < 0) {
+        // Decode frame failed.
+        CODEC2_LOG(CODEC2_LOG_ERR, "Decode failed, frame Index %" PRId64", In_Pts %" PRId64"",
+            request.frameIndex, request.timestamp);
+        return C2_OK;
     }
+    // Free pic on every return from here, also when it is not output.
+    struct FrameReleaser {
+        AmVideoCodec *codec;
+        ~FrameReleaser() { mFFmpegVideoDecoderFreeFrameFunc(codec); }
+    } releaser = { mCodec };
+
+    if (pic.width != 0 && pic.height != 0
+        && (pic.width != mWidth ||  pic.height != mHeight)) {
+        CODEC2_LOG(CODEC2_LOG_INFO, "Resolution changed from %d x %d to %d x %d", mWidth, mHeight, pic.width, pic.height);
+        mWidth = pic.width;
+        mHeight = pic.height;
+
+        C2StreamPictureSizeInfo::output size(0u, mWidth, mHeight);
+        std::vector<std::unique_ptr<C2SettingResult>> failures;
+        c2_status_t err =
+            mIntfImpl->config({&size}, C2_MAY_BLOCK, &failures);
+        if (err != OK) {
+            CODEC2_LOG(CODEC2_LOG_ERR, "Cannot set width and height");
+            return C2_CORRUPTED;
+        }
+        mSizeChanged = true;
+    }
+
+    c2_status_t err = ensureDecoderState(request.pool);
+    if (err == C2_BLOCKING) {
+        // Gave up waiting for an output buffer, the decode thread is stopping.
+        return err;
+    }
+    if (err != C2_OK) {
+        return C2_CORRUPTED;
+    }
+    C2GraphicView wView = mOutBlock->map().get();
+    if (wView.error()) {
+        CODEC2_LOG(CODEC2_LOG_ERR, "Graphic view map failed %d", wView.error());
+        return wView.error();
+    }
+
+    uint8_t *dstY = const_cast<uint8_t *>(wView.data()[C2PlanarLayout::PLANE_Y]);
+    uint8_t *dstU = const_cast<uint8_t *>(wView.data()[C2PlanarLayout::PLANE_U]);
+    uint8_t *dstV = const_cast<uint8_t *>(wView.data()[C2PlanarLayout::PLANE_V]);
+
+    size_t srcYStride = pic.linesize[0];
+    size_t srcUStride = pic.linesize[1];
+    size_t srcVStride = pic.linesize[2];
+    C2PlanarLayout layout = wView.layout();
+    size_t dstYStride = layout.planes[C2PlanarLayout::PLANE_Y].rowInc;
+    size_t dstUVStride = layout.planes[C2PlanarLayout::PLANE_U].rowInc;
+
+    const uint8_t *srcY = (const uint8_t *)pic.data[0];
+    const uint8_t *srcU = (const uint8_t *)pic.data[1];
+    const uint8_t *srcV = (const uint8_t *)pic.data[2];
+
+    // Convert and fill yuv data.
+    convertYUV420Planar8ToYV12(dstY, dstU, dstV, srcY, srcU, srcV, srcYStride, srcUStride,
+                               srcVStride, dstYStride, dstUVStride, mWidth, mHeight);
+
+    // For yuv dump
+    if (mDumpYuvFp) {
+        uint8_t *data = NULL;
+        int shift;
+        for (int i = 0; i < 3; i++) {
+             shift = i>0 ? 1 : 0;
+             data = (uint8_t *)pic.data[i];
+             for (int j = 0; j < mOutBlock->height()>>shift; j++) {
+                  fwrite(data, sizeof(char), mOutBlock->width()>>shift, mDumpYuvFp);
+                   data += pic.linesize[i];
+             }
+        }
+    }
+
+    // Set out pts
+    mOutPts = pic.pts;
+    mFirstPictureReviced = true;
+    *hasPicture = true;
+    return C2_OK;
 }
 
-c2_status_t C2SoftVdec::drainInternal(
+c2_status_t C2SoftVdec::drain(
         uint32_t drainMode,
-        const std::shared_ptr<C2BlockPool> &pool,
-        const std::unique_ptr<C2Work> &work) {
+        const std::shared_ptr<C2BlockPool> &pool) {
     (void)pool;
     if (drainMode == NO_DRAIN) {
         CODEC2_LOG(CODEC2_LOG_ERR, "Drain with NO_DRAIN: no-op");
@@ -599,21 +697,9 @@ c2_status_t C2SoftVdec::drainInternal(
         CODEC2_LOG(CODEC2_LOG_ERR, "Drain with DRAIN_CHAIN not supported");
         return C2_OMITTED;
     }
-
-    if (drainMode == DRAIN_COMPONENT_WITH_EOS &&
-            work && work->workletsProcessed == 0u) {
-        fillEmptyWork(work);
-    }
     return C2_OK;
 }
 
-
-c2_status_t C2SoftVdec::drain(
-        uint32_t drainMode,
-        const std::shared_ptr<C2BlockPool> &pool) {
-    return drainInternal(drainMode, pool, nullptr);
-}
-
 class C2SoftVdecFactory : public C2ComponentFactory {
 public:
     C2SoftVdecFactory(C2String decoderName)
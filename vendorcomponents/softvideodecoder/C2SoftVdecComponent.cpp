@@ -21,6 +21,7 @@
 #include <cutils/properties.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <inttypes.h>
+#include <unistd.h>
 #include <C2Debug.h>
 #include <C2Config.h>
 #include <C2PlatformSupport.h>
@@ -31,6 +32,8 @@
 #include <C2VendorDebug.h>
 #include <C2SoftVdecComponent.h>
 
+// Wait between two fetches from a pool out of blocks.
+#define BLOCK_POOL_RETRY_US (2000)
 
 namespace android {
 constexpr uint8_t kNeutralUVBitDepth8 = 128;
@@ -523,7 +526,9 @@ void C2SoftVdecComponent::WorkHandler::onMessageReceived(const sp<AMessage> &msg
 
 class C2SoftVdecComponent::BlockingBlockPool : public C2BlockPool {
 public:
-    BlockingBlockPool(const std::shared_ptr<C2BlockPool>& base): mBase{base} {}
+    BlockingBlockPool(const std::shared_ptr<C2BlockPool>& base,
+                      std::function<bool()> interrupted)
+        : mBase{base}, mInterrupted{interrupted} {}
 
     virtual local_id_t getLocalId() const override {
         return mBase->getLocalId();
@@ -540,7 +545,7 @@ public:
         c2_status_t status;
         do {
             status = mBase->fetchLinearBlock(capacity, usage, block);
-        } while (status == C2_BLOCKING);
+        } while (status == C2_BLOCKING && !waitRetry());
         return status;
     }
 
@@ -551,7 +556,7 @@ public:
         c2_status_t status;
         do {
             status = mBase->fetchCircularBlock(capacity, usage, block);
-        } while (status == C2_BLOCKING);
+        } while (status == C2_BLOCKING && !waitRetry());
         return status;
     }
 
@@ -563,12 +568,22 @@ public:
         do {
             status = mBase->fetchGraphicBlock(width, height, format, usage,
                                               block);
-        } while (status == C2_BLOCKING);
+        } while (status == C2_BLOCKING && !waitRetry());
         return status;
     }
 
 private:
+    // Returns true to give up, otherwise waits a little before the next try.
+    bool waitRetry() {
+        if (mInterrupted()) {
+            return true;
+        }
+        usleep(BLOCK_POOL_RETRY_US);
+        return false;
+    }
+
     std::shared_ptr<C2BlockPool> mBase;
+    std::function<bool()> mInterrupted;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -658,6 +673,7 @@ c2_status_t C2SoftVdecComponent::flush_sm(
             return C2_BAD_STATE;
         }
     }
+    onFlushStart();
     {
         Mutexed<WorkQueue>::Locked queue(mWorkQueue);
         queue->incGeneration();
@@ -916,7 +932,8 @@ bool C2SoftVdecComponent::processQueue() {
                 }
             }
             if (err == C2_OK) {
-                mOutputBlockPool = std::make_shared<BlockingBlockPool>(blockPool);
+                mOutputBlockPool = std::make_shared<BlockingBlockPool>(blockPool,
+                        [this] { return isFetchInterrupted(); });
             }
             return err;
         }();
@@ -997,6 +1014,7 @@ bool C2SoftVdecComponent::processQueue() {
         (void)queue->pending().insert({ frameIndex, std::move(work) });
 
         queue.unlock();
+        onWorkPending(frameIndex);
         if (unexpected) {
             CODEC2_LOG(CODEC2_LOG_ERR, "Unexpected pending work");
             unexpected->result = C2_CORRUPTED;
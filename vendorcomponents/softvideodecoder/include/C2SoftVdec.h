@@ -20,6 +20,10 @@
 #include <sys/time.h>
 #include <inttypes.h>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <C2Component.h>
 #include <C2ComponentFactory.h>
 #include <media/stagefright/foundation/ColorUtils.h>
@@ -124,21 +128,57 @@ private:
             uint32_t drainMode,
             const std::shared_ptr<C2BlockPool> &pool) override;
 
+    /**
+     * Called once process() left the work pending, hands its staged input over
+     * to the decode thread.
+     */
+    void onWorkPending(uint64_t frameIndex) override;
+
+    /**
+     * Stop the decode thread before flush_sm hands the works back.
+     */
+    void onFlushStart() override;
+
+    /**
+     * Give up a blocked output buffer fetch once the decode thread is stopping.
+     */
+    bool isFetchInterrupted() override;
+
+    // Input packet handed over from process() to the decode thread.
+    struct DecodeRequest {
+        uint64_t frameIndex;
+        uint64_t timestamp;
+        uint64_t customOrdinal;
+        uint32_t flags;
+        std::shared_ptr<C2Buffer> buffer;
+        // Output pool of the work, only used by the decode thread.
+        std::shared_ptr<C2BlockPool> pool;
+    };
+
+    // Work waiting for a decoded picture.
+    struct PendingFrame {
+        uint64_t frameIndex;
+        uint64_t customOrdinal;
+    };
+
     status_t createDecoder();
     void getVersion();
     status_t initDecoder();
     c2_status_t ensureDecoderState(const std::shared_ptr<C2BlockPool> &pool);
-    void finishWork(uint64_t index, const std::unique_ptr<C2Work> &work);
+    void finishWork(uint64_t index, uint32_t flags);
+    void finishEmptyWork(const PendingFrame &frame, uint32_t flags, c2_status_t result);
     status_t setFlushMode();
-    c2_status_t drainInternal(
-            uint32_t drainMode,
-            const std::shared_ptr<C2BlockPool> &pool,
-            const std::unique_ptr<C2Work> &work);
     status_t resetDecoder();
     void resetPlugin();
     status_t deleteDecoder();
 
-
+    void startDecodeThread_l();
+    void stopDecodeThread();
+    void decodeThreadLoop();
+    c2_status_t decodeRequest(const DecodeRequest &request);
+    c2_status_t decodeOnePicture(uint8_t *inBuffer, size_t inSize, const DecodeRequest &request,
+                                 bool *hasPicture);
+    void failPendingWorks(c2_status_t err);
 
     bool load_ffmpeg_decoder_lib();
     bool unload_ffmpeg_decoder_lib();
@@ -153,9 +193,24 @@ private:
     std::shared_ptr<C2GraphicBlock> mOutBlock;
     std::shared_ptr<C2StreamPictureSizeInfo::output> mSize;
     // Store all pending works. The dequeued works are placed here until they are finished and then
-    // sent out by onWorkDone call to listener.
+    // sent out by onWorkDone call to listener. Only accessed on the decode thread.
     // TODO: maybe use priority_queue instead.
-    std::list<uint64_t> mPendingWorkFrameIndexes;
+    std::list<PendingFrame> mPendingWorkFrameIndexes;
+
+    // Decode thread, fed by the component thread through mDecodeRequests. Works are
+    // finished from this thread as soon as their picture is ready.
+    std::thread mDecodeThread;
+    std::mutex mDecodeLock;
+    // Signalled when a request is queued or taken, and on exit.
+    std::condition_variable mDecodeCond;
+    std::deque<DecodeRequest> mDecodeRequests;
+    bool mDecodeThreadExit;
+    // Set from flush_sm until onFlush_sm, the decode thread is not restarted meanwhile.
+    bool mDecodeFlushing;
+    // Max queued requests before process() blocks, this is the input backpressure.
+    size_t mMaxDecodeRequests;
+    // Input staged by process() until the work is queued as pending.
+    std::unique_ptr<DecodeRequest> mStagedRequest;
 
     C2String mDecoderName;
     uint32_t mWidth;
@@ -163,12 +218,13 @@ private:
     uint64_t mTotalDropedOutputFrameNum;
     uint64_t mTotalProcessedFrameNum;
     std::atomic_uint64_t mOutIndex;
-    bool mSignalledOutputEos;
-    bool mSignalledError;
+    std::atomic<bool> mSignalledOutputEos;
+    std::atomic<bool> mSignalledError;
     bool mFirstPictureReviced;
+    bool mSizeChanged;
+    uint64_t mOutPts;
 
     bool mDecInit;
-    VIDEO_FRAME_WRAPPER_T *mPic;
     VIDEO_INFO_T mVideoInfo;
 
     AmVideoCodec *mCodec;
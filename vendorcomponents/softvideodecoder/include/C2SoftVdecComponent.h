@@ -132,6 +132,28 @@ protected:
             uint32_t drainMode,
             const std::shared_ptr<C2BlockPool> &pool) = 0;
 
+    /**
+     * Called on the component thread once a work left unfinished by process()
+     * has been queued as pending, so that it can be finished from another
+     * thread with finish().
+     *
+     * \param[in]   frameIndex    the index of the pending work
+     */
+    virtual void onWorkPending(uint64_t frameIndex) { (void)frameIndex; }
+
+    /**
+     * Called on the client thread by flush_sm() before the flushed works are
+     * taken out of the queue. Anything finishing works from another thread
+     * must be stopped here, onFlush_sm() only runs once the next work comes.
+     */
+    virtual void onFlushStart() {}
+
+    /**
+     * Polled while a fetch from the output block pool is blocked, returning
+     * true makes the fetch give up with C2_BLOCKING.
+     */
+    virtual bool isFetchInterrupted() { return false; }
+
     // for derived classes
     /**
      * Finish pending work.
@@ -54,6 +54,7 @@
 #include <C2VdecTunnelHelper.h>
 #include <C2VdecTunerPassthroughHelper.h>
 #include <C2VdecDebugUtil.h>
+#include <C2VdecPropertySnapshot.h>
 #include <C2VendorProperty.h>
 #include <C2VendorDebug.h>
 #include <unistd.h>
@@ -81,6 +82,9 @@
 #define MAX_INSTANCE_SECURE_LOW_RAM 1
 #define MAX_INSTANCE_SECURE_DEFAULT 2
 #define MAX_INSTANCE_HIGH_RES_DEFAULT 2
+// macroblocks per second, two 4k60 streams or one 4k30 stream on low ram devices.
+#define MBPS_BUDGET_DEFAULT (2 * 240 * 135 * 60)
+#define MBPS_BUDGET_LOW_RAM (240 * 135 * 30)
 
 #define UNUSED(expr)  \
     do {              \
@@ -126,6 +130,10 @@ const uint32_t kDpbOutputBufferExtraCount = 0;          // Use the same number a
 const int kDequeueRetryDelayUs = 10000;                 // Wait time of dequeue buffer retry in microseconds.
 const int32_t kAllocateBufferMaxRetries = 10;           // Max retry time for fetchGraphicBlock timeout.
 constexpr uint32_t kDefaultSmoothnessFactor = 8;        // Default smoothing margin.(kRenderingDepth + kSmoothnessFactor + 1)
+constexpr uint32_t kMaxDequeueWorksPerTask = 16;        // Max input works sent to the decoder in one onDequeueWork.
+constexpr nsecs_t kDequeueWorkBudgetNs = 4000000;       // Time budget of one onDequeueWork, 4ms.
+constexpr int32_t kSideDataPoolSlots = 16;              // Side data copies of the queued input works.
+constexpr uint32_t kSideDataMaxSlotSize = 4096;         // Larger side data is copied on heap.
 }  // namespace
 
 static c2_status_t adaptorResultToC2Status(VideoDecodeAcceleratorAdaptor::Result result) {
@@ -163,64 +171,60 @@ C2VdecComponent::VideoFormat::VideoFormat(HalPixelFormat pixelFormat, uint32_t m
         mVisibleRect(visibleRect) {}
 
 
-// static
-std::atomic<int32_t> C2VdecComponent::sConcurrentInstances = 0;
-std::atomic<int32_t> C2VdecComponent::sConcurrentInstanceSecures = 0;
-std::atomic<int32_t> C2VdecComponent::sConcurrentMaxResolutionInstance = 0;
-std::atomic<int32_t> C2VdecComponent::sConcurrentVc1Instance = 0;
-
-
-
-
 // static
 std::shared_ptr<C2Component> C2VdecComponent::create(
         const std::string& name, c2_node_id_t id, const std::shared_ptr<C2ReflectorHelper>& helper,
         C2ComponentFactory::ComponentDeleter deleter) {
     UNUSED(deleter);
-    bool isLowMemDevice = !property_get_bool(PROPERTY_PLATFORM_SUPPORT_4K, true);
-    int maxInstance = isLowMemDevice ? MAX_INSTANCE_LOW_RAM : MAX_INSTANCE_DEFAULT;
-    int maxInstanceSecure = isLowMemDevice ? MAX_INSTANCE_SECURE_LOW_RAM : MAX_INSTANCE_SECURE_DEFAULT;
-    static const int32_t kMaxConcurrentInstances =
-            property_get_int32(C2_PROPERTY_VDEC_INST_MAX_NUM, maxInstance);
-    static const int32_t kMaxSecureConcurrentInstances =
-            property_get_int32(C2_PROPERTY_VDEC_INST_MAX_NUM_SECURE, maxInstanceSecure);
-    static const int32_t kMaxHighResConcurrentInstances =
-            property_get_int32(C2_PROPERTY_VDEC_INST_MAX_HIGH_RES_NUM, MAX_INSTANCE_HIGH_RES_DEFAULT);
-    static std::mutex mutex;
-    std::lock_guard<std::mutex> lock(mutex);
-    bool isSecure = name.find(".secure") != std::string::npos;
-    if (isSecure) {
-        if (kMaxSecureConcurrentInstances >= 0 && sConcurrentInstanceSecures.load() >= kMaxSecureConcurrentInstances) {
-            ALOGW("Reject to Initialize() due to too many secure instances: %d", sConcurrentInstanceSecures.load());
-            return nullptr;
-        }
-        if (kMaxSecureConcurrentInstances >= 0 &&
-            ((sConcurrentInstances.load() + sConcurrentInstanceSecures.load()) >= kMaxConcurrentInstances)) {
-            ALOGW("Reject to Initialize() due to too many secure and nosecure instances: %d", sConcurrentInstanceSecures.load());
-            return nullptr;
-        }
-    } else {
-        if (kMaxConcurrentInstances >= 0 &&
-            ((sConcurrentInstances.load() + sConcurrentInstanceSecures.load()) >= kMaxConcurrentInstances)) {
-            ALOGW("Reject to Initialize() due to too many instances: %d", sConcurrentInstances.load());
-            return nullptr;
-        }
-        //since vc1 use single mode in decoder now, so only 1 instance can be used
-        if (sConcurrentVc1Instance.load() > 0 || ((sConcurrentInstances.load() + sConcurrentInstanceSecures.load()) > 0
-            && name.find(".vc1") != std::string::npos)) {
-            ALOGW("Reject to Initialize() due to vc1 can only create one instance or can't paly with other vdec, sConcurrentVc1Instance:%d",
-                sConcurrentVc1Instance.load());
-            return nullptr;
-        }
-    }
+    static std::once_flag budgetOnce;
+    std::call_once(budgetOnce, []() {
+        bool isLowMemDevice = !property_get_bool(PROPERTY_PLATFORM_SUPPORT_4K, true);
+        int maxInstance = isLowMemDevice ? MAX_INSTANCE_LOW_RAM : MAX_INSTANCE_DEFAULT;
+        int maxInstanceSecure = isLowMemDevice ? MAX_INSTANCE_SECURE_LOW_RAM : MAX_INSTANCE_SECURE_DEFAULT;
+        C2VdecResourceBudget budget;
+        budget.mMaxInstances = property_get_int32(C2_PROPERTY_VDEC_INST_MAX_NUM, maxInstance);
+        budget.mMaxSecureInstances = property_get_int32(C2_PROPERTY_VDEC_INST_MAX_NUM_SECURE, maxInstanceSecure);
+        budget.mMaxHighResInstances = property_get_int32(C2_PROPERTY_VDEC_INST_MAX_HIGH_RES_NUM, MAX_INSTANCE_HIGH_RES_DEFAULT);
+        int32_t mbps = property_get_int32(C2_PROPERTY_VDEC_MBPS_BUDGET,
+                isLowMemDevice ? MBPS_BUDGET_LOW_RAM : MBPS_BUDGET_DEFAULT);
+        int32_t memoryMB = property_get_int32(C2_PROPERTY_VDEC_MEMORY_BUDGET_MB, 0);
+        budget.mMaxMbPerSec = (mbps > 0) ? mbps : 0;
+        budget.mMaxMemoryBytes = (memoryMB > 0) ? (uint64_t)memoryMB * 1024 * 1024 : 0;
+        C2VdecResourcePolicy::getInstance().setBudget(budget);
+    });
 
-    ALOGW("Initialize() instances: %d", sConcurrentMaxResolutionInstance.load());
-    if (kMaxHighResConcurrentInstances >= 0 && (sConcurrentMaxResolutionInstance.load() >= kMaxHighResConcurrentInstances)) {
-        ALOGW("Reject to Initialize() due to too many Max instances: %d", sConcurrentMaxResolutionInstance.load());
+    C2VdecResourceRequest request;
+    memset(&request, 0, sizeof(request));
+    request.mSecure = name.find(".secure") != std::string::npos;
+    //since vc1 use single mode in decoder now, so only 1 instance can be used
+    request.mExclusive = name.find(".vc1") != std::string::npos;
+    //the priority is only configured later, a new instance counts as realtime.
+    request.mPriority = 0;
+    request.mForeground = true;
+    C2VdecResourceDecision decision;
+    C2VdecResourcePolicy& policy = C2VdecResourcePolicy::getInstance();
+    int32_t handle = policy.acquire(request, &decision);
+    if (handle < 0) {
+        ALOGW("Reject to Initialize() %s due to too many instances: %d secure: %d max res: %d",
+                name.c_str(), policy.getInstanceCount(false), policy.getInstanceCount(true),
+                policy.getHighResInstanceCount());
         return nullptr;
     }
+    if (decision.mPreemptedCount > 0) {
+        ALOGW("Initialize() %s preempted %d background instances", name.c_str(), decision.mPreemptedCount);
+    }
 
-    return std::shared_ptr<C2Component>(new C2VdecComponent(name, id, helper));
+    std::shared_ptr<C2VdecComponent> comp(new C2VdecComponent(name, id, helper));
+    comp->mResourceHandle = handle;
+    //the policy may call back after the component is gone.
+    std::weak_ptr<C2VdecComponent> weakComp = comp;
+    policy.setPreemptCallback(handle, [weakComp]() {
+        std::shared_ptr<C2VdecComponent> comp = weakComp.lock();
+        if (comp) {
+            comp->Preempted();
+        }
+    });
+    return comp;
 }
 
 struct DummyReadView : public C2ReadView {
@@ -270,18 +274,18 @@ C2VdecComponent::C2VdecComponent(C2String name, c2_node_id_t id,
     mTaskRunner = mThread.task_runner();
     mState.store(State::LOADED);
 
-    propGetInt(CODEC2_VDEC_LOGDEBUG_PROPERTY, &gloglevel);
+    //reload the properties only if one was set since the last instance.
+    C2VdecPropertySnapshot::getInstance().refreshIfChanged();
+    std::shared_ptr<const C2VdecProperties> props = C2VdecPropertySnapshot::getInstance().get();
+    gloglevel = props->mLogLevel;
     //default 1min
-    mDefaultRetryBlockTimeOutMs = (uint64_t)property_get_int32(C2_PROPERTY_VDEC_RETRYBLOCK_TIMEOUT, DEFAULT_RETRYBLOCK_TIMEOUT_MS);
-    mSkipErrFrameTimeOut = (uint64_t)property_get_int32(C2_PROPERTY_VDEC_SKIP_ERRFRAME_TIMEOUT, DEFAULT_SKIP_ERR_FRAMES_TIMEOUT);
-    mFdInfoDebugEnable = property_get_bool(C2_PROPERTY_VDEC_FD_INFO_DEBUG, false);
+    mDefaultRetryBlockTimeOutMs = (uint64_t)props->mRetryBlockTimeoutMs;
+    mSkipErrFrameTimeOut = (uint64_t)props->mSkipErrFrameTimeout;
+    mFdInfoDebugEnable = props->mFdInfoDebug;
 
-    bool support_soft_10bit = property_get_bool(C2_PROPERTY_VDEC_SUPPORT_10BIT, true);
-    support_soft_10bit = property_get_bool(PROPERTY_PLATFORM_SUPPORT_SOFTWARE_P010, support_soft_10bit);
-    bool support_hardware_10bit = property_get_bool(PROPERTY_PLATFORM_SUPPORT_HARDWARE_P010, false);
-
-    mSupport10BitDepth = support_soft_10bit || support_hardware_10bit;
+    mSupport10BitDepth = props->mSupport10Bit || props->mHwSupportP010;
     mDebugUtil = std::make_shared<DebugUtil>();
+    mSideDataPool = C2VdecSideDataPool::create(kSideDataPoolSlots, kSideDataMaxSlotSize);
     addObserver(mDebugUtil, static_cast<int>(mComponentState), mCompHasError);
     mDequeueThreadUtil = std::make_shared<DequeueThreadUtil>();
     addObserver(mDequeueThreadUtil, static_cast<int>(mComponentState), mCompHasError);
@@ -318,6 +322,7 @@ void C2VdecComponent::Init(C2String compName) {
     mPendingOutputEOS = false;
     mCanQueueOutBuffer = false;
     mSurfaceUsageGot = false;
+    mStreamHeaderSniffed = false;
     mResolutionChanging = false;
     mPictureSizeChanged = false;
     mBufferFirstAllocated = false;
@@ -332,6 +337,9 @@ void C2VdecComponent::Init(C2String compName) {
     mUnstable = 0;
     mInputQueueNum = 0;
     mInputBufferNum = 0;
+    mDequeueWorkScheduled = false;
+    mDequeueWakeupCount = 0;
+    mDequeueDispatchCount = 0;
     mInputWorkCount = 0;
     mOutBufferCount = 0;
     mOutputWorkCount = 0;
@@ -360,13 +368,7 @@ void C2VdecComponent::Init(C2String compName) {
     memset(mGraphicBlockStateCount, 0, sizeof(mGraphicBlockStateCount));
 
     mSecureMode = compName.find(".secure") != std::string::npos;
-    if (mSecureMode)
-        sConcurrentInstanceSecures.fetch_add(1, std::memory_order_relaxed);
-    else
-        sConcurrentInstances.fetch_add(1, std::memory_order_relaxed);
-    if (compName.find(".vc1") != std::string::npos) {
-        sConcurrentVc1Instance.fetch_add(1, std::memory_order_relaxed);
-    }
+    mResourceHandle = -1;
 
     mIsDolbyVision = compName.find(".dolby-vision") != std::string::npos;
     mIsReleasing = false;
@@ -388,6 +390,9 @@ C2VdecComponent::~C2VdecComponent() {
         done.Wait();
         mThread.Stop();
     }
+    //onDestroy only runs when the thread was started.
+    C2VdecResourcePolicy::getInstance().release(mResourceHandle);
+    mResourceHandle = -1;
 
     C2Vdec_LOG(CODEC2_LOG_INFO, "~C2VdecComponent done");
     --mInstanceNum;
@@ -447,17 +452,6 @@ void C2VdecComponent::onDestroy(::base::WaitableEvent* done) {
     if (mStopDoneEvent != nullptr)
         mStopDoneEvent = nullptr;
 
-    if (mSecureMode)
-        sConcurrentInstanceSecures.fetch_sub(1, std::memory_order_relaxed);
-    else
-        sConcurrentInstances.fetch_sub(1, std::memory_order_relaxed);
-
-    if (mIsMaxResolution)
-        sConcurrentMaxResolutionInstance.fetch_sub(1, std::memory_order_relaxed);
-    if (mIntfImpl->getInputCodec() == InputCodec::VC1) {
-        sConcurrentVc1Instance.fetch_sub(1, std::memory_order_relaxed);
-    }
-
     updateComponentState(ComponentState::DESTROYED);
     done->Signal();
     C2Vdec_LOG(CODEC2_LOG_INFO, "[%s] done", __func__);
@@ -468,8 +462,8 @@ void C2VdecComponent::onStart(media::VideoCodecProfile profile, ::base::Waitable
     updateComponentState(ComponentState::STARTING);
     C2Vdec_LOG(CODEC2_LOG_INFO, "OnStart DolbyVision:%d", mIsDolbyVision);
     //CHECK_EQ(mComponentState, ComponentState::UNINITIALIZED);
-    bool disableRC = property_get_bool(C2_PROPERTY_VDEC_DISABLE_RC, true);
-    if (!disableRC) {
+    std::shared_ptr<const C2VdecProperties> props = C2VdecPropertySnapshot::getInstance().get();
+    if (!props->mDisableRC) {
         struct sched_param param = {0};
         param.sched_priority = 1;
         if (sched_setscheduler(0, SCHED_RR, &param) != 0) {
@@ -477,8 +471,7 @@ void C2VdecComponent::onStart(media::VideoCodecProfile profile, ::base::Waitable
         }
     } else {
         int niceval = -10;
-        int priorityval = 0;
-        propGetInt(C2_PROPERTY_VDEC_DEBUG_PRIORITY, &priorityval);
+        int priorityval = props->mDebugPriority;
         niceval = ((priorityval > 0) ? (priorityval - 120) : (-10));
         if (setpriority(PRIO_PROCESS, 0, niceval) != 0) {
             C2Vdec_LOG(CODEC2_LOG_ERR, "setpriority error: %s, niceval:%d", strerror(errno), niceval);
@@ -511,6 +504,7 @@ void C2VdecComponent::onStart(media::VideoCodecProfile profile, ::base::Waitable
             mSessionID = mPlayerId;
         }
         mVideoDecWraper->setSessionID((uint32_t)mSessionID);
+        updateResourceUsage();
         mDeviceUtil->codecConfig(&mConfigParam);
 
         //update profile
@@ -603,7 +597,8 @@ void C2VdecComponent::TraceInit() {
     TRACE_NAME_VDEC_COMPONENT_THREAD << mSessionID << "-" << mDecoderID << "-C2VdecComponentThread";
 }
 
-void C2VdecComponent::onQueueWork(std::unique_ptr<C2Work> work, std::shared_ptr<C2StreamHdrDynamicMetadataInfo::input> info) {
+void C2VdecComponent::onQueueWork(std::unique_ptr<C2Work> work, C2VdecSideDataPool::Buffer info,
+        int32_t hdr10PlusParamIndex) {
     DCHECK(mTaskRunner->BelongsToCurrentThread());
     RETURN_ON_UNINITIALIZED_OR_ERROR();
 
@@ -634,10 +629,10 @@ void C2VdecComponent::onQueueWork(std::unique_ptr<C2Work> work, std::shared_ptr<
         mInputCSDWorkCount ++;
     }
     //std::shared_ptr<C2StreamHdr10PlusInfo::input> info((mIntfImpl->getHdr10PlusInfo()));
-    mQueue.push({std::move(work), drainMode, info});
+    mQueue.push({std::move(work), drainMode, std::move(info), hdr10PlusParamIndex});
 
     //  TODO: set a maximum size of mQueue and check if mQueue is already full.
-    mTaskRunner->PostTask(FROM_HERE, ::base::Bind(&C2VdecComponent::onDequeueWork, mWeakThisFactory.GetWeakPtr()));
+    scheduleDequeueWork();
 
     if (mReportEosWork == true || (mHaveFlushDone == true)) {
         mReportEosWork = false;
@@ -717,7 +712,7 @@ void C2VdecComponent::onReusedOutBuf() {
 
 void C2VdecComponent::onDequeueWork() {
     DCHECK(mTaskRunner->BelongsToCurrentThread());
-    uint32_t queueWorkCount = mQueue.size();
+    mDequeueWorkScheduled = false;
     RETURN_ON_UNINITIALIZED_OR_ERROR();
     if (mQueue.empty()) {
         return;
@@ -741,10 +736,44 @@ void C2VdecComponent::onDequeueWork() {
         reStartAllocTask();
     }
 
+    //drain the queue in one wakeup,bounded so the output side is not starved.
+    nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    uint32_t dispatched = 0;
+    while (!mQueue.empty() && mComponentState == ComponentState::STARTED && !mCompHasError) {
+        if (dispatched >= kMaxDequeueWorksPerTask
+            || systemTime(SYSTEM_TIME_MONOTONIC) - startTime >= kDequeueWorkBudgetNs) {
+            break;
+        }
+        dispatchQueuedWork();
+        dispatched++;
+    }
+    mDequeueWakeupCount++;
+    mDequeueDispatchCount += dispatched;
+    CODEC2_LOG(CODEC2_LOG_DEBUG_LEVEL2, "[%s] dispatched %u works, remain:%zu, average %.2f per wakeup", __func__,
+            dispatched, mQueue.size(), (double)mDequeueDispatchCount / mDequeueWakeupCount);
+
+    //reportError() keeps the state,the works left wait for the client to stop.
+    if (!mQueue.empty() && !mCompHasError) {
+        scheduleDequeueWork();
+    }
+}
+
+void C2VdecComponent::scheduleDequeueWork() {
+    DCHECK(mTaskRunner->BelongsToCurrentThread());
+    if (mDequeueWorkScheduled) {
+        return;
+    }
+    mDequeueWorkScheduled = true;
+    mTaskRunner->PostTask(FROM_HERE, ::base::Bind(&C2VdecComponent::onDequeueWork,
+                                                  mWeakThisFactory.GetWeakPtr()));
+}
+
+void C2VdecComponent::dispatchQueuedWork() {
     // Dequeue a work from mQueue.
     std::unique_ptr<C2Work> work(std::move(mQueue.front().mWork));
     auto drainMode = mQueue.front().mDrainMode;
-    std::shared_ptr<C2StreamHdrDynamicMetadataInfo::input> hdrInfo = mQueue.front().mHdr10PlusInfo;
+    C2VdecSideDataPool::Buffer hdrInfo(std::move(mQueue.front().mHdr10PlusInfo));
+    int32_t hdr10PlusParamIndex = mQueue.front().mHdr10PlusParamIndex;
     mQueue.pop();
 
     //CHECK_LE(work->input.buffers.size(), 1u);
@@ -773,46 +802,37 @@ void C2VdecComponent::onDequeueWork() {
         //check hdr10 plus
         uint8_t *hdr10plusBuf = nullptr;
         uint32_t hdr10plusLen = 0;
-        C2ReadView rView = mDefaultDummyReadView;
         bool isHdr10PlusInfoWithWork = false;
 
-        for (const std::unique_ptr<C2Param> &param : work->input.configUpdate) {
-            switch (param->coreIndex().coreIndex()) {
-                case C2StreamHdr10PlusInfo::CORE_INDEX:
-                    {
-                        C2StreamHdr10PlusInfo::input *hdr10PlusInfo =
-                        C2StreamHdr10PlusInfo::input::From(param.get());
-                        if (hdr10PlusInfo != nullptr) {
-                            std::vector<std::unique_ptr<C2SettingResult>> failures;
-                            std::unique_ptr<C2Param> outParam = C2Param::CopyAsStream(*param.get(), true /* out put*/, param->stream());
-
-                            isHdr10PlusInfoWithWork = true;
-                            hdr10plusBuf = hdr10PlusInfo->m.value;
-                            hdr10plusLen = hdr10PlusInfo->flexCount();
-                            c2_status_t err = mIntfImpl->config({outParam.get()}, C2_MAY_BLOCK, &failures);
-                            if (err == C2_OK) {
-                                work->worklets.front()->output.configUpdate.push_back(C2Param::Copy(*outParam.get()));
-                            } else {
-                                C2Vdec_LOG(CODEC2_LOG_ERR, "Config update hdr10Plus size Failed.");
-                            }
-                        }
-                    }
-                    break;
-                case C2StreamHdrDynamicMetadataInfo::CORE_INDEX:
-                    C2Vdec_LOG(CODEC2_LOG_INFO, "Config Update hdrDynamicMetadateInfo");
-                    break;
-                default:
-                    break;
+        if (hdr10PlusParamIndex >= 0 && hdr10PlusParamIndex < (int32_t)work->input.configUpdate.size()) {
+            const std::unique_ptr<C2Param> &param = work->input.configUpdate[hdr10PlusParamIndex];
+            C2StreamHdr10PlusInfo::input *hdr10PlusInfo =
+                C2StreamHdr10PlusInfo::input::From(param.get());
+            if (hdr10PlusInfo != nullptr) {
+                std::vector<std::unique_ptr<C2SettingResult>> failures;
+                std::unique_ptr<C2Param> outParam = C2Param::CopyAsStream(*param.get(), true /* out put*/, param->stream());
+
+                isHdr10PlusInfoWithWork = true;
+                hdr10plusBuf = hdr10PlusInfo->m.value;
+                hdr10plusLen = hdr10PlusInfo->flexCount();
+                c2_status_t err = mIntfImpl->config({outParam.get()}, C2_MAY_BLOCK, &failures);
+                if (err == C2_OK) {
+                    work->worklets.front()->output.configUpdate.push_back(std::move(outParam));
+                } else {
+                    C2Vdec_LOG(CODEC2_LOG_ERR, "Config update hdr10Plus size Failed.");
+                }
             }
         }
         if (mIntfImpl->mIsSupportHdr && !isHdr10PlusInfoWithWork) {
-            if (hdrInfo != nullptr) {
-                hdr10plusBuf = hdrInfo->m.data;
-                hdr10plusLen = hdrInfo->flexCount();
+            if (hdrInfo.valid()) {
+                hdr10plusBuf = hdrInfo.data();
+                hdr10plusLen = hdrInfo.size();
                 std::unique_ptr<C2StreamHdrDynamicMetadataInfo::output> hdr10PlusInfo =
                     C2StreamHdrDynamicMetadataInfo::output::AllocUnique(hdr10plusLen);
-                hdr10PlusInfo->m.type_ = hdrInfo->m.type_;
-                memcpy(hdr10PlusInfo->m.data, hdr10plusBuf, hdr10plusLen);
+                hdr10PlusInfo->m.type_ = (C2Config::hdr_dynamic_metadata_type_t)hdrInfo.type();
+                if (hdr10plusLen > 0) {
+                    memcpy(hdr10PlusInfo->m.data, hdr10plusBuf, hdr10plusLen);
+                }
                 work->worklets.front()->output.configUpdate.push_back(std::move(hdr10PlusInfo));
             } else {
                 mIntfImpl->updateHdr10PlusInfoToWork(*work);
@@ -844,8 +864,8 @@ void C2VdecComponent::onDequeueWork() {
     }
 
     // Put work to mPendingWorks.
-    CODEC2_LOG(CODEC2_LOG_TAG_BUFFER, "OnDequeueWork,queue work size:%d put pending work bitId:%d, pending work size:%zd",
-            queueWorkCount, frameIndexToBitstreamId(work->input.ordinal.frameIndex.peeku()), mPendingWorks.size());
+    CODEC2_LOG(CODEC2_LOG_TAG_BUFFER, "OnDequeueWork,queue work size:%zu put pending work bitId:%d, pending work size:%zd",
+            mQueue.size(), frameIndexToBitstreamId(work->input.ordinal.frameIndex.peeku()), mPendingWorks.size());
 
     mPendingWorks.emplace_back(std::move(work));
 
@@ -854,10 +874,6 @@ void C2VdecComponent::onDequeueWork() {
         C2Vdec_LOG(CODEC2_LOG_INFO, "OnDequeueWork empty csd work, bitId:%d\n", bitstreamId);
         reportWorkIfFinished(bitstreamId, 0, isEmptyWork);
     }
-    if (!mQueue.empty()) {
-        mTaskRunner->PostTask(FROM_HERE, ::base::Bind(&C2VdecComponent::onDequeueWork,
-                                                      mWeakThisFactory.GetWeakPtr()));
-    }
 }
 
 void C2VdecComponent::onInputBufferDone(int32_t bitstreamId) {
@@ -970,10 +986,7 @@ void C2VdecComponent::onOutputBufferReturned(std::shared_ptr<C2GraphicBlock> blo
     } else {
         // Do not pass the ownership to accelerator if this buffer will still be reused under
         // |mPendingBuffersToWork|.
-        auto existingFrame = std::find_if(
-                mPendingBuffersToWork.begin(), mPendingBuffersToWork.end(),
-                [id = info->mBlockId](const OutputBufferInfo& o) { return o.mBlockId == id; });
-        bool ownByAccelerator = existingFrame == mPendingBuffersToWork.end();
+        bool ownByAccelerator = !mPendingBuffersToWork.containsBlockId(info->mBlockId);
         sendOutputBufferToAccelerator(info, ownByAccelerator);
         sendOutputBufferToWorkIfAny(false /* dropIfUnavailable */);
     }
@@ -1298,7 +1311,7 @@ c2_status_t C2VdecComponent::sendOutputBufferToWorkIfAny(bool dropIfUnavailable)
         if (isSendCloneWork) {
             sendClonedWork(work, nextBuffer.flags);
         } else {
-            mPendingBuffersToWork.at(0).mSetOutInfo = true;
+            mPendingBuffersToWork.front().mSetOutInfo = true;
             c2_status_t status = reportWorkIfFinished(nextBuffer.mBitstreamId, nextBuffer.flags);
             if (status != C2_OK) {
                 C2Vdec_LOG(CODEC2_LOG_ERR, "[%s] reportWorkIfFinished- error.size(%zd) workdone[%d]input[%d]", __func__, mPendingBuffersToWork.size(), isWorkDone(work),isInputWorkDone(work));
@@ -1377,6 +1390,28 @@ void C2VdecComponent::updateUndequeuedBlockIds(int32_t blockId) {
     mUndequeuedBlockIds.pop_front();
 }
 
+void C2VdecComponent::updateResourceUsage() {
+    C2VdecResourceRequest request;
+    memset(&request, 0, sizeof(request));
+    request.mPriority = mIntfImpl->mRealTimePriority->value;
+    //the tunnel video is the main video on the screen.
+    request.mForeground = (request.mPriority <= 0) || isTunnelMode();
+    request.mWidth = mIntfImpl->mSize->width;
+    request.mHeight = mIntfImpl->mSize->height;
+    float frameRate = mIntfImpl->getInputFrameRate();
+    request.mFrameRate = (frameRate > 0) ? (uint32_t)(frameRate + 0.5) : 0;
+
+    C2VdecResourceDecision decision = C2VdecResourcePolicy::getInstance().update(mResourceHandle, request);
+    C2Vdec_LOG(CODEC2_LOG_INFO, "[%s] %dx%d@%d priority:%d foreground:%d %s preempted:%d over budget:%d", __func__,
+            request.mWidth, request.mHeight, request.mFrameRate, request.mPriority, request.mForeground,
+            C2VdecResourcePolicy::actionToString(decision.mAction), decision.mPreemptedCount, decision.mOverCommitted);
+    if (decision.mAction == C2VdecResourceDecision::REJECT) {
+        //yield like an instance preempted by the resource manager, checkPreempting reports it.
+        Preempted();
+    }
+    mDeviceUtil->setResourceDowngrade(decision.mAction == C2VdecResourceDecision::DOWNGRADE);
+}
+
 void C2VdecComponent::checkPreempting() {
     if (mComponentState >= ComponentState::STARTED && mComponentState < ComponentState::DESTROYING
         && Preempting()) {
@@ -1450,8 +1485,7 @@ void C2VdecComponent::onDrainDone() {
 
     if (isTunnelMode()) {
         CODEC2_LOG(CODEC2_LOG_INFO, "[%s:%d] tunnel mode reset done", __FUNCTION__, __LINE__);
-        mTaskRunner->PostTask(FROM_HERE,
-                          ::base::Bind(&C2VdecComponent::onDequeueWork, mWeakThisFactory.GetWeakPtr()));
+        scheduleDequeueWork();
         return;
     }
 
@@ -1469,8 +1503,7 @@ void C2VdecComponent::onDrainDone() {
     }
 
     // Work dequeueing was stopped while component draining. Restart it.
-    mTaskRunner->PostTask(FROM_HERE,
-                          ::base::Bind(&C2VdecComponent::onDequeueWork, mWeakThisFactory.GetWeakPtr()));
+    scheduleDequeueWork();
 }
 
 void C2VdecComponent::onFlush() {
@@ -1714,6 +1747,7 @@ void C2VdecComponent::onStopDone() {
     }
     mBufferFirstAllocated = false;
     mSurfaceUsageGot = false;
+    mStreamHeaderSniffed = false;
     for (auto& info : mGraphicBlocks) {
         C2Vdec_LOG(CODEC2_LOG_DEBUG_LEVEL2, "GraphicBlock reset, block Info Id:%d Fd:%d poolId:%d State:%s block use count:%ld",
             info.mBlockId, info.mFd, info.mPoolId, GraphicBlockState(info.mState), info.mGraphicBlock.use_count());
@@ -1748,6 +1782,12 @@ c2_status_t C2VdecComponent::setListener_vb(const std::shared_ptr<C2Component::L
 void C2VdecComponent::sendInputBufferToAccelerator(const C2ConstLinearBlock& input,
         int32_t bitstreamId, uint64_t timestamp,int32_t flags,uint8_t *hdrbuf,uint32_t hdrlen) {
     //UNUSED(flags);
+    //the decoder reads the bitstream from the dmabuf with the block offset, it is never mapped here.
+    if (input.handle() == nullptr || input.handle()->numFds < 1) {
+        C2Vdec_LOG(CODEC2_LOG_ERR, "Input buffer (bitstreamId:%d) has no fd", bitstreamId);
+        reportError(C2_CORRUPTED);
+        return;
+    }
     int dupFd = dup(input.handle()->data[0]);
     if (dupFd < 0) {
         C2Vdec_LOG(CODEC2_LOG_ERR, "Failed to dup(%d) input buffer (bitstreamId:%d), errno:%d", input.handle()->data[0],
@@ -1759,6 +1799,9 @@ void C2VdecComponent::sendInputBufferToAccelerator(const C2ConstLinearBlock& inp
             bitstreamId, timestamp, input.offset(), (int)input.size(), hdrlen, flags);
     if (mDebugUtil) {
         mDebugUtil->emptyBuffer((void*) input.handle(), timestamp, flags, input.size());
+        if (C2VdecPropertySnapshot::getInstance().get()->mDumpInput) {
+            mDebugUtil->dumpInputBuffer(input, bitstreamId);
+        }
     }
     if (mVideoDecWraper != NULL) {
         mVideoDecWraper->decode(bitstreamId, dupFd, input.offset(), input.size(), timestamp, hdrbuf, hdrlen, flags);
@@ -1891,17 +1934,12 @@ C2VdecComponent::GraphicBlockInfo* C2VdecComponent::getGraphicBlockByFd(int32_t
     return &(*blockIter);
 }
 
-std::deque<C2VdecComponent::OutputBufferInfo>::iterator C2VdecComponent::findPendingBuffersToWorkByTime(uint64_t timeus) {
-    return std::find_if(mPendingBuffersToWork.begin(), mPendingBuffersToWork.end(),
-            [time=timeus](const OutputBufferInfo& o) {
-                return o.mMediaTimeUs == time;});
+C2VdecOutputLedger::iterator C2VdecComponent::findPendingBuffersToWorkByTime(uint64_t timeus) {
+    return mPendingBuffersToWork.findByTime(timeus);
 }
 
 bool C2VdecComponent::erasePendingBuffersToWorkByTime(uint64_t timeus) {
-   auto buffer = findPendingBuffersToWorkByTime(timeus);
-   if (buffer != mPendingBuffersToWork.end()) {
-       mPendingBuffersToWork.erase(buffer);
-   }
+   mPendingBuffersToWork.eraseByTime(timeus);
 
    return C2_OK;
 }
@@ -1964,7 +2002,7 @@ void C2VdecComponent::updateOutputDelayBufCount() {
         dequeueBufferNum = mOutputFormat.mMinNumBuffers;
     }
 
-    int32_t bufferNumAdd = property_get_int32(C2_PROPERTY_VDEC_OUT_ADD_DELAY, 0);
+    int32_t bufferNumAdd = C2VdecPropertySnapshot::getInstance().get()->mOutAddDelay;
     dequeueBufferNum += bufferNumAdd;
     C2Vdec_LOG(CODEC2_LOG_INFO, "Update dequeue buffer num: %d -> %d out delay buffer margin:%d", mOutputFormat.mMinNumBuffers, dequeueBufferNum, bufferNumAdd);
 
@@ -2044,6 +2082,9 @@ void C2VdecComponent::tryChangeOutputFormat() {
     mOutputFormat.mPixelFormat = mPendingOutputFormat->mPixelFormat;
     mOutputFormat.mMinNumBuffers = mPendingOutputFormat->mMinNumBuffers;
     mOutputFormat.mCodedSize = mPendingOutputFormat->mCodedSize;
+    if (mDeviceUtil) {
+        mDeviceUtil->invalidateAllocProfile();
+    }
 
     setOutputFormatCrop(mPendingOutputFormat->mVisibleRect);
 
@@ -2082,17 +2123,17 @@ void C2VdecComponent::tryChangeOutputFormat() {
 c2_status_t C2VdecComponent::videoResolutionChange() {
     C2Vdec_LOG(CODEC2_LOG_INFO, "VideoResolutionChange");
 
-    bool bufferSizeChanged = false;
-    bool bufferNumIncreased = false;
     mPendingOutputFormat.reset();
     if (mDequeueThreadUtil)
         mDequeueThreadUtil->StopRunDequeueTask();
 
-    auto reallocate = mDeviceUtil->isReallocateOutputBuffer(mLastOutputFormat, mOutputFormat, &bufferSizeChanged, &bufferNumIncreased);
-    C2Vdec_LOG(CODEC2_LOG_DEBUG_LEVEL2, "output buffer reallocate:%d size change:%d number increase:%d", reallocate, bufferSizeChanged, bufferNumIncreased);
+    C2VdecBufferPlan plan = mDeviceUtil->planOutputBufferSet(mLastOutputFormat, mOutputFormat);
+    bool reallocate = (plan.mAction == C2VdecBufferPlan::REALLOC);
+    C2Vdec_LOG(CODEC2_LOG_DEBUG_LEVEL2, "output buffer plan:%s size change:%d number increase:%d",
+        C2VdecBufferPlanner::actionToString(plan.mAction), plan.mSizeChanged, plan.mBufferNumIncreased);
 
     if (mBlockPoolUtil->isBufferQueue()) {
-        if (bufferSizeChanged) {
+        if (reallocate) {
             for (auto& info : mGraphicBlocks) {
                 info.mFdHaveSet = false;
                 info.mBind = false;
@@ -2126,7 +2167,7 @@ c2_status_t C2VdecComponent::videoResolutionChange() {
             if (mVideoDecWraper) {
                 mVideoDecWraper->assignPictureBuffers(mOutputFormat.mMinNumBuffers);
             }
-        } else if (bufferNumIncreased) {
+        } else if (plan.mAction == C2VdecBufferPlan::GROW) {
             C2Vdec_LOG(CODEC2_LOG_DEBUG_LEVEL2, "[%s:%d] Do not need realloc", __func__, __LINE__);
             if (mVideoDecWraper) {
                 mVideoDecWraper->assignPictureBuffers(mOutputFormat.mMinNumBuffers);
@@ -2195,6 +2236,12 @@ c2_status_t C2VdecComponent::videoResolutionChange() {
                     mBlockPoolUtil->resetGraphicBlock(info.mBlockId);
                 }
             }
+            if (plan.mAction == C2VdecBufferPlan::GROW) {
+                //the dequeue thread fetches the added buffers,only the pool limit grows
+                size_t bufferCount = mOutputFormat.mMinNumBuffers + kDpbOutputBufferExtraCount;
+                C2Vdec_LOG(CODEC2_LOG_DEBUG_LEVEL2, "Keep %u buffers and add %u", plan.mKeepCount, plan.mAddCount);
+                mBlockPoolUtil->requestNewBufferSet(static_cast<int32_t>(bufferCount));
+            }
 
             if (mVideoDecWraper) {
                 mVideoDecWraper->assignPictureBuffers(mOutputFormat.mMinNumBuffers);
@@ -2453,7 +2500,10 @@ c2_status_t C2VdecComponent::allocNonTunnelBuffers(const media::Size& size, uint
     }
     int32_t llv_first_alloc_num = mOutBufferCount / 2;
     if (mDeviceUtil->isLowLatencyMode() && (dequeue_buffer_num > llv_first_alloc_num)) {
-        llv_first_alloc_num = property_get_int32(C2_PROPERTY_VDEC_LLV_FIRST_ALLOC_NUM, llv_first_alloc_num);
+        int32_t propAllocNum = C2VdecPropertySnapshot::getInstance().get()->mLlvFirstAllocNum;
+        if (propAllocNum >= 0) {
+            llv_first_alloc_num = propAllocNum;
+        }
         CODEC2_LOG(CODEC2_LOG_INFO, "lowlatency mode set first alloc buffer num from %d to %d", dequeue_buffer_num, llv_first_alloc_num);
         dequeue_buffer_num = llv_first_alloc_num;
     }
@@ -2958,6 +3008,20 @@ c2_status_t C2VdecComponent::queue_nb(std::list<std::unique_ptr<C2Work>>* const
         return C2_BAD_STATE;
     }
 
+    //predict the stream format from the first input,posted ahead of the decoder reconfig that uses it
+    for (auto it = items->begin(); !mStreamHeaderSniffed.load() && it != items->end(); ++it) {
+        C2VdecStreamHeaderInfo headerInfo;
+        bool inspected = false;
+        //works without data,such as a lone eos,leave it to the next input.
+        if (sniffStreamHeader(it->get(), &headerInfo, &inspected)) {
+            mTaskRunner->PostTask(FROM_HERE,
+                        ::base::Bind(&C2VdecComponent::onStreamHeaderSniffed, mWeakThisFactory.GetWeakPtr(), headerInfo));
+        }
+        if (inspected) {
+            mStreamHeaderSniffed = true;
+        }
+    }
+
     if (!mSurfaceUsageGot) {
         if (isNonTunnelMode())
             mTaskRunner->PostTask(FROM_HERE,
@@ -2967,17 +3031,95 @@ c2_status_t C2VdecComponent::queue_nb(std::list<std::unique_ptr<C2Work>>* const
     while (!items->empty()) {
         CODEC2_ATRACE_CALL();
         mHasQueuedWork = true;
-        std::shared_ptr<C2StreamHdrDynamicMetadataInfo::input> info((mIntfImpl->getHdr10PlusInfo()));
+        int32_t hdr10PlusParamIndex = findHdr10PlusParam(items->front().get());
+        //the interface info can change before the work is decoded, send a copy of it.
+        C2VdecSideDataPool::Buffer info;
+        std::shared_ptr<C2StreamHdrDynamicMetadataInfo::input> hdrInfo = mIntfImpl->getHdr10PlusInfo();
+        if (mIntfImpl->mIsSupportHdr && hdr10PlusParamIndex < 0 && hdrInfo != nullptr
+            && !items->front()->input.buffers.empty()) {
+            info = mSideDataPool->acquire((uint32_t)hdrInfo->m.type_, hdrInfo->m.data, hdrInfo->flexCount());
+        }
         mTaskRunner->PostTask(FROM_HERE,
                               ::base::Bind(&C2VdecComponent::onQueueWork, mWeakThisFactory.GetWeakPtr(),
                                            ::base::Passed(&items->front()),
-                                           std::move(info)));
+                                           ::base::Passed(&info), hdr10PlusParamIndex));
         //onQueueWork(std::move(items->front()));
         items->pop_front();
     }
     return C2_OK;
 }
 
+// static
+int32_t C2VdecComponent::findHdr10PlusParam(const C2Work* work) {
+    //parsed on the client thread,the component thread only picks the param by index.
+    if (work->input.buffers.empty()) {
+        return -1;
+    }
+    for (size_t i = 0; i < work->input.configUpdate.size(); i++) {
+        const std::unique_ptr<C2Param> &param = work->input.configUpdate[i];
+        if (param == nullptr) {
+            continue;
+        }
+        switch (param->coreIndex().coreIndex()) {
+            case C2StreamHdr10PlusInfo::CORE_INDEX:
+                return (int32_t)i;
+            case C2StreamHdrDynamicMetadataInfo::CORE_INDEX:
+                ALOGV("Config Update hdrDynamicMetadateInfo");
+                break;
+            default:
+                break;
+        }
+    }
+    return -1;
+}
+
+bool C2VdecComponent::sniffStreamHeader(const C2Work* work, C2VdecStreamHeaderInfo* info, bool* inspected) {
+    *inspected = false;
+    C2VdecHeaderSniffer::Codec codec = C2VdecHeaderSniffer::CODEC_UNKNOWN;
+    switch (mIntfImpl->getInputCodec()) {
+        case InputCodec::H264:
+        case InputCodec::DVAV:
+            codec = C2VdecHeaderSniffer::CODEC_H264;
+            break;
+        case InputCodec::H265:
+        case InputCodec::DVHE:
+            codec = C2VdecHeaderSniffer::CODEC_H265;
+            break;
+        case InputCodec::VP9:
+            codec = C2VdecHeaderSniffer::CODEC_VP9;
+            break;
+        case InputCodec::AV1:
+        case InputCodec::DVAV1:
+            codec = C2VdecHeaderSniffer::CODEC_AV1;
+            break;
+        default:
+            break;
+    }
+    //secure input can not be read
+    if (codec == C2VdecHeaderSniffer::CODEC_UNKNOWN || mSecureMode || work == nullptr ||
+        work->input.buffers.empty() || work->input.buffers.front() == nullptr ||
+        work->input.buffers.front()->data().linearBlocks().empty()) {
+        return false;
+    }
+
+    C2ConstLinearBlock linearBlock = work->input.buffers.front()->data().linearBlocks().front();
+    C2ReadView view = linearBlock.map().get();
+    if (view.error() != C2_OK || view.capacity() == 0) {
+        return false;
+    }
+    *inspected = true;
+    return C2VdecHeaderSniffer::sniff(codec, view.data(), view.capacity(), info);
+}
+
+void C2VdecComponent::onStreamHeaderSniffed(C2VdecStreamHeaderInfo info) {
+    DCHECK(mTaskRunner->BelongsToCurrentThread());
+    C2Vdec_LOG(CODEC2_LOG_INFO, "Stream header predicts %dx%d bitdepth:%d dpb:%d interlaced:%d",
+        info.mWidth, info.mHeight, info.mBitDepth, info.mDpbSize, info.mInterlaced);
+    if (mDeviceUtil) {
+        mDeviceUtil->setPredictedStreamInfo(info);
+    }
+}
+
 c2_status_t C2VdecComponent::announce_nb(const std::vector<C2WorkOutline>& items) {
     UNUSED(items);
     return C2_OMITTED;  // Tunneling is not supported by now
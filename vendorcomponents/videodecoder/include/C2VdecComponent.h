@@ -59,6 +59,10 @@
 #include <TunerPassthroughWrapper.h>
 #include <C2VendorConfig.h>
 #include <C2VdecBlockPoolUtil.h>
+#include <C2VdecOutputLedger.h>
+#include <C2VdecHeaderSniffer.h>
+#include <C2VdecResourcePolicy.h>
+#include <C2VdecSideDataPool.h>
 #include <C2VendorVideoSupport.h>
 #include <AmlMessageBase.h>
 #include <C2ObserverBase.h>
@@ -210,14 +214,18 @@ public:
     void Preempted();
     bool Preempting();
     void checkPreempting();
+    void updateResourceUsage();
     static uint32_t mInstanceNum;
     static uint32_t mInstanceID;
     C2String mName;
     int32_t mSessionID;
     int32_t mDecoderID;
     bool mIsMaxResolution;
+    // handle of this instance in C2VdecResourcePolicy.
+    int32_t mResourceHandle;
 
-    bool mPreempting;
+    // set by the resource policy from the thread of another instance.
+    std::atomic<bool> mPreempting;
     bool IsCompHaveCurrentBlock(uint32_t poolId, uint32_t blockId);
     bool IsCheckStopDequeueTask();
     void onOutputBufferReturned(std::shared_ptr<C2GraphicBlock> block, uint32_t poolId,uint32_t blockId);
@@ -282,7 +290,10 @@ private:
     struct WorkEntry {
         std::unique_ptr<C2Work> mWork;
         uint32_t mDrainMode = NO_DRAIN;
-        std::shared_ptr<C2StreamHdrDynamicMetadataInfo::input> mHdr10PlusInfo;
+        // copy of the interface HDR10+ info taken in queue_nb.
+        C2VdecSideDataPool::Buffer mHdr10PlusInfo;
+        // index of the HDR10+ param in input.configUpdate, found in queue_nb.
+        int32_t mHdr10PlusParamIndex = -1;
     };
 
     // Internal struct to keep the information of a specific graphic block.
@@ -328,21 +339,18 @@ private:
     };
 
     // Internal struct for the information of output buffer returned from the accelerator.
-    struct OutputBufferInfo {
-        int32_t mBitstreamId;
-        int32_t mBlockId;
-        uint64_t mMediaTimeUs;
-        int32_t flags;
-        bool    mSetOutInfo;
-    };
+    typedef C2VdecOutputBufferInfo OutputBufferInfo;
 
     // These tasks should be run on the component thread |mThread|.
     void onDestroy(::base::WaitableEvent* done);
     void onStart(media::VideoCodecProfile profile, ::base::WaitableEvent* done);
-    void onQueueWork(std::unique_ptr<C2Work> work, std::shared_ptr<C2StreamHdrDynamicMetadataInfo::input> info);
+    void onQueueWork(std::unique_ptr<C2Work> work, C2VdecSideDataPool::Buffer info,
+            int32_t hdr10PlusParamIndex);
     void reStartAllocTask();
     void onReusedOutBuf();
     void onDequeueWork();
+    void scheduleDequeueWork();
+    void dispatchQueuedWork();
     void onInputBufferDone(int32_t bitstreamId);
     void onOutputBufferDone(int32_t pictureBufferId, int64_t bitstreamId, int32_t flags, uint64_t timestamp);
     void onDrain(uint32_t drainMode);
@@ -370,7 +378,7 @@ private:
     // Helper function to get the specified GraphicBlockInfo object by its pool id.
     GraphicBlockInfo* getGraphicBlockByBlockId(uint32_t poolId,uint32_t blockId);
     GraphicBlockInfo* getGraphicBlockByFd(int32_t fd);
-    std::deque<C2VdecComponent::OutputBufferInfo>::iterator findPendingBuffersToWorkByTime(uint64_t timeus);
+    C2VdecOutputLedger::iterator findPendingBuffersToWorkByTime(uint64_t timeus);
     bool erasePendingBuffersToWorkByTime(uint64_t timeus);
 
     //get first unbind graphicblock
@@ -408,6 +416,10 @@ private:
     // Update |mUndequeuedBlockIds| FIFO by pushing |blockId|.
     void updateUndequeuedBlockIds(int32_t blockId);
     void onCheckVideoDecReconfig();
+    // inspected is set when the work had input data to look at.
+    bool sniffStreamHeader(const C2Work* work, C2VdecStreamHeaderInfo* info, bool* inspected);
+    static int32_t findHdr10PlusParam(const C2Work* work);
+    void onStreamHeaderSniffed(C2VdecStreamHeaderInfo info);
 
     // Specific to VP8/VP9, since for no-show frame cases Vdec will not call PictureReady to return
     // output buffer which the corresponding work is waiting for, this function detects these works
@@ -466,10 +478,6 @@ private:
     //convert graphicblock state.
     const char* GraphicBlockState(GraphicBlockInfo::State state);
     //get the delay time of fetch block
-    static std::atomic<int32_t> sConcurrentInstances;
-    static std::atomic<int32_t> sConcurrentInstanceSecures;
-    static std::atomic<int32_t> sConcurrentMaxResolutionInstance;
-    static std::atomic<int32_t> sConcurrentVc1Instance;
 
     // The pointer of component interface implementation.
     std::shared_ptr<IntfImpl> mIntfImpl;
@@ -504,6 +512,11 @@ private:
     // The work queue. Works are queued along with drain mode from component API queue_nb and
     // dequeued by the decode process of component.
     std::queue<WorkEntry> mQueue;
+    // An onDequeueWork task is posted and not run yet.
+    bool mDequeueWorkScheduled;
+    // onDequeueWork runs and the works dispatched by them, for the works per wakeup.
+    uint64_t mDequeueWakeupCount;
+    uint64_t mDequeueDispatchCount;
     // Store all pending works. The dequeued works are placed here until they are finished and then
     // sent out by onWorkDone call to listener.
     // TODO: maybe use priority_queue instead.
@@ -526,7 +539,7 @@ private:
     std::shared_ptr<C2StreamColorAspectsInfo::output> mCurrentColorAspects;
 
     // The record of bitstream and block ID of pending output buffers returned from accelerator.
-    std::deque<OutputBufferInfo> mPendingBuffersToWork;
+    C2VdecOutputLedger mPendingBuffersToWork;
     // A FIFO queue to record the block IDs which are currently undequeued for display. The size
     // of this queue will be equal to the minimum number of undequeued buffers.
     std::deque<int32_t> mUndequeuedBlockIds;
@@ -581,6 +594,8 @@ private:
     std::shared_ptr<TunnelHelper> mTunnelHelper;
     std::shared_ptr<TunerPassthroughHelper> mTunerPassthroughHelper;
     std::shared_ptr<DebugUtil> mDebugUtil;
+    // side data of the queued input works.
+    std::shared_ptr<C2VdecSideDataPool> mSideDataPool;
     std::shared_ptr<DequeueThreadUtil> mDequeueThreadUtil;
 
     bool mUseBufferQueue; /*surface use buffer queue */
@@ -588,6 +603,8 @@ private:
     bool mPictureSizeChanged;
     c2_resch_stat mResChStat;
     bool mSurfaceUsageGot;
+    // set in queue_nb on the client thread,reset on the component thread.
+    std::atomic<bool> mStreamHeaderSniffed;
     bool mVdecComponentStopDone;
     bool mCanQueueOutBuffer;
     int32_t mOutBufferCount;
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "C2VdecAllocProfile"
+
+#include <string.h>
+#include <utils/Log.h>
+
+#include <C2VdecAllocProfile.h>
+
+namespace android {
+
+C2VdecAllocProfileCache::C2VdecAllocProfileCache()
+    : mSerial(0),
+      mSerialValid(false),
+      mUseClock(0),
+      mHitCount(0),
+      mMissCount(0) {
+    invalidate();
+}
+
+void C2VdecAllocProfileCache::checkSerial(uint32_t serial) {
+    if (mSerialValid && serial == mSerial) {
+        return;
+    }
+    if (mSerialValid) {
+        ALOGV("property serial %u -> %u, drop the profiles", mSerial, serial);
+        invalidate();
+    }
+    mSerial = serial;
+    mSerialValid = true;
+}
+
+C2VdecAllocProfileCache::Entry* C2VdecAllocProfileCache::findEntry(const C2VdecAllocProfileKey& key) {
+    for (int32_t i = 0; i < kMaxEntries; i++) {
+        if (mEntries[i].mUsed && mEntries[i].mKey == key) {
+            return &mEntries[i];
+        }
+    }
+    return NULL;
+}
+
+bool C2VdecAllocProfileCache::lookup(const C2VdecAllocProfileKey& key, uint32_t field,
+        C2VdecAllocProfile* profile) {
+    Entry* entry = findEntry(key);
+    if (entry == NULL || (entry->mProfile.mValidMask & field) != field) {
+        mMissCount++;
+        return false;
+    }
+    entry->mLastUse = ++mUseClock;
+    *profile = entry->mProfile;
+    mHitCount++;
+    return true;
+}
+
+void C2VdecAllocProfileCache::store(const C2VdecAllocProfileKey& key, uint32_t field,
+        const C2VdecAllocProfile& profile) {
+    Entry* entry = findEntry(key);
+    if (entry == NULL) {
+        //reuse the free or the least recently used entry.
+        entry = &mEntries[0];
+        for (int32_t i = 0; i < kMaxEntries; i++) {
+            if (!mEntries[i].mUsed) {
+                entry = &mEntries[i];
+                break;
+            }
+            if (mEntries[i].mLastUse < entry->mLastUse) {
+                entry = &mEntries[i];
+            }
+        }
+        memset(entry, 0, sizeof(*entry));
+        entry->mUsed = true;
+        entry->mKey = key;
+    }
+    if (field & C2VdecAllocProfile::DOUBLE_WRITE) {
+        entry->mProfile.mDoubleWrite = profile.mDoubleWrite;
+    }
+    if (field & C2VdecAllocProfile::TRIPLE_WRITE) {
+        entry->mProfile.mTripleWrite = profile.mTripleWrite;
+    }
+    if (field & C2VdecAllocProfile::USAGE) {
+        entry->mProfile.mUsage = profile.mUsage;
+    }
+    entry->mProfile.mValidMask |= field;
+    entry->mLastUse = ++mUseClock;
+}
+
+void C2VdecAllocProfileCache::invalidate() {
+    memset(mEntries, 0, sizeof(mEntries));
+}
+
+}
@@ -18,6 +18,7 @@
 #define LOG_TAG "C2VdecBlockPoolUtil"
 
 #include <C2VdecBlockPoolUtil.h>
+#include <C2VdecPropertySnapshot.h>
 #include <C2PlatformSupport.h>
 #include <C2BlockInternal.h>
 #include <C2BufferPriv.h>
@@ -77,7 +78,7 @@ public:
         bool useSurface = C2PlatformAllocatorStore::BUFFERQUEUE == id;
         std::shared_ptr<C2AllocatorStore> allocatorStore = GetCodec2PlatformAllocatorStore();
         c2_status_t status = allocatorStore->fetchAllocator(id, &mAllocatorBase);
-        propGetInt(CODEC2_VDEC_LOGDEBUG_PROPERTY, &gloglevel);
+        gloglevel = C2VdecPropertySnapshot::getInstance().get()->mLogLevel;
 
         if (status != C2_OK) {
             CODEC2_LOG(CODEC2_LOG_ERR, "Create block block pool fail.");
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <C2VdecBufferPlanner.h>
+
+namespace android {
+
+C2VdecBufferPlan C2VdecBufferPlanner::plan(const C2VdecBufferPlanParams& params) {
+    const C2VdecBufferSetSpec& oldSet = params.mOld;
+    const C2VdecBufferSetSpec& newSet = params.mNew;
+    C2VdecBufferPlan plan;
+
+    plan.mSizeChanged = (oldSet.mWidth != newSet.mWidth || oldSet.mHeight != newSet.mHeight);
+    //a count of 0 means not known yet, not a change
+    plan.mBufferNumIncreased = (oldSet.mBufferCount != 0 && newSet.mBufferCount != 0 &&
+                                newSet.mBufferCount > oldSet.mBufferCount);
+    plan.mKeepCount = 0;
+    plan.mAddCount = 0;
+    plan.mReplaceCount = 0;
+
+    bool fits = (newSet.mWidth <= oldSet.mWidth && newSet.mHeight <= oldSet.mHeight &&
+                 newSet.mUsage == oldSet.mUsage);
+    if (plan.mSizeChanged && !(fits && params.mCanDecodeIntoLarger)) {
+        plan.mAction = C2VdecBufferPlan::REALLOC;
+        plan.mReplaceCount = newSet.mBufferCount;
+        return plan;
+    }
+    if (newSet.mUsage != oldSet.mUsage) {
+        plan.mAction = C2VdecBufferPlan::REALLOC;
+        plan.mReplaceCount = newSet.mBufferCount;
+        return plan;
+    }
+
+    //the buffers fit the new picture,only the count may change
+    if (params.mNoSurface && !plan.mBufferNumIncreased && newSet.mBufferCount != oldSet.mBufferCount) {
+        //the pool without surface is sized by the count,a smaller set is a new set
+        plan.mAction = C2VdecBufferPlan::REALLOC;
+        plan.mReplaceCount = newSet.mBufferCount;
+        return plan;
+    }
+    if (plan.mBufferNumIncreased) {
+        plan.mAction = C2VdecBufferPlan::GROW;
+        plan.mKeepCount = oldSet.mBufferCount;
+        plan.mAddCount = newSet.mBufferCount - oldSet.mBufferCount;
+        return plan;
+    }
+    //extra buffers of a larger set stay in use,the decoder is told the new count
+    plan.mAction = C2VdecBufferPlan::KEEP;
+    plan.mKeepCount = oldSet.mBufferCount;
+    return plan;
+}
+
+const char* C2VdecBufferPlanner::actionToString(C2VdecBufferPlan::Action action) {
+    switch (action) {
+        case C2VdecBufferPlan::KEEP:
+            return "keep";
+        case C2VdecBufferPlan::GROW:
+            return "grow";
+        case C2VdecBufferPlan::REALLOC:
+            return "realloc";
+        default:
+            return "unknown";
+    }
+}
+
+}
@@ -39,6 +39,7 @@
 #include <C2VendorDebug.h>
 #include <C2VdecDebugUtil.h>
 #include <C2VdecInterfaceImpl.h>
+#include <C2VdecPropertySnapshot.h>
 
 #include "base/memory/weak_ptr.h"
 
@@ -57,14 +58,18 @@ namespace android {
 
 #define C2VdecDU_LOG(level, fmt, str...) CODEC2_LOG(level, "[%d##%d]"#fmt, comp->mSessionID, comp->mDecoderID, ##str)
 
-C2VdecComponent::DebugUtil::DebugUtil():mWeakFactory(this) {
-    propGetInt(CODEC2_VDEC_LOGDEBUG_PROPERTY, &gloglevel);
+C2VdecComponent::DebugUtil::DebugUtil():mWeakFactory(this), mInputDumpFp(NULL) {
+    gloglevel = C2VdecPropertySnapshot::getInstance().get()->mLogLevel;
     CODEC2_LOG(CODEC2_LOG_INFO, "[%s:%d]", __func__, __LINE__);
     mServer = &C2DebugServer::getInstance();
 }
 
 C2VdecComponent::DebugUtil::~DebugUtil() {
     CODEC2_LOG(CODEC2_LOG_INFO, "[%s:%d]", __func__, __LINE__);
+    if (mInputDumpFp != NULL) {
+        fclose(mInputDumpFp);
+        mInputDumpFp = NULL;
+    }
 }
 
 c2_status_t C2VdecComponent::DebugUtil::setComponent(std::shared_ptr<C2VdecComponent> sharedcomp) {
@@ -182,7 +187,39 @@ void C2VdecComponent::DebugUtil::dump() {
 }
 
 void C2VdecComponent::DebugUtil::debug(std::list<std::string> cmds) {
+    for (auto& cmd : cmds) {
+        if (cmd == "refresh_props") {
+            //pick up the properties set while the instances are running.
+            C2VdecPropertySnapshot::getInstance().refresh();
+            gloglevel = C2VdecPropertySnapshot::getInstance().get()->mLogLevel;
+            CODEC2_LOG(CODEC2_LOG_INFO, "[%s] properties reloaded, generation:%u", __func__,
+                    C2VdecPropertySnapshot::getInstance().getGeneration());
+        }
+    }
+}
 
+void C2VdecComponent::DebugUtil::dumpInputBuffer(const C2ConstLinearBlock& input, int32_t bitstreamId) {
+    LockWeakPtrWithReturnVoid(comp, mComp);
+    //secure input can not be read.
+    if (comp->mSecureMode) {
+        return;
+    }
+    if (mInputDumpFp == NULL) {
+        char pathFile[64];
+        snprintf(pathFile, sizeof(pathFile), "/data/tmp/c2vdec_input_%d.es", comp->mSessionID);
+        mInputDumpFp = fopen(pathFile, "wb");
+        if (mInputDumpFp == NULL) {
+            C2VdecDU_LOG(CODEC2_LOG_ERR, "[%s] open %s failed", __func__, pathFile);
+            return;
+        }
+    }
+    C2ReadView view = input.map().get();
+    if (view.error() != C2_OK) {
+        C2VdecDU_LOG(CODEC2_LOG_ERR, "[%s] map input bitstreamId:%d failed", __func__, bitstreamId);
+        return;
+    }
+    fwrite(view.data(), 1, view.capacity(), mInputDumpFp);
+    fflush(mInputDumpFp);
 }
 
 void C2VdecComponent::DebugUtil::ctor() {
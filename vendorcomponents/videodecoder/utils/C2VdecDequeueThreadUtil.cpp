@@ -42,6 +42,7 @@
 #include <C2VdecDeviceUtil.h>
 #include <C2VdecInterfaceImpl.h>
 #include <C2VdecDequeueThreadUtil.h>
+#include <C2VdecPropertySnapshot.h>
 #include <C2VdecBlockPoolUtil.h>
 
 namespace android {
@@ -58,7 +59,7 @@ namespace android {
 
 C2VdecComponent::DequeueThreadUtil::DequeueThreadUtil() : mWeakFactory(this) {
     mDequeueThread = new ::base::Thread("C2VdecDequeueThread");
-    propGetInt(CODEC2_VDEC_LOGDEBUG_PROPERTY, &gloglevel);
+    gloglevel = C2VdecPropertySnapshot::getInstance().get()->mLogLevel;
     CODEC2_LOG(CODEC2_LOG_INFO, "Creat DequeueThreadUtil!!");
     mRunTaskLoop.store(false);
     mAllocBufferLoop.store(false);
@@ -141,8 +142,8 @@ void C2VdecComponent::DequeueThreadUtil::onInitTask() {
     DCHECK(mDequeueTaskRunner->BelongsToCurrentThread());
 
     // set priority
-    bool disableRC = property_get_bool(C2_PROPERTY_VDEC_DISABLE_RC, true);
-    if (!disableRC) {
+    std::shared_ptr<const C2VdecProperties> props = C2VdecPropertySnapshot::getInstance().get();
+    if (!props->mDisableRC) {
         struct sched_param param = {0};
         param.sched_priority = 1;
         if (sched_setscheduler(0, SCHED_RR, &param) != 0) {
@@ -150,8 +151,7 @@ void C2VdecComponent::DequeueThreadUtil::onInitTask() {
         }
     } else {
         int niceval = -10;
-        int priorityval = 0;
-        propGetInt(C2_PROPERTY_VDEC_DEBUG_PRIORITY, &priorityval);
+        int priorityval = props->mDebugPriority;
         niceval = ((priorityval > 0) ? (priorityval - 120) : (-10));
         if (setpriority(PRIO_PROCESS, 0, niceval) != 0) {
             C2VdecDQ_LOG(CODEC2_LOG_ERR, "setpriority error: %s, niceval:%d", strerror(errno), niceval);
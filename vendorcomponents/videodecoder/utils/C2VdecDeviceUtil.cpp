@@ -34,6 +34,7 @@
 #include <C2VendorDebug.h>
 #include <C2VendorConfig.h>
 #include <C2VdecCodecConfig.h>
+#include <C2VdecPropertySnapshot.h>
 #include <grallocwraper/GrallocWraper.h>
 #include <inttypes.h>
 
@@ -43,6 +44,7 @@
 
 #define OUTPUT_BUFS_ALIGN_SIZE_32 (32)
 #define OUTPUT_BUFS_ALIGN_SIZE_64 (64)
+#define STREAM_SIZE_ALIGN(x) (((x) + 15) & ~15)
 #define min(a, b) (((a) > (b))? (b):(a))
 
 namespace android {
@@ -57,7 +59,7 @@ constexpr int kMaxWidthP010 = 720;
 constexpr int kMaxHeightP010 = 576;
 
 C2VdecComponent::DeviceUtil::DeviceUtil(bool secure) {
-    propGetInt(CODEC2_VDEC_LOGDEBUG_PROPERTY, &gloglevel);
+    gloglevel = C2VdecPropertySnapshot::getInstance().get()->mLogLevel;
     init(secure);
     CODEC2_LOG(CODEC2_LOG_INFO, "[%s:%d]", __func__, __LINE__);
 }
@@ -84,15 +86,18 @@ void C2VdecComponent::DeviceUtil::init(bool secure) {
 
     // P010
     mStreamBitDepth = -1;
+    memset(&mPredictedStreamInfo, 0, sizeof(mPredictedStreamInfo));
     mIsYcbRP010Stream = false;
     mIsNeedUse10BitOutBuffer = false;
-    mHwSupportP010 = property_get_bool(PROPERTY_PLATFORM_SUPPORT_HARDWARE_P010, false);
-    mSwSupportP010 = property_get_bool(PROPERTY_PLATFORM_SUPPORT_SOFTWARE_P010, true);
+    std::shared_ptr<const C2VdecProperties> props = C2VdecPropertySnapshot::getInstance().get();
+    mHwSupportP010 = props->mHwSupportP010;
+    mSwSupportP010 = props->mSwSupportP010;
     mUseP010ForDisplay = false;
 
-    mDiPost = property_get_bool(C2_PROPERTY_VDEC_DI_POST, false);
+    mDiPost = props->mDiPost;
     // 8K
     mStreamIs8k = false;
+    mResourceDowngrade = false;
     mEnable8kNR = false;
     mCodecSupport8k = false;
 
@@ -150,13 +155,29 @@ c2_status_t C2VdecComponent::DeviceUtil::setComponent(std::shared_ptr<C2VdecComp
 }
 
 int32_t C2VdecComponent::DeviceUtil::getDoubleWriteModeValue() {
+    C2VdecAllocProfileKey key;
+    C2VdecAllocProfile profile = {0, 0, 0, 0};
+    media::Size size = getPictureSize();
+    if (size.IsEmpty() || !getAllocProfileKey(size, &key)) {
+        return computeDoubleWriteModeValue();
+    }
+    if (lookupAllocProfile(key, C2VdecAllocProfile::DOUBLE_WRITE, &profile)) {
+        return profile.mDoubleWrite;
+    }
+    profile.mDoubleWrite = computeDoubleWriteModeValue();
+    storeAllocProfile(key, C2VdecAllocProfile::DOUBLE_WRITE, profile);
+    return profile.mDoubleWrite;
+}
+
+int32_t C2VdecComponent::DeviceUtil::computeDoubleWriteModeValue() {
     uint32_t doubleWriteValue = 3;
     LockWeakPtrWithReturnVal(comp, mComp, doubleWriteValue);
     LockWeakPtrWithReturnVal(intfImpl, mIntfImpl, doubleWriteValue);
 
     InputCodec codec = intfImpl->getInputCodec();
+    std::shared_ptr<const C2VdecProperties> props = C2VdecPropertySnapshot::getInstance().get();
     int32_t defaultDoubleWrite = getPropertyDoubleWrite();
-    int32_t fixedBufferSlice = property_get_int32(C2_PROPERTY_VDEC_FIXED_BUFF_SLICE, -1);
+    int32_t fixedBufferSlice = props->mFixedBufferSlice;
 
     if (defaultDoubleWrite >= 0) {
         doubleWriteValue = defaultDoubleWrite;
@@ -170,7 +191,15 @@ int32_t C2VdecComponent::DeviceUtil::getDoubleWriteModeValue() {
         return doubleWriteValue;
     }
 
-    if (fixedBufferSlice != 540 && comp->isAmDolbyVision() && property_get_bool(C2_PROPERTY_VDEC_AMDV_USE_540P, false)) {
+    // short of decoder memory, give a half size output to the display.
+    if (mResourceDowngrade && !mUseSurfaceTexture && !mNoSurface
+        && (codec == InputCodec::H265 || codec == InputCodec::VP9 || codec == InputCodec::AV1)) {
+        doubleWriteValue = 4;
+        CODEC2_LOG(CODEC2_LOG_INFO, "resource downgrade, set double write %d", doubleWriteValue);
+        return doubleWriteValue;
+    }
+
+    if (fixedBufferSlice != 540 && comp->isAmDolbyVision() && props->mAmdvUse540p) {
         fixedBufferSlice = 540;
     }
 
@@ -270,6 +299,21 @@ int32_t C2VdecComponent::DeviceUtil::getDoubleWriteModeValue() {
 }
 
 int32_t C2VdecComponent::DeviceUtil::getTripleWriteModeValue() {
+    C2VdecAllocProfileKey key;
+    C2VdecAllocProfile profile = {0, 0, 0, 0};
+    media::Size size = getPictureSize();
+    if (size.IsEmpty() || !getAllocProfileKey(size, &key)) {
+        return computeTripleWriteModeValue();
+    }
+    if (lookupAllocProfile(key, C2VdecAllocProfile::TRIPLE_WRITE, &profile)) {
+        return profile.mTripleWrite;
+    }
+    profile.mTripleWrite = computeTripleWriteModeValue();
+    storeAllocProfile(key, C2VdecAllocProfile::TRIPLE_WRITE, profile);
+    return profile.mTripleWrite;
+}
+
+int32_t C2VdecComponent::DeviceUtil::computeTripleWriteModeValue() {
     int32_t tripleWriteValue = 0x10001;
     LockWeakPtrWithReturnVal(comp, mComp, tripleWriteValue);
     LockWeakPtrWithReturnVal(intfImpl, mIntfImpl, tripleWriteValue);
@@ -335,7 +379,7 @@ void C2VdecComponent::DeviceUtil::queryStreamBitDepth() {
 
 uint32_t C2VdecComponent::DeviceUtil::getStreamPixelFormat(uint32_t pixelFormat) {
     uint32_t format = pixelFormat;
-    bool support_soft_10bit = property_get_bool(PROPERTY_PLATFORM_SUPPORT_SOFTWARE_P010, true);
+    bool support_soft_10bit = C2VdecPropertySnapshot::getInstance().get()->mSwSupportP010;
     if (support_soft_10bit && (mIsYcbRP010Stream || mIsNeedUse10BitOutBuffer)) {
         format = HAL_PIXEL_FORMAT_YCBCR_P010;
     }
@@ -391,6 +435,7 @@ bool C2VdecComponent::DeviceUtil::paramsPreCheck(std::shared_ptr<C2VdecComponent
 void C2VdecComponent::DeviceUtil::codecConfig(mediahal_cfg_parms* configParam) {
     LockWeakPtrWithReturnVoid(comp, mComp);
     LockWeakPtrWithReturnVoid(intfImpl, mIntfImpl);
+    invalidateAllocProfile();
 
     uint32_t doubleWriteMode = 3;
     int default_margin = 6;
@@ -405,11 +450,12 @@ void C2VdecComponent::DeviceUtil::codecConfig(mediahal_cfg_parms* configParam) {
         return;
     }
 
-    mEnableNR = property_get_bool(C2_PROPERTY_VDEC_DISP_NR_ENABLE, false);
-    mEnableDILocalBuf = property_get_bool(C2_PROPERTY_VDEC_DISP_DI_LOCALBUF_ENABLE, false);
-    mEnable8kNR = property_get_bool(C2_PROPERTY_VDEC_DISP_NR_8K_ENABLE, false);
-    mDisableErrPolicy = property_get_bool(C2_PROPERTY_VDEC_ERRPOLICY_DISABLE, true);
-    mForceDIPermission = property_get_bool(C2_PROPERTY_VDEC_FORCE_DI_PERMISSION, false);
+    std::shared_ptr<const C2VdecProperties> props = C2VdecPropertySnapshot::getInstance().get();
+    mEnableNR = props->mEnableNR;
+    mEnableDILocalBuf = props->mEnableDILocalBuf;
+    mEnable8kNR = props->mEnable8kNR;
+    mDisableErrPolicy = props->mDisableErrPolicy;
+    mForceDIPermission = props->mForceDIPermission;
 
     mConfigParam = configParam;
     memset(mConfigParam, 0, sizeof(mediahal_cfg_parms));
@@ -474,24 +520,32 @@ void C2VdecComponent::DeviceUtil::codecConfig(mediahal_cfg_parms* configParam) {
         mEnableDILocalBuf = false;
     }
 
-    if (intfImpl->mAvc4kMMUMode->value ||
-           property_get_bool(C2_PROPERTY_VDEC_ENABLE_AVC_4K_MMU, false)) {
+    if (intfImpl->mAvc4kMMUMode->value || props->mEnableAvc4kMMU) {
         mEnableAvc4kMMU = true;
-        propGetInt(C2_PROPERTY_VDEC_AVC_MMU_WIDTH, &mAVCMMUWidth);
-        propGetInt(C2_PROPERTY_VDEC_AVC_MMU_HEIGHT, &mAVCMMUHeight);
+        mAVCMMUWidth = props->mAvcMMUWidth;
+        mAVCMMUHeight = props->mAvcMMUHeight;
         C2VdecMDU_LOG(CODEC2_LOG_INFO, "mEnableAvc4kMMU = %d, mmu open width:%d, height:%d", mEnableAvc4kMMU, mAVCMMUWidth, mAVCMMUHeight);
     } else {
         mEnableAvc4kMMU = false;
     }
 
     if (comp->isAmDolbyVision()) {
-        mUseP010ForDisplay = property_get_bool(C2_PROPERTY_VDEC_AMDV_USE_P010, false);
+        mUseP010ForDisplay = props->mAmdvUseP010;
         dvUseTwoLayer = checkDvProfileAndLayer();
     }
 
     bufwidth = output.width;
     bufheight = output.height;
-    C2VdecMDU_LOG(CODEC2_LOG_INFO, "configure width:%d height:%d", output.width, output.height);
+    //the sequence header is more reliable than the size given by the client
+    if (mPredictedStreamInfo.mValid &&
+        (STREAM_SIZE_ALIGN(bufwidth) != STREAM_SIZE_ALIGN(mPredictedStreamInfo.mWidth) ||
+         STREAM_SIZE_ALIGN(bufheight) != STREAM_SIZE_ALIGN(mPredictedStreamInfo.mHeight))) {
+        C2VdecMDU_LOG(CODEC2_LOG_INFO, "configure predicted size %dx%d instead of %dx%d",
+            mPredictedStreamInfo.mWidth, mPredictedStreamInfo.mHeight, bufwidth, bufheight);
+        bufwidth = mPredictedStreamInfo.mWidth;
+        bufheight = mPredictedStreamInfo.mHeight;
+    }
+    C2VdecMDU_LOG(CODEC2_LOG_INFO, "configure width:%d height:%d", bufwidth, bufheight);
 
     // add v4l2 config
     pAmlV4l2Param->magic = V4L2_PARMS_MAGIC;
@@ -520,7 +574,9 @@ void C2VdecComponent::DeviceUtil::codecConfig(mediahal_cfg_parms* configParam) {
 
     doubleWriteMode = getDoubleWriteModeValue();
 
-    default_margin = property_get_int32(C2_PROPERTY_VDEC_MARGIN, default_margin);
+    if (props->mMargin >= 0) {
+        default_margin = props->mMargin;
+    }
     margin = default_margin;
     pAmlDecParam->cfg.canvas_mem_mode = 0;
     mMarginBufferNum = margin;
@@ -686,7 +742,7 @@ uint64_t C2VdecComponent::DeviceUtil::getLastOutputPts() {
 }
 
 int C2VdecComponent::DeviceUtil::HDRInfoDataBLEndianInt(int value) {
-    bool enable = property_get_bool(C2_PROPERTY_VDEC_HDR_LITTLE_ENDIAN_ENABLE, true);
+    bool enable = C2VdecPropertySnapshot::getInstance().get()->mHdrLittleEndian;
     if (enable)
         return value;
     else
@@ -1107,14 +1163,14 @@ bool C2VdecComponent::DeviceUtil::isColorAspectsChanged() {
 
 int32_t C2VdecComponent::DeviceUtil::getPropertyDoubleWrite() {
     LockWeakPtrWithReturnVal(comp, mComp, -1);
-    int32_t doubleWrite = property_get_int32(C2_PROPERTY_VDEC_DOUBLEWRITE, -1);
+    int32_t doubleWrite = C2VdecPropertySnapshot::getInstance().get()->mDoubleWrite;
     CODEC2_LOG(CODEC2_LOG_DEBUG_LEVEL1, "get property double write:%d", doubleWrite);
     return doubleWrite;
 }
 
 int32_t C2VdecComponent::DeviceUtil::getPropertyTripleWrite() {
     LockWeakPtrWithReturnVal(comp, mComp, -1);
-    int32_t tripleWrite = property_get_int32(C2_PROPERTY_VDEC_TRIPLEWRITE, -1);
+    int32_t tripleWrite = C2VdecPropertySnapshot::getInstance().get()->mTripleWrite;
     CODEC2_LOG(CODEC2_LOG_DEBUG_LEVEL1, "get property triple write:%d", tripleWrite);
     return tripleWrite;
 }
@@ -1236,15 +1292,90 @@ uint64_t C2VdecComponent::DeviceUtil::getPlatformUsage(const media::Size& size)
         mIsNeedUse10BitOutBuffer = true;
     }
 
+    C2VdecAllocProfileKey key;
+    C2VdecAllocProfile profile = {0, 0, 0, 0};
+    bool cacheable = getAllocProfileKey(size, &key);
+    if (cacheable && lookupAllocProfile(key, C2VdecAllocProfile::USAGE, &profile)) {
+        return profile.mUsage;
+    }
     usage = mGrallocWraper->getPlatformUsage(this, size);
-    return usage & C2MemoryUsage::PLATFORM_MASK;
+    profile.mUsage = usage & C2MemoryUsage::PLATFORM_MASK;
+    if (cacheable) {
+        storeAllocProfile(key, C2VdecAllocProfile::USAGE, profile);
+    }
+    return profile.mUsage;
+}
+
+bool C2VdecComponent::DeviceUtil::getAllocProfileKey(const media::Size& size, C2VdecAllocProfileKey* key) {
+    LockWeakPtrWithReturnVal(comp, mComp, false);
+    LockWeakPtrWithReturnVal(intfImpl, mIntfImpl, false);
+
+    memset(key, 0, sizeof(*key));
+    key->mCodec = (int32_t)intfImpl->getInputCodec();
+    key->mWidth = size.width();
+    key->mHeight = size.height();
+    key->mBitDepth = mIsYcbRP010Stream ? 10 : 8;
+    key->mSecure = mSecure;
+    key->mTunnel = !comp->isNonTunnelMode();
+
+    //every state read by the write modes and the gralloc usage.
+    uint32_t flags = 0;
+    flags |= mUseSurfaceTexture ? (1 << 0) : 0;
+    flags |= mNoSurface ? (1 << 1) : 0;
+    flags |= mIsInterlaced ? (1 << 2) : 0;
+    flags |= mStreamIs8k ? (1 << 3) : 0;
+    flags |= mCodecSupport8k ? (1 << 4) : 0;
+    flags |= mHwSupportP010 ? (1 << 5) : 0;
+    flags |= mSwSupportP010 ? (1 << 6) : 0;
+    flags |= mUseP010ForDisplay ? (1 << 7) : 0;
+    flags |= mEnableNR ? (1 << 8) : 0;
+    flags |= mEnableDILocalBuf ? (1 << 9) : 0;
+    flags |= mDiPost ? (1 << 10) : 0;
+    flags |= mForceFullUsage ? (1 << 11) : 0;
+    flags |= mResourceDowngrade ? (1 << 12) : 0;
+    flags |= mEnableAvc4kMMU ? (1 << 13) : 0;
+    flags |= comp->isAmDolbyVision() ? (1 << 14) : 0;
+    flags |= (mDecoderWidthAlign == OUTPUT_BUFS_ALIGN_SIZE_32) ? (1 << 15) : 0;
+    flags |= (mDecoderWidthAlign == OUTPUT_BUFS_ALIGN_SIZE_64) ? (1 << 16) : 0;
+    key->mStateFlags = flags;
+    return true;
+}
+
+media::Size C2VdecComponent::DeviceUtil::getPictureSize() {
+    LockWeakPtrWithReturnVal(intfImpl, mIntfImpl, media::Size(0, 0));
+    C2StreamPictureSizeInfo::output output = {0};
+    c2_status_t err = intfImpl->query({&output}, {}, C2_MAY_BLOCK, nullptr);
+    if (err != C2_OK) {
+        C2VdecMDU_LOG(CODEC2_LOG_ERR, "[%s:%d] Query PictureSize error", __func__, __LINE__);
+        return media::Size(0, 0);
+    }
+    return media::Size(output.width, output.height);
+}
+
+bool C2VdecComponent::DeviceUtil::lookupAllocProfile(const C2VdecAllocProfileKey& key, uint32_t field,
+        C2VdecAllocProfile* profile) {
+    std::lock_guard<std::mutex> lock(mAllocProfileLock);
+    //any property set moves the serial, the debug properties take effect as before.
+    mAllocProfileCache.checkSerial(C2VdecPropertySnapshot::getInstance().getGeneration());
+    return mAllocProfileCache.lookup(key, field, profile);
+}
+
+void C2VdecComponent::DeviceUtil::storeAllocProfile(const C2VdecAllocProfileKey& key, uint32_t field,
+        const C2VdecAllocProfile& profile) {
+    std::lock_guard<std::mutex> lock(mAllocProfileLock);
+    mAllocProfileCache.store(key, field, profile);
+}
+
+void C2VdecComponent::DeviceUtil::invalidateAllocProfile() {
+    std::lock_guard<std::mutex> lock(mAllocProfileLock);
+    mAllocProfileCache.invalidate();
 }
 
 bool C2VdecComponent::DeviceUtil::checkSupport8kMode() {
     LockWeakPtrWithReturnVal(comp, mComp, 0);
     LockWeakPtrWithReturnVal(intfImpl, mIntfImpl, 0);
     //need report error for 8k video at not surface mode if device not support 8k buf mode.
-    bool support = property_get_bool(PROPERTY_PLATFORM_SUPPORT_8K_BUF_MODE, false);
+    bool support = C2VdecPropertySnapshot::getInstance().get()->mSupport8kBufMode;
     if (mStreamIs8k
         && (mUseSurfaceTexture || mNoSurface)
         && !support
@@ -1304,7 +1435,7 @@ bool C2VdecComponent::DeviceUtil::needAllocWithMaxSize() {
     bool needMaxSize = false;
     LockWeakPtrWithReturnVal(comp, mComp, needMaxSize);
     LockWeakPtrWithReturnVal(intfImpl, mIntfImpl, needMaxSize);
-    bool debugrealloc = property_get_bool(C2_PROPERTY_VDEC_OUT_BUF_REALLOC, false);
+    bool debugrealloc = C2VdecPropertySnapshot::getInstance().get()->mOutBufRealloc;
 
     if (debugrealloc)
         return false;
@@ -1347,40 +1478,58 @@ bool C2VdecComponent::DeviceUtil::isNeedHalfHeightBuffer() {
 
 bool C2VdecComponent::DeviceUtil::isReallocateOutputBuffer(VideoFormat rawFormat,VideoFormat currentFormat,
                                                     bool *sizechange, bool *buffernumincrease) {
-    bool realloc = false, frameSizeChanged = false;
-    bool bufferNumChanged = false;
-    LockWeakPtrWithReturnVal(comp, mComp, !realloc);
-
-    if (currentFormat.mMinNumBuffers != rawFormat.mMinNumBuffers) {
-        bufferNumChanged = true;
-    }
+    C2VdecBufferPlan plan = planOutputBufferSet(rawFormat, currentFormat);
 
-    if (currentFormat.mCodedSize.width() != rawFormat.mCodedSize.width() ||
-        currentFormat.mCodedSize.height() !=  rawFormat.mCodedSize.height()) {
-        frameSizeChanged = true;
-        *sizechange = true;
-    }
-
-    if ((currentFormat.mMinNumBuffers != 0 && rawFormat.mMinNumBuffers != 0) &&
-        (currentFormat.mMinNumBuffers > rawFormat.mMinNumBuffers)) {
-        *buffernumincrease = true;
-    }
-
-    if (mNoSurface) {
-        realloc = (bufferNumChanged || frameSizeChanged);
-    } else {
-        realloc = frameSizeChanged;
-    }
+    *sizechange = plan.mSizeChanged;
+    *buffernumincrease = plan.mBufferNumIncreased;
+    return (plan.mAction == C2VdecBufferPlan::REALLOC);
+}
 
-    if (realloc) {
+C2VdecBufferPlan C2VdecComponent::DeviceUtil::planOutputBufferSet(VideoFormat rawFormat, VideoFormat currentFormat) {
+    C2VdecBufferPlanParams params;
+    C2VdecBufferPlan plan = {C2VdecBufferPlan::REALLOC, false, false, 0, 0, 0};
+    LockWeakPtrWithReturnVal(comp, mComp, plan);
+
+    params.mOld.mWidth = getOutAlignedSize(rawFormat.mCodedSize.width());
+    params.mOld.mHeight = getOutAlignedSize(rawFormat.mCodedSize.height(), true);
+    params.mOld.mBufferCount = rawFormat.mMinNumBuffers;
+    params.mOld.mUsage = getPlatformUsage(rawFormat.mCodedSize);
+    params.mNew.mWidth = getOutAlignedSize(currentFormat.mCodedSize.width());
+    params.mNew.mHeight = getOutAlignedSize(currentFormat.mCodedSize.height(), true);
+    params.mNew.mBufferCount = currentFormat.mMinNumBuffers;
+    params.mNew.mUsage = getPlatformUsage(currentFormat.mCodedSize);
+    params.mNoSurface = mNoSurface;
+    //codecs allocated with max size already decode any smaller picture into the max buffer
+    params.mCanDecodeIntoLarger = needAllocWithMaxSize();
+
+    plan = C2VdecBufferPlanner::plan(params);
+    if (plan.mAction == C2VdecBufferPlan::REALLOC) {
         releaseGrallocSlot();
     }
 
-    C2VdecMDU_LOG(CODEC2_LOG_INFO, "[%s:%d] raw size:%s %d new size:%s %d realloc:%d",__func__, __LINE__,
+    C2VdecMDU_LOG(CODEC2_LOG_INFO, "[%s:%d] raw size:%s %d new size:%s %d plan:%s keep:%u add:%u replace:%u",__func__, __LINE__,
         rawFormat.mCodedSize.ToString().c_str(), rawFormat.mMinNumBuffers,
-        currentFormat.mCodedSize.ToString().c_str(),currentFormat.mMinNumBuffers, realloc);
+        currentFormat.mCodedSize.ToString().c_str(),currentFormat.mMinNumBuffers,
+        C2VdecBufferPlanner::actionToString(plan.mAction), plan.mKeepCount, plan.mAddCount, plan.mReplaceCount);
+
+    return plan;
+}
 
-    return realloc;
+void C2VdecComponent::DeviceUtil::setPredictedStreamInfo(const C2VdecStreamHeaderInfo& info) {
+    LockWeakPtrWithReturnVoid(comp, mComp);
+    if (!info.mValid) {
+        return;
+    }
+    mPredictedStreamInfo = info;
+    //the decoder reports the real values later,these only take effect until then
+    if (mStreamBitDepth == -1 && (info.mBitDepth == 8 || info.mBitDepth == 10)) {
+        mStreamBitDepth = info.mBitDepth;
+    }
+    if (info.mWidth * info.mHeight > kMaxWidth4k * kMaxHeight4k) {
+        mStreamIs8k = true;
+    }
+    C2VdecMDU_LOG(CODEC2_LOG_INFO, "[%s:%d] predicted %dx%d bitdepth:%d 8k:%d", __func__, __LINE__,
+        info.mWidth, info.mHeight, info.mBitDepth, mStreamIs8k);
 }
 
 void C2VdecComponent::DeviceUtil::releaseGrallocSlot() {
@@ -1619,8 +1768,7 @@ bool C2VdecComponent::DeviceUtil::checkConfigInfoFromDecoderAndReconfig(int type
             configChanged = true;
         }
 
-        int32_t disableVppThreshold = 0;
-        propGetInt(C2_PROPERTY_VDEC_DIABLE_VPP_THRES, &disableVppThreshold);
+        int32_t disableVppThreshold = C2VdecPropertySnapshot::getInstance().get()->mDisableVppThreshold;
         LockWeakPtrWithReturnVal(intfImpl, mIntfImpl, false);
         C2VendorVideoBitrate::input bitrate = {0};
         c2_status_t err = intfImpl->query({&bitrate}, {}, C2_MAY_BLOCK, nullptr);
@@ -1657,7 +1805,7 @@ bool C2VdecComponent::DeviceUtil::checkConfigInfoFromDecoderAndReconfig(int type
             params->cfg.triple_write_mode = tripleWriteValue;
 
             // by pass vpp.
-            bool bypass_vpp = property_get_bool(C2_PROPERTY_VDEC_DIABLE_BYPASS_VPP, true);
+            bool bypass_vpp = C2VdecPropertySnapshot::getInstance().get()->mBypassVpp;
             if (bypass_vpp)
                 params->cfg.metadata_config_flag |= VDEC_CFG_FLAG_DISABLE_DECODE_VPP;
 
@@ -1681,6 +1829,7 @@ bool C2VdecComponent::DeviceUtil::checkConfigInfoFromDecoderAndReconfig(int type
     }
 
     if (configChanged) {
+        invalidateAllocProfile();
         AmlMessageBase *msg = VideoDecWraper::AmVideoDec_getAmlMessage();
         std::shared_ptr<VideoDecWraper> videoWraper = comp->getCompVideoDecWraper();
         if (msg != NULL && videoWraper != NULL) {
@@ -1723,6 +1872,10 @@ bool C2VdecComponent::DeviceUtil::shouldEnableMMU() {
 }
 
 
+void C2VdecComponent::DeviceUtil::setResourceDowngrade(bool downgrade) {
+    mResourceDowngrade = downgrade;
+}
+
 void C2VdecComponent::DeviceUtil::setGameMode(bool enable) {
     static SystemControlClient *sc = SystemControlClient::getInstance();
 
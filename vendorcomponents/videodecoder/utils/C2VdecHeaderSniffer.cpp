@@ -0,0 +1,585 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "C2VdecHeaderSniffer"
+
+#include <utils/Log.h>
+
+#include <C2VdecHeaderSniffer.h>
+
+namespace android {
+
+namespace {
+
+const uint8_t kH264NalSps = 7;
+const uint8_t kH265NalSps = 33;
+const uint8_t kAV1ObuSequenceHeader = 1;
+const uint32_t kVP9RefFrames = 8;
+const uint32_t kAV1RefFrames = 8;
+
+// msb first bit reader, reading past the end sets an error instead of failing.
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size)
+        : mData(data), mSize(size), mPos(0), mError(false) {}
+
+    uint32_t u(uint32_t bits) {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < bits; i++) {
+            if (mPos >= mSize * 8) {
+                mError = true;
+                return 0;
+            }
+            value = (value << 1) | ((mData[mPos >> 3] >> (7 - (mPos & 7))) & 1);
+            mPos++;
+        }
+        return value;
+    }
+
+    void skip(uint32_t bits) {
+        mPos += bits;
+        if (mPos > mSize * 8) {
+            mError = true;
+        }
+    }
+
+    uint32_t ue() {
+        uint32_t zeros = 0;
+        while (u(1) == 0) {
+            if (mError || ++zeros > 31) {
+                mError = true;
+                return 0;
+            }
+        }
+        if (zeros == 0) {
+            return 0;
+        }
+        return ((1u << zeros) - 1) + u(zeros);
+    }
+
+    int32_t se() {
+        uint32_t value = ue();
+        return (value & 1) ? (int32_t)((value + 1) / 2) : -(int32_t)(value / 2);
+    }
+
+    // av1 uvlc(),same prefix as ue() but values up to 32 bits.
+    uint32_t uvlc() {
+        uint32_t zeros = 0;
+        while (u(1) == 0) {
+            if (mError) {
+                return 0;
+            }
+            zeros++;
+        }
+        if (zeros >= 32) {
+            return UINT32_MAX;
+        }
+        return ((1u << zeros) - 1) + u(zeros);
+    }
+
+    bool error() const { return mError; }
+
+private:
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mPos;
+    bool mError;
+};
+
+// av1 leb128(),returns the number of bytes used or 0 on error.
+size_t readLeb128(const uint8_t* data, size_t size, uint64_t* value) {
+    *value = 0;
+    for (size_t i = 0; i < 8 && i < size; i++) {
+        *value |= (uint64_t)(data[i] & 0x7f) << (i * 7);
+        if (!(data[i] & 0x80)) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// find the next annex b start code from offset,returns the payload offset or size.
+size_t findStartCode(const uint8_t* data, size_t size, size_t offset) {
+    for (size_t i = offset; i + 3 <= size; i++) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            return i + 3;
+        }
+    }
+    return size;
+}
+
+void skipH264ScalingList(BitReader& br, uint32_t sizeOfScalingList) {
+    int32_t lastScale = 8;
+    int32_t nextScale = 8;
+    for (uint32_t j = 0; j < sizeOfScalingList; j++) {
+        if (nextScale != 0) {
+            int32_t delta = br.se();
+            nextScale = (lastScale + delta + 256) % 256;
+        }
+        lastScale = (nextScale == 0) ? lastScale : nextScale;
+        if (br.error()) {
+            return;
+        }
+    }
+}
+
+uint32_t getH264MaxDpbMbs(uint32_t levelIdc, bool constraintSet3) {
+    switch (levelIdc) {
+        case 9: return 396;
+        case 10: return 396;
+        case 11: return constraintSet3 ? 396 : 900;
+        case 12: return 2376;
+        case 13: return 2376;
+        case 20: return 2376;
+        case 21: return 4752;
+        case 22: return 8100;
+        case 30: return 8100;
+        case 31: return 18000;
+        case 32: return 20480;
+        case 40: return 32768;
+        case 41: return 32768;
+        case 42: return 34816;
+        case 50: return 110400;
+        case 51: return 184320;
+        case 52: return 184320;
+        default: return 696320;
+    }
+}
+
+}
+
+bool C2VdecHeaderSniffer::sniff(Codec codec, const uint8_t* data, size_t size, C2VdecStreamHeaderInfo* info) {
+    if (data == NULL || size == 0 || info == NULL) {
+        return false;
+    }
+    info->mValid = false;
+    info->mWidth = 0;
+    info->mHeight = 0;
+    info->mBitDepth = 8;
+    info->mDpbSize = 0;
+    info->mInterlaced = false;
+
+    bool found = false;
+    switch (codec) {
+        case CODEC_H264:
+            found = sniffH264(data, size, info);
+            break;
+        case CODEC_H265:
+            found = sniffH265(data, size, info);
+            break;
+        case CODEC_VP9:
+            found = sniffVP9(data, size, info);
+            break;
+        case CODEC_AV1:
+            found = sniffAV1(data, size, info);
+            break;
+        default:
+            break;
+    }
+    info->mValid = found && info->mWidth > 0 && info->mHeight > 0;
+    if (info->mValid) {
+        ALOGV("codec:%d size:%ux%u bitdepth:%u dpb:%u interlaced:%d", codec,
+                info->mWidth, info->mHeight, info->mBitDepth, info->mDpbSize, info->mInterlaced);
+    }
+    return info->mValid;
+}
+
+void C2VdecHeaderSniffer::unescapeNal(const uint8_t* nal, size_t size, std::vector<uint8_t>* rbsp) {
+    rbsp->clear();
+    rbsp->reserve(size);
+    uint32_t zeros = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (zeros >= 2 && nal[i] == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = (nal[i] == 0) ? zeros + 1 : 0;
+        rbsp->push_back(nal[i]);
+    }
+}
+
+bool C2VdecHeaderSniffer::sniffH264(const uint8_t* data, size_t size, C2VdecStreamHeaderInfo* info) {
+    //avcC: version,profile,compat,level,length size,then sps count and sps list
+    if (data[0] == 1 && size > 8) {
+        uint32_t numSps = data[5] & 0x1f;
+        size_t offset = 6;
+        for (uint32_t i = 0; i < numSps && offset + 2 <= size; i++) {
+            size_t len = (data[offset] << 8) | data[offset + 1];
+            offset += 2;
+            if (offset + len > size) {
+                return false;
+            }
+            if (len > 0 && (data[offset] & 0x1f) == kH264NalSps) {
+                return parseH264Sps(data + offset, len, info);
+            }
+            offset += len;
+        }
+        return false;
+    }
+
+    size_t start = findStartCode(data, size, 0);
+    while (start < size) {
+        size_t next = findStartCode(data, size, start);
+        size_t end = (next < size) ? next - 3 : size;
+        if ((data[start] & 0x1f) == kH264NalSps) {
+            return parseH264Sps(data + start, end - start, info);
+        }
+        start = next;
+    }
+    return false;
+}
+
+bool C2VdecHeaderSniffer::parseH264Sps(const uint8_t* nal, size_t size, C2VdecStreamHeaderInfo* info) {
+    std::vector<uint8_t> rbsp;
+    unescapeNal(nal, size, &rbsp);
+    BitReader br(rbsp.data(), rbsp.size());
+
+    br.skip(8);
+    uint32_t profileIdc = br.u(8);
+    uint32_t constraintFlags = br.u(8);
+    uint32_t levelIdc = br.u(8);
+    br.ue();
+    uint32_t chromaFormatIdc = 1;
+    if (profileIdc == 100 || profileIdc == 110 || profileIdc == 122 || profileIdc == 244 ||
+        profileIdc == 44 || profileIdc == 83 || profileIdc == 86 || profileIdc == 118 ||
+        profileIdc == 128 || profileIdc == 138 || profileIdc == 139 || profileIdc == 134 ||
+        profileIdc == 135) {
+        chromaFormatIdc = br.ue();
+        if (chromaFormatIdc == 3) {
+            br.skip(1);
+        }
+        info->mBitDepth = br.ue() + 8;
+        br.ue();
+        br.skip(1);
+        if (br.u(1)) {
+            uint32_t lists = (chromaFormatIdc != 3) ? 8 : 12;
+            for (uint32_t i = 0; i < lists; i++) {
+                if (br.u(1)) {
+                    skipH264ScalingList(br, (i < 6) ? 16 : 64);
+                }
+            }
+        }
+    }
+    br.ue();
+    uint32_t pocType = br.ue();
+    if (pocType == 0) {
+        br.ue();
+    } else if (pocType == 1) {
+        br.skip(1);
+        br.se();
+        br.se();
+        uint32_t cycle = br.ue();
+        if (cycle > 255) {
+            return false;
+        }
+        for (uint32_t i = 0; i < cycle; i++) {
+            br.se();
+        }
+    }
+    uint32_t maxNumRefFrames = br.ue();
+    br.skip(1);
+    uint32_t widthMbs = br.ue() + 1;
+    uint32_t heightMapUnits = br.ue() + 1;
+    uint32_t frameMbsOnly = br.u(1);
+    if (br.error() || widthMbs > 1024 || heightMapUnits > 1024) {
+        return false;
+    }
+    uint32_t heightMbs = (2 - frameMbsOnly) * heightMapUnits;
+
+    info->mWidth = widthMbs * 16;
+    info->mHeight = heightMbs * 16;
+    info->mInterlaced = (frameMbsOnly == 0);
+    uint32_t dpb = getH264MaxDpbMbs(levelIdc, constraintFlags & 0x10) / (widthMbs * heightMbs);
+    if (dpb > 16) {
+        dpb = 16;
+    }
+    info->mDpbSize = (maxNumRefFrames > dpb) ? maxNumRefFrames : dpb;
+    return true;
+}
+
+bool C2VdecHeaderSniffer::sniffH265(const uint8_t* data, size_t size, C2VdecStreamHeaderInfo* info) {
+    //hvcC: 22 bytes of header,then arrays of nal units
+    if (data[0] == 1 && size > 23) {
+        uint32_t numArrays = data[22];
+        size_t offset = 23;
+        for (uint32_t i = 0; i < numArrays && offset + 3 <= size; i++) {
+            uint32_t type = data[offset] & 0x3f;
+            uint32_t numNalus = (data[offset + 1] << 8) | data[offset + 2];
+            offset += 3;
+            for (uint32_t j = 0; j < numNalus && offset + 2 <= size; j++) {
+                size_t len = (data[offset] << 8) | data[offset + 1];
+                offset += 2;
+                if (offset + len > size) {
+                    return false;
+                }
+                if (type == kH265NalSps) {
+                    return parseH265Sps(data + offset, len, info);
+                }
+                offset += len;
+            }
+        }
+        return false;
+    }
+
+    size_t start = findStartCode(data, size, 0);
+    while (start < size) {
+        size_t next = findStartCode(data, size, start);
+        size_t end = (next < size) ? next - 3 : size;
+        if (((data[start] >> 1) & 0x3f) == kH265NalSps) {
+            return parseH265Sps(data + start, end - start, info);
+        }
+        start = next;
+    }
+    return false;
+}
+
+bool C2VdecHeaderSniffer::parseH265Sps(const uint8_t* nal, size_t size, C2VdecStreamHeaderInfo* info) {
+    std::vector<uint8_t> rbsp;
+    unescapeNal(nal, size, &rbsp);
+    BitReader br(rbsp.data(), rbsp.size());
+
+    br.skip(16);
+    br.skip(4);
+    uint32_t maxSubLayersMinus1 = br.u(3);
+    br.skip(1);
+    //profile_tier_level,general part is 88 bits of profile and 8 bits of level
+    br.skip(96);
+    uint32_t subLayerProfilePresent = 0;
+    uint32_t subLayerLevelPresent = 0;
+    for (uint32_t i = 0; i < maxSubLayersMinus1; i++) {
+        subLayerProfilePresent |= br.u(1) << i;
+        subLayerLevelPresent |= br.u(1) << i;
+    }
+    if (maxSubLayersMinus1 > 0) {
+        br.skip(2 * (8 - maxSubLayersMinus1));
+    }
+    for (uint32_t i = 0; i < maxSubLayersMinus1; i++) {
+        if (subLayerProfilePresent & (1 << i)) {
+            br.skip(88);
+        }
+        if (subLayerLevelPresent & (1 << i)) {
+            br.skip(8);
+        }
+    }
+    br.ue();
+    uint32_t chromaFormatIdc = br.ue();
+    if (chromaFormatIdc == 3) {
+        br.skip(1);
+    }
+    uint32_t width = br.ue();
+    uint32_t height = br.ue();
+    if (br.u(1)) {
+        br.ue();
+        br.ue();
+        br.ue();
+        br.ue();
+    }
+    uint32_t bitDepth = br.ue() + 8;
+    br.ue();
+    br.ue();
+    uint32_t orderingInfoPresent = br.u(1);
+    uint32_t maxDecPicBuffering = 0;
+    for (uint32_t i = orderingInfoPresent ? 0 : maxSubLayersMinus1; i <= maxSubLayersMinus1; i++) {
+        maxDecPicBuffering = br.ue() + 1;
+        br.ue();
+        br.ue();
+    }
+    if (br.error() || width > 16384 || height > 16384) {
+        return false;
+    }
+
+    info->mWidth = width;
+    info->mHeight = height;
+    info->mBitDepth = bitDepth;
+    info->mDpbSize = maxDecPicBuffering;
+    return true;
+}
+
+bool C2VdecHeaderSniffer::sniffVP9(const uint8_t* data, size_t size, C2VdecStreamHeaderInfo* info) {
+    BitReader br(data, size);
+
+    if (br.u(2) != 2) {
+        return false;
+    }
+    uint32_t profile = br.u(1);
+    profile |= br.u(1) << 1;
+    if (profile == 3) {
+        br.skip(1);
+    }
+    //show_existing_frame,then only key frames carry the size
+    if (br.u(1)) {
+        return false;
+    }
+    if (br.u(1) != 0) {
+        return false;
+    }
+    br.skip(2);
+    if (br.u(8) != 0x49 || br.u(8) != 0x83 || br.u(8) != 0x42) {
+        return false;
+    }
+    uint32_t bitDepth = 8;
+    if (profile >= 2) {
+        bitDepth = br.u(1) ? 12 : 10;
+    }
+    uint32_t colorSpace = br.u(3);
+    if (colorSpace != 7) {
+        br.skip(1);
+        if (profile == 1 || profile == 3) {
+            br.skip(3);
+        }
+    } else if (profile == 1 || profile == 3) {
+        br.skip(1);
+    }
+    uint32_t width = br.u(16) + 1;
+    uint32_t height = br.u(16) + 1;
+    if (br.error()) {
+        return false;
+    }
+
+    info->mWidth = width;
+    info->mHeight = height;
+    info->mBitDepth = bitDepth;
+    info->mDpbSize = kVP9RefFrames;
+    return true;
+}
+
+bool C2VdecHeaderSniffer::sniffAV1(const uint8_t* data, size_t size, C2VdecStreamHeaderInfo* info) {
+    size_t offset = 0;
+    //av1C: marker and version,then 3 bytes of profile and level,config obus follow
+    if (size > 4 && data[0] == 0x81) {
+        offset = 4;
+    }
+    while (offset < size) {
+        uint8_t header = data[offset];
+        uint32_t type = (header >> 3) & 0xf;
+        bool hasExtension = header & 0x4;
+        bool hasSize = header & 0x2;
+        size_t pos = offset + 1 + (hasExtension ? 1 : 0);
+        uint64_t obuSize = size - pos;
+        if (pos > size) {
+            return false;
+        }
+        if (hasSize) {
+            size_t len = readLeb128(data + pos, size - pos, &obuSize);
+            if (len == 0) {
+                return false;
+            }
+            pos += len;
+        }
+        if (obuSize > size - pos) {
+            return false;
+        }
+        if (type == kAV1ObuSequenceHeader) {
+            return parseAV1SequenceHeader(data + pos, (size_t)obuSize, info);
+        }
+        offset = pos + obuSize;
+    }
+    return false;
+}
+
+bool C2VdecHeaderSniffer::parseAV1SequenceHeader(const uint8_t* obu, size_t size, C2VdecStreamHeaderInfo* info) {
+    BitReader br(obu, size);
+
+    uint32_t profile = br.u(3);
+    br.skip(1);
+    uint32_t reducedStillPictureHeader = br.u(1);
+    if (reducedStillPictureHeader) {
+        br.skip(5);
+    } else {
+        uint32_t decoderModelInfoPresent = 0;
+        uint32_t bufferDelayLength = 0;
+        if (br.u(1)) {
+            br.skip(32);
+            br.skip(32);
+            if (br.u(1)) {
+                br.uvlc();
+            }
+            decoderModelInfoPresent = br.u(1);
+            if (decoderModelInfoPresent) {
+                bufferDelayLength = br.u(5) + 1;
+                br.skip(32);
+                br.skip(5);
+                br.skip(5);
+            }
+        }
+        uint32_t initialDisplayDelayPresent = br.u(1);
+        uint32_t operatingPoints = br.u(5) + 1;
+        for (uint32_t i = 0; i < operatingPoints; i++) {
+            br.skip(12);
+            uint32_t levelIdx = br.u(5);
+            if (levelIdx > 7) {
+                br.skip(1);
+            }
+            if (decoderModelInfoPresent && br.u(1)) {
+                br.skip(bufferDelayLength);
+                br.skip(bufferDelayLength);
+                br.skip(1);
+            }
+            if (initialDisplayDelayPresent && br.u(1)) {
+                br.skip(4);
+            }
+        }
+    }
+    uint32_t widthBits = br.u(4) + 1;
+    uint32_t heightBits = br.u(4) + 1;
+    uint32_t width = br.u(widthBits) + 1;
+    uint32_t height = br.u(heightBits) + 1;
+
+    uint32_t enableOrderHint = 0;
+    if (!reducedStillPictureHeader && br.u(1)) {
+        br.skip(4);
+        br.skip(3);
+    }
+    br.skip(3);
+    if (!reducedStillPictureHeader) {
+        br.skip(4);
+        enableOrderHint = br.u(1);
+        if (enableOrderHint) {
+            br.skip(2);
+        }
+        uint32_t forceScreenContentTools = 2;
+        if (!br.u(1)) {
+            forceScreenContentTools = br.u(1);
+        }
+        if (forceScreenContentTools > 0 && !br.u(1)) {
+            br.skip(1);
+        }
+        if (enableOrderHint) {
+            br.skip(3);
+        }
+    }
+    br.skip(3);
+    //color_config
+    uint32_t bitDepth = 8;
+    if (br.u(1)) {
+        bitDepth = 10;
+        if (profile == 2 && br.u(1)) {
+            bitDepth = 12;
+        }
+    }
+    if (br.error()) {
+        return false;
+    }
+
+    info->mWidth = width;
+    info->mHeight = height;
+    info->mBitDepth = bitDepth;
+    info->mDpbSize = kAV1RefFrames;
+    return true;
+}
+
+}
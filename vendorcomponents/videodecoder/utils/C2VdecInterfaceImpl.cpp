@@ -449,6 +449,9 @@ C2VdecComponent::IntfImpl::IntfImpl(C2String name, const std::shared_ptr<C2Refle
     //lowlatency
     onLowLatencyDeclareParam();
 
+    //priority
+    onPriorityDeclareParam();
+
     //PixelFormat
     onPixelFormatDeclareParam();
 
@@ -1536,6 +1539,15 @@ void C2VdecComponent::IntfImpl::onLowLatencyDeclareParam() {
     .build());
 }
 
+void C2VdecComponent::IntfImpl::onPriorityDeclareParam() {
+    addParameter(
+        DefineParam(mRealTimePriority, C2_PARAMKEY_PRIORITY)
+            .withDefault(new C2RealTimePriorityTuning(0))
+            .withFields({C2F(mRealTimePriority, value).any()})
+            .withSetter(Setter<decltype(*mRealTimePriority)>::StrictValueWithNoDeps)
+    .build());
+}
+
 void C2VdecComponent::IntfImpl::onPixelFormatDeclareParam() {
     bool support_soft_10bit = property_get_bool(C2_PROPERTY_VDEC_SUPPORT_10BIT, true);
     support_soft_10bit = property_get_bool(PROPERTY_PLATFORM_SUPPORT_SOFTWARE_P010, support_soft_10bit);
@@ -1783,10 +1795,10 @@ c2_status_t C2VdecComponent::IntfImpl::onStreamPictureSizeConfigParam(
     bool isMaxRes = C2VdecCodecConfig::getInstance().isMaxResolutionFromXml(vendorCodec, mSecureMode, mSize->width, mSize->height);
 
     if (isMaxRes && !mComponent->mIsMaxResolution) {
-        C2VdecComponent::sConcurrentMaxResolutionInstance.fetch_add(1, std::memory_order_relaxed);
+        C2VdecResourcePolicy::getInstance().setHighResolution(mComponent->mResourceHandle, true);
         mComponent->mIsMaxResolution = true;
         CODEC2_LOG(CODEC2_LOG_INFO, "[%d##%d] use max res, ins:%d",
-            C2VdecComponent::mInstanceID, mComponent->mSessionID, C2VdecComponent::sConcurrentMaxResolutionInstance.load());
+            C2VdecComponent::mInstanceID, mComponent->mSessionID, C2VdecResourcePolicy::getInstance().getHighResInstanceCount());
     }
 
     return ret;
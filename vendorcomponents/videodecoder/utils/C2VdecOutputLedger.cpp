@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "C2VdecOutputLedger"
+
+#include <inttypes.h>
+#include <utils/Log.h>
+
+#include <C2VdecOutputLedger.h>
+
+namespace android {
+
+C2VdecOutputLedger::C2VdecOutputLedger()
+    : mDuplicateTimeCount(0) {
+}
+
+C2VdecOutputLedger::~C2VdecOutputLedger() {
+    clear();
+}
+
+void C2VdecOutputLedger::push_back(const C2VdecOutputBufferInfo& info) {
+    iterator it = mBuffers.insert(mBuffers.end(), info);
+    if (mByTime.count(info.mMediaTimeUs) > 0) {
+        mDuplicateTimeCount++;
+        ALOGV("duplicate media time %" PRIu64 " bitstream id:%d block id:%d",
+                info.mMediaTimeUs, info.mBitstreamId, info.mBlockId);
+    }
+    mByTime.emplace_hint(mByTime.upper_bound(info.mMediaTimeUs), info.mMediaTimeUs, it);
+    mByBlockId.emplace(info.mBlockId, it);
+    mByBitstreamId.emplace(info.mBitstreamId, it);
+}
+
+void C2VdecOutputLedger::pop_front() {
+    if (!mBuffers.empty()) {
+        erase(mBuffers.begin());
+    }
+}
+
+void C2VdecOutputLedger::eraseFromIdIndex(IdIndex& index, int32_t id, iterator it) {
+    auto range = index.equal_range(id);
+    for (auto i = range.first; i != range.second; ++i) {
+        if (i->second == it) {
+            index.erase(i);
+            return;
+        }
+    }
+}
+
+C2VdecOutputLedger::iterator C2VdecOutputLedger::erase(iterator it) {
+    if (it == mBuffers.end()) {
+        return it;
+    }
+    auto range = mByTime.equal_range(it->mMediaTimeUs);
+    for (auto i = range.first; i != range.second; ++i) {
+        if (i->second == it) {
+            mByTime.erase(i);
+            break;
+        }
+    }
+    eraseFromIdIndex(mByBlockId, it->mBlockId, it);
+    eraseFromIdIndex(mByBitstreamId, it->mBitstreamId, it);
+    return mBuffers.erase(it);
+}
+
+void C2VdecOutputLedger::clear() {
+    mByTime.clear();
+    mByBlockId.clear();
+    mByBitstreamId.clear();
+    mBuffers.clear();
+    mDuplicateTimeCount = 0;
+}
+
+C2VdecOutputLedger::iterator C2VdecOutputLedger::findByTime(uint64_t timeUs) {
+    //multimap::find may land anywhere in the range, the oldest one is at lower_bound.
+    auto i = mByTime.lower_bound(timeUs);
+    if (i == mByTime.end() || i->first != timeUs) {
+        return mBuffers.end();
+    }
+    return i->second;
+}
+
+// a block is never pending twice,it goes back to the accelerator only after leaving the ledger.
+C2VdecOutputLedger::iterator C2VdecOutputLedger::findByBlockId(int32_t blockId) {
+    auto i = mByBlockId.find(blockId);
+    return (i == mByBlockId.end()) ? mBuffers.end() : i->second;
+}
+
+C2VdecOutputLedger::iterator C2VdecOutputLedger::findByBitstreamId(int32_t bitstreamId) {
+    auto i = mByBitstreamId.find(bitstreamId);
+    return (i == mByBitstreamId.end()) ? mBuffers.end() : i->second;
+}
+
+bool C2VdecOutputLedger::eraseByTime(uint64_t timeUs) {
+    iterator it = findByTime(timeUs);
+    if (it == mBuffers.end()) {
+        return false;
+    }
+    erase(it);
+    return true;
+}
+
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "C2VdecPropertySnapshot"
+
+#include <utils/Log.h>
+#include <cutils/properties.h>
+#include <sys/system_properties.h>
+
+#include <C2VendorProperty.h>
+#include <C2VdecPropertySnapshot.h>
+
+namespace android {
+
+// same defaults as the former direct reads.
+#define PROPERTY_DEFAULT_LOG_LEVEL           1
+#define PROPERTY_DEFAULT_RETRYBLOCK_TIMEOUT  (60*1000)
+#define PROPERTY_DEFAULT_SKIP_ERR_TIMEOUT    (10)
+#define PROPERTY_DEFAULT_AVC_MMU_WIDTH       2560
+#define PROPERTY_DEFAULT_AVC_MMU_HEIGHT      2160
+
+static int32_t systemGetInt32(const char* key, int32_t defaultValue) {
+    return property_get_int32(key, defaultValue);
+}
+
+static bool systemGetBool(const char* key, bool defaultValue) {
+    return property_get_bool(key, defaultValue);
+}
+
+static uint32_t systemGetSerial() {
+    return __system_property_area_serial();
+}
+
+// static
+C2VdecPropertySnapshot::Backend C2VdecPropertySnapshot::getSystemBackend() {
+    Backend backend = {systemGetInt32, systemGetBool, systemGetSerial};
+    return backend;
+}
+
+// static
+C2VdecPropertySnapshot& C2VdecPropertySnapshot::getInstance() {
+    static C2VdecPropertySnapshot sSnapshot(getSystemBackend());
+    return sSnapshot;
+}
+
+C2VdecPropertySnapshot::C2VdecPropertySnapshot(const Backend& backend)
+    : mBackend(backend),
+      mSerial(0),
+      mGeneration(0) {
+    std::lock_guard<std::mutex> lock(mRefreshLock);
+    loadLocked();
+}
+
+std::shared_ptr<const C2VdecProperties> C2VdecPropertySnapshot::get() const {
+    return std::atomic_load(&mCurrent);
+}
+
+uint32_t C2VdecPropertySnapshot::getGeneration() const {
+    return mGeneration.load(std::memory_order_acquire);
+}
+
+void C2VdecPropertySnapshot::loadLocked() {
+    std::shared_ptr<C2VdecProperties> props = std::make_shared<C2VdecProperties>();
+    //read the serial first,a property set during the load is seen by the next check.
+    mSerial = mBackend.getSerial();
+
+    int32_t logLevel = mBackend.getInt32(CODEC2_VDEC_LOGDEBUG_PROPERTY, PROPERTY_DEFAULT_LOG_LEVEL);
+    props->mLogLevel = (uint32_t)logLevel;
+
+    props->mDoubleWrite = mBackend.getInt32(C2_PROPERTY_VDEC_DOUBLEWRITE, -1);
+    props->mTripleWrite = mBackend.getInt32(C2_PROPERTY_VDEC_TRIPLEWRITE, -1);
+    props->mFixedBufferSlice = mBackend.getInt32(C2_PROPERTY_VDEC_FIXED_BUFF_SLICE, -1);
+    props->mAmdvUse540p = mBackend.getBool(C2_PROPERTY_VDEC_AMDV_USE_540P, false);
+    props->mAmdvUseP010 = mBackend.getBool(C2_PROPERTY_VDEC_AMDV_USE_P010, false);
+    props->mOutBufRealloc = mBackend.getBool(C2_PROPERTY_VDEC_OUT_BUF_REALLOC, false);
+    props->mOutAddDelay = mBackend.getInt32(C2_PROPERTY_VDEC_OUT_ADD_DELAY, 0);
+    // -1 when not set, the users have their own default.
+    props->mLlvFirstAllocNum = mBackend.getInt32(C2_PROPERTY_VDEC_LLV_FIRST_ALLOC_NUM, -1);
+    props->mMargin = mBackend.getInt32(C2_PROPERTY_VDEC_MARGIN, -1);
+    props->mReallocTunnelResChange = mBackend.getBool(C2_PROPERTY_VDEC_REALLOC_TUNNEL_RESCHANGE, false);
+    props->mReuseTunnelResChange = mBackend.getBool(C2_PROPERTY_VDEC_REUSE_TUNNEL_RESCHANGE, true);
+
+    props->mDisableRC = mBackend.getBool(C2_PROPERTY_VDEC_DISABLE_RC, true);
+    props->mDebugPriority = mBackend.getInt32(C2_PROPERTY_VDEC_DEBUG_PRIORITY, 0);
+
+    props->mDiPost = mBackend.getBool(C2_PROPERTY_VDEC_DI_POST, false);
+    props->mEnableNR = mBackend.getBool(C2_PROPERTY_VDEC_DISP_NR_ENABLE, false);
+    props->mEnable8kNR = mBackend.getBool(C2_PROPERTY_VDEC_DISP_NR_8K_ENABLE, false);
+    props->mEnableDILocalBuf = mBackend.getBool(C2_PROPERTY_VDEC_DISP_DI_LOCALBUF_ENABLE, false);
+    props->mForceDIPermission = mBackend.getBool(C2_PROPERTY_VDEC_FORCE_DI_PERMISSION, false);
+    props->mDisableVppThreshold = mBackend.getInt32(C2_PROPERTY_VDEC_DIABLE_VPP_THRES, 0);
+    props->mBypassVpp = mBackend.getBool(C2_PROPERTY_VDEC_DIABLE_BYPASS_VPP, true);
+
+    // the platform property overrides the decoder one when set.
+    props->mSupport10Bit = mBackend.getBool(PROPERTY_PLATFORM_SUPPORT_SOFTWARE_P010,
+            mBackend.getBool(C2_PROPERTY_VDEC_SUPPORT_10BIT, true));
+    props->mHwSupportP010 = mBackend.getBool(PROPERTY_PLATFORM_SUPPORT_HARDWARE_P010, false);
+    props->mSwSupportP010 = mBackend.getBool(PROPERTY_PLATFORM_SUPPORT_SOFTWARE_P010, true);
+    props->mSupport8kBufMode = mBackend.getBool(PROPERTY_PLATFORM_SUPPORT_8K_BUF_MODE, false);
+    props->mEnableAvc4kMMU = mBackend.getBool(C2_PROPERTY_VDEC_ENABLE_AVC_4K_MMU, false);
+    props->mAvcMMUWidth = mBackend.getInt32(C2_PROPERTY_VDEC_AVC_MMU_WIDTH, PROPERTY_DEFAULT_AVC_MMU_WIDTH);
+    props->mAvcMMUHeight = mBackend.getInt32(C2_PROPERTY_VDEC_AVC_MMU_HEIGHT, PROPERTY_DEFAULT_AVC_MMU_HEIGHT);
+
+    props->mHdrLittleEndian = mBackend.getBool(C2_PROPERTY_VDEC_HDR_LITTLE_ENDIAN_ENABLE, true);
+    props->mDisableErrPolicy = mBackend.getBool(C2_PROPERTY_VDEC_ERRPOLICY_DISABLE, true);
+    props->mRetryBlockTimeoutMs = mBackend.getInt32(C2_PROPERTY_VDEC_RETRYBLOCK_TIMEOUT, PROPERTY_DEFAULT_RETRYBLOCK_TIMEOUT);
+    props->mSkipErrFrameTimeout = mBackend.getInt32(C2_PROPERTY_VDEC_SKIP_ERRFRAME_TIMEOUT, PROPERTY_DEFAULT_SKIP_ERR_TIMEOUT);
+    props->mFdInfoDebug = mBackend.getBool(C2_PROPERTY_VDEC_FD_INFO_DEBUG, false);
+    props->mDumpInput = mBackend.getBool(C2_PROPERTY_VDEC_DUMP_INPUT, false);
+
+    std::atomic_store(&mCurrent, std::shared_ptr<const C2VdecProperties>(props));
+    mGeneration.fetch_add(1, std::memory_order_release);
+    ALOGV("loaded generation %u serial %u loglevel 0x%x dw %d tw %d",
+            mGeneration.load(std::memory_order_relaxed), mSerial, props->mLogLevel,
+            props->mDoubleWrite, props->mTripleWrite);
+}
+
+void C2VdecPropertySnapshot::refresh() {
+    std::lock_guard<std::mutex> lock(mRefreshLock);
+    loadLocked();
+}
+
+bool C2VdecPropertySnapshot::refreshIfChanged() {
+    std::lock_guard<std::mutex> lock(mRefreshLock);
+    uint32_t serial = mBackend.getSerial();
+    if (serial != 0 && serial == mSerial) {
+        return false;
+    }
+    loadLocked();
+    return true;
+}
+
+void C2VdecPropertySnapshot::setBackend(const Backend& backend) {
+    std::lock_guard<std::mutex> lock(mRefreshLock);
+    mBackend = backend;
+    loadLocked();
+}
+
+}
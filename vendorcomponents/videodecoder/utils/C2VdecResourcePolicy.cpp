@@ -0,0 +1,350 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "C2VdecResourcePolicy"
+
+#include <inttypes.h>
+#include <chrono>
+#include <utils/Log.h>
+
+#include <C2VdecResourcePolicy.h>
+
+namespace android {
+
+// the decoder keeps its dpb plus the frames held by the display.
+#define RESOURCE_DEFAULT_BUFFER_COUNT 16
+#define RESOURCE_DEFAULT_FRAME_RATE   30
+// a preempted instance gives its resource back once its client released it.
+#define RESOURCE_PREEMPT_WAIT_MS      1000
+
+// static
+C2VdecResourcePolicy& C2VdecResourcePolicy::getInstance() {
+    static C2VdecResourcePolicy sPolicy;
+    return sPolicy;
+}
+
+C2VdecResourcePolicy::C2VdecResourcePolicy()
+    : mNextHandle(1) {
+    mBudget.mMaxInstances = -1;
+    mBudget.mMaxSecureInstances = -1;
+    mBudget.mMaxHighResInstances = -1;
+    mBudget.mMaxMbPerSec = 0;
+    mBudget.mMaxMemoryBytes = 0;
+}
+
+void C2VdecResourcePolicy::setBudget(const C2VdecResourceBudget& budget) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mBudget = budget;
+}
+
+C2VdecResourceBudget C2VdecResourcePolicy::getBudget() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mBudget;
+}
+
+// static
+uint64_t C2VdecResourcePolicy::mbPerSec(const C2VdecResourceRequest& request) {
+    uint64_t mbs = (uint64_t)((request.mWidth + 15) / 16) * ((request.mHeight + 15) / 16);
+    uint32_t frameRate = (request.mFrameRate > 0) ? request.mFrameRate : RESOURCE_DEFAULT_FRAME_RATE;
+    return mbs * frameRate;
+}
+
+// static
+uint64_t C2VdecResourcePolicy::memoryBytes(const C2VdecResourceRequest& request, bool downgrade) {
+    uint64_t width = (request.mWidth + 63) & ~63;
+    uint64_t height = (request.mHeight + 63) & ~63;
+    uint32_t count = (request.mBufferCount > 0) ? request.mBufferCount : RESOURCE_DEFAULT_BUFFER_COUNT;
+    if (downgrade) {
+        //half width and half height output.
+        width /= 2;
+        height /= 2;
+    }
+    return width * height * 3 / 2 * count;
+}
+
+// static
+const char* C2VdecResourcePolicy::actionToString(C2VdecResourceDecision::Action action) {
+    switch (action) {
+        case C2VdecResourceDecision::ADMIT:
+            return "admit";
+        case C2VdecResourceDecision::DOWNGRADE:
+            return "downgrade";
+        case C2VdecResourceDecision::REJECT:
+            return "reject";
+        default:
+            return "unknown";
+    }
+}
+
+void C2VdecResourcePolicy::usageLocked(int32_t exclude, bool withPreempted, int32_t* instances, int32_t* secures,
+        int32_t* exclusives, int32_t* highRes, uint64_t* mbps, uint64_t* memory) {
+    *instances = 0;
+    *secures = 0;
+    *exclusives = 0;
+    *highRes = 0;
+    *mbps = 0;
+    *memory = 0;
+    for (auto& it : mInstances) {
+        const Instance& instance = it.second;
+        //a preempted instance holds the decoder until it is released.
+        if (it.first == exclude || (instance.mPreempted && !withPreempted)) {
+            continue;
+        }
+        if (instance.mRequest.mSecure) {
+            (*secures)++;
+        } else {
+            (*instances)++;
+        }
+        if (instance.mRequest.mExclusive) {
+            (*exclusives)++;
+        }
+        if (instance.mHighRes) {
+            (*highRes)++;
+        }
+        if (instance.mStarted) {
+            *mbps += mbPerSec(instance.mRequest);
+            *memory += memoryBytes(instance.mRequest, instance.mDowngrade);
+        }
+    }
+}
+
+bool C2VdecResourcePolicy::preemptableLocked(const Instance& instance, const C2VdecResourceRequest& request) {
+    return !instance.mPreempted && !instance.mRequest.mForeground
+            && instance.mRequest.mPriority > request.mPriority;
+}
+
+int32_t C2VdecResourcePolicy::preemptLocked(int32_t exclude, const C2VdecResourceRequest& request,
+        const std::function<bool(bool)>& satisfied, std::vector<PreemptCallback>* callbacks) {
+    int32_t count = 0;
+    while (!satisfied(false)) {
+        //the lowest priority goes first, the newest one between equals.
+        auto victim = mInstances.end();
+        for (auto it = mInstances.begin(); it != mInstances.end(); ++it) {
+            if (it->first == exclude || !preemptableLocked(it->second, request)) {
+                continue;
+            }
+            if (victim == mInstances.end()
+                || it->second.mRequest.mPriority >= victim->second.mRequest.mPriority) {
+                victim = it;
+            }
+        }
+        if (victim == mInstances.end()) {
+            break;
+        }
+        ALOGD("preempt instance %d priority:%d for priority:%d", victim->first,
+                victim->second.mRequest.mPriority, request.mPriority);
+        victim->second.mPreempted = true;
+        if (victim->second.mCallback) {
+            callbacks->push_back(victim->second.mCallback);
+        }
+        count++;
+    }
+    return count;
+}
+
+void C2VdecResourcePolicy::waitPreemptedLocked(std::unique_lock<std::mutex>& lock,
+        std::vector<PreemptCallback>* callbacks, const std::function<bool(bool)>& satisfied, int32_t timeoutMs) {
+    if (!callbacks->empty()) {
+        //the callback may drop the last reference to a component, which releases it.
+        lock.unlock();
+        for (size_t i = 0; i < callbacks->size(); i++) {
+            (*callbacks)[i]();
+        }
+        callbacks->clear();
+        lock.lock();
+    }
+    //nothing to wait for unless the instances on their way out make it fit.
+    if (timeoutMs <= 0 || satisfied(true) || !satisfied(false)) {
+        return;
+    }
+    if (!mReleaseCond.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+            [&]() { return satisfied(true); })) {
+        ALOGW("preempted instances not released in %d ms", timeoutMs);
+    }
+}
+
+int32_t C2VdecResourcePolicy::acquire(const C2VdecResourceRequest& request, C2VdecResourceDecision* decision) {
+    std::unique_lock<std::mutex> lock(mLock);
+    std::vector<PreemptCallback> callbacks;
+    auto slotAvailable = [&](bool withPreempted) {
+        int32_t instances, secures, exclusives, highRes;
+        uint64_t mbps, memory;
+        usageLocked(-1, withPreempted, &instances, &secures, &exclusives, &highRes, &mbps, &memory);
+        int32_t total = instances + secures;
+        if (exclusives > 0 || (request.mExclusive && total > 0)) {
+            return false;
+        }
+        if (mBudget.mMaxInstances >= 0 && total >= mBudget.mMaxInstances) {
+            return false;
+        }
+        if (request.mSecure && mBudget.mMaxSecureInstances >= 0 && secures >= mBudget.mMaxSecureInstances) {
+            return false;
+        }
+        if (mBudget.mMaxHighResInstances >= 0 && highRes >= mBudget.mMaxHighResInstances) {
+            return false;
+        }
+        return true;
+    };
+
+    C2VdecResourceDecision result = {C2VdecResourceDecision::ADMIT, 0, false};
+    result.mPreemptedCount = preemptLocked(-1, request, slotAvailable, &callbacks);
+    waitPreemptedLocked(lock, &callbacks, slotAvailable, RESOURCE_PREEMPT_WAIT_MS);
+    if (!slotAvailable(true)) {
+        result.mAction = C2VdecResourceDecision::REJECT;
+        if (decision) {
+            *decision = result;
+        }
+        return -1;
+    }
+
+    int32_t handle = mNextHandle++;
+    Instance instance;
+    instance.mRequest = request;
+    instance.mHighRes = false;
+    instance.mDowngrade = false;
+    instance.mPreempted = false;
+    instance.mStarted = false;
+    mInstances[handle] = instance;
+    if (decision) {
+        *decision = result;
+    }
+    return handle;
+}
+
+C2VdecResourceDecision C2VdecResourcePolicy::update(int32_t handle, const C2VdecResourceRequest& request) {
+    std::unique_lock<std::mutex> lock(mLock);
+    std::vector<PreemptCallback> callbacks;
+    C2VdecResourceDecision result = {C2VdecResourceDecision::ADMIT, 0, false};
+    auto it = mInstances.find(handle);
+    if (it == mInstances.end() || it->second.mPreempted) {
+        return result;
+    }
+    Instance& instance = it->second;
+    // the slot kind is chosen by the component name and does not change.
+    bool secure = instance.mRequest.mSecure;
+    bool exclusive = instance.mRequest.mExclusive;
+    instance.mRequest = request;
+    instance.mRequest.mSecure = secure;
+    instance.mRequest.mExclusive = exclusive;
+    instance.mStarted = false;
+    instance.mDowngrade = false;
+
+    uint64_t needMbps = mbPerSec(request);
+    uint64_t needMemory = memoryBytes(request, false);
+    uint64_t usedMbps = 0, usedMemory = 0;
+    auto refresh = [&](bool withPreempted) {
+        int32_t instances, secures, exclusives, highRes;
+        usageLocked(handle, withPreempted, &instances, &secures, &exclusives, &highRes, &usedMbps, &usedMemory);
+    };
+    auto mbpsFit = [&]() {
+        return mBudget.mMaxMbPerSec == 0 || usedMbps + needMbps <= mBudget.mMaxMbPerSec;
+    };
+    auto memoryFit = [&](uint64_t memory) {
+        return mBudget.mMaxMemoryBytes == 0 || usedMemory + memory <= mBudget.mMaxMemoryBytes;
+    };
+
+    auto fit = [&](bool withPreempted) {
+        refresh(withPreempted);
+        return mbpsFit() && memoryFit(needMemory);
+    };
+    result.mPreemptedCount = preemptLocked(handle, instance.mRequest, fit, &callbacks);
+    //only this component releases its own instance,it stays valid while unlocked.
+    //the preempted instances are on their way out,the start does not wait for them.
+    waitPreemptedLocked(lock, &callbacks, fit, 0);
+    refresh(false);
+
+    if (!instance.mRequest.mForeground && !memoryFit(memoryBytes(request, true))) {
+        //a background instance yields when not even the half size output fits.
+        result.mAction = C2VdecResourceDecision::REJECT;
+        instance.mPreempted = true;
+        ALOGD("instance %d rejected, used mbps:%" PRIu64 " need:%" PRIu64 " used memory:%" PRIu64 " need:%" PRIu64,
+                handle, usedMbps, needMbps, usedMemory, needMemory);
+        return result;
+    }
+    //a background instance over the throughput budget lowers its load by the half size output too.
+    if (!memoryFit(needMemory) || (!instance.mRequest.mForeground && !mbpsFit())) {
+        result.mAction = C2VdecResourceDecision::DOWNGRADE;
+        instance.mDowngrade = true;
+        result.mOverCommitted = !memoryFit(memoryBytes(request, true));
+    }
+    if (!mbpsFit()) {
+        result.mOverCommitted = true;
+    }
+    instance.mStarted = true;
+    ALOGD("instance %d %s%s, mbps:%" PRIu64 "/%" PRIu64 " memory:%" PRIu64 "/%" PRIu64,
+            handle, actionToString(result.mAction), result.mOverCommitted ? " over budget" : "",
+            usedMbps + needMbps, mBudget.mMaxMbPerSec,
+            usedMemory + memoryBytes(request, instance.mDowngrade), mBudget.mMaxMemoryBytes);
+    return result;
+}
+
+void C2VdecResourcePolicy::setPreemptCallback(int32_t handle, PreemptCallback callback) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mInstances.find(handle);
+    if (it != mInstances.end()) {
+        it->second.mCallback = callback;
+    }
+}
+
+void C2VdecResourcePolicy::setHighResolution(int32_t handle, bool highRes) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mInstances.find(handle);
+    if (it != mInstances.end()) {
+        it->second.mHighRes = highRes;
+    }
+}
+
+void C2VdecResourcePolicy::release(int32_t handle) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mInstances.erase(handle) > 0) {
+        mReleaseCond.notify_all();
+    }
+}
+
+int32_t C2VdecResourcePolicy::getInstanceCount(bool secure) {
+    std::lock_guard<std::mutex> lock(mLock);
+    int32_t instances, secures, exclusives, highRes;
+    uint64_t mbps, memory;
+    usageLocked(-1, true, &instances, &secures, &exclusives, &highRes, &mbps, &memory);
+    return secure ? secures : instances;
+}
+
+int32_t C2VdecResourcePolicy::getHighResInstanceCount() {
+    std::lock_guard<std::mutex> lock(mLock);
+    int32_t instances, secures, exclusives, highRes;
+    uint64_t mbps, memory;
+    usageLocked(-1, true, &instances, &secures, &exclusives, &highRes, &mbps, &memory);
+    return highRes;
+}
+
+uint64_t C2VdecResourcePolicy::getUsedMbPerSec() {
+    std::lock_guard<std::mutex> lock(mLock);
+    int32_t instances, secures, exclusives, highRes;
+    uint64_t mbps, memory;
+    usageLocked(-1, true, &instances, &secures, &exclusives, &highRes, &mbps, &memory);
+    return mbps;
+}
+
+uint64_t C2VdecResourcePolicy::getUsedMemoryBytes() {
+    std::lock_guard<std::mutex> lock(mLock);
+    int32_t instances, secures, exclusives, highRes;
+    uint64_t mbps, memory;
+    usageLocked(-1, true, &instances, &secures, &exclusives, &highRes, &mbps, &memory);
+    return memory;
+}
+
+}
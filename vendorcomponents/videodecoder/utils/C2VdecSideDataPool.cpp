@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "C2VdecSideDataPool"
+
+#include <string.h>
+#include <utils/Log.h>
+
+#include <C2VdecSideDataPool.h>
+
+namespace android {
+
+C2VdecSideDataPool::Buffer::Buffer()
+    : mSlot(-1),
+      mData(NULL),
+      mSize(0),
+      mType(0),
+      mValid(false) {
+}
+
+C2VdecSideDataPool::Buffer::Buffer(Buffer&& other)
+    : mSlot(-1),
+      mData(NULL),
+      mSize(0),
+      mType(0),
+      mValid(false) {
+    moveFrom(other);
+}
+
+C2VdecSideDataPool::Buffer& C2VdecSideDataPool::Buffer::operator=(Buffer&& other) {
+    if (this != &other) {
+        reset();
+        moveFrom(other);
+    }
+    return *this;
+}
+
+C2VdecSideDataPool::Buffer::~Buffer() {
+    reset();
+}
+
+void C2VdecSideDataPool::Buffer::moveFrom(Buffer& other) {
+    mPool = std::move(other.mPool);
+    mSlot = other.mSlot;
+    mOverflow = std::move(other.mOverflow);
+    //a moved vector keeps its storage, the data pointer stays valid.
+    mData = other.mData;
+    mSize = other.mSize;
+    mType = other.mType;
+    mValid = other.mValid;
+    other.mPool.reset();
+    other.mSlot = -1;
+    other.mData = NULL;
+    other.mSize = 0;
+    other.mValid = false;
+}
+
+void C2VdecSideDataPool::Buffer::reset() {
+    if (mPool != nullptr && mSlot >= 0) {
+        mPool->release(mSlot);
+    }
+    mPool.reset();
+    mSlot = -1;
+    mOverflow.clear();
+    mData = NULL;
+    mSize = 0;
+    mValid = false;
+}
+
+// static
+std::shared_ptr<C2VdecSideDataPool> C2VdecSideDataPool::create(int32_t slotCount, uint32_t maxSlotSize) {
+    return std::shared_ptr<C2VdecSideDataPool>(new C2VdecSideDataPool(slotCount, maxSlotSize));
+}
+
+C2VdecSideDataPool::C2VdecSideDataPool(int32_t slotCount, uint32_t maxSlotSize)
+    : mSlots(slotCount > 0 ? slotCount : 0),
+      mSlotInUse(slotCount > 0 ? slotCount : 0, false),
+      mMaxSlotSize(maxSlotSize),
+      mOverflowCount(0) {
+}
+
+C2VdecSideDataPool::Buffer C2VdecSideDataPool::acquire(uint32_t type, const uint8_t* data, uint32_t size) {
+    Buffer buffer;
+    buffer.mType = type;
+    buffer.mSize = size;
+    buffer.mValid = true;
+    if (size == 0 || data == NULL) {
+        buffer.mSize = 0;
+        return buffer;
+    }
+
+    if (size <= mMaxSlotSize) {
+        std::lock_guard<std::mutex> lock(mLock);
+        for (size_t i = 0; i < mSlots.size(); i++) {
+            if (mSlotInUse[i]) {
+                continue;
+            }
+            //a slot only grows,the later metadata of a stream has about the same size.
+            if (mSlots[i].size() < size) {
+                mSlots[i].resize(size);
+            }
+            mSlotInUse[i] = true;
+            memcpy(mSlots[i].data(), data, size);
+            buffer.mPool = shared_from_this();
+            buffer.mSlot = i;
+            buffer.mData = mSlots[i].data();
+            return buffer;
+        }
+        mOverflowCount++;
+    }
+    ALOGV("no free slot for %u bytes, copy on heap", size);
+    buffer.mOverflow.assign(data, data + size);
+    buffer.mData = buffer.mOverflow.data();
+    return buffer;
+}
+
+void C2VdecSideDataPool::release(int32_t slot) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (slot >= 0 && slot < (int32_t)mSlotInUse.size()) {
+        mSlotInUse[slot] = false;
+    }
+}
+
+int32_t C2VdecSideDataPool::getFreeSlotCount() {
+    std::lock_guard<std::mutex> lock(mLock);
+    int32_t count = 0;
+    for (size_t i = 0; i < mSlotInUse.size(); i++) {
+        if (!mSlotInUse[i]) {
+            count++;
+        }
+    }
+    return count;
+}
+
+uint32_t C2VdecSideDataPool::getOverflowCount() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mOverflowCount;
+}
+
+}
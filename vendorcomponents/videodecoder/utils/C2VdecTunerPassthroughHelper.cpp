@@ -26,6 +26,7 @@
 
 #include <C2VendorProperty.h>
 #include <C2VdecTunerPassthroughHelper.h>
+#include <C2VdecPropertySnapshot.h>
 #include <C2VendorDebug.h>
 #include <C2VdecInterfaceImpl.h>
 
@@ -67,7 +68,7 @@ C2VdecComponent::TunerPassthroughHelper::TunerPassthroughHelper(bool secure,
         std::shared_ptr<C2VdecComponent::TunnelHelper> tunnelHelper) {
     mTunnelHelper = tunnelHelper;
 
-    propGetInt(CODEC2_VDEC_LOGDEBUG_PROPERTY, &gloglevel);
+    gloglevel = C2VdecPropertySnapshot::getInstance().get()->mLogLevel;
     mTunerPassthroughParams.secure_mode = secure;
     mTunerPassthroughParams.mime = mime;
     mTunerPassthroughParams.tunnel_renderer = tunnelHelper->getTunnelRender();
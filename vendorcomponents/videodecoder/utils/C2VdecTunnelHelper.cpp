@@ -28,6 +28,7 @@
 #include <C2VendorProperty.h>
 #include <C2VendorDebug.h>
 #include <C2VdecTunnelHelper.h>
+#include <C2VdecPropertySnapshot.h>
 #include <C2VdecInterfaceImpl.h>
 #include <C2VdecDebugUtil.h>
 #include <C2VdecDeviceUtil.h>
@@ -37,13 +38,16 @@
 
 namespace android {
 
-C2VdecComponent::TunnelHelper::TunnelHelper(bool secure) : mWeakFactory(this) {
+C2VdecComponent::TunnelHelper::TunnelHelper(bool secure) : mDrainPending(false), mWeakFactory(this) {
     mSecure = secure;
-    mReallocWhenResChange = false;
-    mReallocWhenResChange = property_get_bool(C2_PROPERTY_VDEC_REALLOC_TUNNEL_RESCHANGE, mReallocWhenResChange);
-    propGetInt(CODEC2_VDEC_LOGDEBUG_PROPERTY, &gloglevel);
+    std::shared_ptr<const C2VdecProperties> props = C2VdecPropertySnapshot::getInstance().get();
+    mReallocWhenResChange = props->mReallocTunnelResChange;
+    gloglevel = props->mLogLevel;
+    mReuseWhenResChange = props->mReuseTunnelResChange;
     mPixelFormat = 0;
     mOutBufferCount = 0;
+    mAllocGeneration = 0;
+    mAllocatedUsage = 0;
 
     mSyncId = 0;
     mTunnelId = 0;
@@ -103,6 +107,7 @@ c2_status_t C2VdecComponent::TunnelHelper::start() {
 
 c2_status_t C2VdecComponent::TunnelHelper::stop() {
     mTunnelAbandonMediaTimeQueue.clear();
+    mAllocGeneration++;
 
     for (auto iter = mOutBufferFdMap.begin(); iter != mOutBufferFdMap.end(); iter++) {
         if (iter->first >= 0) {
@@ -118,6 +123,9 @@ c2_status_t C2VdecComponent::TunnelHelper::stop() {
 
         mVideoTunnelRenderer->stop();
         mVideoTunnelRenderer.reset();
+        mFillVideoFrameRing.clear();
+        mRenderTimeRing.clear();
+        mTunnelEventRing.clear();
         mVideoTunnelRenderer = NULL;
         if (mTunnelHandle) {
             am_gralloc_destroy_sideband_handle(mTunnelHandle);
@@ -148,10 +156,17 @@ void C2VdecComponent::TunnelHelper::onFillVideoFrameTunnel2(int dmafd, bool rend
     };
 
     mFillVideoFrameQueue.push_back(frame);
+    processFillVideoFrameQueue();
+}
 
+void C2VdecComponent::TunnelHelper::processFillVideoFrameQueue() {
+    LockWeakPtrWithReturnVoid(comp, mComp);
+    if (mFillVideoFrameQueue.empty()) {
+        return;
+    }
     if (!comp->mCanQueueOutBuffer) {
-        C2VdecTMH_LOG(CODEC2_LOG_DEBUG_LEVEL1, "Cannot queue out buffer, cache it fd:%d, render:%d",
-            dmafd, rendered);
+        C2VdecTMH_LOG(CODEC2_LOG_DEBUG_LEVEL1, "Cannot queue out buffer, cache %zu frames",
+            mFillVideoFrameQueue.size());
         return;
     }
 
@@ -162,10 +177,10 @@ void C2VdecComponent::TunnelHelper::onFillVideoFrameTunnel2(int dmafd, bool rend
             //check fd is new size or old
             LockWeakPtrWithReturnVoid(blockPoolUtil, mBlockPoolUtil);
             blockPoolUtil->getPoolId(&poolId);
-            auto iter = mOutBufferFdMap.find(dmafd);
+            auto iter = mOutBufferFdMap.find(frame.fd);
             DCHECK(iter != mOutBufferFdMap.end());
             if (iter == mOutBufferFdMap.end()) {
-                C2VdecTMH_LOG(CODEC2_LOG_ERR, "[%s:%d] Cannot get fd:%d", __func__, __LINE__, dmafd);
+                C2VdecTMH_LOG(CODEC2_LOG_ERR, "[%s:%d] Cannot get fd:%d", __func__, __LINE__, frame.fd);
                 comp->reportError(C2_CORRUPTED);
                 return;
             }
@@ -199,7 +214,7 @@ void C2VdecComponent::TunnelHelper::onFillVideoFrameTunnel2(int dmafd, bool rend
 
         GraphicBlockInfo* info = comp->getGraphicBlockByFd(frame.fd);
         if (info == NULL) {
-            C2VdecTMH_LOG(CODEC2_LOG_ERR, "[%s:%d] Cannot get graphicblock according fd:%d", __func__, __LINE__, dmafd);
+            C2VdecTMH_LOG(CODEC2_LOG_ERR, "[%s:%d] Cannot get graphicblock according fd:%d", __func__, __LINE__, frame.fd);
             comp->reportError(C2_CORRUPTED);
             return;
         }
@@ -210,9 +225,7 @@ void C2VdecComponent::TunnelHelper::onFillVideoFrameTunnel2(int dmafd, bool rend
 
         /* for drop, need report finished work */
         if (!frame.rendered) {
-            auto pendingBuffer = std::find_if(
-                    comp->mPendingBuffersToWork.begin(), comp->mPendingBuffersToWork.end(),
-                    [id = info->mBlockId](const OutputBufferInfo& o) { return o.mBlockId == id;});
+            auto pendingBuffer = comp->mPendingBuffersToWork.findByBlockId(info->mBlockId);
             if (pendingBuffer != comp->mPendingBuffersToWork.end()) {
                 struct renderTime rendertime = {
                     .mediaUs = (int64_t)pendingBuffer->mMediaTimeUs,
@@ -241,7 +254,11 @@ int C2VdecComponent::TunnelHelper::fillVideoFrameCallback2(void* obj, void* args
     C2VdecComponent::TunnelHelper* pTunnelHelper = (C2VdecComponent::TunnelHelper*)obj;
     struct fillVideoFrame2* pfillVideoFrame = (struct fillVideoFrame2*)args;
 
-    pTunnelHelper->postFillVideoFrameTunnel2(pfillVideoFrame->fd, pfillVideoFrame->rendered);
+    if (pTunnelHelper->mFillVideoFrameRing.push(*pfillVideoFrame)) {
+        pTunnelHelper->postDrainCallbackRecords();
+    } else {
+        pTunnelHelper->postFillVideoFrameTunnel2(pfillVideoFrame->fd, pfillVideoFrame->rendered);
+    }
 
     return 0;
 }
@@ -281,19 +298,29 @@ int C2VdecComponent::TunnelHelper::postNotifyRenderTimeTunnel(struct renderTime*
 int C2VdecComponent::TunnelHelper::notifyTunnelRenderTimeCallback(void* obj, void* args) {
     C2VdecComponent::TunnelHelper* pTunnelHelper = (C2VdecComponent::TunnelHelper*)obj;
     struct renderTime* rendertime = (struct renderTime*)args;
-    pTunnelHelper->postNotifyRenderTimeTunnel(rendertime);
+    if (pTunnelHelper->mRenderTimeRing.push(*rendertime)) {
+        pTunnelHelper->postDrainCallbackRecords();
+    } else {
+        pTunnelHelper->postNotifyRenderTimeTunnel(rendertime);
+    }
     return 0;
 }
 
 void C2VdecComponent::TunnelHelper::onNotifyTunnelEvent(struct tunnelEventParam param) {
+    handleTunnelEvent(param.type, param.data, param.paramSize);
+    free(param.data);
+}
+
+void C2VdecComponent::TunnelHelper::handleTunnelEvent(int32_t type, void* data, uint32_t size) {
     LockWeakPtrWithReturnVoid(comp, mComp);
     LockWeakPtrWithReturnVoid(deviceUtil, mDeviceUtil);
-    switch (param.type) {
+    switch (type) {
         case android::VideoTunnelRendererWraper::CB_EVENT_UNDERFLOW: {
-            uint32_t* data = (uint32_t*)param.data;
-            comp->mTunnelUnderflow = data[0];
-            free(data);
-            data = NULL;
+            if (data == NULL || size < sizeof(uint32_t)) {
+                C2VdecTMH_LOG(CODEC2_LOG_ERR, "tunnel underflow event with bad param size:%u", size);
+                break;
+            }
+            comp->mTunnelUnderflow = ((uint32_t*)data)[0];
             CODEC2_LOG(CODEC2_LOG_DEBUG_LEVEL1, "tunnel underflow %d!", comp->mTunnelUnderflow);
             deviceUtil->checkConfigInfoFromDecoderAndReconfig(TUNNEL_UNDERFLOW);
             break;
@@ -338,10 +365,80 @@ int C2VdecComponent::TunnelHelper::notifyTunnelEventCallback(void* obj, void* ar
     }
     C2VdecComponent::TunnelHelper* pTunnelHelper = (C2VdecComponent::TunnelHelper*)obj;
     struct tunnelEventParam* eventParam = (struct tunnelEventParam*)args;
+    if ((uint32_t)eventParam->paramSize <= kTunnelEventInlineSize &&
+        (eventParam->data != NULL || eventParam->paramSize == 0)) {
+        TunnelEventRecord record;
+        record.type = eventParam->type;
+        record.paramSize = eventParam->paramSize;
+        if (record.paramSize > 0) {
+            memcpy(record.data, eventParam->data, record.paramSize);
+        }
+        if (pTunnelHelper->mTunnelEventRing.push(record)) {
+            pTunnelHelper->postDrainCallbackRecords();
+            return 0;
+        }
+    }
+    //large payload or ring full,fall back to a task of its own
     pTunnelHelper->postNotifyTunnelEvent(eventParam);
     return 0;
 }
 
+void C2VdecComponent::TunnelHelper::postDrainCallbackRecords() {
+    //a queued drain task picks up this record too
+    if (mDrainPending.exchange(true)) {
+        return;
+    }
+    std::shared_ptr<C2VdecComponent> comp = mComp.lock();
+    if (comp == nullptr) {
+        mDrainPending.store(false);
+        return;
+    }
+    scoped_refptr<::base::SingleThreadTaskRunner> taskRunner = comp->GetTaskRunner();
+    if (taskRunner == nullptr) {
+        mDrainPending.store(false);
+        return;
+    }
+    taskRunner->PostTask(FROM_HERE,
+        ::base::Bind(&C2VdecComponent::TunnelHelper::onDrainCallbackRecords, mWeakFactory.GetWeakPtr()));
+}
+
+void C2VdecComponent::TunnelHelper::onDrainCallbackRecords() {
+    //clear the flag before draining,a record pushed from now on posts a new task
+    mDrainPending.store(false);
+    LockWeakPtrWithReturnVoid(comp, mComp);
+    scoped_refptr<::base::SingleThreadTaskRunner> taskRunner = comp->GetTaskRunner();
+    if (taskRunner == nullptr) {
+        return;
+    }
+    DCHECK(taskRunner->BelongsToCurrentThread());
+
+    //render times first,a dropped frame is reported from its fill record
+    struct renderTime rendertime;
+    int renderCount = 0;
+    while (mRenderTimeRing.pop(&rendertime)) {
+        CODEC2_LOG(CODEC2_LOG_DEBUG_LEVEL2, "[%s:%d] Rendertime:%" PRId64 "", __func__, __LINE__, rendertime.mediaUs);
+        sendOutputBufferToWorkTunnel(&rendertime);
+        renderCount++;
+    }
+
+    struct fillVideoFrame2 frame;
+    int fillCount = 0;
+    while (mFillVideoFrameRing.pop(&frame)) {
+        C2VdecTMH_LOG(CODEC2_LOG_DEBUG_LEVEL1, "[%s:%d] Fd:%d, render:%d", __func__, __LINE__, frame.fd, frame.rendered);
+        mFillVideoFrameQueue.push_back(frame);
+        fillCount++;
+    }
+    if (fillCount > 0) {
+        processFillVideoFrameQueue();
+    }
+
+    TunnelEventRecord record;
+    while (mTunnelEventRing.pop(&record)) {
+        handleTunnelEvent(record.type, record.paramSize > 0 ? record.data : NULL, record.paramSize);
+    }
+    C2VdecTMH_LOG(CODEC2_LOG_DEBUG_LEVEL2, "[%s:%d] drained render:%d fill:%d", __func__, __LINE__, renderCount, fillCount);
+}
+
 c2_status_t C2VdecComponent::TunnelHelper::sendVideoFrameToVideoTunnel(int32_t pictureBufferId, int64_t bitstreamId, uint64_t timestamp) {
     LockWeakPtrWithReturnVal(comp, mComp, C2_BAD_VALUE);
     LockWeakPtrWithReturnVal(intfImpl, mIntfImpl, C2_BAD_VALUE);
@@ -429,16 +526,17 @@ c2_status_t C2VdecComponent::TunnelHelper::sendOutputBufferToWorkTunnel(struct r
     }
 
     auto pendingBuffer = comp->findPendingBuffersToWorkByTime(rendertime->mediaUs);
-    int32_t renderBitstreamId = pendingBuffer->mBitstreamId;
-    C2Work* work = comp->getPendingWorkByBitstreamId(renderBitstreamId);
+    C2Work* work = NULL;
+    if (pendingBuffer != comp->mPendingBuffersToWork.end()) {
+        work = comp->getPendingWorkByBitstreamId(pendingBuffer->mBitstreamId);
+    }
     if (work == NULL) {
-        for (auto it = mTunnelAbandonMediaTimeQueue.begin(); it != mTunnelAbandonMediaTimeQueue.end(); it++) {
-            if (rendertime->mediaUs == *it) {
-                mTunnelAbandonMediaTimeQueue.erase(it);
-                CODEC2_LOG(CODEC2_LOG_DEBUG_LEVEL2, "Not find the correct work with mediaTime:%" PRId64", correct work have abandoned and report to framework", rendertime->mediaUs);
-                comp->erasePendingBuffersToWorkByTime(rendertime->mediaUs);
-                return C2_OK;
-            }
+        auto abandoned = mTunnelAbandonMediaTimeQueue.find(rendertime->mediaUs);
+        if (abandoned != mTunnelAbandonMediaTimeQueue.end()) {
+            mTunnelAbandonMediaTimeQueue.erase(abandoned);
+            CODEC2_LOG(CODEC2_LOG_DEBUG_LEVEL2, "Not find the correct work with mediaTime:%" PRId64", correct work have abandoned and report to framework", rendertime->mediaUs);
+            comp->erasePendingBuffersToWorkByTime(rendertime->mediaUs);
+            return C2_OK;
         }
         CODEC2_LOG(CODEC2_LOG_DEBUG_LEVEL2, "not found corresponded work with mediaTime:%lld", (long long)rendertime->mediaUs);
         comp->erasePendingBuffersToWorkByTime(rendertime->mediaUs);
@@ -470,7 +568,7 @@ c2_status_t C2VdecComponent::TunnelHelper::sendOutputBufferToWorkTunnel(struct r
 
 
 c2_status_t C2VdecComponent::TunnelHelper::storeAbandonedFrame(int64_t timeus) {
-    mTunnelAbandonMediaTimeQueue.push_back(timeus);
+    mTunnelAbandonMediaTimeQueue.insert(timeus);
     return C2_OK;
 }
 
@@ -489,7 +587,7 @@ c2_status_t C2VdecComponent::TunnelHelper::allocTunnelBuffersAndSendToDecoder(co
         comp->mCanQueueOutBuffer = true;
     }
 
-    allocTunnelBufferAndSendToDecoder(size, pixelFormat, 0);
+    allocTunnelBufferAndSendToDecoder(size, pixelFormat, 0, ++mAllocGeneration);
     return C2_OK;
 }
 
@@ -507,6 +605,7 @@ c2_status_t C2VdecComponent::TunnelHelper::allocTunnelBuffer(const media::Size&
     C2MemoryUsage usage = {
             mSecure ? (C2MemoryUsage::READ_PROTECTED | C2MemoryUsage::WRITE_PROTECTED) :
             (C2MemoryUsage::CPU_READ | C2MemoryUsage::CPU_WRITE),  platformUsage};
+    mAllocatedUsage = platformUsage;
 
     C2BlockPool::local_id_t poolId = -1;
     uint32_t blockId = -1;
@@ -542,7 +641,7 @@ c2_status_t C2VdecComponent::TunnelHelper::allocTunnelBuffer(const media::Size&
     return C2_OK;
 }
 
-void C2VdecComponent::TunnelHelper::allocTunnelBufferAndSendToDecoder(const media::Size& size, uint32_t pixelFormat, int index) {
+void C2VdecComponent::TunnelHelper::allocTunnelBufferAndSendToDecoder(const media::Size& size, uint32_t pixelFormat, int index, uint32_t generation) {
     LockWeakPtrWithReturnVoid(comp, mComp);
     LockWeakPtrWithReturnVoid(intfImpl, mIntfImpl);
     scoped_refptr<::base::SingleThreadTaskRunner> taskRunner = comp->GetTaskRunner();
@@ -551,7 +650,12 @@ void C2VdecComponent::TunnelHelper::allocTunnelBufferAndSendToDecoder(const medi
     }
 
     C2VdecTMH_LOG(CODEC2_LOG_DEBUG_LEVEL2, "%s#%d create buffer#%d", __func__, __LINE__, index);
-    if (index >= mOutBufferCount) {
+    if (generation != mAllocGeneration) {
+        C2VdecTMH_LOG(CODEC2_LOG_DEBUG_LEVEL1, "%s#%d buffer set changed, stop at buffer#%d", __func__, __LINE__, index);
+        return;
+    }
+    //buffers returned by the renderer are replaced in fill callback,they count as well
+    if (index >= mOutBufferCount || comp->mGraphicBlocks.size() >= mOutBufferCount) {
         return;
     }
 
@@ -567,11 +671,26 @@ void C2VdecComponent::TunnelHelper::allocTunnelBufferAndSendToDecoder(const medi
     comp->sendOutputBufferToAccelerator(info, true);
     taskRunner->PostTask(FROM_HERE,
         ::base::Bind(&C2VdecComponent::TunnelHelper::allocTunnelBufferAndSendToDecoder, mWeakFactory.GetWeakPtr(),
-        size, pixelFormat, index+1));
+        size, pixelFormat, index+1, generation));
 
     return;
 }
 
+bool C2VdecComponent::TunnelHelper::canReuseTunnelBuffers(const media::Size& size, uint64_t platformUsage) {
+    LockWeakPtrWithReturnVal(comp, mComp, false);
+    if (!mReuseWhenResChange || comp->mGraphicBlocks.empty() || platformUsage != mAllocatedUsage) {
+        return false;
+    }
+    for (auto& info : comp->mGraphicBlocks) {
+        if (info.mGraphicBlock == nullptr ||
+            info.mGraphicBlock->width() < (uint32_t)size.width() ||
+            info.mGraphicBlock->height() < (uint32_t)size.height()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 c2_status_t C2VdecComponent::TunnelHelper::videoResolutionChangeTunnel() {
     bool sizeChanged = false;
     bool bufferNumEnlarged = false;
@@ -594,12 +713,16 @@ c2_status_t C2VdecComponent::TunnelHelper::videoResolutionChangeTunnel() {
     }
 
     C2VdecTMH_LOG(CODEC2_LOG_INFO, "[%s:%d] in resolution changing:%d", __func__, __LINE__, isInResolutionChanging());
+    uint32_t allocStart = mOutBufferCount;
     if (checkReallocOutputBuffer(comp->mLastOutputFormat, comp->mOutputFormat, &sizeChanged, &bufferNumEnlarged)) {
         deviceUtil->releaseGrallocSlot();
-        if (mReallocWhenResChange && sizeChanged) {
+        bool reuse = mReallocWhenResChange && sizeChanged && canReuseTunnelBuffers(size, platformUsage);
+        if (reuse) {
+            C2VdecTMH_LOG(CODEC2_LOG_INFO, "[%s:%d] current buffers fit %dx%d, keep them", __func__, __LINE__, size.width(), size.height());
+        }
+        if (mReallocWhenResChange && sizeChanged && !reuse) {
             //all realloc buffer
             int alloc_first = 0;
-            int fd = -1;
             for (auto& info : comp->mGraphicBlocks) {
                 if (info.mState != GraphicBlockInfo::State::OWNER_BY_TUNNELRENDER) {
                     GraphicBlockInfo* info1 = &info;
@@ -629,31 +752,15 @@ c2_status_t C2VdecComponent::TunnelHelper::videoResolutionChangeTunnel() {
             }
             blockPoolUtil->requestNewBufferSet(mOutBufferCount);
             bufferNumSet = true;
-            for (int i = 0; i < alloc_first; i++) {
-                allocTunnelBuffer(size, mPixelFormat, &fd);
-                GraphicBlockInfo* info = comp->getGraphicBlockByFd(fd);
-                if (info != NULL) {
-                    GraphicBlockStateInit(comp, info, GraphicBlockInfo::State::OWNED_BY_COMPONENT);
-                    BufferStatus(comp, CODEC2_LOG_TAG_BUFFER, "tunnel new allocate fd=%d, index=%d", info->mFd, info->mBlockId);
-                }
-            }
+            //the buffers still in renderer are replaced when they come back
+            allocStart = mOutBufferCount - alloc_first;
         } else if (bufferNumEnlarged) {
             //add new allocate buffer
             for (auto& info : comp->mGraphicBlocks) {
                 info.mFdHaveSet = false;
             }
-            int32_t lastBufferCount = comp->mLastOutputFormat.mMinNumBuffers;
+            allocStart = comp->mGraphicBlocks.size();
             mOutBufferCount = comp->mOutputFormat.mMinNumBuffers;
-
-            int fd = -1;
-            for (int i = lastBufferCount; i < mOutBufferCount; i++) {
-                allocTunnelBuffer(size, mPixelFormat, &fd);
-                GraphicBlockInfo* info = comp->getGraphicBlockByFd(fd);
-                if (info != NULL) {
-                    GraphicBlockStateInit(comp, info, GraphicBlockInfo::State::OWNED_BY_COMPONENT);
-                    BufferStatus(comp, CODEC2_LOG_TAG_BUFFER, "tunnel new allocate fd=%d, index=%d", info->mFd, info->mBlockId);
-                }
-            }
         }
     }
 
@@ -671,6 +778,9 @@ c2_status_t C2VdecComponent::TunnelHelper::videoResolutionChangeTunnel() {
         }
     }
 
+    //new buffers go to the decoder one by one from later tasks,decoding restarts with the first one
+    allocTunnelBufferAndSendToDecoder(size, mPixelFormat, allocStart, ++mAllocGeneration);
+
     return C2_OK;
 }
 
@@ -774,7 +884,10 @@ c2_status_t C2VdecComponent::TunnelHelper::fastHandleOutBufferTunnel(uint64_t ti
 
     C2Work* work = NULL;
     auto pendingBuffer = comp->findPendingBuffersToWorkByTime(timestamp);
-    auto workIter = comp->findPendingWorkByBitstreamId(pendingBuffer->mBitstreamId);
+    auto workIter = comp->mPendingWorks.end();
+    if (pendingBuffer != comp->mPendingBuffersToWork.end()) {
+        workIter = comp->findPendingWorkByBitstreamId(pendingBuffer->mBitstreamId);
+    }
     if (workIter != comp->mPendingWorks.end()) {
         work = workIter->get();
     }
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _C2_VDEC_ALLOC_PROFILE_H_
+#define _C2_VDEC_ALLOC_PROFILE_H_
+
+#include <stdint.h>
+
+namespace android {
+
+// What the output buffer allocation of a stream depends on.
+struct C2VdecAllocProfileKey {
+    int32_t mCodec;
+    // the picture size for the write modes, the buffer size for the usage.
+    uint32_t mWidth;
+    uint32_t mHeight;
+    int32_t mBitDepth;
+    bool mSecure;
+    bool mTunnel;
+    // the other device states, one bit each.
+    uint32_t mStateFlags;
+
+    bool operator==(const C2VdecAllocProfileKey& other) const {
+        return mCodec == other.mCodec && mWidth == other.mWidth && mHeight == other.mHeight
+                && mBitDepth == other.mBitDepth && mSecure == other.mSecure
+                && mTunnel == other.mTunnel && mStateFlags == other.mStateFlags;
+    }
+};
+
+struct C2VdecAllocProfile {
+    enum {
+        DOUBLE_WRITE = 1 << 0,
+        TRIPLE_WRITE = 1 << 1,
+        USAGE        = 1 << 2,
+    };
+    // the fields computed so far.
+    uint32_t mValidMask;
+    int32_t mDoubleWrite;
+    int32_t mTripleWrite;
+    uint64_t mUsage;
+};
+
+/**
+ * Allocation profiles of the last few stream formats.
+ *
+ * The write modes and the platform usage are derived from properties, the
+ * codec and the stream, they do not change between two buffers of the same
+ * set. Each field is computed at its first use and kept until the key
+ * changes, the property snapshot is reloaded or the owner invalidates the cache
+ * on a config change. Not thread safe, the owner serializes the calls.
+ */
+class C2VdecAllocProfileCache {
+public:
+    C2VdecAllocProfileCache();
+
+    // drops everything when |serial| (the property generation) differs from the last one seen.
+    void checkSerial(uint32_t serial);
+    bool lookup(const C2VdecAllocProfileKey& key, uint32_t field, C2VdecAllocProfile* profile);
+    void store(const C2VdecAllocProfileKey& key, uint32_t field, const C2VdecAllocProfile& profile);
+    void invalidate();
+
+    uint32_t getHitCount() const { return mHitCount; }
+    uint32_t getMissCount() const { return mMissCount; }
+
+private:
+    static const int32_t kMaxEntries = 4;
+
+    struct Entry {
+        bool mUsed;
+        uint32_t mLastUse;
+        C2VdecAllocProfileKey mKey;
+        C2VdecAllocProfile mProfile;
+    };
+
+    Entry* findEntry(const C2VdecAllocProfileKey& key);
+
+    Entry mEntries[kMaxEntries];
+    uint32_t mSerial;
+    bool mSerialValid;
+    uint32_t mUseClock;
+    uint32_t mHitCount;
+    uint32_t mMissCount;
+};
+
+}
+
+#endif
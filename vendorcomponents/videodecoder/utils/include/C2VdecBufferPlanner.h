@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _C2_VDEC_BUFFER_PLANNER_H_
+#define _C2_VDEC_BUFFER_PLANNER_H_
+
+#include <stdint.h>
+
+namespace android {
+
+// One output buffer set, sizes are the aligned allocation sizes.
+struct C2VdecBufferSetSpec {
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mBufferCount;
+    uint64_t mUsage;
+};
+
+struct C2VdecBufferPlanParams {
+    C2VdecBufferSetSpec mOld;
+    C2VdecBufferSetSpec mNew;
+    // bufferpool output without surface, the pool is sized by the buffer count.
+    bool mNoSurface;
+    // the decoder can write a smaller picture into a larger buffer.
+    bool mCanDecodeIntoLarger;
+};
+
+struct C2VdecBufferPlan {
+    enum Action {
+        // keep the current set as it is.
+        KEEP,
+        // keep the current set and add mAddCount buffers.
+        GROW,
+        // drop the current set and allocate a new one.
+        REALLOC,
+    };
+    Action mAction;
+    bool mSizeChanged;
+    bool mBufferNumIncreased;
+    uint32_t mKeepCount;
+    uint32_t mAddCount;
+    uint32_t mReplaceCount;
+};
+
+/**
+ * Decides what to do with the output buffer set when the decoder reports a
+ * new format in non tunnel mode.
+ *
+ * Pure function of the old and new set and the platform constraints, no
+ * buffer is touched here. The component carries the plan out, new buffers
+ * are then fetched by the dequeue thread while output goes on.
+ */
+class C2VdecBufferPlanner {
+public:
+    static C2VdecBufferPlan plan(const C2VdecBufferPlanParams& params);
+    static const char* actionToString(C2VdecBufferPlan::Action action);
+};
+
+}
+
+#endif
@@ -185,6 +185,8 @@ public:
                         int64_t timestamp=kInvalidTimestamp, int64_t bitstreamId=-1, int64_t pictureBufferId=-1);
     void dump();
     void debug(std::list<std::string> cmds);
+    // maps the input, only called when the input dump is enabled.
+    void dumpInputBuffer(const C2ConstLinearBlock& input, int32_t bitstreamId);
 
 private:
     std::weak_ptr<C2VdecComponent> mComp;
@@ -206,6 +208,7 @@ private:
 
     std::shared_ptr<AmlDiagnosticStatsQty> mInputQtyStats;
     std::shared_ptr<AmlDiagnosticStatsQty> mOutputQtyStats;
+    FILE* mInputDumpFp;
 };
 
 struct AmlDiagnosticStatsQty {
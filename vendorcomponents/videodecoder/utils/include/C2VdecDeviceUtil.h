@@ -30,6 +30,8 @@
 #include <cutils/native_handle.h>
 #include <C2VdecComponent.h>
 #include <VideoDecWraper.h>
+#include <C2VdecBufferPlanner.h>
+#include <C2VdecAllocProfile.h>
 
 namespace android {
 
@@ -110,6 +112,8 @@ public:
     bool needAllocWithMaxSize();
     bool isReallocateOutputBuffer(VideoFormat rawFormat,VideoFormat currentFormat,
                                  bool *sizechange, bool *buffernumincrease);
+    C2VdecBufferPlan planOutputBufferSet(VideoFormat rawFormat, VideoFormat currentFormat);
+    void setPredictedStreamInfo(const C2VdecStreamHeaderInfo& info);
     bool getMaxBufWidthAndHeight(uint32_t &width, uint32_t &height);
     bool getUvmMetaData(int fd,unsigned char *data,int *size);
     void parseAndProcessMetaData(unsigned char *data, int size, C2Work& work);
@@ -118,6 +122,8 @@ public:
     void setHDRStaticColorAspects(std::shared_ptr<C2StreamColorAspectsInfo::output> coloraspect);
     int32_t getDoubleWriteModeValue();
     int32_t getTripleWriteModeValue();
+    // drop the cached allocation profiles after a config or a size change.
+    void invalidateAllocProfile();
 
     // bit depth
     void queryStreamBitDepth();
@@ -138,6 +144,7 @@ public:
     uint32_t checkUseP010Mode(); /* 10bit */
 
     void setGameMode(bool enable);
+    void setResourceDowngrade(bool downgrade);
     bool isLowLatencyMode();
 
     void releaseGrallocSlot();
@@ -160,6 +167,14 @@ private:
     int32_t getPropertyTripleWrite();
 
     int32_t getPropertyDoubleWrite();
+    int32_t computeDoubleWriteModeValue();
+    int32_t computeTripleWriteModeValue();
+    bool getAllocProfileKey(const media::Size& size, C2VdecAllocProfileKey* key);
+    // the picture size of the interface, 0x0 when unknown. The mmu decision
+    // and so the write modes depend on it.
+    media::Size getPictureSize();
+    bool lookupAllocProfile(const C2VdecAllocProfileKey& key, uint32_t field, C2VdecAllocProfile* profile);
+    void storeAllocProfile(const C2VdecAllocProfileKey& key, uint32_t field, const C2VdecAllocProfile& profile);
     bool checkDvProfileAndLayer();
     bool isYcrcb420Stream() const; /* 8bit */
 
@@ -193,6 +208,7 @@ private:
     bool mForceDIPermission;
     bool mEnableDILocalBuf;
     bool mStreamIs8k;
+    bool mResourceDowngrade;
     bool mCodecSupport8k;
     bool mEnable8kNR;
     bool mDisableErrPolicy;
@@ -219,6 +235,8 @@ private:
 
     int32_t mMarginBufferNum;
     int32_t mStreamBitDepth;
+    // stream format read from the first input before the decoder reports it.
+    C2VdecStreamHeaderInfo mPredictedStreamInfo;
     int32_t mDecoderWidthAlign;
     uint32_t mBufferWidth;
     uint32_t mBufferHeight;
@@ -235,6 +253,10 @@ private:
 
     /* for gralloc wraper */
     std::unique_ptr<GrallocWraper> mGrallocWraper;
+
+    // write modes and usage per stream format, the dequeue thread reads them too.
+    C2VdecAllocProfileCache mAllocProfileCache;
+    std::mutex mAllocProfileLock;
 };
 
 }
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _C2_VDEC_HEADER_SNIFFER_H_
+#define _C2_VDEC_HEADER_SNIFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace android {
+
+// Stream parameters predicted from the sequence header.
+struct C2VdecStreamHeaderInfo {
+    bool mValid;
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mBitDepth;
+    uint32_t mDpbSize;
+    bool mInterlaced;
+};
+
+/**
+ * Lightweight parser of the sequence header of the first input, it reads
+ * the coded size, bit depth and dpb size before the decoder reports them.
+ *
+ * H.264 and HEVC take the sps from annex b or from an avcC/hvcC record,
+ * VP9 reads the uncompressed header of a key frame and AV1 the sequence
+ * header obu, with or without an av1C record. Only the fields up to the
+ * ones needed are parsed, anything unexpected gives up.
+ */
+class C2VdecHeaderSniffer {
+public:
+    enum Codec {
+        CODEC_H264,
+        CODEC_H265,
+        CODEC_VP9,
+        CODEC_AV1,
+        CODEC_UNKNOWN,
+    };
+
+    static bool sniff(Codec codec, const uint8_t* data, size_t size, C2VdecStreamHeaderInfo* info);
+
+private:
+    static bool sniffH264(const uint8_t* data, size_t size, C2VdecStreamHeaderInfo* info);
+    static bool sniffH265(const uint8_t* data, size_t size, C2VdecStreamHeaderInfo* info);
+    static bool sniffVP9(const uint8_t* data, size_t size, C2VdecStreamHeaderInfo* info);
+    static bool sniffAV1(const uint8_t* data, size_t size, C2VdecStreamHeaderInfo* info);
+
+    static bool parseH264Sps(const uint8_t* nal, size_t size, C2VdecStreamHeaderInfo* info);
+    static bool parseH265Sps(const uint8_t* nal, size_t size, C2VdecStreamHeaderInfo* info);
+    static bool parseAV1SequenceHeader(const uint8_t* obu, size_t size, C2VdecStreamHeaderInfo* info);
+
+    // nal payload without emulation prevention bytes.
+    static void unescapeNal(const uint8_t* nal, size_t size, std::vector<uint8_t>* rbsp);
+};
+
+}
+
+#endif
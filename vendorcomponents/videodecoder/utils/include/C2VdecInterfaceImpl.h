@@ -186,6 +186,7 @@ private:
 
     std::shared_ptr<C2SecureModeTuning> mSecureBufferMode;
     std::shared_ptr<C2GlobalLowLatencyModeTuning> mLowLatencyMode;
+    std::shared_ptr<C2RealTimePriorityTuning> mRealTimePriority;
     std::shared_ptr<C2Avc4kMMU::input> mAvc4kMMUMode;
     std::shared_ptr<C2VendorGameModeLatency::input> mVendorGameModeLatency;
     std::shared_ptr<C2StreamPixelFormatInfo::output> mPixelFormatInfo;
@@ -233,6 +234,7 @@ private:
     void onBufferPoolDeclareParam();
     void onColorAspectsDeclareParam();
     void onLowLatencyDeclareParam();
+    void onPriorityDeclareParam();
     void onPixelFormatDeclareParam();
     void onVendorExtendParam();
     void onAvc4kMMUEnable();
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _C2_VDEC_OUTPUT_LEDGER_H_
+#define _C2_VDEC_OUTPUT_LEDGER_H_
+
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <unordered_map>
+
+namespace android {
+
+// Information of an output buffer returned from the accelerator and not yet
+// attached to its work.
+struct C2VdecOutputBufferInfo {
+    int32_t mBitstreamId;
+    int32_t mBlockId;
+    uint64_t mMediaTimeUs;
+    int32_t flags;
+    bool    mSetOutInfo;
+};
+
+/**
+ * Pending output buffers, kept in decode order and indexed by media time,
+ * bitstream id and block id.
+ *
+ * Non tunnel mode consumes the buffers in order from the front, tunnel mode
+ * retires them by media time from the renderer callbacks. Duplicate media
+ * times are legal (unstable pts from the stream), a lookup by time always
+ * returns the oldest buffer with that time, which is what the renderer
+ * reports first.
+ */
+class C2VdecOutputLedger {
+public:
+    typedef std::list<C2VdecOutputBufferInfo>::iterator iterator;
+
+    C2VdecOutputLedger();
+    ~C2VdecOutputLedger();
+
+    bool empty() const { return mBuffers.empty(); }
+    size_t size() const { return mBuffers.size(); }
+    iterator begin() { return mBuffers.begin(); }
+    iterator end() { return mBuffers.end(); }
+    C2VdecOutputBufferInfo& front() { return mBuffers.front(); }
+
+    void push_back(const C2VdecOutputBufferInfo& info);
+    void pop_front();
+    iterator erase(iterator it);
+    void clear();
+
+    iterator findByTime(uint64_t timeUs);
+    iterator findByBlockId(int32_t blockId);
+    iterator findByBitstreamId(int32_t bitstreamId);
+    bool containsBlockId(int32_t blockId) const { return mByBlockId.count(blockId) > 0; }
+    bool eraseByTime(uint64_t timeUs);
+
+    uint32_t getDuplicateTimeCount() const { return mDuplicateTimeCount; }
+
+private:
+    typedef std::unordered_multimap<int32_t, iterator> IdIndex;
+
+    void eraseFromIdIndex(IdIndex& index, int32_t id, iterator it);
+
+    std::list<C2VdecOutputBufferInfo> mBuffers;
+    // same media time keeps insertion order inside a multimap.
+    std::multimap<uint64_t, iterator> mByTime;
+    IdIndex mByBlockId;
+    IdIndex mByBitstreamId;
+    uint32_t mDuplicateTimeCount;
+};
+
+}
+
+#endif
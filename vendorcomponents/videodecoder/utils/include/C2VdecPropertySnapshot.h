@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _C2_VDEC_PROPERTY_SNAPSHOT_H_
+#define _C2_VDEC_PROPERTY_SNAPSHOT_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace android {
+
+// The runtime properties of the video decoder, the ones only read when the
+// interface is declared are not here.
+struct C2VdecProperties {
+    uint32_t mLogLevel;
+
+    // output buffers
+    int32_t mDoubleWrite;
+    int32_t mTripleWrite;
+    int32_t mFixedBufferSlice;
+    bool mAmdvUse540p;
+    bool mAmdvUseP010;
+    bool mOutBufRealloc;
+    int32_t mOutAddDelay;
+    int32_t mLlvFirstAllocNum;
+    int32_t mMargin;
+    bool mReallocTunnelResChange;
+    bool mReuseTunnelResChange;
+
+    // scheduling
+    bool mDisableRC;
+    int32_t mDebugPriority;
+
+    // post processing
+    bool mDiPost;
+    bool mEnableNR;
+    bool mEnable8kNR;
+    bool mEnableDILocalBuf;
+    bool mForceDIPermission;
+    int32_t mDisableVppThreshold;
+    bool mBypassVpp;
+
+    // platform
+    // software 10bit output, decoder or platform property.
+    bool mSupport10Bit;
+    bool mHwSupportP010;
+    bool mSwSupportP010;
+    bool mSupport8kBufMode;
+    bool mEnableAvc4kMMU;
+    int32_t mAvcMMUWidth;
+    int32_t mAvcMMUHeight;
+
+    // misc
+    bool mHdrLittleEndian;
+    bool mDisableErrPolicy;
+    int32_t mRetryBlockTimeoutMs;
+    int32_t mSkipErrFrameTimeout;
+    bool mFdInfoDebug;
+    bool mDumpInput;
+};
+
+/**
+ * Snapshot of the decoder properties shared by all the instances.
+ *
+ * The properties are loaded once into a C2VdecProperties and only read
+ * again on refresh(), which a new component calls through
+ * refreshIfChanged() and the debug server calls on request. Readers get
+ * the current immutable snapshot and never wait on a refresh. The backend
+ * can be replaced to run without the android property service.
+ */
+class C2VdecPropertySnapshot {
+public:
+    struct Backend {
+        int32_t (*getInt32)(const char* key, int32_t defaultValue);
+        bool (*getBool)(const char* key, bool defaultValue);
+        // moves when any property is set, always 0 if not supported.
+        uint32_t (*getSerial)();
+    };
+
+    static C2VdecPropertySnapshot& getInstance();
+    static Backend getSystemBackend();
+
+    explicit C2VdecPropertySnapshot(const Backend& backend);
+
+    std::shared_ptr<const C2VdecProperties> get() const;
+    // bumped by every refresh, for the caches derived from the snapshot.
+    uint32_t getGeneration() const;
+
+    void refresh();
+    // reload only when the backend serial moved since the last load.
+    bool refreshIfChanged();
+    void setBackend(const Backend& backend);
+
+private:
+    void loadLocked();
+
+    Backend mBackend;
+    std::mutex mRefreshLock;
+    std::shared_ptr<const C2VdecProperties> mCurrent;
+    uint32_t mSerial;
+    std::atomic<uint32_t> mGeneration;
+};
+
+}
+
+#endif
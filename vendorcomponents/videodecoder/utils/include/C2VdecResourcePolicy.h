@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _C2_VDEC_RESOURCE_POLICY_H_
+#define _C2_VDEC_RESOURCE_POLICY_H_
+
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace android {
+
+// Decoder capacity shared by all the instances of the process, a negative
+// count or a zero budget means no limit.
+struct C2VdecResourceBudget {
+    int32_t mMaxInstances;
+    int32_t mMaxSecureInstances;
+    int32_t mMaxHighResInstances;
+    // decoding throughput in 16x16 macroblocks per second.
+    uint64_t mMaxMbPerSec;
+    // estimated memory of the output buffers.
+    uint64_t mMaxMemoryBytes;
+};
+
+// What an instance asks for, the stream part is only known at start.
+struct C2VdecResourceRequest {
+    bool mSecure;
+    // vc1 runs the decoder in single mode, it can not share it.
+    bool mExclusive;
+    // 0 is realtime, larger values yield to smaller ones.
+    int32_t mPriority;
+    bool mForeground;
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mFrameRate;
+    uint32_t mBufferCount;
+};
+
+struct C2VdecResourceDecision {
+    enum Action {
+        ADMIT,
+        // admitted with an output of half width and half height.
+        DOWNGRADE,
+        REJECT,
+    };
+    Action mAction;
+    // instances asked to give their resource back to admit this one.
+    int32_t mPreemptedCount;
+    // admitted over the throughput budget, the decoding may not be realtime.
+    bool mOverCommitted;
+};
+
+/**
+ * Admission and accounting of the hardware decoder instances.
+ *
+ * An instance takes a slot when it is created, only the instance count
+ * limits apply then. At start it reports its stream and is charged on the
+ * throughput and memory budgets. Instead of failing the policy first
+ * preempts lower priority background instances, then asks for a downscaled
+ * output when only memory is short, and at last lets a foreground instance
+ * run over the throughput budget. A preempted instance keeps its share
+ * until it is released, the instance it was preempted for waits a bounded
+ * time for that. The preempt callbacks are called without the policy lock.
+ */
+class C2VdecResourcePolicy {
+public:
+    typedef std::function<void()> PreemptCallback;
+
+    static C2VdecResourcePolicy& getInstance();
+
+    C2VdecResourcePolicy();
+
+    void setBudget(const C2VdecResourceBudget& budget);
+    C2VdecResourceBudget getBudget();
+
+    // returns the handle of the instance, or -1 when it is rejected.
+    int32_t acquire(const C2VdecResourceRequest& request, C2VdecResourceDecision* decision);
+    void setPreemptCallback(int32_t handle, PreemptCallback callback);
+    C2VdecResourceDecision update(int32_t handle, const C2VdecResourceRequest& request);
+    void setHighResolution(int32_t handle, bool highRes);
+    void release(int32_t handle);
+
+    int32_t getInstanceCount(bool secure);
+    int32_t getHighResInstanceCount();
+    uint64_t getUsedMbPerSec();
+    uint64_t getUsedMemoryBytes();
+
+    static uint64_t mbPerSec(const C2VdecResourceRequest& request);
+    static uint64_t memoryBytes(const C2VdecResourceRequest& request, bool downgrade);
+    static const char* actionToString(C2VdecResourceDecision::Action action);
+
+private:
+    struct Instance {
+        C2VdecResourceRequest mRequest;
+        PreemptCallback mCallback;
+        bool mHighRes;
+        bool mDowngrade;
+        bool mPreempted;
+        bool mStarted;
+    };
+
+    // withPreempted counts the preempted instances which are not released yet.
+    void usageLocked(int32_t exclude, bool withPreempted, int32_t* instances, int32_t* secures,
+            int32_t* exclusives, int32_t* highRes, uint64_t* mbps, uint64_t* memory);
+    bool preemptableLocked(const Instance& instance, const C2VdecResourceRequest& request);
+    // satisfied is asked without the preempted instances, their callbacks
+    // are added to callbacks to be called once the lock is dropped.
+    int32_t preemptLocked(int32_t exclude, const C2VdecResourceRequest& request,
+            const std::function<bool(bool)>& satisfied, std::vector<PreemptCallback>* callbacks);
+    // call the callbacks without the lock, then wait until satisfied or timeoutMs.
+    void waitPreemptedLocked(std::unique_lock<std::mutex>& lock, std::vector<PreemptCallback>* callbacks,
+            const std::function<bool(bool)>& satisfied, int32_t timeoutMs);
+
+    std::mutex mLock;
+    // signalled when an instance is released.
+    std::condition_variable mReleaseCond;
+    C2VdecResourceBudget mBudget;
+    std::map<int32_t, Instance> mInstances;
+    int32_t mNextHandle;
+};
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _C2_VDEC_SIDE_DATA_POOL_H_
+#define _C2_VDEC_SIDE_DATA_POOL_H_
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace android {
+
+/**
+ * Reusable buffers for the side data sent along with the input bitstream.
+ *
+ * The HDR10+ metadata of the interface can change while a work waits in
+ * the queue, so a copy is taken when the work is queued. The copies go to
+ * a few fixed slots which keep their memory, a slot is given back when
+ * its Buffer is destroyed. When all the slots are busy, or the data is
+ * bigger than a slot may grow, the Buffer owns a heap copy instead.
+ */
+class C2VdecSideDataPool : public std::enable_shared_from_this<C2VdecSideDataPool> {
+public:
+    class Buffer {
+    public:
+        Buffer();
+        Buffer(Buffer&& other);
+        Buffer& operator=(Buffer&& other);
+        ~Buffer();
+
+        bool valid() const { return mValid; }
+        uint8_t* data() { return mData; }
+        uint32_t size() const { return mSize; }
+        uint32_t type() const { return mType; }
+
+    private:
+        friend class C2VdecSideDataPool;
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+        void moveFrom(Buffer& other);
+        void reset();
+
+        std::shared_ptr<C2VdecSideDataPool> mPool;
+        int32_t mSlot;
+        std::vector<uint8_t> mOverflow;
+        uint8_t* mData;
+        uint32_t mSize;
+        uint32_t mType;
+        bool mValid;
+    };
+
+    static std::shared_ptr<C2VdecSideDataPool> create(int32_t slotCount, uint32_t maxSlotSize);
+
+    // copies |size| bytes of |data|, |type| is kept for the caller.
+    Buffer acquire(uint32_t type, const uint8_t* data, uint32_t size);
+
+    int32_t getFreeSlotCount();
+    uint32_t getOverflowCount();
+
+private:
+    C2VdecSideDataPool(int32_t slotCount, uint32_t maxSlotSize);
+    void release(int32_t slot);
+
+    std::mutex mLock;
+    std::vector<std::vector<uint8_t>> mSlots;
+    std::vector<bool> mSlotInUse;
+    uint32_t mMaxSlotSize;
+    uint32_t mOverflowCount;
+};
+
+}
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2023 Amlogic, Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _C2_VDEC_SPSC_RING_H_
+#define _C2_VDEC_SPSC_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+namespace android {
+
+/**
+ * Fixed capacity single producer single consumer ring of plain records.
+ *
+ * push() is only called from one thread and pop() from another one, no lock
+ * and no allocation on either side. Capacity must be a power of two.
+ */
+template <typename T, uint32_t N>
+class C2VdecSpscRing {
+    static_assert(N != 0 && (N & (N - 1)) == 0, "ring capacity must be a power of two");
+
+public:
+    C2VdecSpscRing() : mHead(0), mTail(0) {}
+
+    // producer side, false when the ring is full.
+    bool push(const T& record) {
+        uint32_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) >= N) {
+            return false;
+        }
+        mRecords[tail & (N - 1)] = record;
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, false when the ring is empty.
+    bool pop(T* record) {
+        uint32_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        *record = mRecords[head & (N - 1)];
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, drop everything already pushed.
+    void clear() {
+        mHead.store(mTail.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    bool empty() const {
+        return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+    }
+
+private:
+    T mRecords[N];
+    std::atomic<uint32_t> mHead;
+    std::atomic<uint32_t> mTail;
+};
+
+}
+
+#endif
@@ -17,7 +17,9 @@
 #ifndef _C2Vdec_Tunnel_HELPER_H_
 #define _C2Vdec_Tunnel_HELPER_H_
 
+#include <atomic>
 #include <mutex>
+#include <set>
 
 #include <C2Config.h>
 #include <C2Enum.h>
@@ -29,6 +31,7 @@
 #include <C2VdecComponent.h>
 
 #include <C2VdecBlockPoolUtil.h>
+#include <C2VdecSpscRing.h>
 #include <VideoTunnelRendererWraper.h>
 
 namespace android {
@@ -53,6 +56,10 @@ public:
     void configureEsModeHwAvsyncId(int32_t            avSyncId);
     void videoSyncQueueVideoFrame(int64_t timestampUs, uint32_t size);
 private:
+    static const uint32_t kTunnelRecordRingSize = 64;
+    static const uint32_t kTunnelEventRingSize = 8;
+    static const uint32_t kTunnelEventInlineSize = 16;
+
     static int fillVideoFrameCallback2(void* obj, void* args);
     int postFillVideoFrameTunnel2(int dmafd, bool rendered);
     void onFillVideoFrameTunnel2(int dmafd, bool rendered);
@@ -64,13 +71,19 @@ private:
     static int notifyTunnelEventCallback(void* obj, void* args);
     int postNotifyTunnelEvent(struct tunnelEventParam* param);
     void onNotifyTunnelEvent(struct tunnelEventParam param);
+    void handleTunnelEvent(int32_t type, void* data, uint32_t size);
+
+    void postDrainCallbackRecords();
+    void onDrainCallbackRecords();
+    void processFillVideoFrameQueue();
 
     c2_status_t sendOutputBufferToWorkTunnel(struct renderTime* rendertime);
     bool checkReallocOutputBuffer(VideoFormat video_format_old,VideoFormat video_format_new, bool *sizeChanged, bool *bufferNumEnlarged);
     void appendTunnelOutputBuffer(std::shared_ptr<C2GraphicBlock> block, int fd, uint32_t blockId, uint32_t poolId);
     uint64_t getPlatformUsage();
     c2_status_t allocTunnelBuffer(const media::Size& size, uint32_t pixelFormat, int* pFd);
-    void allocTunnelBufferAndSendToDecoder(const media::Size& size, uint32_t pixelFormat, int index);
+    void allocTunnelBufferAndSendToDecoder(const media::Size& size, uint32_t pixelFormat, int index, uint32_t generation);
+    bool canReuseTunnelBuffers(const media::Size& size, uint64_t platformUsage);
     c2_status_t resetBlockPoolBuffers();
     bool isInResolutionChanging();
 
@@ -95,10 +108,30 @@ private:
     };
 
     std::vector<struct fillVideoFrame2> mFillVideoFrameQueue;
-    std::vector<int64_t> mTunnelAbandonMediaTimeQueue;
+
+    // records pushed from the renderer callbacks, drained on the component thread.
+    // each callback is invoked from a single renderer thread, so one ring per callback.
+    struct TunnelEventRecord {
+        int32_t type;
+        uint32_t paramSize;
+        uint8_t data[kTunnelEventInlineSize];
+    };
+    C2VdecSpscRing<struct fillVideoFrame2, kTunnelRecordRingSize> mFillVideoFrameRing;
+    C2VdecSpscRing<struct renderTime, kTunnelRecordRingSize> mRenderTimeRing;
+    C2VdecSpscRing<TunnelEventRecord, kTunnelEventRingSize> mTunnelEventRing;
+    // set when a drain task is queued, later records ride on it.
+    std::atomic<bool> mDrainPending;
+
+    // media times of works already reported as abandoned, retired by render callbacks.
+    std::multiset<int64_t> mTunnelAbandonMediaTimeQueue;
     std::map<int, TunnelFdInfo> mOutBufferFdMap;
 
     uint32_t mOutBufferCount;
+    // bumped on every new buffer set, a pending allocation task of an older set stops.
+    uint32_t mAllocGeneration;
+    // platform usage the current buffer set was allocated with.
+    uint64_t mAllocatedUsage;
+    bool mReuseWhenResChange;
     uint32_t mPixelFormat;
     bool mReallocWhenResChange;
     ::base::WeakPtrFactory<C2VdecComponent::TunnelHelper> mWeakFactory;
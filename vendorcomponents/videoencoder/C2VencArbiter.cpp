@@ -0,0 +1,275 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "C2VencArbiter"
+#include <utils/Log.h>
+#include <utils/Timers.h>
+#include <cutils/properties.h>
+
+#include <inttypes.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <C2VendorProperty.h>
+#include <C2VencArbiter.h>
+
+namespace android {
+
+#define ARBITER_DEFAULT_FRAME_RATE  30.0f
+#define ARBITER_LATE_FRAMES         3     //a frame this late goes before any priority
+#define ARBITER_MIN_SHARE           0.1f  //a paced session still gets some frames through
+#define ARBITER_ENCODE_TIME_WEIGHT  0.125
+#define ARBITER_MAX_DELAY_US        200000 //below the time stop waits for the encoder thread
+
+static int64_t getNowUs() {
+    return ns2us(systemTime(SYSTEM_TIME_MONOTONIC));
+}
+
+static int64_t getFrameIntervalUs(const C2VencArbiter::Session_t &session) {
+    float frameRate = (session.frameRate > 0) ? session.frameRate : ARBITER_DEFAULT_FRAME_RATE;
+    return (int64_t)(1000000 / frameRate);
+}
+
+static int64_t getLateUs(const C2VencArbiter::Session_t &session) {
+    return std::min<int64_t>(ARBITER_LATE_FRAMES * getFrameIntervalUs(session), ARBITER_MAX_DELAY_US);
+}
+
+// static
+C2VencArbiter &C2VencArbiter::getInstance(const char *name, uint32_t defaultSlots, uint64_t defaultMaxMbPerSec) {
+    static std::mutex sLock;
+    //never deleted,the sessions of the hardware live as long as the process.
+    static std::map<std::string, C2VencArbiter *> sArbiters;
+    std::lock_guard<std::mutex> lock(sLock);
+
+    std::map<std::string, C2VencArbiter *>::iterator it = sArbiters.find(name);
+    if (it == sArbiters.end()) {
+        int32_t slots = property_get_int32(C2_PROPERTY_VENC_ARBITER_SLOTS, -1);
+        int32_t maxMbPerSec = property_get_int32(C2_PROPERTY_VENC_ARBITER_MBPS, -1);
+        C2VencArbiter *arbiter = new C2VencArbiter((slots >= 0) ? (uint32_t)slots : defaultSlots,
+                                                   (maxMbPerSec >= 0) ? (uint64_t)maxMbPerSec : defaultMaxMbPerSec);
+        ALOGD("arbiter of %s,slots:%u,max mbps:%" PRIu64, name, arbiter->mSlots, arbiter->mMaxMbPerSec);
+        it = sArbiters.insert(std::make_pair(std::string(name), arbiter)).first;
+    }
+    return *it->second;
+}
+
+C2VencArbiter::C2VencArbiter(uint32_t slots, uint64_t maxMbPerSec)
+    : mSlots(slots),
+      mBusy(0),
+      mMaxMbPerSec(maxMbPerSec),
+      mNextHandle(1),
+      mSeq(0) {
+}
+
+// static
+uint64_t C2VencArbiter::mbPerSec(const Session_t &session) {
+    uint64_t mbs = (uint64_t)((session.width + 15) / 16) * ((session.height + 15) / 16);
+    float frameRate = (session.frameRate > 0) ? session.frameRate : ARBITER_DEFAULT_FRAME_RATE;
+    return (uint64_t)(mbs * frameRate);
+}
+
+void C2VencArbiter::updateSharesLocked() {
+    std::vector<std::pair<int32_t, int32_t>> order;
+    uint64_t remaining = mMaxMbPerSec;
+
+    for (std::map<int32_t, Entry_t>::iterator it = mSessions.begin(); it != mSessions.end(); ++it) {
+        order.push_back(std::make_pair(it->second.session.priority, it->first));
+    }
+    //by priority,the older session first between equals.
+    std::sort(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); i++) {
+        Entry_t &entry = mSessions[order[i].second];
+        uint64_t need = mbPerSec(entry.session);
+        float share = 1.0f;
+        //a lone session is never paced,there is nobody to yield to.
+        if (mMaxMbPerSec > 0 && order.size() > 1) {
+            if (need <= remaining) {
+                remaining -= need;
+            } else {
+                share = std::max(ARBITER_MIN_SHARE, (float)remaining / need);
+                remaining = 0;
+            }
+        }
+        if (share != entry.share) {
+            ALOGD("session %d priority:%d mbps:%" PRIu64 " share %.2f -> %.2f", order[i].second,
+                  entry.session.priority, need, entry.share, share);
+            entry.share = share;
+            if (share >= 1.0f) {
+                entry.nextGrantUs = 0;
+            }
+        }
+    }
+}
+
+int32_t C2VencArbiter::addSession(const Session_t &session) {
+    std::lock_guard<std::mutex> lock(mLock);
+    int32_t handle = mNextHandle++;
+    Entry_t entry;
+    entry.session = session;
+    entry.share = 1.0f;
+    entry.waiting = false;
+    entry.deadlineUs = 0;
+    entry.seq = 0;
+    entry.nextGrantUs = 0;
+    entry.avgEncodeUs = 0;
+    mSessions[handle] = entry;
+    updateSharesLocked();
+    mCond.notify_all();
+    return handle;
+}
+
+void C2VencArbiter::updateSession(int32_t handle, const Session_t &session) {
+    std::lock_guard<std::mutex> lock(mLock);
+    std::map<int32_t, Entry_t>::iterator it = mSessions.find(handle);
+    if (it == mSessions.end()) {
+        return;
+    }
+    it->second.session = session;
+    updateSharesLocked();
+    mCond.notify_all();
+}
+
+void C2VencArbiter::removeSession(int32_t handle) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mSessions.erase(handle);
+    updateSharesLocked();
+    mCond.notify_all();
+}
+
+bool C2VencArbiter::isBeforeLocked(int64_t nowUs, const Entry_t &a, const Entry_t &b) {
+    bool lateA = nowUs - a.deadlineUs > getLateUs(a.session);
+    bool lateB = nowUs - b.deadlineUs > getLateUs(b.session);
+    if (lateA != lateB) {
+        return lateA;
+    }
+    if (!lateA && a.session.priority != b.session.priority) {
+        return a.session.priority < b.session.priority;
+    }
+    //the late ones go by deadline,the others by slack.
+    int64_t keyA = lateA ? a.deadlineUs : a.deadlineUs - a.avgEncodeUs;
+    int64_t keyB = lateB ? b.deadlineUs : b.deadlineUs - b.avgEncodeUs;
+    if (keyA != keyB) {
+        return keyA < keyB;
+    }
+    return a.seq < b.seq;
+}
+
+int32_t C2VencArbiter::pickLocked(int64_t nowUs, int64_t *wakeUs) {
+    int32_t best = -1;
+    *wakeUs = 0;
+    for (std::map<int32_t, Entry_t>::iterator it = mSessions.begin(); it != mSessions.end(); ++it) {
+        const Entry_t &entry = it->second;
+        if (!entry.waiting) {
+            continue;
+        }
+        if (entry.nextGrantUs > nowUs) {
+            int64_t waitUs = entry.nextGrantUs - nowUs;
+            if (*wakeUs == 0 || waitUs < *wakeUs) {
+                *wakeUs = waitUs;
+            }
+            continue;
+        }
+        if (best < 0 || isBeforeLocked(nowUs, entry, mSessions[best])) {
+            best = it->first;
+        }
+    }
+    return best;
+}
+
+C2VencArbiter::Grant_t C2VencArbiter::acquire(int32_t handle) {
+    Grant_t grant = {0, false};
+    int64_t startUs = getNowUs();
+    int64_t nowUs = startUs;
+    std::unique_lock<std::mutex> lock(mLock);
+
+    std::map<int32_t, Entry_t>::iterator it = mSessions.find(handle);
+    if (mSlots == 0 || it == mSessions.end()) {
+        return grant;
+    }
+    Entry_t &entry = it->second;
+    int64_t intervalUs = getFrameIntervalUs(entry.session);
+    entry.waiting = true;
+    //the wait of a paced session for its turn does not make it late.
+    entry.deadlineUs = std::max(startUs, entry.nextGrantUs) + intervalUs;
+    entry.seq = mSeq++;
+    mCond.notify_all();
+    while (true) {
+        int64_t wakeUs = 0;
+        int32_t next = pickLocked(nowUs, &wakeUs);
+        if (mBusy < mSlots && next == handle) {
+            break;
+        }
+        if (mBusy < mSlots && next < 0 && wakeUs > 0) {
+            //only paced sessions wait,nothing will signal when they are due.
+            mCond.wait_for(lock, std::chrono::microseconds(wakeUs));
+        } else {
+            mCond.wait(lock);
+        }
+        nowUs = getNowUs();
+    }
+    entry.waiting = false;
+    mBusy++;
+    if (entry.share < 1.0f) {
+        //catch up by one frame at most after a gap of the session.
+        int64_t paceUs = std::min<int64_t>((int64_t)(intervalUs / entry.share), ARBITER_MAX_DELAY_US);
+        entry.nextGrantUs = std::max(entry.nextGrantUs, nowUs - intervalUs) + paceUs;
+    }
+    grant.waitUs = nowUs - startUs;
+    grant.backPressure = entry.share < 1.0f;
+    //a free slot may be for one of the others.
+    mCond.notify_all();
+    return grant;
+}
+
+void C2VencArbiter::release(int32_t handle, int64_t encodeTimeUs) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mSlots == 0) {
+        return;
+    }
+    if (mBusy > 0) {
+        mBusy--;
+    }
+    std::map<int32_t, Entry_t>::iterator it = mSessions.find(handle);
+    if (it != mSessions.end()) {
+        Entry_t &entry = it->second;
+        if (entry.avgEncodeUs == 0) {
+            entry.avgEncodeUs = encodeTimeUs;
+        } else {
+            entry.avgEncodeUs += (int64_t)((encodeTimeUs - entry.avgEncodeUs) * ARBITER_ENCODE_TIME_WEIGHT);
+        }
+    }
+    mCond.notify_all();
+}
+
+uint64_t C2VencArbiter::getUsedMbPerSec() {
+    std::lock_guard<std::mutex> lock(mLock);
+    uint64_t used = 0;
+    for (std::map<int32_t, Entry_t>::iterator it = mSessions.begin(); it != mSessions.end(); ++it) {
+        used += (uint64_t)(mbPerSec(it->second.session) * it->second.share);
+    }
+    return used;
+}
+
+float C2VencArbiter::getShare(int32_t handle) {
+    std::lock_guard<std::mutex> lock(mLock);
+    std::map<int32_t, Entry_t>::iterator it = mSessions.find(handle);
+    return (it != mSessions.end()) ? it->second.share : 1.0f;
+}
+
+}  // namespace android
@@ -31,6 +31,7 @@
 #include <cutils/properties.h>
 #include "C2VendorSupport.h"
 #include "C2VencIntfImpl.h"
+#include "C2VencLibRegistry.h"
 
 #include <string>
 #include <inttypes.h>
@@ -38,7 +39,6 @@
 #include <algorithm>
 #include <string>
 #include <stdio.h>
-#include <dlfcn.h>
 
 
 namespace android {
@@ -131,11 +131,11 @@ C2VencComp::C2VencComp(const char *name, c2_node_id_t id, const std::shared_ptr<
                   mIntfImpl(intfImpl),
                   mIntf(std::make_shared<SimpleInterface<IntfImpl>>(name, id, intfImpl)),
                   mIsInit(false),
-                  mSpsPpsHeaderReceived(false),
                   mOutBufferSize(OUTPUT_BUFFERSIZE_MIN),
                   mSawInputEOS(false),
+                  mWakeupCount(0),
+                  mParamResync(false),
                   mAmlVencInst(NULL),
-                  mLibHandle(NULL),
                   CreateMethod(NULL),
                   DestroyMethod(NULL) {
     ALOGD("C2VencComponent constructor!");
@@ -173,11 +173,24 @@ c2_status_t C2VencComp::setListener_vb(const std::shared_ptr<Listener>& listener
 
 c2_status_t C2VencComp::queue_nb(std::list<std::unique_ptr<C2Work>>* const items) {
     C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"C2VencComponent queue_nb!,receive buffer count:%d", (int)items->size());
+    //the updates are checked and taken in the interface here,the encode thread
+    //only pushes the resulting encoder params before the frame of the work.
+    std::map<uint64_t, stVencParam> changes;
+    for (const std::unique_ptr<C2Work> &work : *items) {
+        stVencParam param;
+        if (work != nullptr && stageConfigUpdate(work, &param)) {
+            changes[work->input.ordinal.frameIndex.peeku()] = param;
+        }
+    }
     AutoMutex l(mInputQueueLock);
+    for (std::map<uint64_t, stVencParam>::iterator it = changes.begin(); it != changes.end(); ++it) {
+        mParamChanges[it->first] = it->second;
+    }
     while (!items->empty()) {
         mQueue.push_back(std::move(items->front()));
         items->pop_front();
     }
+    mInputQueueCond.signal();
     return C2_OK;
 }
 
@@ -198,6 +211,7 @@ c2_status_t C2VencComp::flush_sm(flush_mode_t mode, std::list<std::unique_ptr<C2
     }*/
     {
         // TODO: queue->splicedBy(flushedWork, flushedWork->end());
+        AutoMutex l(mInputQueueLock);
         while (!mQueue.empty()) {
             std::unique_ptr<C2Work> work = std::move(mQueue.front());
             mQueue.pop_front();
@@ -205,29 +219,33 @@ c2_status_t C2VencComp::flush_sm(flush_mode_t mode, std::list<std::unique_ptr<C2
                 flushedWork->push_back(std::move(work));
             }
         }
+        //the interface kept the settings of the flushed works,bring the encoder to them.
+        if (!mParamChanges.empty()) {
+            mParamChanges.clear();
+            mParamResync = true;
+        }
+        mInputQueueCond.signal();
     }
     return C2_OK;
 }
 
 c2_status_t C2VencComp::drain_nb(drain_mode_t mode) {
     C2Venc_LOG(CODEC2_VENC_LOG_INFO,"C2VencComponent drain_nb!");
-
+    wakeWorkLoop();
     return C2_OK;
 }
 
 
 bool C2VencComp::Load() {
-     mLibHandle = dlopen(kComponentLoadMediaProcessLibrary.c_str(), RTLD_NOW | RTLD_NODELETE);
-    if (mLibHandle == nullptr) {
-        ALOGD("Could not dlopen %s: %s", kComponentLoadMediaProcessLibrary.c_str(), dlerror());
+    C2VencLibRegistry::Symbol_t symbols[] = {
+        {"VencGetInstance", true, (void **)&CreateMethod},
+        {"VencDelInstance", true, (void **)&DestroyMethod},
+    };
+    if (!C2VencLibRegistry::getInstance().bind(kComponentLoadMediaProcessLibrary.c_str(), symbols,
+                                               sizeof(symbols) / sizeof(symbols[0]))) {
+        ALOGD("Could not load %s", kComponentLoadMediaProcessLibrary.c_str());
         return false;
     }
-    ALOGE("C2VencComp::mLibHandle:%p",mLibHandle);
-    CreateMethod = (C2VencCreateInstance)dlsym(
-                mLibHandle, "VencGetInstance");
-
-    DestroyMethod = (C2VencDestroyInstance)dlsym(
-                mLibHandle, "VencDelInstance");
 
     if (!CreateMethod || !DestroyMethod) {
         ALOGE("load library failed,CreateMethod:%p,DestroyMethod:%p",CreateMethod,DestroyMethod);
@@ -259,11 +277,6 @@ void C2VencComp::unLoad() {
         ALOGE("Destroy mAmlVencInst");
         DestroyMethod(mAmlVencInst);
     }
-
-    if (mLibHandle) {
-        ALOGV("Unloading dll");
-        dlclose(mLibHandle);
-    }
 }
 
 
@@ -283,6 +296,8 @@ c2_status_t C2VencComp::start() {
         C2Venc_LOG(CODEC2_VENC_LOG_ERR,"Module init failed!!,please check");
         return C2_NO_INIT;
     }
+    //the encoder was inited again,so is its header.
+    mHeaderCache.invalidate();
     mthread.start(runWorkLoop,this);
     mComponentState = ComponentState::STARTED;
 
@@ -299,10 +314,13 @@ c2_status_t C2VencComp::stop_process() {
     {
         AutoMutex l(mInputQueueLock);
         mQueue.clear();
+        mParamChanges.clear();
+        mParamResync = false;
     }
     if (mthread.isRunning()) {
         AutoMutex l(mProcessDoneLock);
         mthread.requestExit();
+        wakeWorkLoop();
         C2Venc_LOG(CODEC2_VENC_LOG_INFO,"wait for thread to exit!");
         if (mProcessDoneCond.waitRelative(mProcessDoneLock,500000000ll) == ETIMEDOUT) {
             C2Venc_LOG(CODEC2_VENC_LOG_ERR,"wait for thread timeout!!!!");
@@ -372,6 +390,9 @@ void C2VencComp::ProcessData()
     eResult Result = FAIL;
     stInputFrameInfo InputFrameInfo;
     std::shared_ptr<const C2ReadView> Linearview;
+    stVencParam param;
+    bool hasParam = false;
+    bool resync = false;
     memset(&InputFrameInfo,0,sizeof(InputFrameInfo));
 
     {
@@ -381,6 +402,16 @@ void C2VencComp::ProcessData()
         C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"begin to process input data");
         work = std::move(mQueue.front());
         mQueue.pop_front();
+        if (work) {
+            std::map<uint64_t, stVencParam>::iterator it = mParamChanges.find(work->input.ordinal.frameIndex.peeku());
+            if (it != mParamChanges.end()) {
+                param = it->second;
+                hasParam = true;
+                mParamChanges.erase(it);
+            }
+        }
+        resync = mParamResync;
+        mParamResync = false;
     }
 
     if (NULL == work) {
@@ -388,18 +419,12 @@ void C2VencComp::ProcessData()
         return;
     }
 
-    {
-        std::vector<C2Param *> updates;
-        for (const std::unique_ptr<C2Param> &param: work->input.configUpdate) {
-            if (param) {
-                updates.emplace_back(param.get());
-            }
-        }
-        if (!updates.empty()) {
-            std::vector<std::unique_ptr<C2SettingResult>> failures;
-            c2_status_t err = intf()->config_vb(updates, C2_MAY_BLOCK, &failures);
-            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"applied %zu configUpdates => %s (%d)", updates.size(), asString(err), err);
-        }
+    //between two frames,the updates were checked in queue_nb.
+    if (resync) {
+        mIntfImpl->ParamUpdate();
+    }
+    if (hasParam) {
+        mIntfImpl->applyStagedParam(param);
     }
 
     if (!work->input.buffers.empty() && !work->input.buffers[0]) {
@@ -485,22 +510,25 @@ void C2VencComp::ProcessData()
         return;
     }
 
-    if (!mSpsPpsHeaderReceived) {
-        uint32_t uHeaderLength = 0;
-        uint8_t header[128] = {0};
-        bool error = mAmlVencInst->GenerateHeader((char *)header,uHeaderLength);
-        if (!error) {
-            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"Encode header failed = 0x%x\n",error);
+    if (!mHeaderCache.isValid()) {
+        //generated in the output block,it is reused for the frame right after.
+        bool ok = mHeaderCache.generate((uint8_t *)wView.base(),wView.capacity(),
+                                        [this](uint8_t *pHeader,uint32_t *pSize) {
+                                            unsigned int length = 0;
+                                            bool ret = mAmlVencInst->GenerateHeader((char *)pHeader,length);
+                                            *pSize = length;
+                                            return ret;
+                                        });
+        if (!ok) {
+            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"Encode header failed");
             work->workletsProcessed = 1u;
             WorkDone(work);
             return;
         } else {
-            C2Venc_LOG(CODEC2_VENC_LOG_INFO,"Bytes Generated in header %d\n",uHeaderLength);
+            C2Venc_LOG(CODEC2_VENC_LOG_INFO,"Bytes Generated in header %u\n",mHeaderCache.size());
         }
 
-        mSpsPpsHeaderReceived = true;
-
-        std::unique_ptr<C2StreamInitDataInfo::output> csd = C2StreamInitDataInfo::output::AllocUnique(uHeaderLength, 0u);
+        std::unique_ptr<C2StreamInitDataInfo::output> csd = C2StreamInitDataInfo::output::AllocUnique(mHeaderCache.size(), 0u);
         if (!csd) {
             C2Venc_LOG(CODEC2_VENC_LOG_ERR,"CSD allocation failed");
             //mSignalledError = true;
@@ -509,7 +537,7 @@ void C2VencComp::ProcessData()
             WorkDone(work);
             return;
         }
-        memcpy(csd->m.value, header, uHeaderLength);
+        memcpy(csd->m.value, mHeaderCache.data(), mHeaderCache.size());
         work->worklets.front()->output.configUpdate.push_back(std::move(csd));
         if (work->input.buffers.empty()) {
             work->workletsProcessed = 1u;
@@ -611,13 +639,51 @@ void *C2VencComp::runWorkLoop(void *arg) {
     return threadloop->threadLoop();
 }
 
+bool C2VencComp::stageConfigUpdate(const std::unique_ptr<C2Work> &work, stVencParam *pParam) {
+    std::vector<C2Param *> params;
+    std::vector<C2Param *> updates;
+    for (const std::unique_ptr<C2Param> &param: work->input.configUpdate) {
+        if (param) {
+            params.emplace_back(param.get());
+        }
+    }
+    if (params.empty()) {
+        return false;
+    }
+    //the client often resends the current settings,those do not reach the encoder.
+    mIntfImpl->filterUnchangedParams(params, &updates);
+    if (updates.empty()) {
+        C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"%zu configUpdates unchanged, skip", params.size());
+        return false;
+    }
+    c2_status_t err = mIntfImpl->stageConfig(updates, pParam);
+    C2Venc_LOG(CODEC2_VENC_LOG_INFO,"staged %zu/%zu configUpdates => %s (%d)", updates.size(), params.size(), asString(err), err);
+    return true;
+}
+
+void C2VencComp::wakeWorkLoop() {
+    AutoMutex l(mInputQueueLock);
+    mInputQueueCond.signal();
+}
+
 void *C2VencComp::threadLoop() {
+    mWakeupCount = 0;
     while (!mthread.exitRequested()) {
+        {
+            //sleep until there is work,the exit request is checked under the queue lock so a wake is not lost.
+            AutoMutex l(mInputQueueLock);
+            while (mQueue.empty() && !mthread.exitRequested()) {
+                mInputQueueCond.wait(mInputQueueLock);
+                mWakeupCount++;
+            }
+        }
+        if (mthread.exitRequested()) {
+            break;
+        }
+        //back to back works are processed without sleeping.
         ProcessData();
-
-        usleep(100);
     }
-    C2Venc_LOG(CODEC2_VENC_LOG_INFO,"threadLoop exit done!");
+    C2Venc_LOG(CODEC2_VENC_LOG_INFO,"threadLoop exit done! wakeups:%u", mWakeupCount);
     AutoMutex l(mProcessDoneLock);
     mProcessDoneCond.signal();
     return NULL;
@@ -19,6 +19,7 @@
 #define LOG_TAG "C2VencComponent"
 
 #include <C2VencComponent.h>
+#include <C2VencFormatConv.h>
 #include <C2AllocatorGralloc.h>
 #include <C2ComponentFactory.h>
 #include <C2PlatformSupport.h>
@@ -28,6 +29,7 @@
 
 #include <ui/GraphicBuffer.h>
 #include <utils/Log.h>
+#include <utils/Timers.h>
 #include <cutils/properties.h>
 
 #include <string>
@@ -46,6 +48,9 @@ namespace android {
 #define ENABLE_DUMP_ES        1
 #define ENABLE_DUMP_RAW       (1 << 1)
 #define ENCODER_PROP_DUMP_DATA        "debug.vendor.media.c2.venc.dump_data"
+#define DUMP_MAP_CACHE_MAX_ENTRIES    8
+#define DUMP_MAP_CACHE_MAX_BYTES      (64 * 1024 * 1024)
+#define OUTPUT_DRAIN_TIMEOUT_NS       500000000ll
 
 #define USE_CONTINUES_PHYBUFF(h) (am_gralloc_get_usage(h) & GRALLOC_USAGE_HW_VIDEO_ENCODER)
 #define align_32(x)  ((((x)+31)>>5)<<5)
@@ -108,84 +113,25 @@ private:
 };
 
 
-bool C2VencComponent::IsYUV420(const C2GraphicView &view) {
-    const C2PlanarLayout &layout = view.layout();
-    return (layout.numPlanes == 3
-            && layout.type == C2PlanarLayout::TYPE_YUV
-            && layout.planes[layout.PLANE_Y].channel == C2PlaneInfo::CHANNEL_Y
-            && layout.planes[layout.PLANE_Y].allocatedDepth == 8
-            && layout.planes[layout.PLANE_Y].bitDepth == 8
-            && layout.planes[layout.PLANE_Y].rightShift == 0
-            && layout.planes[layout.PLANE_Y].colSampling == 1
-            && layout.planes[layout.PLANE_Y].rowSampling == 1
-            && layout.planes[layout.PLANE_U].channel == C2PlaneInfo::CHANNEL_CB
-            && layout.planes[layout.PLANE_U].allocatedDepth == 8
-            && layout.planes[layout.PLANE_U].bitDepth == 8
-            && layout.planes[layout.PLANE_U].rightShift == 0
-            && layout.planes[layout.PLANE_U].colSampling == 2
-            && layout.planes[layout.PLANE_U].rowSampling == 2
-            && layout.planes[layout.PLANE_V].channel == C2PlaneInfo::CHANNEL_CR
-            && layout.planes[layout.PLANE_V].allocatedDepth == 8
-            && layout.planes[layout.PLANE_V].bitDepth == 8
-            && layout.planes[layout.PLANE_V].rightShift == 0
-            && layout.planes[layout.PLANE_V].colSampling == 2
-            && layout.planes[layout.PLANE_V].rowSampling == 2);
-}
-
-bool C2VencComponent::IsNV12(const C2GraphicView &view) {
-    if (!IsYUV420(view)) {
-        return false;
-    }
-    const C2PlanarLayout &layout = view.layout();
-    return (layout.rootPlanes == 2
-            && layout.planes[layout.PLANE_U].colInc == 2
-            && layout.planes[layout.PLANE_U].rootIx == layout.PLANE_U
-            && layout.planes[layout.PLANE_U].offset == 0
-            && layout.planes[layout.PLANE_V].colInc == 2
-            && layout.planes[layout.PLANE_V].rootIx == layout.PLANE_U
-            && layout.planes[layout.PLANE_V].offset == 1);
-}
-
-bool C2VencComponent::IsNV21(const C2GraphicView &view) {
-    if (!IsYUV420(view)) {
-        return false;
-    }
-    const C2PlanarLayout &layout = view.layout();
-    return (layout.rootPlanes == 2
-            && layout.planes[layout.PLANE_U].colInc == 2
-            && layout.planes[layout.PLANE_U].rootIx == layout.PLANE_V
-            && layout.planes[layout.PLANE_U].offset == 1
-            && layout.planes[layout.PLANE_V].colInc == 2
-            && layout.planes[layout.PLANE_V].rootIx == layout.PLANE_V
-            && layout.planes[layout.PLANE_V].offset == 0);
-}
-
-bool C2VencComponent::IsI420(const C2GraphicView &view) {
-    if (!IsYUV420(view)) {
-        return false;
-    }
-    const C2PlanarLayout &layout = view.layout();
-    return (layout.rootPlanes == 3
-            && layout.planes[layout.PLANE_U].colInc == 1
-            && layout.planes[layout.PLANE_U].rootIx == layout.PLANE_U
-            && layout.planes[layout.PLANE_U].offset == 0
-            && layout.planes[layout.PLANE_V].colInc == 1
-            && layout.planes[layout.PLANE_V].rootIx == layout.PLANE_V
-            && layout.planes[layout.PLANE_V].offset == 0);
-}
-
 C2VencComponent::C2VencComponent(const std::shared_ptr<C2ComponentInterface> &intf)
                 : mComponentState(ComponentState::UNINITIALIZED),
                   mIntf(intf),
                   mIsInit(false),
                   mfdDumpInput(-1),
                   mfdDumpOutput(-1),
-                  mSpsPpsHeaderReceived(false),
+                  mArbiter(NULL),
+                  mArbiterHandle(-1),
+                  mArbiterGeneration(-1),
+                  mBackPressure(false),
+                  mBackPressureChanged(false),
                   mOutBufferSize(OUTPUT_BUFFERSIZE_MIN),
                   mSawInputEOS(false),
                   mDumpYuvEnable(false),
-                  mDumpEsEnable(false) {
+                  mDumpEsEnable(false),
+                  mDumpMapCache(DUMP_MAP_CACHE_MAX_ENTRIES, DUMP_MAP_CACHE_MAX_BYTES),
+                  mOutputDelivering(false) {
     ALOGD("C2VencComponent constructor!");
+    memset(&mInputSettings,0,sizeof(mInputSettings));
     propGetInt(CODEC2_VENC_LOGDEBUG_PROPERTY, &gloglevel);
     propGetInt(CODEC2_ONLY_VENC_LOGDEBUG_PROPERTY,&gloglevel_encoder);
     ALOGD("gloglevel:%x",gloglevel);
@@ -249,6 +195,7 @@ c2_status_t C2VencComponent::flush_sm(flush_mode_t mode, std::list<std::unique_p
             }
         }
     }
+    waitOutputDelivered();
     return C2_OK;
 }
 
@@ -275,6 +222,22 @@ c2_status_t C2VencComponent::start() {
         C2Venc_LOG(CODEC2_VENC_LOG_ERR,"Module init failed!!,please check");
         return C2_NO_INIT;
     }
+    invalidateInputSettings();
+    //the encoder was inited again,so is its header.
+    mHeaderCache.invalidate();
+    mArbiter = getArbiter();
+    if (mArbiter && mArbiterHandle < 0) {
+        C2VencArbiter::Session_t session;
+        memset(&session,0,sizeof(session));
+        getArbiterSession(&session);
+        mArbiterHandle = mArbiter->addSession(session);
+        mArbiterGeneration = getConfigGeneration();
+        mBackPressure = false;
+        mBackPressureChanged = false;
+        C2Venc_LOG(CODEC2_VENC_LOG_INFO,"arbiter session %d,%ux%u@%.1f priority:%d",mArbiterHandle,
+                   session.width,session.height,session.frameRate,session.priority);
+    }
+    mOutputThread.start(runOutputLoop,this);
     mthread.start(runWorkLoop,this);
     mComponentState = ComponentState::STARTED;
 
@@ -325,6 +288,26 @@ c2_status_t C2VencComponent::stop_process() {
         }
         mthread.stop();
     }
+    if (mOutputThread.isRunning()) {
+        waitOutputDelivered();
+        mOutputThread.requestExit();
+        {
+            AutoMutex l(mOutputQueueLock);
+            mOutputQueueCond.signal();
+        }
+        mOutputThread.stop();
+        C2Venc_LOG(CODEC2_VENC_LOG_INFO,"output thread exit done!");
+    }
+    {
+        AutoMutex l(mOutputQueueLock);
+        mOutputQueue.clear();
+    }
+    mDumpMapCache.clear();
+    std::vector<uint8_t>().swap(mConvertBuffer);
+    if (mArbiter && mArbiterHandle >= 0) {
+        mArbiter->removeSession(mArbiterHandle);
+        mArbiterHandle = -1;
+    }
     if (mfdDumpInput >= 0) {
         close(mfdDumpInput);
         mfdDumpInput = -1;
@@ -447,6 +430,42 @@ c2_status_t C2VencComponent::CanvasDataProc(DataModeInfo_t *pDataMode,InputFrame
 }
 
 
+c2_status_t C2VencComponent::getInputSettings(const InputSettings_t **pSettings) {
+    int64_t generation = getConfigGeneration();
+
+    if (mInputSettings.valid && generation >= 0 && generation == mInputSettings.generation) {
+        *pSettings = &mInputSettings;
+        return C2_OK;
+    }
+
+    C2StreamPictureSizeInfo::input PicSize(0u, 16, 16);
+    C2StreamPixelFormatInfo::input InputFmt(0u, HAL_PIXEL_FORMAT_YCRCB_420_SP);
+    C2VencCanvasMode::input CanvasInput(0u);
+
+    //canvas mode is not declared by every encoder,so C2_BAD_INDEX is expected here
+    c2_status_t err = intf()->query_vb({&PicSize,&InputFmt,&CanvasInput},{},C2_DONT_BLOCK,nullptr);
+    if (err == C2_BAD_INDEX) {
+        if (!PicSize || !InputFmt) {
+            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"get PicSize or InputFmt failed!!");
+            return C2_BAD_VALUE;
+        }
+    } else if (err != C2_OK) {
+        C2Venc_LOG(CODEC2_VENC_LOG_ERR,"get subclass param failed!!");
+        return C2_BAD_VALUE;
+    }
+    mInputSettings.width = PicSize.width;
+    mInputSettings.height = PicSize.height;
+    mInputSettings.pixelFormat = InputFmt.value;
+    mInputSettings.canvasMode = CanvasInput ? CanvasInput.value : 0;
+    mInputSettings.generation = generation;
+    mInputSettings.valid = true;
+    C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"input settings refreshed,generation:%" PRId64",size:%d x %d,fmt:%d,canvas:%d",
+        generation,mInputSettings.width,mInputSettings.height,mInputSettings.pixelFormat,mInputSettings.canvasMode);
+    *pSettings = &mInputSettings;
+    return C2_OK;
+}
+
+
 c2_status_t C2VencComponent::LinearDataProc(std::shared_ptr<const C2ReadView> view,InputFrameInfo *pFrameInfo) {
     //private_handle_t *priv_handle = NULL;
     uint32_t dumpFileSize = 0;
@@ -523,37 +542,27 @@ c2_status_t C2VencComponent::LinearDataProc(std::shared_ptr<const C2ReadView> vi
         #endif
     }
     else {  //linear picture buffer
-        C2StreamPictureSizeInfo::input PicSize(0u, 16, 16);
-        C2StreamPixelFormatInfo::input InputFmt(0u, HAL_PIXEL_FORMAT_YCRCB_420_SP);
+        const InputSettings_t *pSettings = NULL;
 
-        c2_status_t err = intf()->query_vb({&PicSize,&InputFmt},{},C2_DONT_BLOCK,nullptr);
-        if (err == C2_BAD_INDEX) {
-            if (!PicSize || !InputFmt) {
-                C2Venc_LOG(CODEC2_VENC_LOG_ERR,"get PicSize or InputFmt failed!!");
-                return C2_BAD_VALUE;
-            }
-        } else if (err != C2_OK) {
-            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"get subclass param failed!!");
+        if (C2_OK != getInputSettings(&pSettings)) {
             return C2_BAD_VALUE;
         }
-        C2Venc_LOG(CODEC2_VENC_LOG_INFO,"get width:%d,height:%d,colorfmt:%d,ptr:%p",PicSize.width,PicSize.height,InputFmt.value,const_cast<uint8_t *>(view->data()));
+        C2Venc_LOG(CODEC2_VENC_LOG_INFO,"get width:%d,height:%d,colorfmt:%d,ptr:%p",pSettings->width,pSettings->height,pSettings->pixelFormat,const_cast<uint8_t *>(view->data()));
         pFrameInfo->bufType = VMALLOC;
-        codecFmtTrans(InputFmt.value,&pFrameInfo->colorFmt);
+        codecFmtTrans(pSettings->pixelFormat,&pFrameInfo->colorFmt);
         pFrameInfo->yPlane = const_cast<uint8_t *>(view->data());
-        pFrameInfo->uPlane = pFrameInfo->yPlane + PicSize.width * PicSize.height;
+        pFrameInfo->uPlane = pFrameInfo->yPlane + pSettings->width * pSettings->height;
         pFrameInfo->vPlane = pFrameInfo->uPlane;
-        pFrameInfo->yStride = PicSize.width;
-        pFrameInfo->uStride = PicSize.width;
-        pFrameInfo->vStride = PicSize.width;
+        pFrameInfo->yStride = pSettings->width;
+        pFrameInfo->uStride = pSettings->width;
+        pFrameInfo->vStride = pSettings->width;
     }
     if (mDumpYuvEnable) {
         if (pFrameInfo->bufType == DMA) {
-            uint8_t *pVirAddr = NULL;
-            pVirAddr = (uint8_t *)mmap( NULL, dumpFileSize,PROT_READ | PROT_WRITE, MAP_SHARED, pFrameInfo->shareFd[0], 0);
+            uint8_t *pVirAddr = mDumpMapCache.map(pFrameInfo->shareFd[0], dumpFileSize);
             if (pVirAddr) {
                 C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"dma mode,viraddr: %p", pVirAddr);
                 dumpDataToFile(mfdDumpInput,pVirAddr,dumpFileSize);
-                munmap(pVirAddr, dumpFileSize);
             }
         }
         else {
@@ -569,17 +578,9 @@ c2_status_t C2VencComponent::DMAProc(const native_handle_t*priv_handle,InputFram
         return C2_BAD_VALUE;
     }
 
-    C2StreamPictureSizeInfo::input PicSize(0u, 16, 16);
-    C2StreamPixelFormatInfo::input InputFmt(0u, HAL_PIXEL_FORMAT_YCRCB_420_SP);
+    const InputSettings_t *pSettings = NULL;
 
-    c2_status_t err = intf()->query_vb({&PicSize,&InputFmt},{},C2_DONT_BLOCK,nullptr);
-    if (err == C2_BAD_INDEX) {
-        if (!PicSize || !InputFmt) {
-            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"get PicSize or InputFmt failed!!");
-            return C2_BAD_VALUE;
-        }
-    } else if (err != C2_OK) {
-        C2Venc_LOG(CODEC2_VENC_LOG_ERR,"get subclass param failed!!");
+    if (C2_OK != getInputSettings(&pSettings)) {
         return C2_BAD_VALUE;
     }
 
@@ -599,53 +600,47 @@ c2_status_t C2VencComponent::DMAProc(const native_handle_t*priv_handle,InputFram
         case HAL_PIXEL_FORMAT_RGB_888:
             pFrameInfo->colorFmt = C2_ENC_FMT_RGBA8888;
             pFrameInfo->yStride = am_gralloc_get_stride_in_byte(priv_handle) / 4;
-            (*dumpFileSize) = pFrameInfo->yStride * PicSize.height * 4;
+            (*dumpFileSize) = pFrameInfo->yStride * pSettings->height * 4;
             break;
         case HAL_PIXEL_FORMAT_YCbCr_420_888:
         case HAL_PIXEL_FORMAT_YCrCb_420_SP:
             pFrameInfo->colorFmt = C2_ENC_FMT_NV21;
-            (*dumpFileSize) = pFrameInfo->yStride * PicSize.height * 3 / 2;
+            (*dumpFileSize) = pFrameInfo->yStride * pSettings->height * 3 / 2;
             break;
         case HAL_PIXEL_FORMAT_YV12:
             pFrameInfo->colorFmt = C2_ENC_FMT_YV12;
-            (*dumpFileSize) = pFrameInfo->yStride * PicSize.height * 3 / 2;
+            (*dumpFileSize) = pFrameInfo->yStride * pSettings->height * 3 / 2;
             break;
         default:
             pFrameInfo->colorFmt = C2_ENC_FMT_NV21;
-            (*dumpFileSize) = pFrameInfo->yStride * PicSize.height * 3 / 2;
+            (*dumpFileSize) = pFrameInfo->yStride * pSettings->height * 3 / 2;
             C2Venc_LOG(CODEC2_VENC_LOG_ERR,"cannot find support fmt %d,default:%d",format,pFrameInfo->colorFmt);
             break;
     }
     C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"yStride:%d,uStride:%d,vStride:%d,view->width():%d,view->height():%d,plane num:%d",
-    pFrameInfo->yStride,pFrameInfo->uStride,pFrameInfo->vStride,PicSize.width,PicSize.height,pFrameInfo->planeNum);
+    pFrameInfo->yStride,pFrameInfo->uStride,pFrameInfo->vStride,pSettings->width,pSettings->height,pFrameInfo->planeNum);
 
     return C2_OK;
 }
 
 c2_status_t C2VencComponent::CheckPicSize(std::shared_ptr<const C2GraphicView> view,uint64_t frameIndex) {
-    C2StreamPictureSizeInfo::input PicSize(0u, 16, 16);
-    c2_status_t err = intf()->query_vb({&PicSize},{},C2_DONT_BLOCK,nullptr);
-    if (err == C2_BAD_INDEX) {
-        if (!PicSize) {
-            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"get PicSize or InputFmt failed!!");
-            return C2_BAD_VALUE;
-        }
-    } else if (err != C2_OK) {
-        C2Venc_LOG(CODEC2_VENC_LOG_ERR,"get subclass param failed!!");
+    const InputSettings_t *pSettings = NULL;
+
+    if (C2_OK != getInputSettings(&pSettings)) {
         return C2_BAD_VALUE;
     }
 
-    if (PicSize.width != view->width() || PicSize.height != view->height()) {
+    if (pSettings->width != view->width() || pSettings->height != view->height()) {
         if (0 == frameIndex) {  //first frame is normally
-            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"pic size :%d x %d,this buffer is:%d x %d,change pic size...",PicSize.width,PicSize.height,view->width(),view->height());
-            PicSize.width = view->width();
-            PicSize.height = view->height();
+            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"pic size :%d x %d,this buffer is:%d x %d,change pic size...",pSettings->width,pSettings->height,view->width(),view->height());
+            C2StreamPictureSizeInfo::input PicSize(0u, view->width(), view->height());
 
             std::vector<std::unique_ptr<C2SettingResult>> failures;
-            err = intf()->config_vb({&PicSize}, C2_MAY_BLOCK, &failures);
+            intf()->config_vb({&PicSize}, C2_MAY_BLOCK, &failures);
+            invalidateInputSettings();
         }
         else {
-            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"buffer is not valid,pic size :%d x %d,but this buffer is:%d x %d",PicSize.width,PicSize.height,view->width(),view->height());
+            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"buffer is not valid,pic size :%d x %d,but this buffer is:%d x %d",pSettings->width,pSettings->height,view->width(),view->height());
             return C2_BAD_VALUE;
         }
     }
@@ -693,18 +688,39 @@ c2_status_t C2VencComponent::ViewDataProc(std::shared_ptr<const C2GraphicView> v
         }
         case C2PlanarLayout::TYPE_YUV: {
             C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"TYPE_YUV");
-            if (IsNV12(*view.get())) {
+            C2VencFormatConv::PassThroughFmt fmt = C2VencFormatConv::getPassThroughFmt(*view.get());
+            if (C2VencFormatConv::PASSTHROUGH_NV12 == fmt) {
                 pFrameInfo->colorFmt = C2_ENC_FMT_NV12;
                 C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"InputFrameInfo colorfmt :C2_ENC_FMT_NV12");
             }
-            else if (IsNV21(*view.get())) {
+            else if (C2VencFormatConv::PASSTHROUGH_NV21 == fmt) {
                 pFrameInfo->colorFmt = C2_ENC_FMT_NV21;
                 C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"InputFrameInfo colorfmt :C2_ENC_FMT_NV21");
             }
-            else if (IsI420(*view.get())) {
+            else if (C2VencFormatConv::PASSTHROUGH_I420 == fmt) {
                 pFrameInfo->colorFmt = C2_ENC_FMT_I420;
                 C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"InputFrameInfo colorfmt :C2_ENC_FMT_I420");
             }
+            else if (C2VencFormatConv::IsYUV420(*view.get())) {
+                //flexible or oddly pitched yuv420,normalize it to nv12
+                uint32_t stride = align_32(view->width());
+                size_t size = stride * view->height() * 3 / 2;
+                if (mConvertBuffer.size() < size) {
+                    mConvertBuffer.resize(size);
+                }
+                if (!C2VencFormatConv::convertToNV12(*view.get(),mConvertBuffer.data(),stride)) {
+                    C2Venc_LOG(CODEC2_VENC_LOG_ERR,"convert input to nv12 failed!!!");
+                    return C2_BAD_VALUE;
+                }
+                pFrameInfo->colorFmt = C2_ENC_FMT_NV12;
+                pFrameInfo->yPlane = mConvertBuffer.data();
+                pFrameInfo->uPlane = pFrameInfo->yPlane + stride * view->height();
+                pFrameInfo->vPlane = pFrameInfo->uPlane + 1;
+                pFrameInfo->yStride = stride;
+                pFrameInfo->uStride = stride;
+                pFrameInfo->vStride = stride;
+                C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"InputFrameInfo converted to C2_ENC_FMT_NV12,stride:%d",stride);
+            }
             else {
                 C2Venc_LOG(CODEC2_VENC_LOG_ERR,"type yuv,but not support fmt!!!");
             }
@@ -756,10 +772,10 @@ c2_status_t C2VencComponent::GraphicDataProc(std::shared_ptr<C2Buffer> inputBuff
             goto fail_process;
         }
 
-        C2VencCanvasMode::input CanvasInput(0u);
+        const InputSettings_t *pSettings = NULL;
 
-        c2_status_t err = intf()->query_vb({&CanvasInput},{},C2_DONT_BLOCK,nullptr);
-        if (err == C2_OK && CanvasInput.value == CANVAS_MODE_ENABLE) {
+        c2_status_t err = getInputSettings(&pSettings);
+        if (err == C2_OK && pSettings->canvasMode == CANVAS_MODE_ENABLE) {
             DataModeInfo_t *pDataMode = (DataModeInfo_t *)(view->data()[C2PlanarLayout::PLANE_Y]);
             if (kMetadataBufferTypeCanvasSource == pDataMode->type) {
                 C2Venc_LOG(CODEC2_VENC_LOG_INFO,"enter canvas mode!!");
@@ -786,12 +802,10 @@ c2_status_t C2VencComponent::GraphicDataProc(std::shared_ptr<C2Buffer> inputBuff
 
     if (mDumpYuvEnable) {
         if (pFrameInfo->bufType == DMA) {
-            uint8_t *pVirAddr = NULL;
-            pVirAddr = (uint8_t *)mmap( NULL, dumpFileSize,PROT_READ | PROT_WRITE, MAP_SHARED, pFrameInfo->shareFd[0], 0);
+            uint8_t *pVirAddr = mDumpMapCache.map(pFrameInfo->shareFd[0], dumpFileSize);
             if (pVirAddr) {
                 C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"dma mode,viraddr: %p", pVirAddr);
                 dumpDataToFile(mfdDumpInput,pVirAddr,dumpFileSize);
-                munmap(pVirAddr, dumpFileSize);
             }
         }
         else {
@@ -842,6 +856,7 @@ void C2VencComponent::ProcessData()
             std::vector<std::unique_ptr<C2SettingResult>> failures;
             c2_status_t err = intf()->config_vb(updates, C2_MAY_BLOCK, &failures);
             C2Venc_LOG(CODEC2_VENC_LOG_ERR,"applied %zu configUpdates => %s (%d)", updates.size(), asString(err), err);
+            invalidateInputSettings();
         }
     }
 
@@ -946,22 +961,22 @@ void C2VencComponent::ProcessData()
         return;
     }
 
-    if (!mSpsPpsHeaderReceived) {
-        uint32_t uHeaderLength = 0;
-        uint8_t header[128] = {0};
-        c2_status_t error = GenerateHeader(header,&uHeaderLength);
-        if (C2_OK != error) {
-            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"Encode header failed = 0x%x\n",error);
+    if (!mHeaderCache.isValid()) {
+        //generated in the output block,it is reused for the frame right after.
+        bool ok = mHeaderCache.generate((uint8_t *)wView.base(),wView.capacity(),
+                                        [this](uint8_t *pHeader,uint32_t *pSize) {
+                                            return C2_OK == GenerateHeader(pHeader,pSize);
+                                        });
+        if (!ok) {
+            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"Encode header failed");
             work->workletsProcessed = 1u;
             WorkDone(work);
             return;
         } else {
-            C2Venc_LOG(CODEC2_VENC_LOG_INFO,"Bytes Generated in header %d\n",uHeaderLength);
+            C2Venc_LOG(CODEC2_VENC_LOG_INFO,"Bytes Generated in header %u\n",mHeaderCache.size());
         }
 
-        mSpsPpsHeaderReceived = true;
-
-        std::unique_ptr<C2StreamInitDataInfo::output> csd = C2StreamInitDataInfo::output::AllocUnique(uHeaderLength, 0u);
+        std::unique_ptr<C2StreamInitDataInfo::output> csd = C2StreamInitDataInfo::output::AllocUnique(mHeaderCache.size(), 0u);
         if (!csd) {
             C2Venc_LOG(CODEC2_VENC_LOG_ERR,"CSD allocation failed");
             //mSignalledError = true;
@@ -970,10 +985,10 @@ void C2VencComponent::ProcessData()
             WorkDone(work);
             return;
         }
-        memcpy(csd->m.value, header, uHeaderLength);
+        memcpy(csd->m.value, mHeaderCache.data(), mHeaderCache.size());
         work->worklets.front()->output.configUpdate.push_back(std::move(csd));
         if (mDumpEsEnable) {
-            dumpDataToFile(mfdDumpOutput,header,uHeaderLength);
+            dumpDataToFile(mfdDumpOutput,(uint8_t *)mHeaderCache.data(),mHeaderCache.size());
         }
         if (work->input.buffers.empty()) {
             work->workletsProcessed = 1u;
@@ -983,12 +998,44 @@ void C2VencComponent::ProcessData()
         }
 
     }
+    //the frame goes behind the headroom,so the header of a key frame is written in front of it.
+    uint32_t headroom = isPrependHeader() ? mHeaderCache.getHeadroom() : 0;
     OutputFrameInfo_t OutInfo;
     memset(&OutInfo,0,sizeof(OutInfo));
-    OutInfo.Data = wView.base();
-    OutInfo.Length = wView.capacity();
+    OutInfo.Data = wView.base() + headroom;
+    OutInfo.Length = wView.capacity() - headroom;
+    if (mArbiterHandle >= 0) {
+        C2VencArbiter::Grant_t grant = mArbiter->acquire(mArbiterHandle);
+        if (grant.backPressure != mBackPressure) {
+            //the hardware budget is taken by sessions of higher priority.
+            C2Venc_LOG(CODEC2_VENC_LOG_INFO,"back pressure %s,waited %" PRId64 "us",
+                       grant.backPressure ? "on" : "off",grant.waitUs);
+            mBackPressure = grant.backPressure;
+            mBackPressureChanged = true;
+        }
+    }
+    nsecs_t encodeStart = systemTime(SYSTEM_TIME_MONOTONIC);
     c2_status_t res = ProcessOneFrame(InputFrameInfo,&OutInfo);
+    if (mArbiterHandle >= 0) {
+        mArbiter->release(mArbiterHandle,ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - encodeStart));
+        int64_t generation = getConfigGeneration();
+        if (generation < 0 || generation != mArbiterGeneration) {
+            //frame rate or priority may have changed.
+            C2VencArbiter::Session_t session;
+            memset(&session,0,sizeof(session));
+            getArbiterSession(&session);
+            mArbiter->updateSession(mArbiterHandle,session);
+            mArbiterGeneration = generation;
+        }
+    }
     if (C2_OK == res) {
+        OutInfo.Offset = headroom;
+        if (headroom > 0 && FRAMETYPE_IDR == OutInfo.FrameType) {
+            uint32_t headerSize = mHeaderCache.prepend(OutInfo.Data,OutInfo.Length,headroom);
+            OutInfo.Data -= headerSize;
+            OutInfo.Length += headerSize;
+            OutInfo.Offset -= headerSize;
+        }
         if (mDumpEsEnable) {
             dumpDataToFile(mfdDumpOutput,OutInfo.Data,OutInfo.Length);
         }
@@ -1007,16 +1054,31 @@ void C2VencComponent::ProcessData()
 void C2VencComponent::WorkDone(std::unique_ptr<C2Work> &work) {
      if (work->workletsProcessed != 0u) {
 
-        std::unique_ptr<C2Work> DoneWork = std::move(work);
-        std::list<std::unique_ptr<C2Work>> finishedWorks;
-        finishedWorks.emplace_back(std::move(DoneWork));
-        mListener->onWorkDone_nb(shared_from_this(), std::move(finishedWorks));
+        queueDoneWork(std::move(work));
     }
 }
 
 void C2VencComponent::ConfigParam(std::unique_ptr<C2Work> &work) {
     C2AndroidStreamAverageBlockQuantizationInfo::output mAverageBlockQuantization(0u,0);
     C2StreamPictureTypeInfo::output mPictureType(0u,C2Config::SYNC_FRAME);
+    C2StreamVencFrameRefInfo::output mFrameRefInfo(0u);
+    C2StreamVencIntraRefreshInfo::output mIntraRefreshInfo(0u);
+    //only the encoders which track them report these.
+    for (C2Param *param : std::vector<C2Param *>{&mFrameRefInfo,&mIntraRefreshInfo}) {
+        if (C2_OK == mIntf->query_vb({param},{},C2_DONT_BLOCK,nullptr)) {
+            work->worklets.front()->output.configUpdate.push_back(C2Param::Copy(*param));
+        }
+    }
+    if (mBackPressureChanged) {
+        //the client may lower the frame rate or size of a paced session.
+        C2StreamVencBackPressureInfo::output mBackPressureInfo(0u,0);
+        if (C2_OK == mIntf->query_vb({&mBackPressureInfo},{},C2_DONT_BLOCK,nullptr)) {
+            mBackPressureInfo.value = mBackPressure ? 1 : 0;
+            work->worklets.front()->output.configUpdate.push_back(
+                    C2Param::Copy(mBackPressureInfo));
+        }
+        mBackPressureChanged = false;
+    }
     c2_status_t err = mIntf->query_vb({&mAverageBlockQuantization,&mPictureType},{},C2_DONT_BLOCK,nullptr);
     if (err == C2_OK) {
         work->worklets.front()->output.configUpdate.push_back(
@@ -1032,8 +1094,12 @@ void C2VencComponent::ConfigParam(std::unique_ptr<C2Work> &work) {
 
 void C2VencComponent::finishWork(uint64_t workIndex, std::unique_ptr<C2Work> &work,
                               OutputFrameInfo_t OutFrameInfo) {
-    std::shared_ptr<C2Buffer> buffer = createLinearBuffer(mOutBlock, 0, OutFrameInfo.Length);
-    if (FRAMETYPE_IDR == OutFrameInfo.FrameType) {
+    std::shared_ptr<C2Buffer> buffer;
+    //a dropped frame finishes with no output buffer,not an empty one.
+    if (OutFrameInfo.Length > 0) {
+        buffer = createLinearBuffer(mOutBlock, OutFrameInfo.Offset, OutFrameInfo.Length);
+    }
+    if (buffer && FRAMETYPE_IDR == OutFrameInfo.FrameType) {
         C2Venc_LOG(CODEC2_VENC_LOG_INFO,"IDR frame produced");
         buffer->setInfo(std::make_shared<C2StreamPictureTypeMaskInfo::output>(0u /* stream id */, C2Config::SYNC_FRAME));
     }
@@ -1045,16 +1111,15 @@ void C2VencComponent::finishWork(uint64_t workIndex, std::unique_ptr<C2Work> &wo
             work->worklets.front()->output.flags = C2FrameData::FLAG_END_OF_STREAM;
         }
         work->worklets.front()->output.buffers.clear();
-        work->worklets.front()->output.buffers.push_back(buffer);
+        if (buffer) {
+            work->worklets.front()->output.buffers.push_back(buffer);
+        }
         work->worklets.front()->output.ordinal = work->input.ordinal;
         work->workletsProcessed = 1u;
     };
     fillWork(work);
     //std::list<std::unique_ptr<C2Work>> workItems
-    std::unique_ptr<C2Work> DoneWork = std::move(work);
-    std::list<std::unique_ptr<C2Work>> finishedWorks;
-    finishedWorks.emplace_back(std::move(DoneWork));
-    mListener->onWorkDone_nb(shared_from_this(), std::move(finishedWorks));
+    queueDoneWork(std::move(work));
     C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"finish this work,index:%" PRId64"",workIndex);
     #if 0
     if (work && c2_cntr64_t(workIndex) == work->input.ordinal.frameIndex) {
@@ -1140,6 +1205,58 @@ void *C2VencComponent::threadLoop() {
     return NULL;
 }
 
+void C2VencComponent::queueDoneWork(std::unique_ptr<C2Work> work) {
+    AutoMutex l(mOutputQueueLock);
+    mOutputQueue.push_back(std::move(work));
+    mOutputQueueCond.signal();
+}
+
+void C2VencComponent::waitOutputDelivered() {
+    AutoMutex l(mOutputQueueLock);
+    while ((!mOutputQueue.empty() || mOutputDelivering) && mOutputThread.isRunning()) {
+        if (mOutputDrainedCond.waitRelative(mOutputQueueLock,OUTPUT_DRAIN_TIMEOUT_NS) == ETIMEDOUT) {
+            C2Venc_LOG(CODEC2_VENC_LOG_ERR,"wait for output delivered timeout,left:%zu",mOutputQueue.size());
+            break;
+        }
+    }
+}
+
+// static
+void *C2VencComponent::runOutputLoop(void *arg) {
+    C2VencComponent *threadloop = static_cast<C2VencComponent *>(arg);
+    return threadloop->outputLoop();
+}
+
+void *C2VencComponent::outputLoop() {
+    while (!mOutputThread.exitRequested()) {
+        std::list<std::unique_ptr<C2Work>> finishedWorks;
+        {
+            AutoMutex l(mOutputQueueLock);
+            //exit is checked under the lock,stop_process signals after requesting it.
+            while (mOutputQueue.empty() && !mOutputThread.exitRequested()) {
+                mOutputQueueCond.wait(mOutputQueueLock);
+            }
+            if (mOutputQueue.empty()) {
+                break;
+            }
+            //deliver everything finished so far in one callback
+            finishedWorks.swap(mOutputQueue);
+            mOutputDelivering = true;
+        }
+        C2Venc_LOG(CODEC2_VENC_LOG_DEBUG,"deliver %zu finished works",finishedWorks.size());
+        mListener->onWorkDone_nb(shared_from_this(), std::move(finishedWorks));
+        {
+            AutoMutex l(mOutputQueueLock);
+            mOutputDelivering = false;
+            if (mOutputQueue.empty()) {
+                mOutputDrainedCond.broadcast();
+            }
+        }
+    }
+    C2Venc_LOG(CODEC2_VENC_LOG_INFO,"outputLoop exit done!");
+    return NULL;
+}
+
 std::shared_ptr<C2Buffer> C2VencComponent::createLinearBuffer(
         const std::shared_ptr<C2LinearBlock> &block, size_t offset, size_t size) {
     return C2Buffer::CreateLinearBuffer(block->share(offset, size, ::C2Fence()));
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "C2VencDmaMapCache"
+#include <utils/Log.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <string.h>
+
+#include <C2VencDmaMapCache.h>
+
+namespace android {
+
+C2VencDmaMapCache::C2VencDmaMapCache(uint32_t maxEntries, size_t maxBytes)
+    : mMaxEntries(maxEntries),
+      mMaxBytes(maxBytes),
+      mMappedBytes(0),
+      mHitCount(0),
+      mMissCount(0) {
+}
+
+C2VencDmaMapCache::~C2VencDmaMapCache() {
+    clear();
+}
+
+bool C2VencDmaMapCache::getIdentity(int fd, dev_t *dev, ino_t *ino) {
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        return false;
+    }
+    *dev = st.st_dev;
+    *ino = st.st_ino;
+    return true;
+}
+
+void C2VencDmaMapCache::unmapEntry(MapEntry_t &entry) {
+    if (munmap(entry.addr, entry.size) < 0) {
+        ALOGE("munmap(base = %p, size = %zu) failed: %s", entry.addr, entry.size, strerror(errno));
+    }
+    mMappedBytes -= entry.size;
+}
+
+void C2VencDmaMapCache::trim(size_t incoming) {
+    while (!mEntries.empty() &&
+           (mEntries.size() >= mMaxEntries || mMappedBytes + incoming > mMaxBytes)) {
+        unmapEntry(mEntries.back());
+        mEntries.pop_back();
+    }
+}
+
+uint8_t *C2VencDmaMapCache::map(int fd, size_t size) {
+    dev_t dev;
+    ino_t ino;
+
+    if (size == 0 || !getIdentity(fd, &dev, &ino)) {
+        return NULL;
+    }
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+        if (it->dev != dev || it->ino != ino) {
+            continue;
+        }
+        if (it->size >= size) {
+            mHitCount++;
+            if (it != mEntries.begin()) {
+                mEntries.splice(mEntries.begin(), mEntries, it);
+            }
+            return mEntries.front().addr;
+        }
+        //same buffer but mapped smaller before,map it again
+        unmapEntry(*it);
+        mEntries.erase(it);
+        break;
+    }
+
+    mMissCount++;
+    uint8_t *addr = (uint8_t *)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        ALOGE("mmap fd:%d size:%zu failed: %s", fd, size, strerror(errno));
+        return NULL;
+    }
+    if (size > mMaxBytes) {
+        //kept as the only entry,the next miss drops it
+        ALOGD("mapping size:%zu exceeds cache limit:%zu", size, mMaxBytes);
+    }
+    trim(size);
+    MapEntry_t entry = {dev, ino, addr, size};
+    mEntries.push_front(entry);
+    mMappedBytes += size;
+    ALOGV("new mapping fd:%d ino:%lu size:%zu,entries:%zu,mapped:%zu",
+          fd, (unsigned long)ino, size, mEntries.size(), mMappedBytes);
+    return addr;
+}
+
+void C2VencDmaMapCache::invalidate(int fd) {
+    dev_t dev;
+    ino_t ino;
+
+    if (!getIdentity(fd, &dev, &ino)) {
+        return;
+    }
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+        if (it->dev == dev && it->ino == ino) {
+            unmapEntry(*it);
+            mEntries.erase(it);
+            return;
+        }
+    }
+}
+
+void C2VencDmaMapCache::clear() {
+    for (auto &entry : mEntries) {
+        unmapEntry(entry);
+    }
+    mEntries.clear();
+    if (mHitCount || mMissCount) {
+        ALOGD("dma map cache hit:%u miss:%u", mHitCount, mMissCount);
+    }
+    mHitCount = 0;
+    mMissCount = 0;
+}
+
+}  // namespace android
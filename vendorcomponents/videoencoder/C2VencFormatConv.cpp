@@ -0,0 +1,220 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "C2VencFormatConv"
+#include <utils/Log.h>
+
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define C2VENC_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define C2VENC_USE_SSE2 1
+#endif
+
+#include <C2VencFormatConv.h>
+
+namespace android {
+
+bool C2VencFormatConv::IsYUV420(const C2GraphicView &view) {
+    const C2PlanarLayout &layout = view.layout();
+    return (layout.numPlanes == 3
+            && layout.type == C2PlanarLayout::TYPE_YUV
+            && layout.planes[layout.PLANE_Y].channel == C2PlaneInfo::CHANNEL_Y
+            && layout.planes[layout.PLANE_Y].allocatedDepth == 8
+            && layout.planes[layout.PLANE_Y].bitDepth == 8
+            && layout.planes[layout.PLANE_Y].rightShift == 0
+            && layout.planes[layout.PLANE_Y].colSampling == 1
+            && layout.planes[layout.PLANE_Y].rowSampling == 1
+            && layout.planes[layout.PLANE_U].channel == C2PlaneInfo::CHANNEL_CB
+            && layout.planes[layout.PLANE_U].allocatedDepth == 8
+            && layout.planes[layout.PLANE_U].bitDepth == 8
+            && layout.planes[layout.PLANE_U].rightShift == 0
+            && layout.planes[layout.PLANE_U].colSampling == 2
+            && layout.planes[layout.PLANE_U].rowSampling == 2
+            && layout.planes[layout.PLANE_V].channel == C2PlaneInfo::CHANNEL_CR
+            && layout.planes[layout.PLANE_V].allocatedDepth == 8
+            && layout.planes[layout.PLANE_V].bitDepth == 8
+            && layout.planes[layout.PLANE_V].rightShift == 0
+            && layout.planes[layout.PLANE_V].colSampling == 2
+            && layout.planes[layout.PLANE_V].rowSampling == 2);
+}
+
+bool C2VencFormatConv::IsNV12(const C2GraphicView &view) {
+    if (!IsYUV420(view)) {
+        return false;
+    }
+    const C2PlanarLayout &layout = view.layout();
+    return (layout.rootPlanes == 2
+            && layout.planes[layout.PLANE_U].colInc == 2
+            && layout.planes[layout.PLANE_U].rootIx == layout.PLANE_U
+            && layout.planes[layout.PLANE_U].offset == 0
+            && layout.planes[layout.PLANE_V].colInc == 2
+            && layout.planes[layout.PLANE_V].rootIx == layout.PLANE_U
+            && layout.planes[layout.PLANE_V].offset == 1);
+}
+
+bool C2VencFormatConv::IsNV21(const C2GraphicView &view) {
+    if (!IsYUV420(view)) {
+        return false;
+    }
+    const C2PlanarLayout &layout = view.layout();
+    return (layout.rootPlanes == 2
+            && layout.planes[layout.PLANE_U].colInc == 2
+            && layout.planes[layout.PLANE_U].rootIx == layout.PLANE_V
+            && layout.planes[layout.PLANE_U].offset == 1
+            && layout.planes[layout.PLANE_V].colInc == 2
+            && layout.planes[layout.PLANE_V].rootIx == layout.PLANE_V
+            && layout.planes[layout.PLANE_V].offset == 0);
+}
+
+bool C2VencFormatConv::IsI420(const C2GraphicView &view) {
+    if (!IsYUV420(view)) {
+        return false;
+    }
+    const C2PlanarLayout &layout = view.layout();
+    return (layout.rootPlanes == 3
+            && layout.planes[layout.PLANE_U].colInc == 1
+            && layout.planes[layout.PLANE_U].rootIx == layout.PLANE_U
+            && layout.planes[layout.PLANE_U].offset == 0
+            && layout.planes[layout.PLANE_V].colInc == 1
+            && layout.planes[layout.PLANE_V].rootIx == layout.PLANE_V
+            && layout.planes[layout.PLANE_V].offset == 0);
+}
+
+C2VencFormatConv::PassThroughFmt C2VencFormatConv::getPassThroughFmt(const C2GraphicView &view) {
+    const C2PlanarLayout &layout = view.layout();
+    int32_t yStride = layout.planes[C2PlanarLayout::PLANE_Y].rowInc;
+    int32_t uStride = layout.planes[C2PlanarLayout::PLANE_U].rowInc;
+    int32_t vStride = layout.planes[C2PlanarLayout::PLANE_V].rowInc;
+
+    if (layout.planes[C2PlanarLayout::PLANE_Y].colInc != 1) {
+        return PASSTHROUGH_NONE;
+    }
+    //the encoders only get the luma pitch,chroma pitch is derived from it
+    if (IsNV12(view) && uStride == yStride) {
+        return PASSTHROUGH_NV12;
+    }
+    if (IsNV21(view) && vStride == yStride) {
+        return PASSTHROUGH_NV21;
+    }
+    if (IsI420(view) && uStride * 2 == yStride && vStride == uStride) {
+        return PASSTHROUGH_I420;
+    }
+    return PASSTHROUGH_NONE;
+}
+
+void C2VencFormatConv::interleaveUV(const uint8_t *pU, const uint8_t *pV, uint8_t *pDst, uint32_t width) {
+    uint32_t i = 0;
+#if defined(C2VENC_USE_NEON)
+    for (; i + 16 <= width; i += 16) {
+        uint8x16x2_t uv;
+        uv.val[0] = vld1q_u8(pU + i);
+        uv.val[1] = vld1q_u8(pV + i);
+        vst2q_u8(pDst + 2 * i, uv);
+    }
+#elif defined(C2VENC_USE_SSE2)
+    for (; i + 16 <= width; i += 16) {
+        __m128i u = _mm_loadu_si128((const __m128i *)(pU + i));
+        __m128i v = _mm_loadu_si128((const __m128i *)(pV + i));
+        _mm_storeu_si128((__m128i *)(pDst + 2 * i), _mm_unpacklo_epi8(u, v));
+        _mm_storeu_si128((__m128i *)(pDst + 2 * i + 16), _mm_unpackhi_epi8(u, v));
+    }
+#endif
+    for (; i < width; i++) {
+        pDst[2 * i] = pU[i];
+        pDst[2 * i + 1] = pV[i];
+    }
+}
+
+void C2VencFormatConv::swapUV(const uint8_t *pSrc, uint8_t *pDst, uint32_t width) {
+    uint32_t i = 0;
+#if defined(C2VENC_USE_NEON)
+    for (; i + 8 <= width; i += 8) {
+        vst1q_u8(pDst + 2 * i, vrev16q_u8(vld1q_u8(pSrc + 2 * i)));
+    }
+#elif defined(C2VENC_USE_SSE2)
+    for (; i + 8 <= width; i += 8) {
+        __m128i vu = _mm_loadu_si128((const __m128i *)(pSrc + 2 * i));
+        _mm_storeu_si128((__m128i *)(pDst + 2 * i),
+                         _mm_or_si128(_mm_slli_epi16(vu, 8), _mm_srli_epi16(vu, 8)));
+    }
+#endif
+    for (; i < width; i++) {
+        pDst[2 * i] = pSrc[2 * i + 1];
+        pDst[2 * i + 1] = pSrc[2 * i];
+    }
+}
+
+bool C2VencFormatConv::convertToNV12(const C2GraphicView &view, uint8_t *pDst, uint32_t dstStride) {
+    if (!IsYUV420(view) || NULL == pDst || dstStride < view.width()) {
+        ALOGE("can not convert this layout to nv12,dstStride:%d,width:%d", dstStride, view.width());
+        return false;
+    }
+    const C2PlanarLayout &layout = view.layout();
+    const C2PlaneInfo &yInfo = layout.planes[C2PlanarLayout::PLANE_Y];
+    const C2PlaneInfo &uInfo = layout.planes[C2PlanarLayout::PLANE_U];
+    const C2PlaneInfo &vInfo = layout.planes[C2PlanarLayout::PLANE_V];
+    const uint8_t *pY = view.data()[C2PlanarLayout::PLANE_Y];
+    const uint8_t *pU = view.data()[C2PlanarLayout::PLANE_U];
+    const uint8_t *pV = view.data()[C2PlanarLayout::PLANE_V];
+    uint32_t width = view.width();
+    uint32_t height = view.height();
+    uint32_t chromaWidth = (width + 1) / 2;
+    uint32_t chromaHeight = (height + 1) / 2;
+    uint8_t *pDstUV = pDst + dstStride * height;
+
+    for (uint32_t row = 0; row < height; row++) {
+        const uint8_t *src = pY + row * yInfo.rowInc;
+        uint8_t *dst = pDst + row * dstStride;
+        if (yInfo.colInc == 1) {
+            memcpy(dst, src, width);
+        }
+        else {
+            for (uint32_t col = 0; col < width; col++) {
+                dst[col] = src[col * yInfo.colInc];
+            }
+        }
+    }
+
+    for (uint32_t row = 0; row < chromaHeight; row++) {
+        const uint8_t *srcU = pU + row * uInfo.rowInc;
+        const uint8_t *srcV = pV + row * vInfo.rowInc;
+        uint8_t *dst = pDstUV + row * dstStride;
+        if (uInfo.colInc == 1 && vInfo.colInc == 1) {
+            interleaveUV(srcU, srcV, dst, chromaWidth);
+        }
+        else if (uInfo.colInc == 2 && vInfo.colInc == 2 && srcV == srcU + 1) {
+            memcpy(dst, srcU, chromaWidth * 2);
+        }
+        else if (uInfo.colInc == 2 && vInfo.colInc == 2 && srcU == srcV + 1) {
+            swapUV(srcV, dst, chromaWidth);
+        }
+        else {
+            for (uint32_t col = 0; col < chromaWidth; col++) {
+                dst[2 * col] = srcU[col * uInfo.colInc];
+                dst[2 * col + 1] = srcV[col * vInfo.colInc];
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace android
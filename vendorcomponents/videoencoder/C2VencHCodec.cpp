@@ -36,9 +36,9 @@
 #include <Codec2BufferUtils.h>
 #include <SimpleC2Interface.h>
 #include <util/C2InterfaceHelper.h>
-#include <dlfcn.h>
 #include "C2VendorSupport.h"
 #include "C2VencHCodec.h"
+#include "C2VencLibRegistry.h"
 
 
 namespace android {
@@ -69,6 +69,7 @@ uint32_t C2VencHCodec::mInstanceID = 0;
 #define DEFAULT_MAX_SRCH_RANGE_X    256
 #define DEFAULT_MAX_SRCH_RANGE_Y    256
 #define DEFAULT_MAX_FRAMERATE       120000
+#define HCODEC_LIB_NAME             "lib_avc_vpcodec.so"
 #define DEFAULT_NUM_CORES           1
 #define DEFAULT_NUM_CORES_PRE_ENC   0
 #define DEFAULT_FPS                 30
@@ -267,6 +268,13 @@ public:
             .withSetter(Setter<decltype(*mFrameRate)>::StrictValueWithNoDeps)
             .build());
 
+    addParameter(
+            DefineParam(mPriority, C2_PARAMKEY_PRIORITY)
+            .withDefault(new C2RealTimePriorityTuning(0))
+            .withFields({C2F(mPriority, value).any()})
+            .withSetter(Setter<decltype(*mPriority)>::StrictValueWithNoDeps)
+            .build());
+
     addParameter(
             DefineParam(mBitrate, C2_PARAMKEY_BITRATE)
             .withDefault(new C2StreamBitrateInfo::output(0u, 64000))
@@ -381,6 +389,13 @@ public:
             .withSetter(Setter<decltype(*mAverageBlockQuantization)>::StrictValueWithNoDeps)
             .build());
 
+    addParameter(
+            DefineParam(mBackPressure, C2_PARAMKEY_VENDOR_VENC_BACK_PRESSURE)
+            .withDefault(new C2StreamVencBackPressureInfo::output(0u, 0))
+            .withFields({C2F(mBackPressure, value).oneOf({0, 1})})
+            .withSetter(Setter<decltype(*mBackPressure)>::StrictValueWithNoDeps)
+            .build());
+
 
     // TODO: support more formats?
     std::vector<uint32_t> pixelFormats;
@@ -665,6 +680,7 @@ public:
     }
 
     std::shared_ptr<C2StreamPictureSizeInfo::input> getSize() const { return mSize; }
+    std::shared_ptr<C2RealTimePriorityTuning> getPriority() const { return mPriority; }
     std::shared_ptr<C2StreamIntraRefreshTuning::output> getIntraRefresh() const { return mIntraRefresh; }
     std::shared_ptr<C2StreamFrameRateInfo::output> getFrameRate() const { return mFrameRate; }
     std::shared_ptr<C2StreamBitrateInfo::output> getBitrate() const { return mBitrate; }
@@ -679,8 +695,20 @@ public:
     std::shared_ptr<C2VencCanvasMode::input> getCanvasMode() const{return mVencCanvasMode; };
     void setAverageQp(int value){mAverageBlockQuantization->value = value;}
     void setPictureType(C2Config::picture_type_t type){mPictureType->value = type;}
+    c2_status_t config(
+            const std::vector<C2Param*> &params, c2_blocking_t mayBlock,
+            std::vector<std::unique_ptr<C2SettingResult>>* const failures,
+            bool updateParams = true,
+            std::vector<std::shared_ptr<C2Param>> *changes = nullptr) {
+        c2_status_t result = C2InterfaceHelper::config(params, mayBlock, failures, updateParams, changes);
+        mConfigGeneration++;
+        return result;
+    }
+    int64_t getConfigGeneration() const { return mConfigGeneration.load(); }
 private:
+    std::atomic<int64_t> mConfigGeneration{0};
     std::shared_ptr<C2StreamPictureSizeInfo::input> mSize;
+    std::shared_ptr<C2RealTimePriorityTuning> mPriority;
     std::shared_ptr<C2StreamUsageTuning::input> mUsage;
     std::shared_ptr<C2StreamFrameRateInfo::output> mFrameRate;
     std::shared_ptr<C2StreamRequestSyncFrameTuning::output> mRequestSync;
@@ -699,6 +727,7 @@ private:
     std::shared_ptr<C2VencCanvasMode::input> mVencCanvasMode;
     std::shared_ptr<C2AndroidStreamAverageBlockQuantizationInfo::output> mAverageBlockQuantization;
     std::shared_ptr<C2StreamPictureTypeInfo::output> mPictureType;
+    std::shared_ptr<C2StreamVencBackPressureInfo::output> mBackPressure;
 
 };
 
@@ -733,7 +762,8 @@ C2VencHCodec::C2VencHCodec(const char *name, c2_node_id_t id, const std::shared_
               mtimeStampBak(0),
               mFrameRateValue(0),
               mBitrateBk(0),
-              mBitRate(0) {
+              mBitRate(0),
+              mConfigGeneration(-1) {
     ALOGD("C2VencHCodec constructor!");
     propGetInt(CODEC2_VENC_LOGDEBUG_PROPERTY, &gloglevel);
     propGetInt(CODEC2_ONLY_VENC_LOGDEBUG_PROPERTY,&gloglevel_encoder);
@@ -771,55 +801,17 @@ bool C2VencHCodec::isSupportCanvas() {
 
 bool C2VencHCodec::LoadModule() {
     ALOGD("C2VencHCodec initModule!,LOG_INFO:%d,gloglevel:%d",CODEC2_VENC_LOG_INFO,gloglevel);
-    void *handle = nullptr;
-    handle = dlopen("lib_avc_vpcodec.so", RTLD_NOW);
-    if (handle != nullptr) {
-        mInitFunc = NULL;
-        mInitFunc = (fn_vl_video_encoder_init)dlsym(handle, "vl_video_encoder_init");
-        if (mInitFunc == NULL) {
-            C2HCodec_LOG(CODEC2_VENC_LOG_ERR,"dlsym for vl_video_encoder_init failed");
-            dlclose(handle);
-            return false;
-        }
-
-        mEncHeaderFunc = NULL;
-        mEncHeaderFunc = (fn_vl_video_encode_header)dlsym(handle, "vl_video_encode_header");
-        if (mEncHeaderFunc == NULL) {
-            C2HCodec_LOG(CODEC2_VENC_LOG_ERR,"dlsym for vl_video_encode_header failed");
-            dlclose(handle);
-            return false;
-        }
-
-        mEncFrameFunc = NULL;
-        mEncFrameFunc = (fn_vl_video_encoder_encode_frame)dlsym(handle, "vl_video_encoder_encode_frame");
-        if (mEncFrameFunc == NULL) {
-            C2HCodec_LOG(CODEC2_VENC_LOG_ERR,"dlsym for vl_video_encode_header failed");
-            dlclose(handle);
-            return false;
-        }
-        mEncFrameQpFunc =NULL;
-        mEncFrameQpFunc = (fn_vl_video_encoder_getavgqp)dlsym(handle,"vl_video_encoder_getavgqp");
-        if (mEncFrameQpFunc == NULL) {
-            C2HCodec_LOG(CODEC2_VENC_LOG_ERR,"dlsym for vl_video_encoder_getavgqp failed");
-            dlclose(handle);
-            return false;
-        }
-
-        mDestroyFunc = NULL;
-        mDestroyFunc = (fn_vl_video_encoder_destroy)dlsym(handle,"vl_video_encoder_destroy");
-        if (mDestroyFunc == NULL) {
-            C2HCodec_LOG(CODEC2_VENC_LOG_ERR,"dlsym for vl_video_encoder_destroy failed");
-            dlclose(handle);
-            return false;
-        }
-    } else {
-        C2HCodec_LOG(CODEC2_VENC_LOG_ERR,"dlopen for lib_avc_vpcodec.so failed");
+    C2VencLibRegistry::Symbol_t symbols[] = {
+        {"vl_video_encoder_init", true, (void **)&mInitFunc},
+        {"vl_video_encode_header", true, (void **)&mEncHeaderFunc},
+        {"vl_video_encoder_encode_frame", true, (void **)&mEncFrameFunc},
+        {"vl_video_encoder_getavgqp", true, (void **)&mEncFrameQpFunc},
+        {"vl_video_encoder_destroy", true, (void **)&mDestroyFunc},
+    };
+    if (!C2VencLibRegistry::getInstance().bind(HCODEC_LIB_NAME, symbols, sizeof(symbols) / sizeof(symbols[0]))) {
+        C2HCodec_LOG(CODEC2_VENC_LOG_ERR,"load lib_avc_vpcodec.so failed");
         return false;
     }
-    /*
-     * This is the logic, no need to modify, ignore coverity weak cryptor report.
-     */
-     /*coverity[leaked_storage:SUPPRESS]*/
     return true;
 }
 
@@ -974,6 +966,7 @@ c2_status_t C2VencHCodec::Init() {
     mSyncFramePeriod = mIntfImpl->getIFrameInterval();
     mPrependHeader = mIntfImpl->getPrependHeader();
     mVencCanvasMode = mIntfImpl->getCanvasMode();
+    mConfigGeneration = -1;
     mIDRInterval = (mSyncFramePeriod->value / 1000000) * mFrameRate->value; //max_int:just one i frame,0:all i frame
 
     C2HCodec_LOG(CODEC2_VENC_LOG_INFO,"canvas mode:%d",mVencCanvasMode->value);
@@ -1140,6 +1133,31 @@ c2_status_t C2VencHCodec::getQp(int32_t *i_qp_max,int32_t *i_qp_min,int32_t *p_q
 }
 
 
+int64_t C2VencHCodec::getConfigGeneration() {
+    return mIntfImpl->getConfigGeneration();
+}
+
+
+C2VencArbiter *C2VencHCodec::getArbiter() {
+    return &C2VencArbiter::getInstance(HCODEC_LIB_NAME,1,0);
+}
+
+
+void C2VencHCodec::getArbiterSession(C2VencArbiter::Session_t *pSession) {
+    IntfImpl::Lock lock = mIntfImpl->lock();
+    pSession->priority = mIntfImpl->getPriority()->value;
+    pSession->width = mIntfImpl->getSize()->width;
+    pSession->height = mIntfImpl->getSize()->height;
+    pSession->frameRate = mIntfImpl->getFrameRate()->value;
+}
+
+
+bool C2VencHCodec::isPrependHeader() {
+    //the library is not asked to put the header before the key frames.
+    return mPrependHeader && C2Config::PREPEND_HEADER_TO_ALL_SYNC == mPrependHeader->value;
+}
+
+
 c2_status_t C2VencHCodec::ProcessOneFrame(InputFrameInfo_t InputFrameInfo,OutputFrameInfo_t *pOutFrameInfo) {
     C2HCodec_LOG(CODEC2_VENC_LOG_DEBUG,"C2VencHCodec ProcessOneFrame! yPlane:%p,uPlane:%p,vPlane:%p",InputFrameInfo.yPlane,InputFrameInfo.uPlane,InputFrameInfo.vPlane);
     vl_enc_result_e ret = ENC_SUCCESS;
@@ -1153,12 +1171,19 @@ c2_status_t C2VencHCodec::ProcessOneFrame(InputFrameInfo_t InputFrameInfo,Output
         return C2_BAD_VALUE;
     }
     memset(&inputInfo,0,sizeof(inputInfo));
-    IntfImpl::Lock lock = mIntfImpl->lock();
-    //std::shared_ptr<C2StreamIntraRefreshTuning::output> intraRefresh = mIntfImpl->getIntraRefresh();
-    std::shared_ptr<C2StreamBitrateInfo::output> bitrate = mIntfImpl->getBitrate();
-    std::shared_ptr<C2StreamRequestSyncFrameTuning::output> requestSync = mIntfImpl->getRequestSync();
-    mFrameRate = mIntfImpl->getFrameRate();
-    lock.unlock();
+    int64_t generation = mIntfImpl->getConfigGeneration();
+    if (generation != mConfigGeneration) {
+        //only touch the interface lock when some config was applied since last frame
+        IntfImpl::Lock lock = mIntfImpl->lock();
+        //std::shared_ptr<C2StreamIntraRefreshTuning::output> intraRefresh = mIntfImpl->getIntraRefresh();
+        mCurBitrate = mIntfImpl->getBitrate();
+        mCurRequestSync = mIntfImpl->getRequestSync();
+        mFrameRate = mIntfImpl->getFrameRate();
+        lock.unlock();
+        mConfigGeneration = generation;
+    }
+    std::shared_ptr<C2StreamBitrateInfo::output> bitrate = mCurBitrate;
+    std::shared_ptr<C2StreamRequestSyncFrameTuning::output> requestSync = mCurRequestSync;
 
     inputInfo.frame_type = FRAME_TYPE_P;
     if (requestSync != mRequestSync) {
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "C2VencHeaderCache"
+#include <utils/Log.h>
+
+#include <string.h>
+
+#include <C2VencHeaderCache.h>
+
+namespace android {
+
+#define HEADER_HEADROOM_ALIGN   64    //keep the encoder output cache line aligned
+#define HEADER_NAL_SCAN_MAX     64
+
+C2VencHeaderCache::C2VencHeaderCache()
+    : mValid(false),
+      mNalHeader(-1),
+      mPrependCount(0) {
+}
+
+void C2VencHeaderCache::invalidate() {
+    mValid = false;
+}
+
+// static
+int32_t C2VencHeaderCache::getFirstNalHeader(const uint8_t *data, uint32_t size) {
+    uint32_t end = (size < HEADER_NAL_SCAN_MAX) ? size : HEADER_NAL_SCAN_MAX;
+    for (uint32_t i = 0; i + 3 < end; i++) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            return data[i + 3];
+        }
+    }
+    return -1;
+}
+
+bool C2VencHeaderCache::generate(uint8_t *buf, uint32_t capacity, const Generator_t &gen) {
+    uint32_t size = 0;
+    if (!buf || capacity == 0) {
+        return false;
+    }
+    if (!gen(buf, &size) || size == 0) {
+        ALOGE("generate header failed");
+        return false;
+    }
+    if (size > capacity) {
+        //the buffer was overrun already,nothing after it can be trusted.
+        ALOGE("header of %u bytes does not fit in %u bytes", size, capacity);
+        return false;
+    }
+    mData.assign(buf, buf + size);
+    mNalHeader = getFirstNalHeader(buf, size);
+    mValid = true;
+    ALOGD("header of %u bytes generated,first nal:0x%x", size, mNalHeader);
+    return true;
+}
+
+uint32_t C2VencHeaderCache::getHeadroom() const {
+    if (!mValid) {
+        return 0;
+    }
+    return (size() + HEADER_HEADROOM_ALIGN - 1) & ~(HEADER_HEADROOM_ALIGN - 1);
+}
+
+uint32_t C2VencHeaderCache::prepend(uint8_t *pFrame, uint32_t frameSize, uint32_t headroom) {
+    if (!mValid || size() > headroom) {
+        return 0;
+    }
+    //some encoders put the header before the key frames by themselves.
+    if (mNalHeader >= 0 && getFirstNalHeader(pFrame, frameSize) == mNalHeader) {
+        ALOGV("key frame has the header already");
+        return 0;
+    }
+    memcpy(pFrame - size(), mData.data(), size());
+    mPrependCount++;
+    return size();
+}
+
+}  // namespace android
@@ -18,7 +18,7 @@
 #include <SimpleC2Interface.h>
 #include <util/C2InterfaceHelper.h>
 #include "C2VencIntfImpl.h"
-#include <dlfcn.h>
+#include "C2VencLibRegistry.h"
 
 
 namespace android {
@@ -132,17 +132,15 @@ int ColorFormatSupprt[] = {
 
 
 bool C2VencComp::IntfImpl::Load() {
-    mLibHandle = dlopen(kComponentLoadMediaProcessLibrary.c_str(), RTLD_NOW | RTLD_NODELETE);
-    if (mLibHandle == nullptr) {
-        ALOGD("Could not dlopen %s: %s", kComponentLoadMediaProcessLibrary.c_str(), dlerror());
+    C2VencLibRegistry::Symbol_t symbols[] = {
+        {"VencParamGetInstance", true, (void **)&mCreateMethod},
+        {"VencParamDelInstance", true, (void **)&mDestroyMethod},
+    };
+    if (!C2VencLibRegistry::getInstance().bind(kComponentLoadMediaProcessLibrary.c_str(), symbols,
+                                               sizeof(symbols) / sizeof(symbols[0]))) {
+        ALOGD("Could not load %s", kComponentLoadMediaProcessLibrary.c_str());
         return false;
     }
-    ALOGE("IntfImpl::mLibHandle:%p",mLibHandle);
-    mCreateMethod = (C2VencParamCreateInstance)dlsym(
-                mLibHandle, "VencParamGetInstance");
-
-    mDestroyMethod = (C2VencParamDestroyInstance)dlsym(
-                mLibHandle, "VencParamDelInstance");
 
     if (!mCreateMethod || !mDestroyMethod) {
         ALOGE("load library failed,mCreateMethod:%p,mDestroyMethod:%p",mCreateMethod,mDestroyMethod);
@@ -174,11 +172,6 @@ void C2VencComp::IntfImpl::unLoad() {
         ALOGE("Destroy mAmlVencParam");
         mDestroyMethod(mAmlVencParam);
     }
-
-    if (mLibHandle) {
-        ALOGE("Unloading dll");
-        dlclose(mLibHandle);
-    }
 }
 
 
@@ -191,7 +184,6 @@ C2VencComp::IntfImpl::IntfImpl(C2String name,C2String mimetype,const std::shared
             C2Component::DOMAIN_VIDEO,
             mimetype),
       mAmlVencParam(NULL),
-      mLibHandle(NULL),
       mCreateMethod(NULL),
       mDestroyMethod(NULL) {
 
@@ -896,57 +888,173 @@ c2_status_t C2VencComp::IntfImpl::config(
 
 
 
+void C2VencComp::IntfImpl::filterUnchangedParams(const std::vector<C2Param*> &params,
+                                                 std::vector<C2Param*> *changed) {
+    for (C2Param *param : params) {
+        if (param == NULL) {
+            continue;
+        }
+        //a sync frame request is an event,it is sent even with the same value.
+        if (param->index() == C2StreamRequestSyncFrameTuning::output::PARAM_TYPE) {
+            changed->push_back(param);
+            continue;
+        }
+        std::vector<std::unique_ptr<C2Param>> current;
+        c2_status_t err = C2InterfaceHelper::query({}, {param->index()}, C2_DONT_BLOCK, &current);
+        //a param which can not be read back is applied as it is.
+        if (err == C2_OK && current.size() == 1 && current[0] != nullptr
+            && current[0]->size() == param->size()
+            && memcmp(current[0].get(), param, param->size()) == 0) {
+            continue;
+        }
+        changed->push_back(param);
+    }
+}
+
 void C2VencComp::IntfImpl::ParamUpdate() {
-    stColorAspect ColorAspect;
-    stProfileLevelInfo ProfileLevelInfo;
-    stVencParam VencParam;
-    stSVCInfo SvcInfo;
-    memset(&SvcInfo,0,sizeof(SvcInfo));
+    stVencParam NewParam;
+    memset(&NewParam,0,sizeof(NewParam));
+    mAmlVencParam->GetVencParam(NewParam);
+    getVencParam(&NewParam);
+    NewParam.SyncFrameRequest = (C2_TRUE == mRequestSync->value) ? true : false;
+    pushVencParam(NewParam, false);
+}
+
+c2_status_t C2VencComp::IntfImpl::stageConfig(const std::vector<C2Param*> &params, stVencParam *pParam) {
+    std::vector<std::unique_ptr<C2SettingResult>> failures;
+    //the base config only,the encoder is told when the frame of the work is next.
+    c2_status_t err = C2InterfaceHelper::config(params, C2_DONT_BLOCK, &failures);
+    memset(pParam,0,sizeof(*pParam));
+    mAmlVencParam->GetVencParam(*pParam);
+    getVencParam(pParam);
+    //only the work which asks for it requests a sync frame,the interface value
+    //stays set until the encoder made one.
+    pParam->SyncFrameRequest = false;
+    for (C2Param *param : params) {
+        if (param && param->index() == C2StreamRequestSyncFrameTuning::output::PARAM_TYPE
+            && C2_TRUE == ((C2StreamRequestSyncFrameTuning::output *)param)->value) {
+            pParam->SyncFrameRequest = true;
+        }
+    }
+    return err;
+}
 
-    mAmlVencParam->GetVencParam(VencParam);
-    mAmlVencParam->SetSize(mSize->width,mSize->height);
-    mAmlVencParam->SetBitrate(mBitrate->value);
+void C2VencComp::IntfImpl::applyStagedParam(const stVencParam &Param) {
+    pushVencParam(Param, true);
+}
+
+void C2VencComp::IntfImpl::getVencParam(stVencParam *pParam) {
+    pParam->Width = mSize->width;
+    pParam->Height = mSize->height;
+    pParam->Bitrate = mBitrate->value;
     //mIntfImpl->GetVencParam()->SetGopSize(mIntfImpl->getGop()->value);
-    mAmlVencParam->SetFrameRate(mFrameRate->value);
-    mAmlVencParam->SetPixFormat(mPixelFormat->value);
-    mAmlVencParam->SetSyncFrameRequest((C2_TRUE == mRequestSync->value) ? true : false);
-    mAmlVencParam->SetCanvasMode(mVencCanvasMode->value);
-    mAmlVencParam->SetSyncPeriodSize(mSyncFramePeriod->value);
-    mAmlVencParam->SetCanvasMode(mVencCanvasMode->value ? 1 : 0);
-
-    ColorAspect.range = mCodedColorAspects->range;
-    ColorAspect.primaries = mCodedColorAspects->primaries;
-    ColorAspect.transfer = mCodedColorAspects->transfer;
-    ColorAspect.matrix = mCodedColorAspects->matrix;
-    mAmlVencParam->SetColorAspect(ColorAspect);
-
-    ProfileLevelInfo.profile = mProfileLevel->profile;
-    ProfileLevelInfo.level = mProfileLevel->level;
-    mAmlVencParam->SetProfileLevel(ProfileLevelInfo);
+    pParam->FrameRate = mFrameRate->value;
+    pParam->PixFormat = mPixelFormat->value;
+    pParam->canvas_mode = mVencCanvasMode->value ? 1 : 0;
+    pParam->SyncFramePeriod = mSyncFramePeriod->value;
+
+    pParam->ColorAspect.range = mCodedColorAspects->range;
+    pParam->ColorAspect.primaries = mCodedColorAspects->primaries;
+    pParam->ColorAspect.transfer = mCodedColorAspects->transfer;
+    pParam->ColorAspect.matrix = mCodedColorAspects->matrix;
+
+    pParam->ProfileLevel.profile = mProfileLevel->profile;
+    pParam->ProfileLevel.level = mProfileLevel->level;
 
     for (size_t i = 0; i < mPictureQuantization->flexCount(); ++i) {
         const C2PictureQuantizationStruct &layer = mPictureQuantization->m.values[i];
-        VencParam.QpInfo.enable = true;
+        pParam->QpInfo.enable = true;
         if (layer.type_ == C2Config::picture_type_t(I_FRAME)) {
-            VencParam.QpInfo.iMax = layer.max;
-            VencParam.QpInfo.iMin = layer.min;
-            ALOGV("iMin %d iMax %d", VencParam.QpInfo.iMin, VencParam.QpInfo.iMax);
+            pParam->QpInfo.iMax = layer.max;
+            pParam->QpInfo.iMin = layer.min;
+            ALOGV("iMin %d iMax %d", pParam->QpInfo.iMin, pParam->QpInfo.iMax);
         } else if (layer.type_ == C2Config::picture_type_t(P_FRAME)) {
-            VencParam.QpInfo.pMax = layer.max;
-            VencParam.QpInfo.pMin = layer.min;
-            ALOGV("pMin %d pMax %d", VencParam.QpInfo.pMin, VencParam.QpInfo.pMax);
+            pParam->QpInfo.pMax = layer.max;
+            pParam->QpInfo.pMin = layer.min;
+            ALOGV("pMin %d pMax %d", pParam->QpInfo.pMin, pParam->QpInfo.pMax);
         } else if (layer.type_ == C2Config::picture_type_t(B_FRAME)) {
-            VencParam.QpInfo.bMax = layer.max;
-            VencParam.QpInfo.bMin = layer.min;
-            ALOGV("bMin %d bMax %d", VencParam.QpInfo.bMin, VencParam.QpInfo.bMax);
+            pParam->QpInfo.bMax = layer.max;
+            pParam->QpInfo.bMin = layer.min;
+            ALOGV("bMin %d bMax %d", pParam->QpInfo.bMin, pParam->QpInfo.bMax);
         }
     }
-    mAmlVencParam->SetQpInfo(VencParam.QpInfo);
-    ALOGD("update Qp Info,min:%d,max:%d!!",VencParam.QpInfo.QpMin,VencParam.QpInfo.QpMax);
+    pParam->LayerCnt = (int)mLayerCount->m.layerCount;
+}
+
+// static
+bool C2VencComp::IntfImpl::isQpInfoEqual(const stQpInfo &a, const stQpInfo &b) {
+    //field by field,the padding after enable is not initialized.
+    return a.enable == b.enable && a.QpMin == b.QpMin && a.QpMax == b.QpMax
+        && a.iMin == b.iMin && a.iMax == b.iMax && a.pMin == b.pMin && a.pMax == b.pMax
+        && a.bMin == b.bMin && a.bMax == b.bMax;
+}
+
+uint32_t C2VencComp::IntfImpl::pushVencParam(const stVencParam &NewParam, bool KeepPendingSync) {
+    stVencParam CurParam;
+    stSVCInfo SvcInfo;
+    uint32_t Changed = 0;
+    memset(&SvcInfo,0,sizeof(SvcInfo));
+    memset(&CurParam,0,sizeof(CurParam));
+
+    //only the fields which differ from the encoder's current values are pushed,
+    //each setter may notify the encoder.
+    mAmlVencParam->GetVencParam(CurParam);
+
+    if (NewParam.Width != CurParam.Width || NewParam.Height != CurParam.Height) {
+        mAmlVencParam->SetSize(NewParam.Width,NewParam.Height);
+        Changed |= PARAM_CHANGE_SIZE;
+    }
+    if (NewParam.Bitrate != CurParam.Bitrate) {
+        mAmlVencParam->SetBitrate(NewParam.Bitrate);
+        Changed |= PARAM_CHANGE_BITRATE;
+    }
+    if (NewParam.FrameRate != CurParam.FrameRate) {
+        mAmlVencParam->SetFrameRate(NewParam.FrameRate);
+        Changed |= PARAM_CHANGE_FRAMERATE;
+    }
+    if (NewParam.PixFormat != CurParam.PixFormat) {
+        mAmlVencParam->SetPixFormat(NewParam.PixFormat);
+        Changed |= PARAM_CHANGE_PIXFORMAT;
+    }
+    //a pending request is sent again,the encoder clears it when the sync frame is out.
+    if (NewParam.SyncFrameRequest
+        || (!KeepPendingSync && NewParam.SyncFrameRequest != CurParam.SyncFrameRequest)) {
+        mAmlVencParam->SetSyncFrameRequest(NewParam.SyncFrameRequest);
+        Changed |= PARAM_CHANGE_SYNC_REQUEST;
+    }
+    if (NewParam.canvas_mode != CurParam.canvas_mode) {
+        mAmlVencParam->SetCanvasMode(NewParam.canvas_mode);
+        Changed |= PARAM_CHANGE_CANVAS_MODE;
+    }
+    if (NewParam.SyncFramePeriod != CurParam.SyncFramePeriod) {
+        mAmlVencParam->SetSyncPeriodSize(NewParam.SyncFramePeriod);
+        Changed |= PARAM_CHANGE_SYNC_PERIOD;
+    }
+    if (NewParam.ColorAspect.range != CurParam.ColorAspect.range
+        || NewParam.ColorAspect.primaries != CurParam.ColorAspect.primaries
+        || NewParam.ColorAspect.transfer != CurParam.ColorAspect.transfer
+        || NewParam.ColorAspect.matrix != CurParam.ColorAspect.matrix) {
+        mAmlVencParam->SetColorAspect(NewParam.ColorAspect);
+        Changed |= PARAM_CHANGE_COLOR_ASPECT;
+    }
+    if (NewParam.ProfileLevel.profile != CurParam.ProfileLevel.profile
+        || NewParam.ProfileLevel.level != CurParam.ProfileLevel.level) {
+        mAmlVencParam->SetProfileLevel(NewParam.ProfileLevel);
+        Changed |= PARAM_CHANGE_PROFILE_LEVEL;
+    }
+    if (!isQpInfoEqual(NewParam.QpInfo, CurParam.QpInfo)) {
+        mAmlVencParam->SetQpInfo(NewParam.QpInfo);
+        Changed |= PARAM_CHANGE_QP;
+        ALOGD("update Qp Info,min:%d,max:%d!!",NewParam.QpInfo.QpMin,NewParam.QpInfo.QpMax);
+    }
 
-    if (mAmlVencParam->GetSVCLimit(SvcInfo) && SvcInfo.enable) {
-        mAmlVencParam->SetLayerCnt(mLayerCount->m.layerCount);
+    if (mAmlVencParam->GetSVCLimit(SvcInfo) && SvcInfo.enable
+        && NewParam.LayerCnt != CurParam.LayerCnt) {
+        mAmlVencParam->SetLayerCnt(NewParam.LayerCnt);
+        Changed |= PARAM_CHANGE_LAYER_COUNT;
     }
+    ALOGV("param update changed:0x%x", Changed);
+    return Changed;
 }
 
 
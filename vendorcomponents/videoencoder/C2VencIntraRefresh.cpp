@@ -0,0 +1,88 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "C2VencIntraRefresh"
+#include <utils/Log.h>
+
+#include <C2VencIntraRefresh.h>
+
+namespace android {
+
+C2VencIntraRefresh::C2VencIntraRefresh()
+    : mMode(MODE_NONE),
+      mPeriod(0),
+      mArg(0),
+      mCycleLength(0),
+      mPosition(0) {
+}
+
+void C2VencIntraRefresh::configure(Mode_e mode, uint32_t periodFrames, uint32_t width, uint32_t height,
+                                   uint32_t blockSize) {
+    uint32_t units = 0;
+    uint32_t cols = 0;
+    uint32_t rows = 0;
+
+    mMode = MODE_NONE;
+    mPeriod = 0;
+    mArg = 0;
+    mCycleLength = 0;
+    mPosition = 0;
+    if (mode == MODE_NONE || periodFrames == 0 || blockSize == 0 || width == 0 || height == 0) {
+        return;
+    }
+
+    cols = (width + blockSize - 1) / blockSize;
+    rows = (height + blockSize - 1) / blockSize;
+    if (mode == MODE_ROW) {
+        units = rows;
+    } else if (mode == MODE_COLUMN) {
+        units = cols;
+    } else if (mode == MODE_STEP) {
+        units = rows * cols;
+    } else {
+        ALOGW("refresh mode %d is not supported", mode);
+        return;
+    }
+    //a period longer than the picture still refreshes one unit per frame.
+    mArg = (units + periodFrames - 1) / periodFrames;
+    mCycleLength = (units + mArg - 1) / mArg;
+    mMode = mode;
+    mPeriod = periodFrames;
+    ALOGV("mode %d period %u units %u -> arg %d cycle %u", mode, periodFrames, units, mArg, mCycleLength);
+}
+
+C2VencIntraRefresh::CycleInfo_t C2VencIntraRefresh::onFrameEncoded(bool keyFrame) {
+    CycleInfo_t info = {false, 0, 0, false, false};
+    if (mMode == MODE_NONE) {
+        return info;
+    }
+    info.enabled = true;
+    info.length = mCycleLength;
+    if (keyFrame) {
+        //the refresh starts over after a key frame.
+        mPosition = 0;
+        return info;
+    }
+    mPosition = (mPosition % mCycleLength) + 1;
+    info.position = mPosition;
+    info.cycleStart = (mPosition == 1);
+    info.cycleEnd = (mPosition == mCycleLength);
+    return info;
+}
+
+}  // namespace android
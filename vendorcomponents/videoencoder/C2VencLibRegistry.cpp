@@ -0,0 +1,243 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "C2VencLibRegistry"
+#include <utils/Log.h>
+#include <utils/Timers.h>
+#include <cutils/properties.h>
+
+#include <dlfcn.h>
+#include <inttypes.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <thread>
+
+#include <C2VendorProperty.h>
+#include <C2VencLibRegistry.h>
+
+namespace android {
+
+#define WARM_CONTEXT_EXPIRE_US      (10 * 1000000ll)
+#define WARM_CONTEXT_MAX            4
+
+static int64_t getNowUs() {
+    return ns2us(systemTime(SYSTEM_TIME_MONOTONIC));
+}
+
+// static
+C2VencLibRegistry &C2VencLibRegistry::getInstance() {
+    //never deleted,the pooled contexts must not be destroyed at exit.
+    static C2VencLibRegistry *sInstance = new C2VencLibRegistry();
+    return *sInstance;
+}
+
+C2VencLibRegistry::C2VencLibRegistry()
+    : mReaperStarted(false),
+      mMaxContexts(0),
+      mOpenCount(0) {
+    int32_t maxContexts = property_get_int32(C2_PROPERTY_VENC_WARM_CONTEXTS, 0);
+    mMaxContexts = (uint32_t)std::max(0, std::min(maxContexts, WARM_CONTEXT_MAX));
+    ALOGD("warm encoder contexts:%u", mMaxContexts);
+}
+
+bool C2VencLibRegistry::bind(const char *libName, const Symbol_t *symbols, size_t count) {
+    std::vector<void *> funcs(count, nullptr);
+    std::lock_guard<std::mutex> lock(mLock);
+
+    Library_t &lib = mLibraries[libName];
+    if (lib.handle == nullptr) {
+        lib.handle = dlopen(libName, RTLD_NOW | RTLD_NODELETE);
+        if (lib.handle == nullptr) {
+            ALOGE("dlopen for %s failed,err:%s", libName, dlerror());
+            mLibraries.erase(libName);
+            return false;
+        }
+        mOpenCount++;
+        ALOGD("%s loaded", libName);
+    }
+    for (size_t i = 0; i < count; i++) {
+        std::map<std::string, void *>::iterator it = lib.symbols.find(symbols[i].name);
+        if (it == lib.symbols.end()) {
+            it = lib.symbols.insert(std::make_pair(std::string(symbols[i].name),
+                                                   dlsym(lib.handle, symbols[i].name))).first;
+        }
+        funcs[i] = it->second;
+        if (funcs[i] == nullptr && symbols[i].required) {
+            ALOGE("dlsym for %s in %s failed", symbols[i].name, libName);
+            return false;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        *symbols[i].func = funcs[i];
+    }
+    return true;
+}
+
+void C2VencLibRegistry::collectExpired(int64_t nowUs, std::list<Context_t> *expired) {
+    std::list<Context_t>::iterator it = mContexts.begin();
+    while (it != mContexts.end()) {
+        if (nowUs - it->putTimeUs >= WARM_CONTEXT_EXPIRE_US) {
+            std::list<Context_t>::iterator next = std::next(it);
+            expired->splice(expired->end(), mContexts, it);
+            it = next;
+        } else {
+            ++it;
+        }
+    }
+}
+
+// static
+void C2VencLibRegistry::destroyContexts(std::list<Context_t> *contexts) {
+    for (Context_t &ctx : *contexts) {
+        ALOGD("destroy warm context 0x%" PRIxPTR " of %s", ctx.context, ctx.libName.c_str());
+        ctx.destroy(ctx.context);
+    }
+    contexts->clear();
+}
+
+void C2VencLibRegistry::putContext(const char *libName, const void *key, size_t keySize, uintptr_t context,
+                                   const std::function<void(uintptr_t)> &destroy) {
+    std::list<Context_t> expired;
+    int64_t nowUs = getNowUs();
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        collectExpired(nowUs, &expired);
+        if (mMaxContexts > 0) {
+            if (mContexts.size() >= mMaxContexts) {
+                //the oldest one is the least likely to be asked for again.
+                expired.splice(expired.end(), mContexts, mContexts.begin());
+            }
+            Context_t ctx;
+            ctx.libName = libName;
+            ctx.key.assign((const uint8_t *)key, (const uint8_t *)key + keySize);
+            ctx.context = context;
+            ctx.destroy = destroy;
+            ctx.putTimeUs = nowUs;
+            mContexts.push_back(ctx);
+            ALOGD("keep warm context 0x%" PRIxPTR " of %s,pooled:%zu", context, libName, mContexts.size());
+            context = 0;
+            if (!mReaperStarted) {
+                //the registry is never deleted,neither is the thread.
+                std::thread(&C2VencLibRegistry::reaperLoop, this).detach();
+                mReaperStarted = true;
+            }
+            mCond.notify_all();
+        }
+    }
+    destroyContexts(&expired);
+    if (context != 0) {
+        destroy(context);
+    }
+}
+
+bool C2VencLibRegistry::takeContext(const char *libName, const void *key, size_t keySize, uintptr_t *context) {
+    std::list<Context_t> expired;
+    bool found = false;
+    int64_t nowUs = getNowUs();
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        collectExpired(nowUs, &expired);
+        for (std::list<Context_t>::iterator it = mContexts.begin(); it != mContexts.end(); ++it) {
+            if (it->libName == libName && it->key.size() == keySize && !memcmp(it->key.data(), key, keySize)) {
+                *context = it->context;
+                mContexts.erase(it);
+                found = true;
+                break;
+            }
+        }
+    }
+    destroyContexts(&expired);
+    if (found) {
+        ALOGD("reuse warm context 0x%" PRIxPTR " of %s", *context, libName);
+    }
+    return found;
+}
+
+void C2VencLibRegistry::flushContexts() {
+    std::list<Context_t> contexts;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        contexts.swap(mContexts);
+    }
+    destroyContexts(&contexts);
+}
+
+void C2VencLibRegistry::addSession(const char *libName) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mSessions[libName]++;
+}
+
+void C2VencLibRegistry::removeSession(const char *libName) {
+    std::list<Context_t> contexts;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        std::map<std::string, uint32_t>::iterator it = mSessions.find(libName);
+        if (it == mSessions.end()) {
+            return;
+        }
+        if (--it->second > 0) {
+            return;
+        }
+        mSessions.erase(it);
+        //nobody is left to take them,give the hardware back.
+        std::list<Context_t>::iterator ctx = mContexts.begin();
+        while (ctx != mContexts.end()) {
+            std::list<Context_t>::iterator next = std::next(ctx);
+            if (ctx->libName == libName) {
+                contexts.splice(contexts.end(), mContexts, ctx);
+            }
+            ctx = next;
+        }
+    }
+    destroyContexts(&contexts);
+}
+
+void C2VencLibRegistry::reaperLoop() {
+    std::unique_lock<std::mutex> lock(mLock);
+    while (true) {
+        if (mContexts.empty()) {
+            mCond.wait(lock);
+            continue;
+        }
+        int64_t nowUs = getNowUs();
+        int64_t waitUs = mContexts.front().putTimeUs + WARM_CONTEXT_EXPIRE_US - nowUs;
+        if (waitUs > 0) {
+            mCond.wait_for(lock, std::chrono::microseconds(waitUs));
+            continue;
+        }
+        std::list<Context_t> expired;
+        collectExpired(nowUs, &expired);
+        lock.unlock();
+        destroyContexts(&expired);
+        lock.lock();
+    }
+}
+
+uint32_t C2VencLibRegistry::getOpenCount() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mOpenCount;
+}
+
+size_t C2VencLibRegistry::getContextCount() {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mContexts.size();
+}
+
+}  // namespace android
@@ -34,9 +34,12 @@
 #include <Codec2BufferUtils.h>
 #include <SimpleC2Interface.h>
 #include <util/C2InterfaceHelper.h>
-#include <dlfcn.h>
+#include <cutils/properties.h>
+#include <math.h>
+#include <utils/Timers.h>
 #include "C2VendorSupport.h"
 #include "C2VencMulti.h"
+#include "C2VencLibRegistry.h"
 
 namespace android {
 
@@ -56,6 +59,18 @@ constexpr static size_t kLinearBufferSize = 5 * 1024 * 1024;
 #define ENC_ENABLE_ROI_FEATURE      0x1
 #define ENC_ENABLE_PARA_UPDATE      0x2 //enable dynamic settings
 #define ENC_ENABLE_LONG_TERM_REF    0x80
+#define ENC_MAX_ROI_REGIONS         32
+#define ENC_ROI_BLOCK_SIZE_AVC      16
+#define ENC_ROI_BLOCK_SIZE_HEVC     32
+#define ENC_ROI_BASE_QP_HYSTERESIS  3 //rebuild the qp hint table only when avg qp moves this much
+#define ENC_REFRESH_BLOCK_SIZE_AVC  16 //intra refresh unit,mb for avc and ctu for hevc
+#define ENC_REFRESH_BLOCK_SIZE_HEVC 64
+#define ENC_RC_MAX_BITRATE          12000000 //upper bound of the bitrate param
+#define ENC_RC_MAX_DELTA_QP         10 //qp spread inside a frame left to the encoder
+#define ENC_MULTI_LIB_NAME          "libvpcodec.so"
+#define ENC_STATS_FRAMES            256 //frames kept in the statistics ring
+#define ENCODER_PROP_DUMP_DATA      "debug.vendor.media.c2.venc.dump_data"
+#define ENABLE_DUMP_STATS           (1 << 2) //bit 0 and 1 are the es and yuv dump of C2VencComponent
 
 #define MAX_INPUT_BUFFER_HEADERS 4
 #define MAX_CONVERSION_BUFFERS   4
@@ -270,6 +285,13 @@ public:
             .withSetter(Setter<decltype(*mFrameRate)>::StrictValueWithNoDeps)
             .build());
 
+    addParameter(
+            DefineParam(mPriority, C2_PARAMKEY_PRIORITY)
+            .withDefault(new C2RealTimePriorityTuning(0))
+            .withFields({C2F(mPriority, value).any()})
+            .withSetter(Setter<decltype(*mPriority)>::StrictValueWithNoDeps)
+            .build());
+
     addParameter(
             DefineParam(mBitrate, C2_PARAMKEY_BITRATE)
             .withDefault(new C2StreamBitrateInfo::output(0u, 64000))
@@ -277,6 +299,28 @@ public:
             .withSetter(BitrateSetter)
             .build());
 
+    addParameter(
+            DefineParam(mBitrateMode, C2_PARAMKEY_BITRATE_MODE)
+            .withDefault(new C2StreamBitrateModeTuning::output(0u, C2Config::BITRATE_CONST))
+            .withFields({C2F(mBitrateMode, value).oneOf({
+                    C2Config::BITRATE_CONST, C2Config::BITRATE_VARIABLE, C2Config::BITRATE_IGNORE})})
+            .withSetter(Setter<decltype(*mBitrateMode)>::StrictValueWithNoDeps)
+            .build());
+
+    addParameter(
+            DefineParam(mQuality, C2_PARAMKEY_QUALITY)
+            .withDefault(new C2StreamQualityTuning::output(0u, 80))
+            .withFields({C2F(mQuality, value).inRange(0, 100)})
+            .withSetter(Setter<decltype(*mQuality)>::StrictValueWithNoDeps)
+            .build());
+
+    addParameter(
+            DefineParam(mMaxBitrate, C2_PARAMKEY_VENDOR_VENC_MAX_BITRATE)
+            .withDefault(new C2StreamVencMaxBitrate::output(0u, 0))
+            .withFields({C2F(mMaxBitrate, value).inRange(0, ENC_RC_MAX_BITRATE)})
+            .withSetter(Setter<decltype(*mMaxBitrate)>::StrictValueWithNoDeps)
+            .build());
+
     addParameter(
             DefineParam(mIntraRefresh, C2_PARAMKEY_INTRA_REFRESH)
             .withDefault(new C2StreamIntraRefreshTuning::output(
@@ -289,6 +333,26 @@ public:
             .withSetter(IntraRefreshSetter)
             .build());
 
+    addParameter(
+            DefineParam(mRoiRegions, C2_PARAMKEY_VENDOR_VENC_ROI_REGIONS)
+            .withDefault(C2StreamVencRoiRegions::output::AllocShared(
+                    0 /* flexCount */, 0u /* stream */))
+            .withFields({C2F(mRoiRegions, m.values[0].left).any(),
+                         C2F(mRoiRegions, m.values[0].top).any(),
+                         C2F(mRoiRegions, m.values[0].width).any(),
+                         C2F(mRoiRegions, m.values[0].height).any(),
+                         C2F(mRoiRegions, m.values[0].qpDelta).inRange(-51, 51)})
+            .withSetter(RoiRegionsSetter)
+            .build());
+
+    mQpOffsetMap = C2StreamVencQpOffsetMap::output::AllocShared(0);
+    addParameter(
+            DefineParam(mQpOffsetMap, C2_PARAMKEY_VENDOR_VENC_QP_OFFSET_MAP)
+            .withDefault(mQpOffsetMap)
+            .withFields({C2F(mQpOffsetMap, m.value).any()})
+            .withSetter(Setter<decltype(*mQpOffsetMap)>::NonStrictValuesWithNoDeps)
+            .build());
+
     if (mimetype == MEDIA_MIMETYPE_VIDEO_AVC) {
         onAvcProfileLevelParam();
     }
@@ -394,7 +458,8 @@ public:
             .withFields({C2F(mMaxInputSize, value).any()})
             .calculatedAs(MaxSizeCalculator)
             .build());
-#if USE_SVC
+
+    //without USE_SVC the layers are planned by the component.
     addParameter(
             DefineParam(mLayerCount, C2_PARAMKEY_TEMPORAL_LAYERING)
             .withDefault(C2StreamTemporalLayeringTuning::output::AllocShared(0u, 0, 0, 0))
@@ -402,7 +467,71 @@ public:
                          C2F(mLayerCount, m.bLayerCount).any()})
             .withSetter(LayerCountSetter)
             .build());
-#endif
+
+    addParameter(
+            DefineParam(mMaxLayer, C2_PARAMKEY_VENDOR_VENC_MAX_LAYER)
+            .withDefault(new C2StreamVencMaxLayer::output(0u, -1))
+            .withFields({C2F(mMaxLayer, value).inRange(-1, C2VencRefPlanner::kMaxLayers - 1)})
+            .withSetter(Setter<decltype(*mMaxLayer)>::StrictValueWithNoDeps)
+            .build());
+
+    addParameter(
+            DefineParam(mLtrInterval, C2_PARAMKEY_VENDOR_VENC_LTR_INTERVAL)
+            .withDefault(new C2StreamVencLtrInterval::output(0u, 0))
+            .withFields({C2F(mLtrInterval, value).any()})
+            .withSetter(Setter<decltype(*mLtrInterval)>::StrictValueWithNoDeps)
+            .build());
+
+    addParameter(
+            DefineParam(mLtrRecovery, C2_PARAMKEY_VENDOR_VENC_LTR_RECOVERY)
+            .withDefault(new C2StreamVencLtrRecovery::output(0u, 0))
+            .withFields({C2F(mLtrRecovery, value).oneOf({0, 1})})
+            .withSetter(Setter<decltype(*mLtrRecovery)>::StrictValueWithNoDeps)
+            .build());
+
+    addParameter(
+            DefineParam(mFrameRefInfo, C2_PARAMKEY_VENDOR_VENC_FRAME_REF_INFO)
+            .withDefault(new C2StreamVencFrameRefInfo::output(0u, 0, 0, 0, 0))
+            .withFields({C2F(mFrameRefInfo, layerId).any(),
+                         C2F(mFrameRefInfo, ltrMark).any(),
+                         C2F(mFrameRefInfo, ltrUse).any(),
+                         C2F(mFrameRefInfo, dropped).any()})
+            .withSetter(Setter<decltype(*mFrameRefInfo)>::NonStrictValuesWithNoDeps)
+            .build());
+
+    addParameter(
+            DefineParam(mIntraRefreshInfo, C2_PARAMKEY_VENDOR_VENC_INTRA_REFRESH_INFO)
+            .withDefault(new C2StreamVencIntraRefreshInfo::output(0u, 0, 0, 0, 0))
+            .withFields({C2F(mIntraRefreshInfo, position).any(),
+                         C2F(mIntraRefreshInfo, length).any(),
+                         C2F(mIntraRefreshInfo, cycleStart).any(),
+                         C2F(mIntraRefreshInfo, cycleEnd).any()})
+            .withSetter(Setter<decltype(*mIntraRefreshInfo)>::NonStrictValuesWithNoDeps)
+            .build());
+
+    addParameter(
+            DefineParam(mStats, C2_PARAMKEY_VENDOR_VENC_STATS)
+            .withDefault(new C2StreamVencStats::output(0u))
+            .withFields({C2F(mStats, frames).any(),
+                         C2F(mStats, idrFrames).any(),
+                         C2F(mStats, pFrames).any(),
+                         C2F(mStats, droppedFrames).any(),
+                         C2F(mStats, maxFrameBytes).any(),
+                         C2F(mStats, avgEncodeTimeUs).any(),
+                         C2F(mStats, maxEncodeTimeUs).any(),
+                         C2F(mStats, avgQp).any(),
+                         C2F(mStats, bitrate).any(),
+                         C2F(mStats, targetBitrate).any(),
+                         C2F(mStats, rcErrorPercent).any()})
+            .withSetter(Setter<decltype(*mStats)>::NonStrictValuesWithNoDeps)
+            .build());
+
+    addParameter(
+            DefineParam(mBackPressure, C2_PARAMKEY_VENDOR_VENC_BACK_PRESSURE)
+            .withDefault(new C2StreamVencBackPressureInfo::output(0u, 0))
+            .withFields({C2F(mBackPressure, value).oneOf({0, 1})})
+            .withSetter(Setter<decltype(*mBackPressure)>::StrictValueWithNoDeps)
+            .build());
 
 }
 
@@ -682,6 +811,17 @@ public:
         return res;
     }
 
+    static C2R RoiRegionsSetter(bool mayBlock, C2P<C2StreamVencRoiRegions::output> &me) {
+        (void)mayBlock;
+        for (size_t i = 0; i < me.v.flexCount(); ++i) {
+            const C2VencRoiRegionStruct &region = me.v.m.values[i];
+            if (region.qpDelta < -51 || region.qpDelta > 51) {
+                me.set().m.values[i].qpDelta = std::min(std::max(region.qpDelta, -51), 51);
+            }
+        }
+        return C2R::Ok();
+    }
+
     static C2R GopSetter(bool mayBlock, C2P<C2StreamGopTuning::output> &me) {
         (void)mayBlock;
         for (size_t i = 0; i < me.v.flexCount(); ++i) {
@@ -793,9 +933,13 @@ public:
     }
 
     std::shared_ptr<C2StreamPictureSizeInfo::input> getSize() const { return mSize; }
+    std::shared_ptr<C2RealTimePriorityTuning> getPriority() const { return mPriority; }
     std::shared_ptr<C2StreamIntraRefreshTuning::output> getIntraRefresh() const { return mIntraRefresh; }
     std::shared_ptr<C2StreamFrameRateInfo::output> getFrameRate() const { return mFrameRate; }
     std::shared_ptr<C2StreamBitrateInfo::output> getBitrate() const { return mBitrate; }
+    std::shared_ptr<C2StreamBitrateModeTuning::output> getBitrateMode() const { return mBitrateMode; }
+    std::shared_ptr<C2StreamQualityTuning::output> getQuality() const { return mQuality; }
+    std::shared_ptr<C2StreamVencMaxBitrate::output> getMaxBitrate() const { return mMaxBitrate; }
     std::shared_ptr<C2StreamRequestSyncFrameTuning::output> getRequestSync() const { return mRequestSync; }
     std::shared_ptr<C2StreamGopTuning::output> getGop() const { return mGop; }
     std::shared_ptr<C2StreamPictureQuantizationTuning::output> getPictureQuantization() const { return mPictureQuantization; }
@@ -806,15 +950,98 @@ public:
     std::shared_ptr<C2VencCanvasMode::input> getCanvasMode() const{return mVencCanvasMode; };
     std::shared_ptr<C2PrependHeaderModeSetting> getPrependHeader() const {return mPrependHeader; }
     std::shared_ptr<C2StreamTemporalLayeringTuning::output> getLayerCount() const {return mLayerCount; }
+    std::shared_ptr<C2StreamVencRoiRegions::output> getRoiRegions() const {return mRoiRegions; }
+    std::shared_ptr<C2StreamVencQpOffsetMap::output> getQpOffsetMap() const {return mQpOffsetMap; }
+    std::shared_ptr<C2StreamVencMaxLayer::output> getMaxLayer() const {return mMaxLayer; }
+    std::shared_ptr<C2StreamVencLtrInterval::output> getLtrInterval() const {return mLtrInterval; }
+    std::shared_ptr<C2StreamVencLtrRecovery::output> getLtrRecovery() const {return mLtrRecovery; }
+    void setFrameRefInfo(const C2VencRefPlanner::FrameRef_t &ref) {
+        mFrameRefInfo->layerId = ref.layerId;
+        mFrameRefInfo->ltrMark = ref.markLtr;
+        mFrameRefInfo->ltrUse = ref.useLtr;
+        mFrameRefInfo->dropped = ref.drop;
+    }
+    void setIntraRefreshInfo(const C2VencIntraRefresh::CycleInfo_t &info) {
+        mIntraRefreshInfo->position = info.position;
+        mIntraRefreshInfo->length = info.length;
+        mIntraRefreshInfo->cycleStart = info.cycleStart;
+        mIntraRefreshInfo->cycleEnd = info.cycleEnd;
+    }
     void setAverageQp(int value){mAverageBlockQuantization->value = value;}
     void setPictureType(C2Config::picture_type_t type){mPictureType->value = type;}
+    c2_status_t config(
+            const std::vector<C2Param*> &params, c2_blocking_t mayBlock,
+            std::vector<std::unique_ptr<C2SettingResult>>* const failures,
+            bool updateParams = true,
+            std::vector<std::shared_ptr<C2Param>> *changes = nullptr) {
+        c2_status_t result = C2InterfaceHelper::config(params, mayBlock, failures, updateParams, changes);
+        mConfigGeneration++;
+        return result;
+    }
+    c2_status_t query(
+            const std::vector<C2Param*> &stackParams,
+            const std::vector<C2Param::Index> &heapParamIndices,
+            c2_blocking_t mayBlock,
+            std::vector<std::unique_ptr<C2Param>>* const heapParams) const {
+        bool wantStats = false;
+        for (C2Param* const param : stackParams) {
+            if (param && param->coreIndex().coreIndex() == kParamIndexVendorVencStats) {
+                wantStats = true;
+            }
+        }
+        for (const C2Param::Index &index : heapParamIndices) {
+            if (index.coreIndex() == kParamIndexVendorVencStats) {
+                wantStats = true;
+            }
+        }
+        if (wantStats) {
+            //the window is only aggregated when somebody asks for it.
+            Lock lock = this->lock();
+            updateStats();
+        }
+        return C2InterfaceHelper::query(stackParams, heapParamIndices, mayBlock, heapParams);
+    }
+    void setStatsSource(const std::shared_ptr<C2VencStats> &stats) {
+        Lock lock = this->lock();
+        mStatsSource = stats;
+    }
+    int64_t getConfigGeneration() const { return mConfigGeneration.load(); }
 private:
+    // called with the interface locked,the window is the last second of frames.
+    void updateStats() const {
+        C2VencStats::Window_t window;
+        uint32_t frames = 1;
+        memset(&window, 0, sizeof(window));
+        window.avgQp = -1;
+        if (mStatsSource) {
+            if (mFrameRate->value > 1) {
+                frames = std::min((uint32_t)ceil(mFrameRate->value), mStatsSource->getCapacity());
+            }
+            mStatsSource->getWindow(frames, mFrameRate->value, &window);
+        }
+        mStats->frames = window.frames;
+        mStats->idrFrames = window.idrFrames;
+        mStats->pFrames = window.pFrames;
+        mStats->droppedFrames = window.droppedFrames;
+        mStats->maxFrameBytes = window.maxFrameBytes;
+        mStats->avgEncodeTimeUs = window.avgEncodeTimeUs;
+        mStats->maxEncodeTimeUs = window.maxEncodeTimeUs;
+        mStats->avgQp = window.avgQp;
+        mStats->bitrate = window.bitrate;
+        mStats->targetBitrate = window.targetBitrate;
+        mStats->rcErrorPercent = window.rcErrorPercent;
+    }
+    std::atomic<int64_t> mConfigGeneration{0};
     std::shared_ptr<C2StreamPictureSizeInfo::input> mSize;
+    std::shared_ptr<C2RealTimePriorityTuning> mPriority;
     std::shared_ptr<C2StreamUsageTuning::input> mUsage;
     std::shared_ptr<C2StreamFrameRateInfo::output> mFrameRate;
     std::shared_ptr<C2StreamRequestSyncFrameTuning::output> mRequestSync;
     std::shared_ptr<C2StreamIntraRefreshTuning::output> mIntraRefresh;
     std::shared_ptr<C2StreamBitrateInfo::output> mBitrate;
+    std::shared_ptr<C2StreamBitrateModeTuning::output> mBitrateMode;
+    std::shared_ptr<C2StreamQualityTuning::output> mQuality;
+    std::shared_ptr<C2StreamVencMaxBitrate::output> mMaxBitrate;
     std::shared_ptr<C2StreamProfileLevelInfo::output> mProfileLevel;
     std::shared_ptr<C2StreamSyncFrameIntervalTuning::output> mSyncFramePeriod;
     std::shared_ptr<C2StreamGopTuning::output> mGop;
@@ -828,6 +1055,16 @@ private:
     std::shared_ptr<C2StreamTemporalLayeringTuning::output> mLayerCount;
     std::shared_ptr<C2AndroidStreamAverageBlockQuantizationInfo::output> mAverageBlockQuantization;
     std::shared_ptr<C2StreamPictureTypeInfo::output> mPictureType;
+    std::shared_ptr<C2StreamVencRoiRegions::output> mRoiRegions;
+    std::shared_ptr<C2StreamVencQpOffsetMap::output> mQpOffsetMap;
+    std::shared_ptr<C2StreamVencMaxLayer::output> mMaxLayer;
+    std::shared_ptr<C2StreamVencLtrInterval::output> mLtrInterval;
+    std::shared_ptr<C2StreamVencLtrRecovery::output> mLtrRecovery;
+    std::shared_ptr<C2StreamVencFrameRefInfo::output> mFrameRefInfo;
+    std::shared_ptr<C2StreamVencIntraRefreshInfo::output> mIntraRefreshInfo;
+    std::shared_ptr<C2StreamVencStats::output> mStats;
+    std::shared_ptr<C2StreamVencBackPressureInfo::output> mBackPressure;
+    std::shared_ptr<C2VencStats> mStatsSource;
 };
 
 
@@ -861,10 +1098,23 @@ C2VencMulti::C2VencMulti(const char *name, c2_node_id_t id, const std::shared_pt
               mEncFrameQpFunc(NULL),
               mEncBitrateChangeFunc(NULL),
               mDestroyFunc(NULL),
+              mEncQpHintFunc(NULL),
+              mEncLtrFunc(NULL),
+              mEncQpChangeFunc(NULL),
               mCodecHandle(0),
               mIDRInterval(0),
               mBitrateBak(0),
-              mCodecID(CODEC_ID_H264) {
+              mConfigGeneration(-1),
+              mCodecID(CODEC_ID_H264),
+              mRoiBaseQp(0),
+              mRoiQpMin(0),
+              mRoiQpMax(0),
+              mLtrEnabled(false),
+              mRefLayerCount(0),
+              mRefLtrInterval(0),
+              mDumpStats(false),
+              mRcMaxBitrate(0),
+              mEncoderChanged(false) {
     ALOGD("C2VencMulti constructor!component name %s",name);
     if (!strcmp(name,COMPONENT_NAME)) {
         mCodecID = CODEC_ID_H264;
@@ -875,6 +1125,8 @@ C2VencMulti::C2VencMulti(const char *name, c2_node_id_t id, const std::shared_pt
     else {
         ALOGE("invalid component name %s",name);
     }
+    //the warm contexts of the library live as long as one of its components.
+    C2VencLibRegistry::getInstance().addSession(ENC_MULTI_LIB_NAME);
     sConcurrentInstances.fetch_add(1, std::memory_order_relaxed);
 }
 
@@ -886,6 +1138,7 @@ C2VencMulti::~C2VencMulti() {
     /*coverity[exn_spec_violation:SUPPRESS]*/
     ALOGD("C2VencMulti destructor!");
     Close();
+    C2VencLibRegistry::getInstance().removeSession(ENC_MULTI_LIB_NAME);
     sConcurrentInstances.fetch_sub(1, std::memory_order_relaxed);
 }
 
@@ -903,63 +1156,31 @@ bool C2VencMulti::isSupportCanvas() {
 
 bool C2VencMulti::LoadModule() {
     ALOGD("C2VencMulti initModule!");
-    void *handle = nullptr;
-    handle = dlopen("libvpcodec.so", RTLD_NOW | RTLD_NODELETE);
-    if (handle != nullptr) {
-        mInitFunc = NULL;
-        mInitFunc = (fn_vl_multi_encoder_init)dlsym(handle, "vl_multi_encoder_init");
-        if (mInitFunc == NULL) {
-            ALOGE("dlsym for vl_multi_encoder_init failed");
-            dlclose(handle);
-            return false;
-        }
-
-        mEncHeaderFunc = NULL;
-        mEncHeaderFunc = (fn_vl_multi_generate_header)dlsym(handle, "vl_multi_encoder_generate_header");
-        if (mEncHeaderFunc == NULL) {
-            ALOGE("dlsym for vl_multi_encoder_generate_header failed");
-            dlclose(handle);
-            return false;
-        }
-        mEncFrameQpFunc =NULL;
-        mEncFrameQpFunc = (fn_vl_multi_encoder_getavgqp)dlsym(handle,"vl_video_encoder_getavgqp");
-        if (mEncFrameQpFunc == NULL) {
-            ALOGE("dlsym for vl_video_encoder_getavgqp failed");
-            dlclose(handle);
-            return false;
-        }
-
-        mEncBitrateChangeFunc = NULL;
-        mEncBitrateChangeFunc = (fn_vl_multi_change_bitrate)dlsym(handle, "vl_video_encoder_change_bitrate");
-        if (mEncBitrateChangeFunc == NULL) {
-            ALOGE("dlsym for vl_video_encoder_change_bitrate failed");
-            dlclose(handle);
-            return false;
-        }
-
-        mEncFrameFunc = NULL;
-        mEncFrameFunc = (fn_vl_multi_encode_frame)dlsym(handle, "vl_multi_encoder_encode");
-        if (mEncFrameFunc == NULL) {
-            ALOGE("dlsym for vl_multi_encoder_encode failed");
-            dlclose(handle);
-            return false;
-        }
-
-        mDestroyFunc = NULL;
-        mDestroyFunc = (fn_vl_multi_encoder_destroy)dlsym(handle,"vl_multi_encoder_destroy");
-        if (mDestroyFunc == NULL) {
-            ALOGE("dlsym for vl_multi_encoder_destroy failed");
-            dlclose(handle);
-            return false;
-        }
-    } else {
-        ALOGE("dlopen for libvpcodec.so failed,err:%s",dlerror());
+    C2VencLibRegistry::Symbol_t symbols[] = {
+        {"vl_multi_encoder_init", true, (void **)&mInitFunc},
+        {"vl_multi_encoder_generate_header", true, (void **)&mEncHeaderFunc},
+        {"vl_video_encoder_getavgqp", true, (void **)&mEncFrameQpFunc},
+        {"vl_video_encoder_change_bitrate", true, (void **)&mEncBitrateChangeFunc},
+        {"vl_multi_encoder_encode", true, (void **)&mEncFrameFunc},
+        {"vl_multi_encoder_destroy", true, (void **)&mDestroyFunc},
+        {"vl_video_encoder_update_qp_hint", false, (void **)&mEncQpHintFunc},
+        {"vl_video_encoder_longterm_ref", false, (void **)&mEncLtrFunc},
+        {"vl_video_encoder_change_qp", false, (void **)&mEncQpChangeFunc},
+    };
+    //the library is opened once per process,later components only copy the functions.
+    if (!C2VencLibRegistry::getInstance().bind(ENC_MULTI_LIB_NAME, symbols, sizeof(symbols) / sizeof(symbols[0]))) {
+        ALOGE("load %s failed",ENC_MULTI_LIB_NAME);
         return false;
     }
-    /*
-    * This is the logic, no need to modify, ignore coverity weak cryptor report.
-    */
-    /*coverity[leaked_storage:SUPPRESS]*/
+    if (mEncQpHintFunc == NULL) {
+        ALOGW("vl_video_encoder_update_qp_hint is not found,roi is not supported");
+    }
+    if (mEncLtrFunc == NULL) {
+        ALOGW("vl_video_encoder_longterm_ref is not found,long term reference is not supported");
+    }
+    if (mEncQpChangeFunc == NULL) {
+        ALOGW("vl_video_encoder_change_qp is not found,rate control only changes the bitrate");
+    }
     return true;
 }
 
@@ -1090,6 +1311,7 @@ c2_status_t C2VencMulti::Init() {
     mSyncFramePeriod = mIntfImpl->getIFrameInterval();
     mPrependHeader = mIntfImpl->getPrependHeader();
     mVencCanvasMode = mIntfImpl->getCanvasMode();
+    mConfigGeneration = -1;
     mIDRInterval = (mSyncFramePeriod->value / 1000000) * mFrameRate->value; //max_int:just one i frame,0:all i frame
 
     memset(&encode_info,0,sizeof(encode_info));
@@ -1133,6 +1355,18 @@ c2_status_t C2VencMulti::Init() {
     codec2ProfileTrans(&encode_info.profile);
 
     encode_info.enc_feature_opts |= ENC_ENABLE_PARA_UPDATE; //enable dynamic settings
+    if (mEncQpHintFunc != NULL) {
+        int32_t i_qp_max,i_qp_min,p_qp_max,p_qp_min,b_qp_max,b_qp_min;
+        encode_info.enc_feature_opts |= ENC_ENABLE_ROI_FEATURE;
+        getQp(&i_qp_max,&i_qp_min,&p_qp_max,&p_qp_min,&b_qp_max,&b_qp_min);
+        mRoiQpMin = std::min(i_qp_min,p_qp_min);
+        mRoiQpMax = std::max(i_qp_max,p_qp_max);
+        //follows the average qp of the encoded frames from then on.
+        mRoiBaseQp = (p_qp_min + p_qp_max) / 2;
+        mRoiMap.setFrameInfo(encode_info.width,encode_info.height,
+                             (CODEC_ID_H265 == mCodecID) ? ENC_ROI_BLOCK_SIZE_HEVC : ENC_ROI_BLOCK_SIZE_AVC);
+        mRoiMap.clear();
+    }
 #if USE_SVC
     mLayerCount = mIntfImpl->getLayerCount();
     ALOGD("canvas mode:%d,prepend header:%d,layercount:%d",mVencCanvasMode->value,mPrependHeader->value,mLayerCount->m.layerCount);
@@ -1148,6 +1382,43 @@ c2_status_t C2VencMulti::Init() {
         encode_info.enc_feature_opts |= (a << 2) & 0x7c;
     }
 #endif
+    mRefLayerCount = 1;
+#if !USE_SVC
+    //the encoder runs a plain IP gop,the layers come from the frame types.
+    mRefLayerCount = mIntfImpl->getLayerCount()->m.layerCount;
+#endif
+    mRefLtrInterval = mIntfImpl->getLtrInterval()->value;
+    mLtrEnabled = (mEncLtrFunc != NULL) && (mRefLayerCount >= 3 || mRefLtrInterval > 0);
+    if (mLtrEnabled) {
+        encode_info.enc_feature_opts |= ENC_ENABLE_LONG_TERM_REF;
+    }
+    mIntraRefresh = mIntfImpl->getIntraRefresh();
+    if (C2Config::INTRA_REFRESH_DISABLED != mIntraRefresh->mode && mIntraRefresh->period >= 1) {
+        int32_t refreshMode = property_get_int32(C2_PROPERTY_VENC_INTRA_REFRESH_MODE, C2VencIntraRefresh::MODE_ROW);
+        if (refreshMode < C2VencIntraRefresh::MODE_ROW || refreshMode > C2VencIntraRefresh::MODE_STEP) {
+            refreshMode = C2VencIntraRefresh::MODE_ROW;
+        }
+        mIntraRefreshState.configure((C2VencIntraRefresh::Mode_e)refreshMode,(uint32_t)ceil(mIntraRefresh->period),
+                                     encode_info.width,encode_info.height,
+                                     (CODEC_ID_H265 == mCodecID) ? ENC_REFRESH_BLOCK_SIZE_HEVC : ENC_REFRESH_BLOCK_SIZE_AVC);
+    } else {
+        mIntraRefreshState.configure(C2VencIntraRefresh::MODE_NONE,0,0,0,0);
+    }
+    encode_info.intra_refresh_mode = mIntraRefreshState.getEncoderMode();
+    encode_info.intra_refresh_arg = mIntraRefreshState.getEncoderArg();
+    ALOGD("intra refresh period:%f,mode:%d,arg:%d,cycle:%u",mIntraRefresh->period,encode_info.intra_refresh_mode,
+          encode_info.intra_refresh_arg,mIntraRefreshState.getCycleLength());
+
+    mStats = C2VencStats::create(ENC_STATS_FRAMES);
+    mStats->setQpSampleInterval(property_get_int32(C2_PROPERTY_VENC_QP_SAMPLE_INTERVAL, 1));
+    mIntfImpl->setStatsSource(mStats);
+    mDumpStats = (property_get_int32(ENCODER_PROP_DUMP_DATA, 0) & ENABLE_DUMP_STATS) != 0;
+
+    mRefPlanner = C2VencRefPlanner();
+    mRefPlanner.configure(mRefLayerCount,mLtrEnabled,mRefLtrInterval);
+    mRefPlanner.setMaxLayer(mIntfImpl->getMaxLayer()->value);
+    ALOGD("reference plan layers:%u,ltr:%d,ltr interval:%u",mRefPlanner.getLayerCount(),mLtrEnabled,mRefLtrInterval);
+    initRateCtrl(&encode_info,&qp_tbl);
     if (C2_OK == genVuiParam((int32_t *)&encode_info.colour_primaries,(int32_t *)&encode_info.transfer_characteristics,(int32_t *)&encode_info.matrix_coefficients,(bool *)&encode_info.video_full_range_flag)) {
         encode_info.vui_parameters_present_flag = true;
         ALOGD("enable vui info");
@@ -1165,6 +1436,18 @@ c2_status_t C2VencMulti::Init() {
                                                               qp_tbl.qp_P_max,
                                                               qp_tbl.qp_P_min,
                                                               encode_info.profile);
+    //a context closed by an earlier session with the same settings skips the init.
+    memset(&mWarmKey,0,sizeof(mWarmKey));
+    mWarmKey.codecId = mCodecID;
+    memcpy(&mWarmKey.encodeInfo,&encode_info,sizeof(encode_info));
+    memcpy(&mWarmKey.qpTbl,&qp_tbl,sizeof(qp_tbl));
+    mEncoderChanged = false;
+    uintptr_t context = 0;
+    if (C2VencLibRegistry::getInstance().takeContext(ENC_MULTI_LIB_NAME,&mWarmKey,sizeof(mWarmKey),&context)) {
+        mCodecHandle = (vl_codec_handle_t)context;
+        ALOGD("reuse warm encoder,mCodecHandle:%ld",mCodecHandle);
+        return C2_OK;
+    }
     mCodecHandle = mInitFunc(mCodecID,encode_info,&qp_tbl);
     if (0 == mCodecHandle) {
         ALOGE("init encoder failed!!,mCodecHandle:%ld",mCodecHandle);
@@ -1187,8 +1470,9 @@ c2_status_t C2VencMulti::GenerateHeader(uint8_t *pHeaderData,uint32_t *pSize)
     }
     //memset(&vuiInfo,0,sizeof(vuiInfo));
     //genVuiParam(&vuiInfo.primaries,&vuiInfo.transfer,&vuiInfo.matrixCoeffs,(bool *)&vuiInfo.range);
-    mEncHeaderFunc(mCodecHandle,pHeaderData,&outSize);
-    if (outSize <= 0) {
+    encoding_metadata_t ret = mEncHeaderFunc(mCodecHandle,pHeaderData,&outSize);
+    if (outSize <= 0 || !ret.is_valid) {
+        ALOGE("generate header failed,errcode:%d",ret.err_cod);
         return C2_BAD_VALUE;
     }
 
@@ -1273,6 +1557,153 @@ c2_status_t C2VencMulti::getQp(int32_t *i_qp_max,int32_t *i_qp_min,int32_t *p_qp
 }
 
 
+uint32_t C2VencMulti::getRcMaxBitrate(C2VencRateCtrl::Mode_e mode,uint32_t targetBitrate) {
+    if (mRcMaxBitrate > 0) {
+        return mRcMaxBitrate;
+    }
+    if (C2VencRateCtrl::MODE_VBR == mode) {
+        //allow half the average on top for the complex scenes.
+        return std::min((uint32_t)ENC_RC_MAX_BITRATE, targetBitrate + targetBitrate / 2);
+    }
+    return ENC_RC_MAX_BITRATE;
+}
+
+void C2VencMulti::initRateCtrl(vl_encode_info_t *encode_info,qp_param_t *qp_tbl) {
+    C2VencRateCtrl::Config_t config;
+    C2Config::bitrate_mode_t bitrateMode = mIntfImpl->getBitrateMode()->value;
+
+    config.mode = C2VencRateCtrl::MODE_CBR;
+    mRcMaxBitrate = mIntfImpl->getMaxBitrate()->value;
+    if (C2Config::BITRATE_VARIABLE == bitrateMode) {
+        config.mode = C2VencRateCtrl::MODE_VBR;
+    } else if (C2Config::BITRATE_IGNORE == bitrateMode) {
+        config.mode = (mRcMaxBitrate > 0) ? C2VencRateCtrl::MODE_CAPPED_CRF : C2VencRateCtrl::MODE_CQ;
+    }
+    if (C2VencRateCtrl::MODE_CAPPED_CRF == config.mode && mEncQpChangeFunc == NULL) {
+        //the cap needs the qp to move while encoding.
+        ALOGW("capped crf needs vl_video_encoder_change_qp,encode at the cap bitrate");
+        config.mode = C2VencRateCtrl::MODE_CBR;
+        encode_info->bit_rate = mRcMaxBitrate;
+    }
+    config.targetBitrate = mBitrate->value;
+    config.frameRate = mFrameRate->value;
+    config.quality = mIntfImpl->getQuality()->value;
+    //the same limits the encoder was given,the controller only narrows them.
+    config.qpMin = std::min(qp_tbl->qp_I_min,qp_tbl->qp_P_min);
+    config.qpMax = std::max(qp_tbl->qp_I_max,qp_tbl->qp_P_max);
+    config.maxBitrate = getRcMaxBitrate(config.mode,config.targetBitrate);
+    mRateCtrl = C2VencRateCtrl();
+    C2VencRateCtrl::Decision_t decision = mRateCtrl.configure(config);
+    if (!mRateCtrl.isEnabled()) {
+        return;
+    }
+    encode_info->bit_rate = decision.bitrate;
+    qp_tbl->qp_I_min = decision.iQpMin;
+    qp_tbl->qp_I_max = decision.iQpMax;
+    qp_tbl->qp_P_min = decision.pQpMin;
+    qp_tbl->qp_P_max = decision.pQpMax;
+    qp_tbl->qp_B_min = decision.pQpMin;
+    qp_tbl->qp_B_max = decision.pQpMax;
+    ALOGD("rate control mode:%d,quality:%d,max bitrate:%u,start bitrate:%u,qp:%d-%d",config.mode,config.quality,
+          config.maxBitrate,decision.bitrate,decision.pQpMin,decision.pQpMax);
+}
+
+void C2VencMulti::applyRateDecision(const C2VencRateCtrl::Decision_t &decision) {
+    if (decision.updateBitrate || decision.updateQp) {
+        mEncoderChanged = true;
+    }
+    if (decision.updateBitrate) {
+        C2MULTI_LOG(CODEC2_VENC_LOG_DEBUG,"rate control bitrate %u",decision.bitrate);
+        mEncBitrateChangeFunc(mCodecHandle,decision.bitrate);
+    }
+    if (decision.updateQp && mEncQpChangeFunc != NULL) {
+        C2MULTI_LOG(CODEC2_VENC_LOG_DEBUG,"rate control qp i:%d-%d,p:%d-%d",decision.iQpMin,decision.iQpMax,
+                    decision.pQpMin,decision.pQpMax);
+        if (mEncQpChangeFunc(mCodecHandle,decision.iQpMin,decision.iQpMax,ENC_RC_MAX_DELTA_QP,
+                             decision.pQpMin,decision.pQpMax,decision.pQpMin,decision.pQpMax) < 0) {
+            C2MULTI_LOG(CODEC2_VENC_LOG_ERR,"change qp failed");
+        }
+    }
+}
+
+void C2VencMulti::updateRoiSettings() {
+    if (mEncQpHintFunc == NULL) {
+        return;
+    }
+    std::shared_ptr<C2StreamVencRoiRegions::output> roiRegions = mIntfImpl->getRoiRegions();
+    std::shared_ptr<C2StreamVencQpOffsetMap::output> qpOffsetMap = mIntfImpl->getQpOffsetMap();
+    std::vector<C2VencRoiMap::Region_t> regions;
+    size_t count = std::min(roiRegions->flexCount(), (size_t)ENC_MAX_ROI_REGIONS);
+    for (size_t i = 0; i < count; ++i) {
+        const C2VencRoiRegionStruct &region = roiRegions->m.values[i];
+        regions.push_back({region.left, region.top, region.width, region.height, region.qpDelta});
+    }
+    //unchanged settings keep the cached table.
+    mRoiMap.setRegions(regions);
+    mRoiMap.setOffsetMap((const int8_t *)qpOffsetMap->m.value, qpOffsetMap->flexCount());
+}
+
+bool C2VencMulti::updateRefSettings() {
+    uint32_t layerCount = 1;
+#if !USE_SVC
+    layerCount = mIntfImpl->getLayerCount()->m.layerCount;
+#endif
+    uint32_t ltrInterval = mIntfImpl->getLtrInterval()->value;
+    if (layerCount != mRefLayerCount || ltrInterval != mRefLtrInterval) {
+        //long term reference is enabled at init,it can not be turned on later.
+        mRefPlanner.configure(layerCount,mLtrEnabled,ltrInterval);
+        mRefLayerCount = layerCount;
+        mRefLtrInterval = ltrInterval;
+        C2MULTI_LOG(CODEC2_VENC_LOG_INFO,"reference plan change,layers:%u,ltr interval:%u",mRefPlanner.getLayerCount(),ltrInterval);
+    }
+    mRefPlanner.setMaxLayer(mIntfImpl->getMaxLayer()->value);
+    return mIntfImpl->getLtrRecovery()->value != 0;
+}
+
+void C2VencMulti::applyRoiHint() {
+    uint32_t size = 0;
+    bool updated = false;
+    if (mEncQpHintFunc == NULL) {
+        return;
+    }
+    const uint8_t *table = mRoiMap.getHintTable(mRoiBaseQp, mRoiQpMin, mRoiQpMax, &size, &updated);
+    if (table == NULL || !updated) {
+        return;
+    }
+    int ret = mEncQpHintFunc(mCodecHandle, (unsigned char *)table, size);
+    mEncoderChanged = true;
+    C2MULTI_LOG(CODEC2_VENC_LOG_DEBUG,"update qp hint,blocks:%u,base qp:%d,roi:%d,ret:%d",size,mRoiBaseQp,mRoiMap.isEnabled(),ret);
+    if (ret < 0) {
+        C2MULTI_LOG(CODEC2_VENC_LOG_ERR,"update qp hint failed,ret:%d",ret);
+    }
+}
+
+
+int64_t C2VencMulti::getConfigGeneration() {
+    return mIntfImpl->getConfigGeneration();
+}
+
+
+C2VencArbiter *C2VencMulti::getArbiter() {
+    return &C2VencArbiter::getInstance(ENC_MULTI_LIB_NAME,1,0);
+}
+
+
+void C2VencMulti::getArbiterSession(C2VencArbiter::Session_t *pSession) {
+    IntfImpl::Lock lock = mIntfImpl->lock();
+    pSession->priority = mIntfImpl->getPriority()->value;
+    pSession->width = mIntfImpl->getSize()->width;
+    pSession->height = mIntfImpl->getSize()->height;
+    pSession->frameRate = mIntfImpl->getFrameRate()->value;
+}
+
+
+bool C2VencMulti::isPrependHeader() {
+    //the library is not asked to put the header before the key frames.
+    return mPrependHeader && C2Config::PREPEND_HEADER_TO_ALL_SYNC == mPrependHeader->value;
+}
+
+
 c2_status_t C2VencMulti::ProcessOneFrame(InputFrameInfo_t InputFrameInfo,OutputFrameInfo_t *pOutFrameInfo) {
     C2MULTI_LOG(CODEC2_VENC_LOG_DEBUG,"C2VencMulti ProcessOneFrame! yPlane:%p,uPlane:%p,vPlane:%p",InputFrameInfo.yPlane,InputFrameInfo.uPlane,InputFrameInfo.vPlane);
     encoding_metadata_t ret;
@@ -1280,17 +1711,45 @@ c2_status_t C2VencMulti::ProcessOneFrame(InputFrameInfo_t InputFrameInfo,OutputF
     vl_buffer_info_t retbuf;
     vl_frame_type_t frameType = FRAME_TYPE_NONE;
     int32_t avg_qp = 0;
+    bool recovery = false;
+    C2VencStats::FrameStats_t frameStats;
     if (!pOutFrameInfo) {
         C2MULTI_LOG(CODEC2_VENC_LOG_ERR,"ProcessOneFrame parameter bad value,pls check!");
         return C2_BAD_VALUE;
     }
     memset(&inputInfo,0,sizeof(inputInfo));
-    IntfImpl::Lock lock = mIntfImpl->lock();
-    //std::shared_ptr<C2StreamIntraRefreshTuning::output> intraRefresh = mIntfImpl->getIntraRefresh();
-    std::shared_ptr<C2StreamBitrateInfo::output> bitrate = mIntfImpl->getBitrate();
-    std::shared_ptr<C2StreamRequestSyncFrameTuning::output> requestSync = mIntfImpl->getRequestSync();
-    mFrameRate = mIntfImpl->getFrameRate();
-    lock.unlock();
+    memset(&frameStats,0,sizeof(frameStats));
+    frameStats.frameIndex = InputFrameInfo.frameIndex;
+    frameStats.avgQp = -1;
+    int64_t generation = mIntfImpl->getConfigGeneration();
+    if (generation != mConfigGeneration) {
+        //only touch the interface lock when some config was applied since last frame
+        IntfImpl::Lock lock = mIntfImpl->lock();
+        std::shared_ptr<C2StreamIntraRefreshTuning::output> intraRefresh = mIntfImpl->getIntraRefresh();
+        uint32_t refreshPeriod = (C2Config::INTRA_REFRESH_DISABLED == intraRefresh->mode) ? 0 : (uint32_t)ceil(intraRefresh->period);
+        if (refreshPeriod != mIntraRefreshState.getPeriod()) {
+            //libvpcodec takes the refresh settings only at init.
+            C2MULTI_LOG(CODEC2_VENC_LOG_INFO,"intra refresh period %u -> %u,kept until the encoder restarts",
+                        mIntraRefreshState.getPeriod(),refreshPeriod);
+        }
+        mCurBitrate = mIntfImpl->getBitrate();
+        mCurRequestSync = mIntfImpl->getRequestSync();
+        mFrameRate = mIntfImpl->getFrameRate();
+        updateRoiSettings();
+        recovery = updateRefSettings();
+        lock.unlock();
+        mConfigGeneration = generation;
+    }
+    if (recovery) {
+        // unset request
+        C2StreamVencLtrRecovery::output clearRecovery(0u, 0);
+        std::vector<std::unique_ptr<C2SettingResult>> failures;
+        mIntfImpl->config({ &clearRecovery }, C2_MAY_BLOCK, &failures);
+        mRefPlanner.requestRecovery();
+        C2MULTI_LOG(CODEC2_VENC_LOG_ERR,"Got ltr recovery request,ltr:%d",mLtrEnabled);
+    }
+    std::shared_ptr<C2StreamBitrateInfo::output> bitrate = mCurBitrate;
+    std::shared_ptr<C2StreamRequestSyncFrameTuning::output> requestSync = mCurRequestSync;
 
     frameType = FRAME_TYPE_P;
     if (requestSync != mRequestSync) {
@@ -1300,12 +1759,35 @@ c2_status_t C2VencMulti::ProcessOneFrame(InputFrameInfo_t InputFrameInfo,OutputF
             C2StreamRequestSyncFrameTuning::output clearSync(0u, C2_FALSE);
             std::vector<std::unique_ptr<C2SettingResult>> failures;
             mIntfImpl->config({ &clearSync }, C2_MAY_BLOCK, &failures);
-            frameType = FRAME_TYPE_IDR;
+            mRefPlanner.requestIdr();
             C2MULTI_LOG(CODEC2_VENC_LOG_ERR,"Got dynamic IDR request");
         }
         mRequestSync = requestSync;
     }
 
+    C2VencRefPlanner::FrameRef_t frameRef = mRefPlanner.plan();
+    mIntfImpl->setFrameRefInfo(frameRef);
+    if (frameRef.drop) {
+        //nothing references the dropped layers,the encoder state is untouched.
+        C2MULTI_LOG(CODEC2_VENC_LOG_DEBUG,"drop layer %d frame,dropped:%u",frameRef.layerId,mRefPlanner.getDropCount());
+        pOutFrameInfo->Length = 0;
+        pOutFrameInfo->FrameType = FRAMETYPE_P;
+        mIntfImpl->setPictureType(C2Config::P_FRAME);
+        mIntfImpl->setIntraRefreshInfo({mIntraRefreshState.getEncoderMode() != 0, 0, mIntraRefreshState.getCycleLength(), false, false});
+        frameStats.targetBitrate = mBitrateBak;
+        frameStats.kind = C2VencStats::FRAME_DROPPED;
+        mStats->record(frameStats);
+        if (mRateCtrl.isEnabled()) {
+            applyRateDecision(mRateCtrl.onFrameEncoded(0,-1,false));
+        }
+        return C2_OK;
+    }
+    if (frameRef.idr) {
+        frameType = FRAME_TYPE_IDR;
+    } else if (!frameRef.reference) {
+        frameType = FRAME_TYPE_DROPPABLE_P;
+    }
+
     codec2TypeTrans(InputFrameInfo.colorFmt,&inputInfo.buf_fmt);
     if (DMA == InputFrameInfo.bufType) {
         inputInfo.buf_type = DMA_TYPE;
@@ -1345,13 +1827,30 @@ c2_status_t C2VencMulti::ProcessOneFrame(InputFrameInfo_t InputFrameInfo,OutputF
 
     if (mBitrateBak != bitrate->value) {
         C2MULTI_LOG(CODEC2_VENC_LOG_ERR,"bitrate change to %d",bitrate->value);
-        mEncBitrateChangeFunc(mCodecHandle,bitrate->value);
+        mEncoderChanged = true;
+        if (mRateCtrl.isEnabled()) {
+            //the new bitrate is the average of the controller,it picks the encoder bitrate.
+            applyRateDecision(mRateCtrl.setTarget(bitrate->value,getRcMaxBitrate(mRateCtrl.getMode(),bitrate->value),mFrameRate->value));
+        } else {
+            mEncBitrateChangeFunc(mCodecHandle,bitrate->value);
+        }
         mBitrateBak = bitrate->value;
     }
 
     C2MULTI_LOG(CODEC2_VENC_LOG_DEBUG,"Debug input info:yAddr:0x%lx,uAddr:0x%lx,vAddr:0x%lx,frame_type:%d,fmt:%d,pitch:%d,bitrate:%d",inputInfo.buf_info.in_ptr[0],
          inputInfo.buf_info.in_ptr[1],inputInfo.buf_info.in_ptr[2],inputInfo.buf_type,inputInfo.buf_fmt,inputInfo.buf_stride,bitrate->value);
+    applyRoiHint();
+    if (mLtrEnabled && (frameRef.markLtr || frameRef.useLtr)) {
+        //bit 0: used as long term reference,bit 1: encoded from the long term reference.
+        int ltrFlags = (frameRef.markLtr ? 0x1 : 0) | (frameRef.useLtr ? 0x2 : 0);
+        mEncoderChanged = true;
+        if (mEncLtrFunc(mCodecHandle,ltrFlags) < 0) {
+            C2MULTI_LOG(CODEC2_VENC_LOG_ERR,"set long term reference flags 0x%x failed",ltrFlags);
+        }
+    }
+    nsecs_t encodeStart = systemTime(SYSTEM_TIME_MONOTONIC);
     ret = mEncFrameFunc(mCodecHandle, frameType, (unsigned char*)pOutFrameInfo->Data, &inputInfo, &retbuf);
+    frameStats.encodeTimeUs = (uint32_t)ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - encodeStart);
     pOutFrameInfo->Length = ret.encoded_data_length_in_bytes;
     C2MULTI_LOG(CODEC2_VENC_LOG_DEBUG,"encode finish,output len:%d",ret.encoded_data_length_in_bytes);
     if (!ret.is_valid) {
@@ -1359,14 +1858,44 @@ c2_status_t C2VencMulti::ProcessOneFrame(InputFrameInfo_t InputFrameInfo,OutputF
         return C2_CORRUPTED;
     }
     int re = 0;
-    re = mEncFrameQpFunc(mCodecHandle,&avg_qp);
-    if (re != 1) {
-        C2MULTI_LOG(CODEC2_VENC_LOG_ERR,"get avg_qp failed,re:%d",re);
+    //the qp query costs a driver call,skipped frames keep the last reported qp.
+    bool sampleQp = mStats->shouldSampleQp();
+    if (sampleQp) {
+        re = mEncFrameQpFunc(mCodecHandle,&avg_qp);
+        if (re != 1) {
+            C2MULTI_LOG(CODEC2_VENC_LOG_ERR,"get avg_qp failed,re:%d",re);
+        }
+        C2MULTI_LOG(CODEC2_VENC_LOG_DEBUG,"per frame avg_qp=%d",avg_qp);
+    }
+    if (re == 1 && mRoiMap.isEnabled() && std::abs(avg_qp - mRoiBaseQp) >= ENC_ROI_BASE_QP_HYSTERESIS) {
+        mRoiBaseQp = avg_qp;
+    }
+    frameStats.sizeBytes = ret.encoded_data_length_in_bytes;
+    frameStats.targetBitrate = mBitrateBak;
+    frameStats.avgQp = (re == 1) ? avg_qp : -1;
+    if (ret.is_key_frame) {
+        frameStats.kind = C2VencStats::FRAME_IDR;
+    } else if (FRAME_TYPE_DROPPABLE_P == frameType) {
+        frameStats.kind = C2VencStats::FRAME_DROPPABLE;
+    } else {
+        frameStats.kind = C2VencStats::FRAME_P;
+    }
+    mStats->record(frameStats);
+    if (mRateCtrl.isEnabled()) {
+        applyRateDecision(mRateCtrl.onFrameEncoded(ret.encoded_data_length_in_bytes,frameStats.avgQp,ret.is_key_frame));
     }
-    C2MULTI_LOG(CODEC2_VENC_LOG_DEBUG,"per frame avg_qp=%d",avg_qp);
 
 
     pOutFrameInfo->FrameType = FRAMETYPE_P;
+    C2VencIntraRefresh::CycleInfo_t refreshInfo = mIntraRefreshState.onFrameEncoded(ret.is_key_frame);
+    mIntfImpl->setIntraRefreshInfo(refreshInfo);
+    if (refreshInfo.cycleEnd) {
+        C2MULTI_LOG(CODEC2_VENC_LOG_DEBUG,"intra refresh cycle of %u frames done",refreshInfo.length);
+    }
+    if (ret.is_key_frame && !frameRef.idr) {
+        //gop key frame,the plan starts over from it.
+        mRefPlanner.onKeyFrame();
+    }
     if (ret.is_key_frame) {
         pOutFrameInfo->FrameType = FRAMETYPE_IDR;
         mIntfImpl->setPictureType(C2Config::SYNC_FRAME);
@@ -1374,17 +1903,65 @@ c2_status_t C2VencMulti::ProcessOneFrame(InputFrameInfo_t InputFrameInfo,OutputF
     else {
         mIntfImpl->setPictureType(C2Config::P_FRAME);
     }
-    mIntfImpl->setAverageQp(avg_qp);
+    if (sampleQp) {
+        mIntfImpl->setAverageQp(avg_qp);
+    }
     return C2_OK;
 }
 
 
+void C2VencMulti::dumpStats() {
+    char pName[128];
+    C2VencStats::Window_t window;
+    C2VencStats::FrameStats_t frame;
+    uint32_t count = 0;
+    FILE *fp = NULL;
+
+    memset(pName,0,sizeof(pName));
+    sprintf(pName, "/data/venc_stats_%lx.txt", mCodecHandle);
+    fp = fopen(pName, "w");
+    if (NULL == fp) {
+        ALOGE("open stats dump file %s failed",pName);
+        return;
+    }
+    count = (uint32_t)std::min<uint64_t>(mStats->getFrameCount(), mStats->getCapacity());
+    if (mStats->getWindow(count, mFrameRate->value, &window)) {
+        fprintf(fp, "# frames:%u idr:%u p:%u dropped:%u bytes:%" PRIu64 " max_bytes:%u avg_enc_us:%u max_enc_us:%u "
+                "avg_qp:%d bitrate:%u target:%u rc_error:%d%% read_retry:%u\n",
+                window.frames, window.idrFrames, window.pFrames, window.droppedFrames, window.totalBytes,
+                window.maxFrameBytes, window.avgEncodeTimeUs, window.maxEncodeTimeUs, window.avgQp,
+                window.bitrate, window.targetBitrate, window.rcErrorPercent, mStats->getRetryCount());
+    }
+    fprintf(fp, "# index kind bytes enc_us qp target\n");
+    for (uint32_t i = count; i > 0; i--) {
+        if (mStats->getFrame(i - 1, &frame)) {
+            fprintf(fp, "%" PRId64 " %u %u %u %d %u\n", frame.frameIndex, frame.kind, frame.sizeBytes,
+                    frame.encodeTimeUs, frame.avgQp, frame.targetBitrate);
+        }
+    }
+    fclose(fp);
+    ALOGD("dump stats of %u frames to %s",count,pName);
+}
+
+
 void C2VencMulti::Close()  {
     ALOGE("C2VencMulti::Close!!!");
     if (!mCodecHandle) {
         return;
     }
-    mDestroyFunc(mCodecHandle);
+    if (mDumpStats && mStats) {
+        dumpStats();
+    }
+    if (!mEncoderChanged) {
+        //the encoder still runs the settings of mWarmKey,the registry destroys it when the pool is off.
+        fn_vl_multi_encoder_destroy destroyFunc = mDestroyFunc;
+        C2VencLibRegistry::getInstance().putContext(ENC_MULTI_LIB_NAME,&mWarmKey,sizeof(mWarmKey),(uintptr_t)mCodecHandle,
+                                                    [destroyFunc](uintptr_t context) {
+                                                        destroyFunc((vl_codec_handle_t)context);
+                                                    });
+    } else {
+        mDestroyFunc(mCodecHandle);
+    }
     mCodecHandle = 0;
     return;
 }
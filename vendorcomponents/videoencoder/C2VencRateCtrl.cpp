@@ -0,0 +1,213 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "C2VencRateCtrl"
+#include <utils/Log.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include <C2VencRateCtrl.h>
+
+namespace android {
+
+#define RC_DEFAULT_FRAME_RATE       30.0f
+#define RC_QP_PER_DOUBLE            6.0   //the bits double when the qp goes down by 6
+#define RC_I_QP_OFFSET              3     //the I frame qp may go this much lower than P frame
+#define RC_BITRATE_STEP_PERCENT     5     //smaller bitrate changes are not sent to the encoder
+#define RC_VBR_MIN_RATIO            0.5
+#define RC_VBR_HORIZON_SEC          2.0   //the average bitrate error is paid back over this time
+#define RC_VBR_SHORT_WEIGHT         0.125
+#define RC_VBR_LONG_SEC             10.0
+#define RC_VBR_QP_SWING             4
+#define RC_CRF_BUFFER_SEC           1.0
+#define RC_CRF_HIGH_RATIO           0.5
+#define RC_CRF_LOW_RATIO            0.2
+#define RC_CRF_RELAX_SEC            0.5
+
+C2VencRateCtrl::C2VencRateCtrl()
+    : mBaseQp(0),
+      mBitrate(0),
+      mQpMin(0),
+      mQpMax(0),
+      mErrorBits(0),
+      mQpShort(-1),
+      mQpLong(-1),
+      mBufferBits(0),
+      mQpRaise(0),
+      mFramesSinceRaise(0) {
+    mConfig.mode = MODE_CBR;
+    mConfig.targetBitrate = 0;
+    mConfig.maxBitrate = 0;
+    mConfig.frameRate = RC_DEFAULT_FRAME_RATE;
+    mConfig.quality = 0;
+    mConfig.qpMin = 0;
+    mConfig.qpMax = 0;
+}
+
+// static
+int32_t C2VencRateCtrl::qualityToQp(int32_t quality, int32_t qpMin, int32_t qpMax) {
+    quality = std::max(0, std::min(quality, 100));
+    return qpMax - (quality * (qpMax - qpMin) + 50) / 100;
+}
+
+C2VencRateCtrl::Decision_t C2VencRateCtrl::makeDecision(bool updateBitrate, bool updateQp) const {
+    Decision_t decision;
+    decision.updateBitrate = updateBitrate;
+    decision.bitrate = mBitrate;
+    decision.updateQp = updateQp;
+    decision.iQpMin = std::max(mConfig.qpMin, mQpMin - RC_I_QP_OFFSET);
+    decision.iQpMax = mQpMax;
+    decision.pQpMin = mQpMin;
+    decision.pQpMax = mQpMax;
+    return decision;
+}
+
+C2VencRateCtrl::Decision_t C2VencRateCtrl::configure(const Config_t &config) {
+    mConfig = config;
+    if (mConfig.frameRate <= 0) {
+        mConfig.frameRate = RC_DEFAULT_FRAME_RATE;
+    }
+    if (mConfig.qpMax < mConfig.qpMin) {
+        mConfig.qpMax = mConfig.qpMin;
+    }
+    if (mConfig.maxBitrate < mConfig.targetBitrate) {
+        mConfig.maxBitrate = mConfig.targetBitrate;
+    }
+    mErrorBits = 0;
+    mQpShort = -1;
+    mQpLong = -1;
+    mBufferBits = 0;
+    mQpRaise = 0;
+    mFramesSinceRaise = 0;
+    mBaseQp = qualityToQp(mConfig.quality, mConfig.qpMin, mConfig.qpMax);
+    mQpMin = mConfig.qpMin;
+    mQpMax = mConfig.qpMax;
+    mBitrate = mConfig.targetBitrate;
+    if (mConfig.mode == MODE_CAPPED_CRF || mConfig.mode == MODE_CQ) {
+        mQpMin = mBaseQp;
+        mQpMax = mBaseQp;
+        mBitrate = mConfig.maxBitrate;
+    }
+    ALOGV("mode %d target %u max %u fps %f quality %d qp %d-%d base %d", mConfig.mode, mConfig.targetBitrate,
+          mConfig.maxBitrate, mConfig.frameRate, mConfig.quality, mConfig.qpMin, mConfig.qpMax, mBaseQp);
+    return makeDecision(isEnabled(), isEnabled());
+}
+
+C2VencRateCtrl::Decision_t C2VencRateCtrl::setTarget(uint32_t targetBitrate, uint32_t maxBitrate, float frameRate) {
+    uint32_t bitrate = mBitrate;
+    mConfig.targetBitrate = targetBitrate;
+    mConfig.maxBitrate = std::max(maxBitrate, targetBitrate);
+    if (frameRate > 0) {
+        mConfig.frameRate = frameRate;
+    }
+    if (mConfig.mode == MODE_VBR) {
+        //the error was counted against the old average.
+        mErrorBits = 0;
+        bitrate = mConfig.targetBitrate;
+    } else if (mConfig.mode != MODE_CBR) {
+        bitrate = mConfig.maxBitrate;
+    }
+    bool update = isEnabled() && (bitrate != mBitrate);
+    mBitrate = bitrate;
+    return makeDecision(update, false);
+}
+
+void C2VencRateCtrl::updateVbr(uint32_t bits, int32_t avgQp, bool keyFrame, bool *updateBitrate, bool *updateQp) {
+    double target = mConfig.targetBitrate;
+    double limit = target * RC_VBR_HORIZON_SEC;
+
+    mErrorBits += bits - target / mConfig.frameRate;
+    mErrorBits = std::max(-limit, std::min(mErrorBits, limit));
+    //the intra qp sits lower on purpose,it says nothing about the content.
+    if (avgQp >= 0 && !keyFrame) {
+        if (mQpLong < 0) {
+            mQpShort = avgQp;
+            mQpLong = avgQp;
+        } else {
+            mQpShort += (avgQp - mQpShort) * RC_VBR_SHORT_WEIGHT;
+            mQpLong += (avgQp - mQpLong) / (mConfig.frameRate * RC_VBR_LONG_SEC);
+        }
+    }
+
+    double scale = 1.0;
+    if (mQpLong >= 0) {
+        scale = pow(2.0, (mQpShort - mQpLong) / RC_QP_PER_DOUBLE);
+    }
+    double correction = std::max(0.5, std::min(1.0 - mErrorBits / limit, 1.5));
+    double wanted = std::max(target * RC_VBR_MIN_RATIO, std::min(target * scale * correction,
+                                                                 (double)mConfig.maxBitrate));
+    uint32_t bitrate = (uint32_t)wanted;
+    if ((uint64_t)abs((int64_t)bitrate - mBitrate) * 100 >= (uint64_t)mBitrate * RC_BITRATE_STEP_PERCENT) {
+        ALOGV("vbr bitrate %u -> %u,qp %.1f/%.1f,error %.0f", mBitrate, bitrate, mQpShort, mQpLong, mErrorBits);
+        mBitrate = bitrate;
+        *updateBitrate = true;
+    }
+    if (mQpLong >= 0) {
+        int32_t qpMin = (int32_t)lround(mQpLong) - RC_VBR_QP_SWING;
+        qpMin = std::max(mConfig.qpMin, std::min(qpMin, mConfig.qpMax));
+        if (qpMin != mQpMin) {
+            mQpMin = qpMin;
+            *updateQp = true;
+        }
+    }
+}
+
+void C2VencRateCtrl::updateCappedCrf(uint32_t bits, bool keyFrame, bool *updateQp) {
+    double size = mConfig.maxBitrate * RC_CRF_BUFFER_SEC;
+    double drain = mConfig.maxBitrate / mConfig.frameRate;
+
+    mBufferBits = std::max(0.0, mBufferBits + bits - drain);
+    mFramesSinceRaise++;
+    if (mBufferBits > size * RC_CRF_HIGH_RATIO && mBaseQp + mQpRaise < mConfig.qpMax) {
+        //jump to the qp which would bring this frame down to the cap,a key frame is expected to be big.
+        int32_t step = 1;
+        if (!keyFrame && bits > drain) {
+            step = std::max(1, (int32_t)ceil(RC_QP_PER_DOUBLE * log2(bits / drain)));
+        }
+        mQpRaise = std::min(mQpRaise + step, mConfig.qpMax - mBaseQp);
+        mFramesSinceRaise = 0;
+        *updateQp = true;
+    } else if (mBufferBits < size * RC_CRF_LOW_RATIO && mQpRaise > 0
+               && mFramesSinceRaise >= mConfig.frameRate * RC_CRF_RELAX_SEC) {
+        mQpRaise--;
+        mFramesSinceRaise = 0;
+        *updateQp = true;
+    }
+    if (*updateQp) {
+        ALOGV("crf qp %d,buffer %.0f/%.0f", mBaseQp + mQpRaise, mBufferBits, size);
+    }
+    mQpMin = mBaseQp + mQpRaise;
+    mQpMax = mQpMin;
+}
+
+C2VencRateCtrl::Decision_t C2VencRateCtrl::onFrameEncoded(uint32_t sizeBytes, int32_t avgQp, bool keyFrame) {
+    bool updateBitrate = false;
+    bool updateQp = false;
+    uint32_t bits = sizeBytes * 8;
+
+    if (mConfig.mode == MODE_VBR) {
+        updateVbr(bits, avgQp, keyFrame, &updateBitrate, &updateQp);
+    } else if (mConfig.mode == MODE_CAPPED_CRF) {
+        updateCappedCrf(bits, keyFrame, &updateQp);
+    }
+    return makeDecision(updateBitrate, updateQp);
+}
+
+}  // namespace android
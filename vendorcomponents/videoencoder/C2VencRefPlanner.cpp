@@ -0,0 +1,149 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "C2VencRefPlanner"
+#include <utils/Log.h>
+
+#include <C2VencRefPlanner.h>
+
+namespace android {
+
+static const int32_t kLayerPattern1[] = {0};
+static const int32_t kLayerPattern2[] = {0, 1};
+static const int32_t kLayerPattern3[] = {0, 2, 1, 2};
+
+static const int32_t *getPattern(uint32_t layerCount, uint32_t *length) {
+    if (layerCount == 3) {
+        *length = sizeof(kLayerPattern3) / sizeof(kLayerPattern3[0]);
+        return kLayerPattern3;
+    } else if (layerCount == 2) {
+        *length = sizeof(kLayerPattern2) / sizeof(kLayerPattern2[0]);
+        return kLayerPattern2;
+    }
+    *length = 1;
+    return kLayerPattern1;
+}
+
+C2VencRefPlanner::C2VencRefPlanner()
+    : mLayerCount(1),
+      mLtrSupported(false),
+      mLtrInterval(0),
+      mMaxLayer(-1),
+      mPosition(0),
+      mBaseSinceLtr(0),
+      mHasLtr(false),
+      mIdrPending(true),
+      mRecoveryPending(false),
+      mDropCount(0),
+      mRecoveryCount(0) {
+}
+
+void C2VencRefPlanner::configure(uint32_t layerCount, bool ltrSupported, uint32_t ltrInterval) {
+    if (layerCount < 1)
+        layerCount = 1;
+    if (layerCount > kMaxLayers)
+        layerCount = kMaxLayers;
+    if (layerCount == 3 && !ltrSupported) {
+        //the base layer can not skip the middle layer without long term reference.
+        ALOGW("3 layers need long term reference,use 2 layers");
+        layerCount = 2;
+    }
+    if (layerCount != mLayerCount) {
+        //start the new pattern on a base layer frame.
+        mPosition = 0;
+    }
+    if (!ltrSupported) {
+        mHasLtr = false;
+    }
+    mLayerCount = layerCount;
+    mLtrSupported = ltrSupported;
+    mLtrInterval = ltrInterval;
+    ALOGV("layers:%u ltr:%d interval:%u", mLayerCount, mLtrSupported, mLtrInterval);
+}
+
+void C2VencRefPlanner::setMaxLayer(int32_t maxLayer) {
+    mMaxLayer = maxLayer;
+}
+
+void C2VencRefPlanner::requestIdr() {
+    mIdrPending = true;
+}
+
+void C2VencRefPlanner::requestRecovery() {
+    mRecoveryPending = true;
+}
+
+void C2VencRefPlanner::onKeyFrame() {
+    uint32_t length = 0;
+    getPattern(mLayerCount, &length);
+    //the key frame took the place of a base frame and dropped the old references.
+    mPosition = 1 % length;
+    mBaseSinceLtr = 0;
+    mHasLtr = false;
+}
+
+C2VencRefPlanner::FrameRef_t C2VencRefPlanner::plan() {
+    FrameRef_t ref = {0, false, true, false, false, false};
+    uint32_t length = 0;
+    const int32_t *pattern = getPattern(mLayerCount, &length);
+
+    if (mIdrPending || (mRecoveryPending && !mHasLtr)) {
+        ref.idr = true;
+        ref.markLtr = mLtrSupported;
+        mHasLtr = mLtrSupported;
+        mIdrPending = false;
+        mRecoveryPending = false;
+        mPosition = 1 % length;
+        mBaseSinceLtr = 0;
+        return ref;
+    }
+    if (mRecoveryPending) {
+        //the last long term reference is known good on the receiver side.
+        ref.useLtr = true;
+        ref.markLtr = true;
+        mRecoveryPending = false;
+        mRecoveryCount++;
+        mPosition = 1 % length;
+        mBaseSinceLtr = 0;
+        return ref;
+    }
+
+    ref.layerId = pattern[mPosition];
+    mPosition = (mPosition + 1) % length;
+    ref.reference = (mLayerCount == 1) || (ref.layerId < (int32_t)mLayerCount - 1);
+    if (mMaxLayer >= 0 && ref.layerId > mMaxLayer) {
+        ref.drop = true;
+        mDropCount++;
+        return ref;
+    }
+    if (ref.layerId == 0 && mLtrSupported) {
+        if (mLayerCount == 3) {
+            //the short term reference may be a layer 1 frame.
+            ref.useLtr = mHasLtr;
+            ref.markLtr = true;
+            mHasLtr = true;
+        } else if (mLtrInterval > 0 && ++mBaseSinceLtr >= mLtrInterval) {
+            ref.markLtr = true;
+            mBaseSinceLtr = 0;
+            mHasLtr = true;
+        }
+    }
+    return ref;
+}
+
+}  // namespace android
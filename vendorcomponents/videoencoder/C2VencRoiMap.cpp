@@ -0,0 +1,188 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "C2VencRoiMap"
+#include <utils/Log.h>
+
+#include <string.h>
+
+#include <C2VencRoiMap.h>
+
+namespace android {
+
+#define ROI_QP_MIN      0
+#define ROI_QP_MAX      51
+
+static int64_t clampValue(int64_t value, int64_t min, int64_t max) {
+    if (value < min)
+        return min;
+    if (value > max)
+        return max;
+    return value;
+}
+
+C2VencRoiMap::C2VencRoiMap()
+    : mWidth(0),
+      mHeight(0),
+      mBlockSize(kMapBlockSize),
+      mCols(0),
+      mRows(0),
+      mOffsetsDirty(true),
+      mTableValid(false),
+      mTableBaseQp(0),
+      mTableMinQp(0),
+      mTableMaxQp(0),
+      mRebuildCount(0) {
+}
+
+void C2VencRoiMap::setFrameInfo(uint32_t width, uint32_t height, uint32_t blockSize) {
+    if (blockSize == 0)
+        blockSize = kMapBlockSize;
+    if (width == mWidth && height == mHeight && blockSize == mBlockSize)
+        return;
+    mWidth = width;
+    mHeight = height;
+    mBlockSize = blockSize;
+    mCols = (width + blockSize - 1) / blockSize;
+    mRows = (height + blockSize - 1) / blockSize;
+    mOffsetsDirty = true;
+    mTableValid = false;
+    ALOGV("frame %ux%u block %u -> %ux%u blocks", width, height, blockSize, mCols, mRows);
+}
+
+void C2VencRoiMap::setRegions(const std::vector<Region_t> &regions) {
+    if (regions.size() == mRegions.size()
+        && (regions.empty() || !memcmp(regions.data(), mRegions.data(), regions.size() * sizeof(Region_t)))) {
+        return;
+    }
+    mRegions = regions;
+    mOffsetsDirty = true;
+}
+
+void C2VencRoiMap::setOffsetMap(const int8_t *offsets, uint32_t size) {
+    if (offsets == NULL)
+        size = 0;
+    if (size == mMap.size() && (size == 0 || !memcmp(offsets, mMap.data(), size))) {
+        return;
+    }
+    mMap.assign(offsets, offsets + size);
+    mOffsetsDirty = true;
+}
+
+void C2VencRoiMap::clear() {
+    setRegions(std::vector<Region_t>());
+    setOffsetMap(NULL, 0);
+}
+
+bool C2VencRoiMap::isEnabled() const {
+    return !mRegions.empty() || !mMap.empty();
+}
+
+void C2VencRoiMap::buildOffsets() {
+    uint32_t mapCols = (mWidth + kMapBlockSize - 1) / kMapBlockSize;
+    mOffsets.assign(mCols * mRows, 0);
+
+    if (!mMap.empty() && mapCols > 0) {
+        for (uint32_t by = 0; by < mRows; by++) {
+            uint32_t r0 = by * mBlockSize / kMapBlockSize;
+            uint32_t r1 = ((by + 1) * mBlockSize - 1) / kMapBlockSize;
+            for (uint32_t bx = 0; bx < mCols; bx++) {
+                uint32_t c0 = bx * mBlockSize / kMapBlockSize;
+                uint32_t c1 = ((bx + 1) * mBlockSize - 1) / kMapBlockSize;
+                bool covered = false;
+                int32_t delta = 0;
+                for (uint32_t r = r0; r <= r1; r++) {
+                    for (uint32_t c = c0; c <= c1 && c < mapCols; c++) {
+                        size_t index = (size_t)r * mapCols + c;
+                        if (index >= mMap.size())
+                            continue;
+                        //the lowest delta keeps the quality of a small region.
+                        if (!covered || mMap[index] < delta)
+                            delta = mMap[index];
+                        covered = true;
+                    }
+                }
+                mOffsets[by * mCols + bx] = (int8_t)clampValue(delta, -ROI_QP_MAX, ROI_QP_MAX);
+            }
+        }
+    }
+
+    for (const Region_t &region : mRegions) {
+        int64_t left = clampValue(region.left, 0, mWidth);
+        int64_t top = clampValue(region.top, 0, mHeight);
+        int64_t right = clampValue((int64_t)region.left + region.width, 0, mWidth);
+        int64_t bottom = clampValue((int64_t)region.top + region.height, 0, mHeight);
+        if (right <= left || bottom <= top)
+            continue;
+        int8_t delta = (int8_t)clampValue(region.qpDelta, -ROI_QP_MAX, ROI_QP_MAX);
+        for (uint32_t by = top / mBlockSize; by <= (bottom - 1) / mBlockSize; by++) {
+            memset(&mOffsets[by * mCols + left / mBlockSize], delta,
+                   (right - 1) / mBlockSize - left / mBlockSize + 1);
+        }
+    }
+    mOffsetsDirty = false;
+}
+
+const uint8_t *C2VencRoiMap::getHintTable(int32_t baseQp, int32_t minQp, int32_t maxQp,
+                                          uint32_t *size, bool *updated) {
+    *updated = false;
+    *size = 0;
+    if (mCols == 0 || mRows == 0)
+        return NULL;
+    if (!isEnabled()) {
+        if (!mTableValid)
+            return NULL;
+        //hand out a flat table once,so the encoder drops the last regions.
+        mOffsetsDirty = true;
+    }
+    minQp = clampValue(minQp, ROI_QP_MIN, ROI_QP_MAX);
+    maxQp = clampValue(maxQp, minQp, ROI_QP_MAX);
+    baseQp = clampValue(baseQp, minQp, maxQp);
+
+    if (mTableValid && !mOffsetsDirty && baseQp == mTableBaseQp
+        && minQp == mTableMinQp && maxQp == mTableMaxQp) {
+        *size = mTable.size();
+        return mTable.data();
+    }
+
+    if (mOffsetsDirty) {
+        if (isEnabled())
+            buildOffsets();
+        else
+            mOffsets.assign(mCols * mRows, 0);
+    }
+    std::vector<uint8_t> table(mCols * mRows);
+    for (size_t i = 0; i < table.size(); i++) {
+        table[i] = (uint8_t)clampValue(baseQp + mOffsets[i], minQp, maxQp);
+    }
+    mRebuildCount++;
+    *updated = !mTableValid || table != mTable;
+    mTable.swap(table);
+    mTableBaseQp = baseQp;
+    mTableMinQp = minQp;
+    mTableMaxQp = maxQp;
+    mTableValid = isEnabled();
+    if (!isEnabled()) {
+        //rebuilt from the settings when they come back.
+        mOffsetsDirty = true;
+    }
+    *size = mTable.size();
+    return mTable.data();
+}
+
+}  // namespace android
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "C2VencStats"
+#include <utils/Log.h>
+
+#include <string.h>
+
+#include <C2VencStats.h>
+
+namespace android {
+
+#define STATS_READ_RETRY_MAX    4
+
+static_assert(sizeof(C2VencStats::FrameStats_t) % sizeof(uint64_t) == 0,
+              "frame stats must fill whole slot words");
+
+// static
+std::shared_ptr<C2VencStats> C2VencStats::create(uint32_t capacity) {
+    return std::shared_ptr<C2VencStats>(new C2VencStats(capacity));
+}
+
+C2VencStats::C2VencStats(uint32_t capacity)
+    : mMask(0),
+      mWriteCount(0),
+      mRetryCount(0),
+      mQpSampleInterval(1),
+      mQpSampleCounter(0) {
+    uint32_t size = 1;
+    while (size < capacity && size < (1u << 16)) {
+        size <<= 1;
+    }
+    mMask = size - 1;
+    mSlots.reset(new Slot_t[size]);
+    for (uint32_t i = 0; i < size; i++) {
+        mSlots[i].seq.store(0, std::memory_order_relaxed);
+        for (int j = 0; j < kSlotWords; j++) {
+            mSlots[i].words[j].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void C2VencStats::record(const FrameStats_t &frame) {
+    uint64_t words[kSlotWords];
+    uint64_t pos = mWriteCount.load(std::memory_order_relaxed);
+    Slot_t &slot = mSlots[pos & mMask];
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+
+    memcpy(words, &frame, sizeof(words));
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < kSlotWords; i++) {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.seq.store(seq + 2, std::memory_order_release);
+    mWriteCount.store(pos + 1, std::memory_order_release);
+}
+
+bool C2VencStats::shouldSampleQp() {
+    if (mQpSampleInterval <= 1) {
+        return true;
+    }
+    return (mQpSampleCounter++ % mQpSampleInterval) == 0;
+}
+
+bool C2VencStats::getFrame(uint32_t i, FrameStats_t *frame) const {
+    uint64_t words[kSlotWords];
+    uint64_t count = mWriteCount.load(std::memory_order_acquire);
+    if (i >= count || i > mMask) {
+        return false;
+    }
+    uint64_t pos = count - 1 - i;
+    const Slot_t &slot = mSlots[pos & mMask];
+
+    for (int retry = 0; retry < STATS_READ_RETRY_MAX; retry++) {
+        uint32_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            mRetryCount.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        for (int j = 0; j < kSlotWords; j++) {
+            words[j] = slot.words[j].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq != slot.seq.load(std::memory_order_relaxed)) {
+            mRetryCount.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        //the writer went round the ring since the count was read.
+        if (mWriteCount.load(std::memory_order_acquire) - pos > (uint64_t)mMask + 1) {
+            return false;
+        }
+        memcpy(frame, words, sizeof(words));
+        return true;
+    }
+    return false;
+}
+
+bool C2VencStats::getWindow(uint32_t frames, float frameRate, Window_t *window) const {
+    FrameStats_t frame;
+    uint64_t encodeTimeUs = 0;
+    uint32_t encoded = 0;
+    int64_t qpSum = 0;
+    uint32_t qpCount = 0;
+
+    memset(window, 0, sizeof(*window));
+    window->avgQp = -1;
+    for (uint32_t i = 0; i < frames; i++) {
+        if (!getFrame(i, &frame)) {
+            break;
+        }
+        if (i == 0) {
+            window->targetBitrate = frame.targetBitrate;
+        }
+        window->frames++;
+        if (frame.kind == FRAME_DROPPED) {
+            window->droppedFrames++;
+            continue;
+        }
+        if (frame.kind == FRAME_IDR) {
+            window->idrFrames++;
+        } else {
+            window->pFrames++;
+        }
+        window->totalBytes += frame.sizeBytes;
+        if (frame.sizeBytes > window->maxFrameBytes) {
+            window->maxFrameBytes = frame.sizeBytes;
+        }
+        encodeTimeUs += frame.encodeTimeUs;
+        encoded++;
+        if (frame.encodeTimeUs > window->maxEncodeTimeUs) {
+            window->maxEncodeTimeUs = frame.encodeTimeUs;
+        }
+        if (frame.avgQp >= 0) {
+            qpSum += frame.avgQp;
+            qpCount++;
+        }
+    }
+    if (window->frames == 0) {
+        return false;
+    }
+    if (encoded > 0) {
+        window->avgEncodeTimeUs = (uint32_t)(encodeTimeUs / encoded);
+    }
+    if (qpCount > 0) {
+        window->avgQp = (int32_t)(qpSum / qpCount);
+    }
+    //the dropped frames still take their time slot.
+    if (frameRate > 0) {
+        window->bitrate = (uint32_t)((double)window->totalBytes * 8 * frameRate / window->frames);
+    }
+    if (window->targetBitrate > 0) {
+        window->rcErrorPercent = (int32_t)(((int64_t)window->bitrate - window->targetBitrate) * 100
+                                           / window->targetBitrate);
+    }
+    return true;
+}
+
+}  // namespace android
@@ -34,9 +34,9 @@
 #include <Codec2BufferUtils.h>
 #include <SimpleC2Interface.h>
 #include <util/C2InterfaceHelper.h>
-#include <dlfcn.h>
 #include "C2VendorSupport.h"
 #include "C2VencW420new.h"
+#include "C2VencLibRegistry.h"
 
 namespace android {
 
@@ -62,6 +62,7 @@ uint32_t C2VencW420New::mInstanceID = 0;
 #define DEFAULT_MAX_SRCH_RANGE_X    256
 #define DEFAULT_MAX_SRCH_RANGE_Y    256
 #define DEFAULT_MAX_FRAMERATE       120000
+#define W420_LIB_NAME               "libvp_hevc_codec_new.so"
 #define DEFAULT_NUM_CORES           1
 #define DEFAULT_NUM_CORES_PRE_ENC   0
 #define DEFAULT_FPS                 30
@@ -256,6 +257,13 @@ public:
             .withSetter(Setter<decltype(*mFrameRate)>::StrictValueWithNoDeps)
             .build());
 
+    addParameter(
+            DefineParam(mPriority, C2_PARAMKEY_PRIORITY)
+            .withDefault(new C2RealTimePriorityTuning(0))
+            .withFields({C2F(mPriority, value).any()})
+            .withSetter(Setter<decltype(*mPriority)>::StrictValueWithNoDeps)
+            .build());
+
     addParameter(
             DefineParam(mBitrate, C2_PARAMKEY_BITRATE)
             .withDefault(new C2StreamBitrateInfo::output(0u, 64000))
@@ -361,6 +369,13 @@ public:
             .withSetter(Setter<decltype(*mAverageBlockQuantization)>::StrictValueWithNoDeps)
             .build());
 
+    addParameter(
+            DefineParam(mBackPressure, C2_PARAMKEY_VENDOR_VENC_BACK_PRESSURE)
+            .withDefault(new C2StreamVencBackPressureInfo::output(0u, 0))
+            .withFields({C2F(mBackPressure, value).oneOf({0, 1})})
+            .withSetter(Setter<decltype(*mBackPressure)>::StrictValueWithNoDeps)
+            .build());
+
 
     // TODO: support more formats?
     std::vector<uint32_t> pixelFormats;
@@ -617,6 +632,7 @@ public:
     }
 
     std::shared_ptr<C2StreamPictureSizeInfo::input> getSize() const { return mSize; }
+    std::shared_ptr<C2RealTimePriorityTuning> getPriority() const { return mPriority; }
     std::shared_ptr<C2StreamIntraRefreshTuning::output> getIntraRefresh() const { return mIntraRefresh; }
     std::shared_ptr<C2StreamFrameRateInfo::output> getFrameRate() const { return mFrameRate; }
     std::shared_ptr<C2StreamBitrateInfo::output> getBitrate() const { return mBitrate; }
@@ -629,8 +645,20 @@ public:
     std::shared_ptr<C2StreamSyncFrameIntervalTuning::output> getIFrameInterval() const {return mSyncFramePeriod; }
     void setAverageQp(int value){mAverageBlockQuantization->value = value;}
     void setPictureType(C2Config::picture_type_t type){mPictureType->value = type;}
+    c2_status_t config(
+            const std::vector<C2Param*> &params, c2_blocking_t mayBlock,
+            std::vector<std::unique_ptr<C2SettingResult>>* const failures,
+            bool updateParams = true,
+            std::vector<std::shared_ptr<C2Param>> *changes = nullptr) {
+        c2_status_t result = C2InterfaceHelper::config(params, mayBlock, failures, updateParams, changes);
+        mConfigGeneration++;
+        return result;
+    }
+    int64_t getConfigGeneration() const { return mConfigGeneration.load(); }
 private:
+    std::atomic<int64_t> mConfigGeneration{0};
     std::shared_ptr<C2StreamPictureSizeInfo::input> mSize;
+    std::shared_ptr<C2RealTimePriorityTuning> mPriority;
     std::shared_ptr<C2StreamUsageTuning::input> mUsage;
     std::shared_ptr<C2StreamFrameRateInfo::output> mFrameRate;
     std::shared_ptr<C2StreamRequestSyncFrameTuning::output> mRequestSync;
@@ -645,6 +673,7 @@ private:
     std::shared_ptr<C2StreamPixelFormatInfo::input> mPixelFormat;
     std::shared_ptr<C2AndroidStreamAverageBlockQuantizationInfo::output> mAverageBlockQuantization;
     std::shared_ptr<C2StreamPictureTypeInfo::output> mPictureType;
+    std::shared_ptr<C2StreamVencBackPressureInfo::output> mBackPressure;
 
 };
 
@@ -682,7 +711,8 @@ C2VencW420New::C2VencW420New(const char *name, c2_node_id_t id, const std::share
               //curFrameRateBak(0),
               //mElapsedTime(0),
               mtimeStampBak(0),
-              mFrameRateValue(0) {
+              mFrameRateValue(0),
+              mConfigGeneration(-1) {
     ALOGD("C2VencW420New constructor!");
     propGetInt(CODEC2_VENC_LOGDEBUG_PROPERTY, &gloglevel);
     propGetInt(CODEC2_ONLY_VENC_LOGDEBUG_PROPERTY,&gloglevel_encoder);
@@ -751,73 +781,19 @@ bool C2VencW420New::isSupportCanvas() {
 
 bool C2VencW420New::LoadModule() {
     C2W420_LOG(CODEC2_VENC_LOG_INFO,"C2VencW420New initModule!");
-    void *handle = nullptr;
-    handle = dlopen("libvp_hevc_codec_new.so", RTLD_NOW);
-    if (handle != nullptr) {
-        mInitFunc = NULL;
-        mInitFunc = (fn_hevc_video_encoder_init)dlsym(handle, "vl_video_encoder_init_hevc");
-        if (mInitFunc == NULL) {
-            C2W420_LOG(CODEC2_VENC_LOG_ERR,"dlsym for vl_video_encoder_init_hevc failed");
-            dlclose(handle);
-            return false;
-        }
-
-        mEncHeaderFunc = NULL;
-        mEncHeaderFunc = (fn_hevc_video_encode_header)dlsym(handle, "vl_video_encoder_generate_header");
-        if (mEncHeaderFunc == NULL) {
-            C2W420_LOG(CODEC2_VENC_LOG_ERR,"dlsym for vl_video_encoder_generate_header failed");
-            dlclose(handle);
-            return false;
-        }
-
-        mEncFrameFunc = NULL;
-        mEncFrameFunc = (fn_hevc_video_encoder_encode)dlsym(handle, "vl_video_encoder_encode_hevc");
-        if (mEncFrameFunc == NULL) {
-            C2W420_LOG(CODEC2_VENC_LOG_ERR,"dlsym for vl_video_encoder_encode_hevc failed");
-            dlclose(handle);
-            return false;
-        }
-
-        mEncFrameQpFunc =NULL;
-        mEncFrameQpFunc = (fn_vl_video_encoder_getavgqp)dlsym(handle,"vl_video_encoder_getavgqp");
-        if (mEncFrameQpFunc == NULL) {
-            C2W420_LOG(CODEC2_VENC_LOG_ERR,"dlsym for vl_video_encoder_getavgqp failed");
-            dlclose(handle);
-            return false;
-        }
-
-
-        mEncBitrateChangeFunc = NULL;
-        mEncBitrateChangeFunc = (fn_vl_change_bitrate)dlsym(handle, "vl_video_encoder_change_bitrate_hevc");
-        if (mEncBitrateChangeFunc == NULL) {
-            ALOGE("dlsym for vl_video_encoder_change_bitrate_hevc failed");
-            dlclose(handle);
-            return false;
-        }
-
-        mEncFrameRateChangeFunc = NULL;
-        mEncFrameRateChangeFunc = (fn_vl_change_framerate_hevc)dlsym(handle, "vl_video_encoder_change_framerate_hevc");
-        if (mEncFrameRateChangeFunc == NULL) {
-            ALOGE("dlsym for vl_video_encoder_change_framerate_hevc failed");
-            dlclose(handle);
-            return false;
-        }
-
-        mDestroyFunc = NULL;
-        mDestroyFunc = (fn_hevc_video_encoder_destroy)dlsym(handle,"vl_video_encoder_destroy_hevc");
-        if (mDestroyFunc == NULL) {
-            C2W420_LOG(CODEC2_VENC_LOG_ERR,"dlsym for vl_video_encoder_destroy_hevc failed");
-            dlclose(handle);
-            return false;
-        }
-    } else {
-        C2W420_LOG(CODEC2_VENC_LOG_ERR,"dlopen for libvp_hevc_codec.so failed");
+    C2VencLibRegistry::Symbol_t symbols[] = {
+        {"vl_video_encoder_init_hevc", true, (void **)&mInitFunc},
+        {"vl_video_encoder_generate_header", true, (void **)&mEncHeaderFunc},
+        {"vl_video_encoder_encode_hevc", true, (void **)&mEncFrameFunc},
+        {"vl_video_encoder_getavgqp", true, (void **)&mEncFrameQpFunc},
+        {"vl_video_encoder_change_bitrate_hevc", true, (void **)&mEncBitrateChangeFunc},
+        {"vl_video_encoder_change_framerate_hevc", true, (void **)&mEncFrameRateChangeFunc},
+        {"vl_video_encoder_destroy_hevc", true, (void **)&mDestroyFunc},
+    };
+    if (!C2VencLibRegistry::getInstance().bind(W420_LIB_NAME, symbols, sizeof(symbols) / sizeof(symbols[0]))) {
+        C2W420_LOG(CODEC2_VENC_LOG_ERR,"load libvp_hevc_codec_new.so failed");
         return false;
     }
-    /*
-    * This is the logic, no need to modify, ignore coverity weak cryptor report.
-    */
-    /*coverity[leaked_storage:SUPPRESS]*/
     return true;
 }
 
@@ -903,6 +879,7 @@ c2_status_t C2VencW420New::Init() {
     mCodedColorAspects = mIntfImpl->getCodedColorAspects();
     mProfileLevel = mIntfImpl->getProfileInfo();
     mSyncFramePeriod = mIntfImpl->getIFrameInterval();
+    mConfigGeneration = -1;
     mIDRInterval = (mSyncFramePeriod->value / 1000000) * mFrameRate->value; //max_int:just one i frame,0:all i frame
 
     //getQp(&mEncParams.i_qp_max,&initParam.i_qp_min,&initParam.p_qp_max,&initParam.p_qp_min);
@@ -1078,6 +1055,25 @@ c2_status_t C2VencW420New::getQp(int32_t *i_qp_max,int32_t *i_qp_min,int32_t *p_
 }
 
 
+int64_t C2VencW420New::getConfigGeneration() {
+    return mIntfImpl->getConfigGeneration();
+}
+
+
+C2VencArbiter *C2VencW420New::getArbiter() {
+    return &C2VencArbiter::getInstance(W420_LIB_NAME,1,0);
+}
+
+
+void C2VencW420New::getArbiterSession(C2VencArbiter::Session_t *pSession) {
+    IntfImpl::Lock lock = mIntfImpl->lock();
+    pSession->priority = mIntfImpl->getPriority()->value;
+    pSession->width = mIntfImpl->getSize()->width;
+    pSession->height = mIntfImpl->getSize()->height;
+    pSession->frameRate = mIntfImpl->getFrameRate()->value;
+}
+
+
 c2_status_t C2VencW420New::ProcessOneFrame(InputFrameInfo_t InputFrameInfo,OutputFrameInfo_t *pOutFrameInfo) {
     C2W420_LOG(CODEC2_VENC_LOG_DEBUG,"C2VencMulti ProcessOneFrame! yPlane:%p,uPlane:%p,vPlane:%p",InputFrameInfo.yPlane,InputFrameInfo.uPlane,InputFrameInfo.vPlane);
     encoding_metadata_hevc_t ret;
@@ -1098,12 +1094,19 @@ c2_status_t C2VencW420New::ProcessOneFrame(InputFrameInfo_t InputFrameInfo,Outpu
     }
 
     memset(&inputInfo,0,sizeof(inputInfo));
-    IntfImpl::Lock lock = mIntfImpl->lock();
-    //std::shared_ptr<C2StreamIntraRefreshTuning::output> intraRefresh = mIntfImpl->getIntraRefresh();
-    std::shared_ptr<C2StreamBitrateInfo::output> bitrate = mIntfImpl->getBitrate();
-    std::shared_ptr<C2StreamRequestSyncFrameTuning::output> requestSync = mIntfImpl->getRequestSync();
-    mFrameRate = mIntfImpl->getFrameRate();
-    lock.unlock();
+    int64_t generation = mIntfImpl->getConfigGeneration();
+    if (generation != mConfigGeneration) {
+        //only touch the interface lock when some config was applied since last frame
+        IntfImpl::Lock lock = mIntfImpl->lock();
+        //std::shared_ptr<C2StreamIntraRefreshTuning::output> intraRefresh = mIntfImpl->getIntraRefresh();
+        mCurBitrate = mIntfImpl->getBitrate();
+        mCurRequestSync = mIntfImpl->getRequestSync();
+        mFrameRate = mIntfImpl->getFrameRate();
+        lock.unlock();
+        mConfigGeneration = generation;
+    }
+    std::shared_ptr<C2StreamBitrateInfo::output> bitrate = mCurBitrate;
+    std::shared_ptr<C2StreamRequestSyncFrameTuning::output> requestSync = mCurRequestSync;
 
     frameType = FRAME_TYPE_AUTO;
     if (requestSync != mRequestSync) {
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_C2_VENC_ARBITER_H_
+#define ANDROID_C2_VENC_ARBITER_H_
+
+#include <stdint.h>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace android {
+
+/**
+ * Hands one hardware encoder out to the sessions of the process, frame by
+ * frame.
+ *
+ * A session waits in acquire() before each frame and gives the hardware
+ * back with release(). A free slot goes to the frame which is late by more
+ * than a few frames first, so no session starves, then to the lowest
+ * priority value and then to the frame with the least slack, its deadline
+ * minus the usual encode time of the session.
+ *
+ * The sessions are charged in 16x16 macroblocks per second. When several
+ * sessions ask for more than the budget of the hardware, they are served by
+ * priority and the ones left over are paced to the share of their frame
+ * rate which still fits, the grant tells them so they can lower their load.
+ * A lone session is never paced and a budget of 0 paces nobody.
+ * One arbiter per hardware, an arbiter of no slot lets every frame through.
+ */
+class C2VencArbiter {
+public:
+    typedef struct Session {
+        // 0 is realtime,larger values yield to smaller ones.
+        int32_t priority;
+        uint32_t width;
+        uint32_t height;
+        float frameRate;
+    }Session_t;
+
+    typedef struct Grant {
+        int64_t waitUs;
+        // the session runs below its frame rate because of the budget.
+        bool backPressure;
+    }Grant_t;
+
+    // the arbiter of the hardware behind name,the defaults are used unless
+    // the properties say otherwise,a default budget of 0 leaves pacing to
+    // the property.
+    static C2VencArbiter &getInstance(const char *name, uint32_t defaultSlots, uint64_t defaultMaxMbPerSec);
+
+    C2VencArbiter(uint32_t slots, uint64_t maxMbPerSec);
+
+    // returns the handle of the session.
+    int32_t addSession(const Session_t &session);
+    void updateSession(int32_t handle, const Session_t &session);
+    void removeSession(int32_t handle);
+
+    // wait until the session may encode one frame,which is due in one frame
+    // interval from now.
+    Grant_t acquire(int32_t handle);
+    void release(int32_t handle, int64_t encodeTimeUs);
+
+    bool isEnabled() const { return mSlots > 0; }
+    uint64_t getUsedMbPerSec();
+    // share of its frame rate the session may run at,1 when it is not paced.
+    float getShare(int32_t handle);
+
+    static uint64_t mbPerSec(const Session_t &session);
+
+private:
+    typedef struct Entry {
+        Session_t session;
+        float share;
+        bool waiting;
+        int64_t deadlineUs;
+        uint64_t seq;
+        // a paced session is not served before this.
+        int64_t nextGrantUs;
+        int64_t avgEncodeUs;
+    }Entry_t;
+
+    // recompute the shares after a session came,went or changed.
+    void updateSharesLocked();
+    // the session to serve now,-1 when none,wakeUs is set when a paced one
+    // becomes due later.
+    int32_t pickLocked(int64_t nowUs, int64_t *wakeUs);
+    bool isBeforeLocked(int64_t nowUs, const Entry_t &a, const Entry_t &b);
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::map<int32_t, Entry_t> mSessions;
+    uint32_t mSlots;
+    uint32_t mBusy;
+    uint64_t mMaxMbPerSec;
+    int32_t mNextHandle;
+    uint64_t mSeq;
+};
+
+}  // namespace android
+
+#endif   // ANDROID_C2_VENC_ARBITER_H_
@@ -10,6 +10,8 @@
 //#include <video_codecs.h>
 //#include <video_decode_accelerator.h>
 
+#include <map>
+
 #include <C2Component.h>
 #include <C2ComponentFactory.h>
 #include <C2Config.h>
@@ -25,6 +27,7 @@
 #include "ThreadWorker.h"
 #include <media/stagefright/foundation/Mutexed.h>
 #include "AmlVencInstIntf.h"
+#include "C2VencHeaderCache.h"
 #include <C2VencLogDebug.h>
 
 namespace android {
@@ -85,6 +88,10 @@ private:
             const C2Rect &crop);
     bool doSomeInit();
     void ProcessData();
+    void wakeWorkLoop();
+    // takes the configUpdate of |work| in the interface, returns true with the
+    // encoder params to push before its frame when a setting changed.
+    bool stageConfigUpdate(const std::unique_ptr<C2Work> &work, stVencParam *pParam);
     c2_status_t stop_process();
     void ConfigParam(std::unique_ptr<C2Work> &work);
     void finishWork(uint64_t workIndex, std::unique_ptr<C2Work> &work,stOutputFrame OutFrameInfo);
@@ -126,14 +133,20 @@ private:
     const std::shared_ptr<C2ComponentInterface> mIntf;
     std::list<std::unique_ptr<C2Work>> mQueue;
     bool mIsInit;
-    bool mSpsPpsHeaderReceived;
+    C2VencHeaderCache mHeaderCache;
     uint32_t mOutBufferSize;
     bool mSawInputEOS;
     Mutex mInputQueueLock;
+    // signalled when a work is queued, on drain, flush and exit request.
+    Condition mInputQueueCond;
+    uint32_t mWakeupCount;
+    // encoder params of the queued works by frame index, guarded by mInputQueueLock.
+    std::map<uint64_t, stVencParam> mParamChanges;
+    // staged params were flushed, the encoder catches up with the interface.
+    bool mParamResync;
     Mutex mProcessDoneLock;
     Condition mProcessDoneCond;
     IAmlVencInst *mAmlVencInst;
-    void* mLibHandle;
     C2VencCreateInstance CreateMethod;
     C2VencDestroyInstance DestroyMethod;
     Mutex mDestroyQueueLock;
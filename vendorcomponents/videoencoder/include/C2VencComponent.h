@@ -23,6 +23,9 @@
 #include <SimpleC2Interface.h>
 //#include <util/C2InterfaceHelper.h>
 #include "ThreadWorker.h"
+#include "C2VencDmaMapCache.h"
+#include "C2VencHeaderCache.h"
+#include "C2VencArbiter.h"
 #include <media/stagefright/foundation/Mutexed.h>
 #include <am_gralloc_ext.h>
 #include <C2VencLogDebug.h>
@@ -61,6 +64,8 @@ typedef struct OutputFrameInfo {
     FrameType_e FrameType;
     uint8_t *Data;
     uint32_t Length;
+    // start of the data in the output block.
+    uint32_t Offset;
 }OutputFrameInfo_t;
 
 typedef enum BufferType {
@@ -129,6 +134,8 @@ public:
 
     static void *runWorkLoop(void *arg);
     void *threadLoop();
+    static void *runOutputLoop(void *arg);
+    void *outputLoop();
 
 protected:
     virtual bool LoadModule() = 0;
@@ -140,8 +147,29 @@ protected:
     virtual bool isSupportDMA() = 0;
     virtual bool isSupportCanvas() = 0;
     virtual void Close() = 0;
+    // Bumped by the interface whenever a config is applied, -1 means not tracked
+    // and the input settings are queried again for every frame.
+    virtual int64_t getConfigGeneration() { return -1; }
+    // The header is put before the key frames by the component, for the
+    // encoders which can not do it by themselves.
+    virtual bool isPrependHeader() { return false; }
+    // The arbiter of the hardware the frames are encoded on, the encoders
+    // which do not give one encode without waiting for the others.
+    virtual C2VencArbiter *getArbiter() { return NULL; }
+    virtual void getArbiterSession(C2VencArbiter::Session_t *pSession) { (void)pSession; }
     // The pointer of component listener.
 private:
+    // Input parameters which are needed by every frame, only refreshed
+    // from the interface when the config generation changed.
+    typedef struct InputSettings {
+        bool valid;
+        int64_t generation;
+        uint32_t width;
+        uint32_t height;
+        uint32_t pixelFormat;
+        uint32_t canvasMode;
+    }InputSettings_t;
+
     std::shared_ptr<C2Buffer> createLinearBuffer(
                              const std::shared_ptr<C2LinearBlock> &block, size_t offset, size_t size);
 
@@ -159,15 +187,15 @@ private:
     c2_status_t LinearDataProc(std::shared_ptr<const C2ReadView> view,InputFrameInfo *pFrameInfo);
     c2_status_t GraphicDataProc(std::shared_ptr<C2Buffer> inputBuffer,InputFrameInfo *pFrameInfo);
     c2_status_t CheckPicSize(std::shared_ptr<const C2GraphicView> view,uint64_t frameIndex);
+    c2_status_t getInputSettings(const InputSettings_t **pSettings);
+    void invalidateInputSettings() { mInputSettings.valid = false; }
     bool codecFmtTrans(uint32_t inputCodec,ColorFmt *pOutputCodec);
     void ConfigParam(std::unique_ptr<C2Work> &work);
     void finishWork(uint64_t workIndex, std::unique_ptr<C2Work> &work,OutputFrameInfo_t OutFrameInfo);
     void finish(uint64_t frameIndex, std::function<void(std::unique_ptr<C2Work> &)> fillWork);
     void WorkDone(std::unique_ptr<C2Work> &work);
-    bool IsYUV420(const C2GraphicView &view);
-    bool IsNV12(const C2GraphicView &view);
-    bool IsNV21(const C2GraphicView &view);
-    bool IsI420(const C2GraphicView &view);
+    void queueDoneWork(std::unique_ptr<C2Work> work);
+    void waitOutputDelivered();
     // The state machine enumeration on component thread.
     enum class ComponentState : int32_t {
         // This is the initial state until VDA initialization returns successfully.
@@ -203,7 +231,12 @@ private:
     bool mIsInit;
     int mfdDumpInput;
     int mfdDumpOutput;
-    bool mSpsPpsHeaderReceived;
+    C2VencHeaderCache mHeaderCache;
+    C2VencArbiter *mArbiter;
+    int32_t mArbiterHandle;
+    int64_t mArbiterGeneration;
+    bool mBackPressure;
+    bool mBackPressureChanged;
     uint32_t mOutBufferSize;
     bool mSawInputEOS;
     Mutex mInputQueueLock;
@@ -211,6 +244,17 @@ private:
     bool mDumpEsEnable;
     Mutex mProcessDoneLock;
     Condition mProcessDoneCond;
+    InputSettings_t mInputSettings;
+    C2VencDmaMapCache mDumpMapCache;
+    std::vector<uint8_t> mConvertBuffer;
+    // finished works are handed to the listener from mOutputThread,
+    // so the encode thread can go on with the next frame.
+    ThreadWorker mOutputThread;
+    std::list<std::unique_ptr<C2Work>> mOutputQueue;
+    Mutex mOutputQueueLock;
+    Condition mOutputQueueCond;
+    Condition mOutputDrainedCond;
+    bool mOutputDelivering;
 };
 
 }
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_C2_VENC_DMA_MAP_CACHE_H_
+#define ANDROID_C2_VENC_DMA_MAP_CACHE_H_
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <list>
+
+namespace android {
+
+/**
+ * Keeps cpu mappings of input dma buffers alive between frames.
+ *
+ * Camera and screen record sources cycle through a small set of buffers,
+ * so the mapping is looked up by the identity of the dmabuf (device and
+ * inode of the fd) instead of being created and destroyed for every frame.
+ * A cached mapping holds a reference on the dmabuf, so the cache is bounded
+ * both by entry count and by mapped bytes and the least recently used entry
+ * is dropped first. Not thread safe, only used from the encoder thread.
+ */
+class C2VencDmaMapCache {
+public:
+    C2VencDmaMapCache(uint32_t maxEntries, size_t maxBytes);
+    ~C2VencDmaMapCache();
+
+    // return a read only mapping of at least size bytes, NULL on failure.
+    uint8_t *map(int fd, size_t size);
+    // drop the mapping of the buffer behind fd, if any.
+    void invalidate(int fd);
+    void clear();
+
+    uint32_t getHitCount() const { return mHitCount; }
+    uint32_t getMissCount() const { return mMissCount; }
+
+private:
+    typedef struct MapEntry {
+        dev_t dev;
+        ino_t ino;
+        uint8_t *addr;
+        size_t size;
+    }MapEntry_t;
+
+    bool getIdentity(int fd, dev_t *dev, ino_t *ino);
+    void unmapEntry(MapEntry_t &entry);
+    void trim(size_t incoming);
+
+    // most recently used first
+    std::list<MapEntry_t> mEntries;
+    uint32_t mMaxEntries;
+    size_t mMaxBytes;
+    size_t mMappedBytes;
+    uint32_t mHitCount;
+    uint32_t mMissCount;
+};
+
+}  // namespace android
+
+#endif   // ANDROID_C2_VENC_DMA_MAP_CACHE_H_
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_C2_VENC_FORMAT_CONV_H_
+#define ANDROID_C2_VENC_FORMAT_CONV_H_
+
+#include <stdint.h>
+#include <C2Buffer.h>
+
+namespace android {
+
+/**
+ * Pixel format normalization of yuv420 graphic input for the encoders.
+ *
+ * The encoders take NV12, NV21 and I420 planes directly, as long as the
+ * chroma pitch is what they derive from the luma pitch. Those layouts are
+ * handed over without any copy. Any other 8 bit yuv420 layout is converted
+ * to NV12, with vectorized kernels for the common row operations.
+ */
+class C2VencFormatConv {
+public:
+    enum PassThroughFmt {
+        PASSTHROUGH_NONE,
+        PASSTHROUGH_NV12,
+        PASSTHROUGH_NV21,
+        PASSTHROUGH_I420,
+    };
+
+    static bool IsYUV420(const C2GraphicView &view);
+    static bool IsNV12(const C2GraphicView &view);
+    static bool IsNV21(const C2GraphicView &view);
+    static bool IsI420(const C2GraphicView &view);
+
+    // layout the encoder can read in place, PASSTHROUGH_NONE if a conversion is needed.
+    static PassThroughFmt getPassThroughFmt(const C2GraphicView &view);
+    // convert any 8 bit yuv420 view to NV12 in pDst,chroma follows luma at dstStride * height.
+    static bool convertToNV12(const C2GraphicView &view, uint8_t *pDst, uint32_t dstStride);
+
+    // row kernels, width is in chroma samples.
+    static void interleaveUV(const uint8_t *pU, const uint8_t *pV, uint8_t *pDst, uint32_t width);
+    static void swapUV(const uint8_t *pSrc, uint8_t *pDst, uint32_t width);
+};
+
+}  // namespace android
+
+#endif   // ANDROID_C2_VENC_FORMAT_CONV_H_
@@ -37,6 +37,10 @@ public:
     void getCodecDumpFileName(std::string &strName,DumpFileType_e type) override;
     bool isSupportDMA() override;
     bool isSupportCanvas() override;
+    int64_t getConfigGeneration() override;
+    C2VencArbiter *getArbiter() override;
+    void getArbiterSession(C2VencArbiter::Session_t *pSession) override;
+    bool isPrependHeader() override;
 
 //protected:
     virtual ~C2VencHCodec();
@@ -61,6 +65,8 @@ private:
     std::shared_ptr<C2StreamFrameRateInfo::output> mFrameRate;
     std::shared_ptr<C2StreamBitrateInfo::output> mBitrate;
     std::shared_ptr<C2StreamRequestSyncFrameTuning::output> mRequestSync;
+    std::shared_ptr<C2StreamRequestSyncFrameTuning::output> mCurRequestSync;
+    std::shared_ptr<C2StreamBitrateInfo::output> mCurBitrate;
     std::shared_ptr<C2StreamColorAspectsInfo::output> mColorAspects;
     std::shared_ptr<C2StreamGopTuning::output> mGop;
     std::shared_ptr<C2StreamPixelFormatInfo::input> mPixelFormat;
@@ -85,6 +91,7 @@ private:
     uint32_t mFrameRateValue;
     uint32_t mBitrateBk;
     uint32_t mBitRate;
+    int64_t mConfigGeneration;
     //uint32_t mIInterval;
     //uint32_t mBframes;
 };
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_C2_VENC_HEADER_CACHE_H_
+#define ANDROID_C2_VENC_HEADER_CACHE_H_
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+namespace android {
+
+/**
+ * The codec specific data (SPS/PPS, VPS for HEVC) of the running encoder.
+ *
+ * The encoder libraries write the header to a buffer without being told its
+ * size, so it is generated straight into the output block, which is far
+ * bigger than any header, and kept here with its real size. It is generated
+ * once per encoder init, nothing the client may change at runtime reaches
+ * the header of these libraries.
+ *
+ * For the encoders which do not put the header before key frames by
+ * themselves, the frame is encoded behind some headroom at the front of the
+ * output block and the header is written into the headroom when the frame
+ * turns out to be a key frame, so the frame is never moved.
+ * Not thread safe, only used from the encoder thread.
+ */
+class C2VencHeaderCache {
+public:
+    // write the header to pHeader and its size to pSize.
+    typedef std::function<bool(uint8_t *pHeader, uint32_t *pSize)> Generator_t;
+
+    C2VencHeaderCache();
+
+    // the encoder was inited again,the header is generated on next use.
+    void invalidate();
+    bool isValid() const { return mValid; }
+    // generate the header in buf of capacity bytes and keep a copy of it.
+    bool generate(uint8_t *buf, uint32_t capacity, const Generator_t &gen);
+
+    const uint8_t *data() const { return mData.data(); }
+    uint32_t size() const { return (uint32_t)mData.size(); }
+
+    // bytes to leave in front of a frame which may need the header.
+    uint32_t getHeadroom() const;
+    // write the header right before pFrame unless the frame starts with one,
+    // returns the bytes written.
+    uint32_t prepend(uint8_t *pFrame, uint32_t frameSize, uint32_t headroom);
+
+    uint32_t getPrependCount() const { return mPrependCount; }
+
+private:
+    // header byte of the first nal unit,-1 when there is no start code.
+    static int32_t getFirstNalHeader(const uint8_t *data, uint32_t size);
+
+    std::vector<uint8_t> mData;
+    bool mValid;
+    int32_t mNalHeader;
+    uint32_t mPrependCount;
+};
+
+}  // namespace android
+
+#endif   // ANDROID_C2_VENC_HEADER_CACHE_H_
@@ -107,14 +107,39 @@ private:
 
 private:
     IAmlVencParam *mAmlVencParam;
-    void* mLibHandle;
     C2VencParamCreateInstance mCreateMethod;
     C2VencParamDestroyInstance mDestroyMethod;
     bool Load();
     void unLoad();
+    // fills the encoder params which come from the interface values.
+    void getVencParam(stVencParam *pParam);
+    // pushes the fields which differ from the encoder's current values,a
+    // pending sync frame request is not cleared when KeepPendingSync is set.
+    uint32_t pushVencParam(const stVencParam &NewParam, bool KeepPendingSync);
+    static bool isQpInfoEqual(const stQpInfo &a, const stQpInfo &b);
+    enum {
+        PARAM_CHANGE_SIZE          = 1 << 0,
+        PARAM_CHANGE_BITRATE       = 1 << 1,
+        PARAM_CHANGE_FRAMERATE     = 1 << 2,
+        PARAM_CHANGE_PIXFORMAT     = 1 << 3,
+        PARAM_CHANGE_SYNC_REQUEST  = 1 << 4,
+        PARAM_CHANGE_CANVAS_MODE   = 1 << 5,
+        PARAM_CHANGE_SYNC_PERIOD   = 1 << 6,
+        PARAM_CHANGE_COLOR_ASPECT  = 1 << 7,
+        PARAM_CHANGE_PROFILE_LEVEL = 1 << 8,
+        PARAM_CHANGE_QP            = 1 << 9,
+        PARAM_CHANGE_LAYER_COUNT   = 1 << 10,
+    };
 public:
     static stPicSize mMaxSize;
     void ParamUpdate();
+    // validates params and takes them in the interface without telling the
+    // encoder,the encoder params to apply before the frame go to pParam.
+    c2_status_t stageConfig(const std::vector<C2Param*> &params, stVencParam *pParam);
+    // pushes the encoder params of stageConfig,on the encode thread between frames.
+    void applyStagedParam(const stVencParam &Param);
+    // keeps the params of |params| which differ from the current values.
+    void filterUnchangedParams(const std::vector<C2Param*> &params, std::vector<C2Param*> *changed);
     static bool VencParamChangeListener(void *pInst,stParamChangeIndex Index,void *pParam);
 };
 
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_C2_VENC_INTRA_REFRESH_H_
+#define ANDROID_C2_VENC_INTRA_REFRESH_H_
+
+#include <stdint.h>
+
+namespace android {
+
+/**
+ * Maps the C2 intra refresh period to the refresh arguments of the encoder
+ * and follows the refresh cycles of the encoded frames.
+ *
+ * The C2 period is the number of frames for a full refresh. The encoder
+ * takes how many block rows, block columns or blocks are intra coded in
+ * each frame, so the argument is the picture size in that unit divided by
+ * the period, rounded up. A cycle starts after a key frame and ends on the
+ * frame which completes the refresh, that frame is a clean point for a
+ * decoder which joined or lost data in between.
+ */
+class C2VencIntraRefresh {
+public:
+    // same values as intra_refresh_mode of vl_encode_info_t.
+    typedef enum {
+        MODE_NONE = 0,
+        MODE_ROW = 1,
+        MODE_COLUMN = 2,
+        MODE_STEP = 3,
+    }Mode_e;
+
+    typedef struct CycleInfo {
+        bool enabled;
+        // refresh frame index in the cycle from 1, 0 for a key frame.
+        uint32_t position;
+        uint32_t length;
+        bool cycleStart;
+        bool cycleEnd;
+    }CycleInfo_t;
+
+    C2VencIntraRefresh();
+
+    // periodFrames 0 disables the refresh.
+    void configure(Mode_e mode, uint32_t periodFrames, uint32_t width, uint32_t height,
+                   uint32_t blockSize);
+
+    int32_t getEncoderMode() const { return mMode; }
+    int32_t getEncoderArg() const { return mArg; }
+    // frames to refresh the whole picture with the rounded argument.
+    uint32_t getCycleLength() const { return mCycleLength; }
+    uint32_t getPeriod() const { return mPeriod; }
+
+    // called for each encoded frame.
+    CycleInfo_t onFrameEncoded(bool keyFrame);
+
+private:
+    Mode_e mMode;
+    uint32_t mPeriod;
+    int32_t mArg;
+    uint32_t mCycleLength;
+    uint32_t mPosition;
+};
+
+}  // namespace android
+
+#endif   // ANDROID_C2_VENC_INTRA_REFRESH_H_
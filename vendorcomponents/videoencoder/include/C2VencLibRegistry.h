@@ -0,0 +1,110 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_C2_VENC_LIB_REGISTRY_H_
+#define ANDROID_C2_VENC_LIB_REGISTRY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+
+/**
+ * The encoder libraries of the process.
+ *
+ * Each library is opened once and never closed, the symbols are looked up
+ * once and kept with it, so a new component only copies its function table.
+ *
+ * It also keeps warm encoder contexts: a component which closes an encoder
+ * it did not change at runtime may hand the context over, and the next
+ * session inited with the same settings takes it instead of initing a new
+ * one. The contexts keep the hardware busy, so the pool is off unless
+ * vendor.media.c2.venc.warm_contexts is set, a context is destroyed by a
+ * reaper thread when it was not taken within a few seconds, and all the
+ * contexts of a library are destroyed when its last component goes.
+ */
+class C2VencLibRegistry {
+public:
+    typedef struct Symbol {
+        const char *name;
+        // the bind fails when a required symbol is missing.
+        bool required;
+        void **func;
+    }Symbol_t;
+
+    static C2VencLibRegistry &getInstance();
+
+    // open the library when needed and fill the functions,nothing is
+    // filled when it fails. optional symbols which are missing are NULL.
+    bool bind(const char *libName, const Symbol_t *symbols, size_t count);
+
+    // key holds the settings the context was inited with.
+    void putContext(const char *libName, const void *key, size_t keySize, uintptr_t context,
+                    const std::function<void(uintptr_t)> &destroy);
+    bool takeContext(const char *libName, const void *key, size_t keySize, uintptr_t *context);
+    // destroy all the pooled contexts.
+    void flushContexts();
+    // a component of libName came or went.
+    void addSession(const char *libName);
+    void removeSession(const char *libName);
+
+    uint32_t getOpenCount();
+    size_t getContextCount();
+
+private:
+    typedef struct Library {
+        void *handle;
+        // NULL is kept too,a missing symbol is not looked up again.
+        std::map<std::string, void *> symbols;
+    }Library_t;
+
+    typedef struct Context {
+        std::string libName;
+        std::vector<uint8_t> key;
+        uintptr_t context;
+        std::function<void(uintptr_t)> destroy;
+        int64_t putTimeUs;
+    }Context_t;
+
+    C2VencLibRegistry();
+    // move the contexts which timed out to expired,called locked.
+    void collectExpired(int64_t nowUs, std::list<Context_t> *expired);
+    static void destroyContexts(std::list<Context_t> *contexts);
+    // destroy the contexts as they expire,runs as long as the process.
+    void reaperLoop();
+
+    std::mutex mLock;
+    // signalled when a context is pooled.
+    std::condition_variable mCond;
+    std::map<std::string, Library_t> mLibraries;
+    // in put order,the first one expires first.
+    std::list<Context_t> mContexts;
+    std::map<std::string, uint32_t> mSessions;
+    bool mReaperStarted;
+    uint32_t mMaxContexts;
+    uint32_t mOpenCount;
+};
+
+}  // namespace android
+
+#endif   // ANDROID_C2_VENC_LIB_REGISTRY_H_
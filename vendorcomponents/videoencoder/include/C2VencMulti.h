@@ -5,6 +5,11 @@
 #include <inttypes.h>
 #include <utils/Vector.h>
 #include <C2VencComponent.h>
+#include <C2VencRoiMap.h>
+#include <C2VencRefPlanner.h>
+#include <C2VencIntraRefresh.h>
+#include <C2VencStats.h>
+#include <C2VencRateCtrl.h>
 #include "vp_multi_codec_1_0.h"
 
 
@@ -26,6 +31,10 @@ typedef int (*fn_vl_multi_change_bitrate)(vl_codec_handle_t handle, int bitRate)
 typedef int (*fn_vl_multi_encoder_destroy)(vl_codec_handle_t handle);
 
 typedef int (*fn_vl_multi_encoder_getavgqp)(vl_codec_handle_t handle, int *avg_qp);
+typedef int (*fn_vl_multi_update_qp_hint)(vl_codec_handle_t handle, unsigned char *pq_hint_table, int size);
+typedef int (*fn_vl_multi_longterm_ref)(vl_codec_handle_t handle, int LongtermRefFlags);
+typedef int (*fn_vl_multi_change_qp)(vl_codec_handle_t handle, int minQpI, int maxQpI, int maxDeltaQp,
+                                     int minQpP, int maxQpP, int minQpB, int maxQpB);
 class C2VencMulti:public C2VencComponent {
 public:
     class IntfImpl;
@@ -42,6 +51,10 @@ public:
     void getCodecDumpFileName(std::string &strName,DumpFileType_e type) override;
     bool isSupportDMA() override;
     bool isSupportCanvas() override;
+    int64_t getConfigGeneration() override;
+    C2VencArbiter *getArbiter() override;
+    void getArbiterSession(C2VencArbiter::Session_t *pSession) override;
+    bool isPrependHeader() override;
 
 //protected:
     virtual ~C2VencMulti();
@@ -62,11 +75,25 @@ private:
     void codec2InitQpTbl(qp_param_t *qp_tbl);
     c2_status_t getQp(int32_t *i_qp_max,int32_t *i_qp_min,int32_t *p_qp_max,int32_t *p_qp_min,int32_t *b_qp_max,int32_t *b_qp_min);
     void ParseGop(const C2StreamGopTuning::output &gop,uint32_t *syncInterval, uint32_t *iInterval, uint32_t *maxBframes);
+    // copy the roi settings of the interface, called with the interface locked.
+    void updateRoiSettings();
+    void applyRoiHint();
+    // copy the reference settings of the interface, called with the interface locked.
+    // return true when the client asked for a recovery frame.
+    bool updateRefSettings();
+    // write the statistics ring to /data,enabled by bit 2 of the dump property.
+    void dumpStats();
+    // pick the rate control mode from the interface and the initial encoder settings.
+    void initRateCtrl(vl_encode_info_t *encode_info,qp_param_t *qp_tbl);
+    uint32_t getRcMaxBitrate(C2VencRateCtrl::Mode_e mode,uint32_t targetBitrate);
+    void applyRateDecision(const C2VencRateCtrl::Decision_t &decision);
     std::shared_ptr<C2StreamPictureSizeInfo::input> mSize;
     std::shared_ptr<C2StreamIntraRefreshTuning::output> mIntraRefresh;
     std::shared_ptr<C2StreamFrameRateInfo::output> mFrameRate;
     std::shared_ptr<C2StreamBitrateInfo::output> mBitrate;
     std::shared_ptr<C2StreamRequestSyncFrameTuning::output> mRequestSync;
+    std::shared_ptr<C2StreamRequestSyncFrameTuning::output> mCurRequestSync;
+    std::shared_ptr<C2StreamBitrateInfo::output> mCurBitrate;
     std::shared_ptr<C2StreamColorAspectsInfo::output> mColorAspects;
     std::shared_ptr<C2StreamGopTuning::output> mGop;
     std::shared_ptr<C2StreamPixelFormatInfo::input> mPixelFormat;
@@ -86,11 +113,40 @@ private:
     fn_vl_multi_encoder_getavgqp mEncFrameQpFunc;
     fn_vl_multi_change_bitrate mEncBitrateChangeFunc;
     fn_vl_multi_encoder_destroy mDestroyFunc;
+    // optional,roi is not supported when the library does not export it.
+    fn_vl_multi_update_qp_hint mEncQpHintFunc;
+    // optional,long term reference is not used when the library does not export it.
+    fn_vl_multi_longterm_ref mEncLtrFunc;
+    // optional,only the bitrate is steered when the library does not export it.
+    fn_vl_multi_change_qp mEncQpChangeFunc;
 
     vl_codec_handle_t mCodecHandle;
     uint32_t mIDRInterval;
     uint32_t mBitrateBak;
+    int64_t mConfigGeneration;
     vl_codec_id_t mCodecID;
+    C2VencRoiMap mRoiMap;
+    int32_t mRoiBaseQp;
+    int32_t mRoiQpMin;
+    int32_t mRoiQpMax;
+    C2VencRefPlanner mRefPlanner;
+    bool mLtrEnabled;
+    uint32_t mRefLayerCount;
+    uint32_t mRefLtrInterval;
+    C2VencIntraRefresh mIntraRefreshState;
+    std::shared_ptr<C2VencStats> mStats;
+    bool mDumpStats;
+    C2VencRateCtrl mRateCtrl;
+    uint32_t mRcMaxBitrate;
+    // the settings the encoder was inited with,a warm context is only reused for the same ones.
+    typedef struct WarmKey {
+        vl_codec_id_t codecId;
+        vl_encode_info_t encodeInfo;
+        qp_param_t qpTbl;
+    }WarmKey_t;
+    WarmKey_t mWarmKey;
+    // set once a runtime setting was sent,such an encoder is not kept warm.
+    bool mEncoderChanged;
 };
 
 }
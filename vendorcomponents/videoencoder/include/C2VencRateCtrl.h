@@ -0,0 +1,111 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_C2_VENC_RATE_CTRL_H_
+#define ANDROID_C2_VENC_RATE_CTRL_H_
+
+#include <stdint.h>
+
+namespace android {
+
+/**
+ * Rate control on top of the constant bitrate control of the encoder.
+ *
+ * The encoder keeps running its own rate control, this class only moves
+ * the target bitrate and the qp bounds of it from the size and the average
+ * qp of the encoded frames:
+ * - VBR: the target follows the complexity of the content, measured as the
+ *   short term average qp against the long term one, between half the
+ *   average bitrate and the peak bitrate. The bits spent over or under the
+ *   average pull the target back, and the qp may not go far below the long
+ *   term average so static content does not waste bits.
+ * - capped CRF: the qp is fixed from the quality, and raised while a one
+ *   second buffer drained at the peak bitrate fills up.
+ * - CQ: the qp is fixed from the quality.
+ * All the qp values stay within the limits given to configure().
+ */
+class C2VencRateCtrl {
+public:
+    typedef enum {
+        // the encoder control only,nothing is changed.
+        MODE_CBR = 0,
+        MODE_VBR = 1,
+        MODE_CAPPED_CRF = 2,
+        MODE_CQ = 3,
+    }Mode_e;
+
+    typedef struct Config {
+        Mode_e mode;
+        // average bitrate of VBR.
+        uint32_t targetBitrate;
+        // peak of VBR,cap of capped CRF,bitrate given to the encoder in CQ.
+        uint32_t maxBitrate;
+        float frameRate;
+        // 0 - 100,higher is better,capped CRF and CQ only.
+        int32_t quality;
+        int32_t qpMin;
+        int32_t qpMax;
+    }Config_t;
+
+    typedef struct Decision {
+        bool updateBitrate;
+        uint32_t bitrate;
+        bool updateQp;
+        int32_t iQpMin;
+        int32_t iQpMax;
+        int32_t pQpMin;
+        int32_t pQpMax;
+    }Decision_t;
+
+    C2VencRateCtrl();
+
+    // returns the settings to start the encoder with.
+    Decision_t configure(const Config_t &config);
+    // runtime bitrate or frame rate change of the client.
+    Decision_t setTarget(uint32_t targetBitrate, uint32_t maxBitrate, float frameRate);
+    // avgQp is -1 when it was not queried,a dropped frame has size 0.
+    Decision_t onFrameEncoded(uint32_t sizeBytes, int32_t avgQp, bool keyFrame);
+
+    bool isEnabled() const { return mConfig.mode != MODE_CBR; }
+    Mode_e getMode() const { return mConfig.mode; }
+    uint32_t getBitrate() const { return mBitrate; }
+
+    // quality 0 - 100 to a qp within the limits.
+    static int32_t qualityToQp(int32_t quality, int32_t qpMin, int32_t qpMax);
+
+private:
+    Decision_t makeDecision(bool updateBitrate, bool updateQp) const;
+    void updateVbr(uint32_t bits, int32_t avgQp, bool keyFrame, bool *updateBitrate, bool *updateQp);
+    void updateCappedCrf(uint32_t bits, bool keyFrame, bool *updateQp);
+
+    Config_t mConfig;
+    int32_t mBaseQp;
+    uint32_t mBitrate;
+    int32_t mQpMin;
+    int32_t mQpMax;
+    // bits over (> 0) or under the average bitrate,VBR.
+    double mErrorBits;
+    double mQpShort;
+    double mQpLong;
+    // bits waiting in the buffer drained at the cap,capped CRF.
+    double mBufferBits;
+    int32_t mQpRaise;
+    uint32_t mFramesSinceRaise;
+};
+
+}  // namespace android
+
+#endif   // ANDROID_C2_VENC_RATE_CTRL_H_
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_C2_VENC_REF_PLANNER_H_
+#define ANDROID_C2_VENC_REF_PLANNER_H_
+
+#include <stdint.h>
+
+namespace android {
+
+/**
+ * Plans the temporal layer and the long term reference use of each frame.
+ *
+ * The encoder keeps one short term reference, updated by every frame which
+ * is not droppable, and one long term reference. The layers are built on
+ * top of that: the frames of the top layer are droppable, and with three
+ * layers the base layer frames reference each other through the long term
+ * reference, so a base frame never depends on an enhancement frame.
+ *
+ *   1 layer:  0 0 0 0 ...
+ *   2 layers: 0 1 0 1 ...
+ *   3 layers: 0 2 1 2 0 2 1 2 ...   (needs long term reference)
+ *
+ * Layers above the max layer are dropped without touching the references,
+ * and a recovery request makes the next frame reference the last long term
+ * reference instead of forcing an IDR. Not thread safe, only used from the
+ * encoder thread.
+ */
+class C2VencRefPlanner {
+public:
+    typedef struct FrameRef {
+        int32_t layerId;
+        bool idr;
+        // later frames may reference it, the top layer is droppable.
+        bool reference;
+        bool markLtr;
+        bool useLtr;
+        // above the max layer, not encoded.
+        bool drop;
+    }FrameRef_t;
+
+    static const uint32_t kMaxLayers = 3;
+
+    C2VencRefPlanner();
+
+    // three layers fall back to two without long term reference. ltrInterval
+    // marks every ltrInterval-th base frame as long term reference, 0 only
+    // marks the IDR frames.
+    void configure(uint32_t layerCount, bool ltrSupported, uint32_t ltrInterval);
+    // a negative value keeps all the layers.
+    void setMaxLayer(int32_t maxLayer);
+    void requestIdr();
+    void requestRecovery();
+    // the encoder made a key frame on its own.
+    void onKeyFrame();
+
+    FrameRef_t plan();
+
+    uint32_t getLayerCount() const { return mLayerCount; }
+    bool isLtrEnabled() const { return mLtrSupported; }
+    uint32_t getDropCount() const { return mDropCount; }
+    uint32_t getRecoveryCount() const { return mRecoveryCount; }
+
+private:
+    uint32_t mLayerCount;
+    bool mLtrSupported;
+    uint32_t mLtrInterval;
+    int32_t mMaxLayer;
+    // position in the layer pattern.
+    uint32_t mPosition;
+    // base layer frames since the last long term reference mark.
+    uint32_t mBaseSinceLtr;
+    bool mHasLtr;
+    bool mIdrPending;
+    bool mRecoveryPending;
+    uint32_t mDropCount;
+    uint32_t mRecoveryCount;
+};
+
+}  // namespace android
+
+#endif   // ANDROID_C2_VENC_REF_PLANNER_H_
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_C2_VENC_ROI_MAP_H_
+#define ANDROID_C2_VENC_ROI_MAP_H_
+
+#include <stdint.h>
+#include <vector>
+
+namespace android {
+
+/**
+ * Turns the region of interest settings into the qp hint table of the encoder.
+ *
+ * The client gives a list of rectangles in pixels with a qp delta, and/or a
+ * map of qp deltas on a 16x16 grid in raster order. The map is applied first
+ * and the regions over it, a later region wins where they overlap. The hint
+ * table holds one absolute qp per encoder block (16x16 for avc, 32x32 for
+ * hevc), a grid cell larger than the map cell takes the lowest delta it
+ * covers so the region keeps its quality. The table is only rebuilt when an
+ * input changed, the caller pushes it to the encoder only when told so.
+ * Not thread safe, only used from the encoder thread.
+ */
+class C2VencRoiMap {
+public:
+    typedef struct Region {
+        int32_t left;
+        int32_t top;
+        int32_t width;
+        int32_t height;
+        int32_t qpDelta;
+    }Region_t;
+
+    // cell size of the offset map given by the client.
+    static const uint32_t kMapBlockSize = 16;
+
+    C2VencRoiMap();
+
+    // size of the coded picture and of one encoder block.
+    void setFrameInfo(uint32_t width, uint32_t height, uint32_t blockSize);
+    // an empty list removes the regions.
+    void setRegions(const std::vector<Region_t> &regions);
+    // size 0 removes the map, a short map leaves the rest of the picture untouched.
+    void setOffsetMap(const int8_t *offsets, uint32_t size);
+    void clear();
+
+    bool isEnabled() const;
+    // the qp hint table around baseQp, or NULL when nothing is set. *updated
+    // tells whether it differs from the table returned last time.
+    const uint8_t *getHintTable(int32_t baseQp, int32_t minQp, int32_t maxQp,
+                                uint32_t *size, bool *updated);
+
+    uint32_t getBlockCount() const { return mCols * mRows; }
+    uint32_t getRebuildCount() const { return mRebuildCount; }
+
+private:
+    void buildOffsets();
+
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mBlockSize;
+    uint32_t mCols;
+    uint32_t mRows;
+    std::vector<Region_t> mRegions;
+    std::vector<int8_t> mMap;
+    // per encoder block delta, valid when !mOffsetsDirty.
+    std::vector<int8_t> mOffsets;
+    bool mOffsetsDirty;
+    std::vector<uint8_t> mTable;
+    bool mTableValid;
+    int32_t mTableBaseQp;
+    int32_t mTableMinQp;
+    int32_t mTableMaxQp;
+    uint32_t mRebuildCount;
+};
+
+}  // namespace android
+
+#endif   // ANDROID_C2_VENC_ROI_MAP_H_
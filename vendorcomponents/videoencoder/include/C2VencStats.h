@@ -0,0 +1,112 @@
+/*
+ * Copyright 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_C2_VENC_STATS_H_
+#define ANDROID_C2_VENC_STATS_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+namespace android {
+
+/**
+ * Statistics of the last encoded frames.
+ *
+ * The encoder thread records one entry per frame into a ring of fixed
+ * size, without lock. Any thread may read a window of the last frames: each
+ * slot carries a sequence number which is odd while the slot is written,
+ * and a reader copies the slot again when the number moved under it. The
+ * frame data is stored as relaxed atomic words so a torn copy is never
+ * used.
+ */
+class C2VencStats {
+public:
+    typedef enum {
+        FRAME_P = 0,
+        FRAME_IDR = 1,
+        // not referenced by later frames.
+        FRAME_DROPPABLE = 2,
+        // not encoded at all.
+        FRAME_DROPPED = 3,
+    }FrameKind_e;
+
+    typedef struct FrameStats {
+        int64_t frameIndex;
+        uint32_t sizeBytes;
+        uint32_t encodeTimeUs;
+        uint32_t targetBitrate;
+        // -1 when the qp was not sampled for this frame.
+        int32_t avgQp;
+        uint32_t kind;
+        uint32_t reserved;
+    }FrameStats_t;
+
+    typedef struct Window {
+        uint32_t frames;
+        uint32_t idrFrames;
+        uint32_t pFrames;
+        uint32_t droppedFrames;
+        uint64_t totalBytes;
+        uint32_t maxFrameBytes;
+        uint32_t avgEncodeTimeUs;
+        uint32_t maxEncodeTimeUs;
+        // -1 when no frame of the window was sampled.
+        int32_t avgQp;
+        uint32_t bitrate;
+        uint32_t targetBitrate;
+        // (bitrate - target) * 100 / target
+        int32_t rcErrorPercent;
+    }Window_t;
+
+    // capacity is rounded up to a power of 2.
+    static std::shared_ptr<C2VencStats> create(uint32_t capacity);
+
+    // encoder thread only.
+    void record(const FrameStats_t &frame);
+    // true when the qp of this frame should be queried, 0 or 1 samples all.
+    bool shouldSampleQp();
+    void setQpSampleInterval(uint32_t interval) { mQpSampleInterval = interval; }
+
+    // the last frames frames, frameRate gives the bitrate. false when empty.
+    bool getWindow(uint32_t frames, float frameRate, Window_t *window) const;
+    // frame i from the newest one, false when it is not in the ring any more.
+    bool getFrame(uint32_t i, FrameStats_t *frame) const;
+
+    uint64_t getFrameCount() const { return mWriteCount.load(std::memory_order_acquire); }
+    uint32_t getCapacity() const { return mMask + 1; }
+    uint32_t getRetryCount() const { return mRetryCount.load(std::memory_order_relaxed); }
+
+private:
+    static const int kSlotWords = sizeof(FrameStats_t) / sizeof(uint64_t);
+    typedef struct Slot {
+        std::atomic<uint32_t> seq;
+        std::atomic<uint64_t> words[kSlotWords];
+    }Slot_t;
+
+    explicit C2VencStats(uint32_t capacity);
+
+    std::unique_ptr<Slot_t[]> mSlots;
+    uint32_t mMask;
+    std::atomic<uint64_t> mWriteCount;
+    mutable std::atomic<uint32_t> mRetryCount;
+    uint32_t mQpSampleInterval;
+    uint32_t mQpSampleCounter;
+};
+
+}  // namespace android
+
+#endif   // ANDROID_C2_VENC_STATS_H_